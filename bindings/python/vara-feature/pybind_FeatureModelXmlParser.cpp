@@ -12,6 +12,8 @@ namespace py = pybind11;
 void init_xml_parser(py::module &M) {
   py::class_<vf::FeatureModelXmlParser>(M, "FeatureModelXmlParser")
       .def(py::init<std::string>())
+      .def(py::init<std::string, bool>(), py::arg("xml"),
+           py::arg("streaming"))
       .def("build_feature_model", &vf::FeatureModelXmlParser::buildFeatureModel,
            R"pbdoc(Build a the FeatureModel from the specifed file.
 
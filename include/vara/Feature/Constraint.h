@@ -1,15 +1,21 @@
 #ifndef VARA_FEATURE_CONSTRAINT_H
 #define VARA_FEATURE_CONSTRAINT_H
 
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/SmallVector.h"
 #include "llvm/ADT/StringRef.h"
+#include "llvm/Support/Casting.h"
 #include "llvm/Support/FormatVariadic.h"
+#include "llvm/Support/raw_ostream.h"
 
 #include <cassert>
 #include <memory>
 #include <sstream>
 #include <string>
+#include <type_traits>
 #include <utility>
 #include <variant>
+#include <vector>
 
 namespace vara::feature {
 
@@ -42,6 +48,10 @@ public:
     CK_UNARY,
     CK_NOT,
     CK_NEG,
+    CK_NARY,
+    CK_NARY_OR,
+    CK_NARY_AND,
+    CK_NARY_XOR,
     CK_PRIMARY,
     CK_INTEGER,
     CK_FEATURE
@@ -68,20 +78,40 @@ public:
     return R;
   }
 
-  /// Recursively clones constraint tree. If this tree contains special nodes
-  /// (like \a PrimaryFeatureConstraint) those may need to be updated
-  /// afterwards.
+  /// Clones constraint tree. If this tree contains special nodes (like
+  /// \a PrimaryFeatureConstraint) those may need to be updated afterwards.
   ///
   /// \return root of cloned constraint tree
-  [[nodiscard]] virtual std::unique_ptr<Constraint> clone() = 0;
+  [[nodiscard]] virtual std::unique_ptr<Constraint> clone();
 
-  [[nodiscard]] virtual std::string toString() const = 0;
+  [[nodiscard]] virtual std::string toString() const;
 
-  [[nodiscard]] virtual std::string toHTML() const { return toString(); }
+  [[nodiscard]] virtual std::string toHTML() const;
+
+  /// Print the constraint tree to \p OS.
+  void print(llvm::raw_ostream &OS) const;
+
+  /// Print the constraint tree to \p OS with HTML escaped operators.
+  void printHTML(llvm::raw_ostream &OS) const;
+
+  /// Move the operands out of a constraint, which is destroyed afterwards.
+  ///
+  /// \returns the operands of \p C in order, without a parent
+  static std::vector<std::unique_ptr<Constraint>>
+  releaseOperands(std::unique_ptr<Constraint> C);
 
   virtual void accept(ConstraintVisitor &V) = 0;
 
+protected:
+  /// Destroy all operands of this constraint without recursion, so tearing
+  /// down deep constraint trees cannot overflow the stack.
+  void destroyOperands();
+
 private:
+  static void
+  takeOperands(Constraint &C,
+               std::vector<std::unique_ptr<Constraint>> &Operands);
+
   const ConstraintKind Kind;
   Constraint *Parent{nullptr};
 };
@@ -99,6 +129,7 @@ public:
     this->LeftOperand->setParent(this);
     this->RightOperand->setParent(this);
   }
+  ~BinaryConstraint() override { destroyOperands(); }
 
   [[nodiscard]] Constraint *getLeftOperand() const { return LeftOperand.get(); }
 
@@ -108,7 +139,22 @@ public:
 
   void accept(ConstraintVisitor &V) override;
 
+  /// Create a binary constraint of the given kind.
+  ///
+  /// \returns the new constraint
+  static std::unique_ptr<Constraint>
+  create(ConstraintKind Kind, std::unique_ptr<Constraint> LeftOperand,
+         std::unique_ptr<Constraint> RightOperand);
+
+  static bool classof(const Constraint *C) {
+    return C->getKind() >= ConstraintKind::CK_BINARY &&
+           C->getKind() <= ConstraintKind::CK_GREATEREQUAL;
+  }
+
 protected:
+  friend class Constraint;
+  friend class NaryConstraint;
+
   std::unique_ptr<Constraint> LeftOperand;
   std::unique_ptr<Constraint> RightOperand;
 };
@@ -120,16 +166,6 @@ public:
       : BinaryConstraint(ConstraintKind::CK_OR, std::move(LeftOperand),
                          std::move(RightOperand)) {}
 
-  std::unique_ptr<Constraint> clone() override {
-    return std::make_unique<OrConstraint>(this->getLeftOperand()->clone(),
-                                          this->getRightOperand()->clone());
-  }
-
-  [[nodiscard]] std::string toString() const override {
-    return llvm::formatv("({0} | {1})", LeftOperand->toString(),
-                         RightOperand->toString());
-  }
-
   static bool classof(const Constraint *C) {
     return C->getKind() == ConstraintKind::CK_OR;
   }
@@ -142,16 +178,6 @@ public:
       : BinaryConstraint(ConstraintKind::CK_XOR, std::move(LeftOperand),
                          std::move(RightOperand)) {}
 
-  std::unique_ptr<Constraint> clone() override {
-    return std::make_unique<XorConstraint>(this->getLeftOperand()->clone(),
-                                           this->getRightOperand()->clone());
-  }
-
-  [[nodiscard]] std::string toString() const override {
-    return llvm::formatv("({0} ^ {1})", LeftOperand->toString(),
-                         RightOperand->toString());
-  }
-
   static bool classof(const Constraint *C) {
     return C->getKind() == ConstraintKind::CK_XOR;
   }
@@ -164,21 +190,6 @@ public:
       : BinaryConstraint(ConstraintKind::CK_AND, std::move(LeftOperand),
                          std::move(RightOperand)) {}
 
-  std::unique_ptr<Constraint> clone() override {
-    return std::make_unique<AndConstraint>(this->getLeftOperand()->clone(),
-                                           this->getRightOperand()->clone());
-  }
-
-  [[nodiscard]] std::string toString() const override {
-    return llvm::formatv("({0} & {1})", LeftOperand->toString(),
-                         RightOperand->toString());
-  }
-
-  [[nodiscard]] std::string toHTML() const override {
-    return llvm::formatv("({0} &amp; {1})", LeftOperand->toString(),
-                         RightOperand->toString());
-  }
-
   static bool classof(const Constraint *C) {
     return C->getKind() == ConstraintKind::CK_AND;
   }
@@ -191,16 +202,6 @@ public:
       : BinaryConstraint(ConstraintKind::CK_EQUALS, std::move(LeftOperand),
                          std::move(RightOperand)) {}
 
-  std::unique_ptr<Constraint> clone() override {
-    return std::make_unique<EqualsConstraint>(this->getLeftOperand()->clone(),
-                                              this->getRightOperand()->clone());
-  }
-
-  [[nodiscard]] std::string toString() const override {
-    return llvm::formatv("({0} = {1})", LeftOperand->toString(),
-                         RightOperand->toString());
-  }
-
   static bool classof(const Constraint *C) {
     return C->getKind() == ConstraintKind::CK_EQUALS;
   }
@@ -213,21 +214,6 @@ public:
       : BinaryConstraint(ConstraintKind::CK_IMPLIES, std::move(LeftOperand),
                          std::move(RightOperand)) {}
 
-  std::unique_ptr<Constraint> clone() override {
-    return std::make_unique<ImpliesConstraint>(
-        this->getLeftOperand()->clone(), this->getRightOperand()->clone());
-  }
-
-  [[nodiscard]] std::string toString() const override {
-    return llvm::formatv("({0} => {1})", LeftOperand->toString(),
-                         RightOperand->toString());
-  }
-
-  [[nodiscard]] std::string toHTML() const override {
-    return llvm::formatv("({0} =&gt; {1})", LeftOperand->toString(),
-                         RightOperand->toString());
-  }
-
   static bool classof(const Constraint *C) {
     return C->getKind() == ConstraintKind::CK_IMPLIES;
   }
@@ -240,21 +226,6 @@ public:
       : BinaryConstraint(ConstraintKind::CK_EXCLUDES, std::move(LeftOperand),
                          std::move(RightOperand)) {}
 
-  std::unique_ptr<Constraint> clone() override {
-    return std::make_unique<ExcludesConstraint>(
-        this->getLeftOperand()->clone(), this->getRightOperand()->clone());
-  }
-
-  [[nodiscard]] std::string toString() const override {
-    return llvm::formatv("({0} => !{1})", LeftOperand->toString(),
-                         RightOperand->toString());
-  }
-
-  [[nodiscard]] std::string toHTML() const override {
-    return llvm::formatv("({0} =&gt; !{1})", LeftOperand->toString(),
-                         RightOperand->toString());
-  }
-
   static bool classof(const Constraint *C) {
     return C->getKind() == ConstraintKind::CK_EXCLUDES;
   }
@@ -268,21 +239,6 @@ public:
       : BinaryConstraint(ConstraintKind::CK_EQUIVALENCE, std::move(LeftOperand),
                          std::move(RightOperand)) {}
 
-  std::unique_ptr<Constraint> clone() override {
-    return std::make_unique<EquivalenceConstraint>(
-        this->getLeftOperand()->clone(), this->getRightOperand()->clone());
-  }
-
-  [[nodiscard]] std::string toString() const override {
-    return llvm::formatv("({0} <=> {1})", LeftOperand->toString(),
-                         RightOperand->toString());
-  }
-
-  [[nodiscard]] std::string toHTML() const override {
-    return llvm::formatv("({0} &lt;=&gt; {1})", LeftOperand->toString(),
-                         RightOperand->toString());
-  }
-
   static bool classof(const Constraint *C) {
     return C->getKind() == ConstraintKind::CK_EQUIVALENCE;
   }
@@ -295,16 +251,6 @@ public:
       : BinaryConstraint(ConstraintKind::CK_ADDITION, std::move(LeftOperand),
                          std::move(RightOperand)) {}
 
-  std::unique_ptr<Constraint> clone() override {
-    return std::make_unique<AdditionConstraint>(
-        this->getLeftOperand()->clone(), this->getRightOperand()->clone());
-  }
-
-  [[nodiscard]] std::string toString() const override {
-    return llvm::formatv("({0} + {1})", LeftOperand->toString(),
-                         RightOperand->toString());
-  }
-
   static bool classof(const Constraint *C) {
     return C->getKind() == ConstraintKind::CK_ADDITION;
   }
@@ -318,16 +264,6 @@ public:
       : BinaryConstraint(ConstraintKind::CK_SUBTRACTION, std::move(LeftOperand),
                          std::move(RightOperand)) {}
 
-  std::unique_ptr<Constraint> clone() override {
-    return std::make_unique<SubtractionConstraint>(
-        this->getLeftOperand()->clone(), this->getRightOperand()->clone());
-  }
-
-  [[nodiscard]] std::string toString() const override {
-    return llvm::formatv("({0} - {1})", LeftOperand->toString(),
-                         RightOperand->toString());
-  }
-
   static bool classof(const Constraint *C) {
     return C->getKind() == ConstraintKind::CK_SUBTRACTION;
   }
@@ -341,16 +277,6 @@ public:
       : BinaryConstraint(ConstraintKind::CK_MULTIPLICATION,
                          std::move(LeftOperand), std::move(RightOperand)) {}
 
-  std::unique_ptr<Constraint> clone() override {
-    return std::make_unique<MultiplicationConstraint>(
-        this->getLeftOperand()->clone(), this->getRightOperand()->clone());
-  }
-
-  [[nodiscard]] std::string toString() const override {
-    return llvm::formatv("({0} * {1})", LeftOperand->toString(),
-                         RightOperand->toString());
-  }
-
   static bool classof(const Constraint *C) {
     return C->getKind() == ConstraintKind::CK_MULTIPLICATION;
   }
@@ -363,16 +289,6 @@ public:
       : BinaryConstraint(ConstraintKind::CK_DIVISION, std::move(LeftOperand),
                          std::move(RightOperand)) {}
 
-  std::unique_ptr<Constraint> clone() override {
-    return std::make_unique<DivisionConstraint>(
-        this->getLeftOperand()->clone(), this->getRightOperand()->clone());
-  }
-
-  [[nodiscard]] std::string toString() const override {
-    return llvm::formatv("({0} / {1})", LeftOperand->toString(),
-                         RightOperand->toString());
-  }
-
   static bool classof(const Constraint *C) {
     return C->getKind() == ConstraintKind::CK_DIVISION;
   }
@@ -385,21 +301,6 @@ public:
       : BinaryConstraint(ConstraintKind::CK_LESS, std::move(LeftOperand),
                          std::move(RightOperand)) {}
 
-  std::unique_ptr<Constraint> clone() override {
-    return std::make_unique<LessConstraint>(this->getLeftOperand()->clone(),
-                                            this->getRightOperand()->clone());
-  }
-
-  [[nodiscard]] std::string toString() const override {
-    return llvm::formatv("({0} < {1})", LeftOperand->toString(),
-                         RightOperand->toString());
-  }
-
-  [[nodiscard]] std::string toHTML() const override {
-    return llvm::formatv("({0} &lt; {1})", LeftOperand->toString(),
-                         RightOperand->toString());
-  }
-
   static bool classof(const Constraint *C) {
     return C->getKind() == ConstraintKind::CK_LESS;
   }
@@ -412,21 +313,6 @@ public:
       : BinaryConstraint(ConstraintKind::CK_GREATER, std::move(LeftOperand),
                          std::move(RightOperand)) {}
 
-  std::unique_ptr<Constraint> clone() override {
-    return std::make_unique<GreaterConstraint>(
-        this->getLeftOperand()->clone(), this->getRightOperand()->clone());
-  }
-
-  [[nodiscard]] std::string toString() const override {
-    return llvm::formatv("({0} > {1})", LeftOperand->toString(),
-                         RightOperand->toString());
-  }
-
-  [[nodiscard]] std::string toHTML() const override {
-    return llvm::formatv("({0} &gt; {1})", LeftOperand->toString(),
-                         RightOperand->toString());
-  }
-
   static bool classof(const Constraint *C) {
     return C->getKind() == ConstraintKind::CK_GREATER;
   }
@@ -439,21 +325,6 @@ public:
       : BinaryConstraint(ConstraintKind::CK_LESSEQUAL, std::move(LeftOperand),
                          std::move(RightOperand)) {}
 
-  std::unique_ptr<Constraint> clone() override {
-    return std::make_unique<LessEqualConstraint>(
-        this->getLeftOperand()->clone(), this->getRightOperand()->clone());
-  }
-
-  [[nodiscard]] std::string toString() const override {
-    return llvm::formatv("({0} <= {1})", LeftOperand->toString(),
-                         RightOperand->toString());
-  }
-
-  [[nodiscard]] std::string toHTML() const override {
-    return llvm::formatv("({0} &lt;= {1})", LeftOperand->toString(),
-                         RightOperand->toString());
-  }
-
   static bool classof(const Constraint *C) {
     return C->getKind() == ConstraintKind::CK_LESSEQUAL;
   }
@@ -467,21 +338,6 @@ public:
       : BinaryConstraint(ConstraintKind::CK_GREATEREQUAL,
                          std::move(LeftOperand), std::move(RightOperand)) {}
 
-  std::unique_ptr<Constraint> clone() override {
-    return std::make_unique<GreaterEqualConstraint>(
-        this->getLeftOperand()->clone(), this->getRightOperand()->clone());
-  }
-
-  [[nodiscard]] std::string toString() const override {
-    return llvm::formatv("({0} >= {1})", LeftOperand->toString(),
-                         RightOperand->toString());
-  }
-
-  [[nodiscard]] std::string toHTML() const override {
-    return llvm::formatv("({0} &gt;= {1})", LeftOperand->toString(),
-                         RightOperand->toString());
-  }
-
   static bool classof(const Constraint *C) {
     return C->getKind() == ConstraintKind::CK_GREATEREQUAL;
   }
@@ -493,12 +349,26 @@ public:
       : Constraint(Kind), Operand(std::move(Operand)) {
     this->Operand->setParent(this);
   }
+  ~UnaryConstraint() override { destroyOperands(); }
 
-  Constraint *getOperand() { return Operand.get(); }
+  [[nodiscard]] Constraint *getOperand() const { return Operand.get(); }
 
   void accept(ConstraintVisitor &V) override;
 
+  /// Create a unary constraint of the given kind.
+  ///
+  /// \returns the new constraint
+  static std::unique_ptr<Constraint>
+  create(ConstraintKind Kind, std::unique_ptr<Constraint> Operand);
+
+  static bool classof(const Constraint *C) {
+    return C->getKind() >= ConstraintKind::CK_UNARY &&
+           C->getKind() <= ConstraintKind::CK_NEG;
+  }
+
 protected:
+  friend class Constraint;
+
   std::unique_ptr<Constraint> Operand;
 };
 
@@ -507,14 +377,6 @@ public:
   NotConstraint(std::unique_ptr<Constraint> Operand)
       : UnaryConstraint(ConstraintKind::CK_NOT, std::move(Operand)) {}
 
-  std::unique_ptr<Constraint> clone() override {
-    return std::make_unique<NotConstraint>(this->getOperand()->clone());
-  }
-
-  [[nodiscard]] std::string toString() const override {
-    return llvm::formatv("!{0}", Operand->toString());
-  }
-
   static bool classof(const Constraint *C) {
     return C->getKind() == ConstraintKind::CK_NOT;
   }
@@ -525,24 +387,105 @@ public:
   NegConstraint(std::unique_ptr<Constraint> Operand)
       : UnaryConstraint(ConstraintKind::CK_NEG, std::move(Operand)) {}
 
-  std::unique_ptr<Constraint> clone() override {
-    return std::make_unique<NegConstraint>(this->getOperand()->clone());
+  static bool classof(const Constraint *C) {
+    return C->getKind() == ConstraintKind::CK_NEG;
   }
+};
 
-  [[nodiscard]] std::string toString() const override {
-    return llvm::formatv("~{0}", Operand->toString());
+/// \brief Constraint with an arbitrary number of operands.
+///
+/// Operands are stored contiguously, so long conjunctions or disjunctions do
+/// not degenerate into deep chains of \a BinaryConstraint.
+class NaryConstraint : public Constraint {
+public:
+  using OperandContainerTy = std::vector<std::unique_ptr<Constraint>>;
+
+  NaryConstraint(ConstraintKind Kind, OperandContainerTy Operands)
+      : Constraint(Kind), Operands(std::move(Operands)) {
+    for (auto &Operand : this->Operands) {
+      Operand->setParent(this);
+    }
+  }
+  ~NaryConstraint() override { destroyOperands(); }
+
+  [[nodiscard]] size_t getNumOperands() const { return Operands.size(); }
+
+  [[nodiscard]] Constraint *getOperand(size_t Idx) const {
+    return Operands[Idx].get();
+  }
+
+  [[nodiscard]] llvm::ArrayRef<std::unique_ptr<Constraint>> operands() const {
+    return Operands;
   }
 
+  void accept(ConstraintVisitor &V) override;
+
+  /// Create a n-ary constraint of the given kind.
+  ///
+  /// \returns the new constraint
+  static std::unique_ptr<Constraint> create(ConstraintKind Kind,
+                                            OperandContainerTy Operands);
+
+  /// Convert a chain of binary or, and, or xor constraints into a single
+  /// n-ary constraint. Operands are moved out of the chain, so no deep
+  /// recursion is needed to tear it down. Nested chains of a different kind
+  /// are converted as well; all other constraints are returned unchanged.
+  ///
+  /// \returns the converted constraint
+  static std::unique_ptr<Constraint> flatten(std::unique_ptr<Constraint> C);
+
   static bool classof(const Constraint *C) {
-    return C->getKind() == ConstraintKind::CK_NEG;
+    return C->getKind() >= ConstraintKind::CK_NARY &&
+           C->getKind() <= ConstraintKind::CK_NARY_XOR;
   }
+
+protected:
+  friend class Constraint;
+
+  OperandContainerTy Operands;
 };
 
-class FeatureModelBuilder;
+class NaryOrConstraint : public NaryConstraint, public BooleanConstraint {
+public:
+  NaryOrConstraint(OperandContainerTy Operands)
+      : NaryConstraint(ConstraintKind::CK_NARY_OR, std::move(Operands)) {}
+
+  static bool classof(const Constraint *C) {
+    return C->getKind() == ConstraintKind::CK_NARY_OR;
+  }
+};
+
+class NaryAndConstraint : public NaryConstraint, public BooleanConstraint {
+public:
+  NaryAndConstraint(OperandContainerTy Operands)
+      : NaryConstraint(ConstraintKind::CK_NARY_AND, std::move(Operands)) {}
+
+  static bool classof(const Constraint *C) {
+    return C->getKind() == ConstraintKind::CK_NARY_AND;
+  }
+};
+
+/// \brief N-ary xor, which is satisfied iff an odd number of operands holds.
+class NaryXorConstraint : public NaryConstraint, public BooleanConstraint {
+public:
+  NaryXorConstraint(OperandContainerTy Operands)
+      : NaryConstraint(ConstraintKind::CK_NARY_XOR, std::move(Operands)) {}
+
+  static bool classof(const Constraint *C) {
+    return C->getKind() == ConstraintKind::CK_NARY_XOR;
+  }
+};
+
+class FeatureModel;
 
 class PrimaryConstraint : public Constraint {
 public:
   PrimaryConstraint(ConstraintKind Kind) : Constraint(Kind) {}
+
+  static bool classof(const Constraint *C) {
+    return C->getKind() >= ConstraintKind::CK_PRIMARY &&
+           C->getKind() <= ConstraintKind::CK_FEATURE;
+  }
 };
 
 class PrimaryIntegerConstraint : public PrimaryConstraint {
@@ -595,13 +538,15 @@ public:
   void accept(ConstraintVisitor &V) override;
 
 private:
-  friend FeatureModelBuilder;
+  friend FeatureModel;
 
   std::variant<Feature *, std::unique_ptr<Feature>> FV;
 
   void setFeature(Feature *F) { this->FV = F; }
 };
 
+/// \brief Recursive visitor for constraint trees. Use \a ConstraintWalker for
+/// trees of unbounded depth.
 class ConstraintVisitor {
 public:
   virtual ~ConstraintVisitor() = default;
@@ -613,10 +558,101 @@ public:
 
   virtual void visit(UnaryConstraint *C) { C->getOperand()->accept(*this); }
 
+  virtual void visit(NaryConstraint *C) {
+    for (const auto &Operand : C->operands()) {
+      Operand->accept(*this);
+    }
+  }
+
   virtual void visit(PrimaryIntegerConstraint *C) {}
 
   virtual void visit(PrimaryFeatureConstraint *C) {}
 };
 
+//===----------------------------------------------------------------------===//
+//                           ConstraintWalker Class
+//===----------------------------------------------------------------------===//
+
+/// \brief Depth-first traversal of constraint trees with an explicit stack.
+///
+/// In contrast to \a ConstraintVisitor, the walker does not recurse, so it can
+/// traverse arbitrarily deep constraint trees. Subclasses hook into the
+/// traversal in pre-order, between two operands, and in post-order.
+///
+/// \tparam ConstraintTy either \a Constraint or \a const Constraint
+template <typename ConstraintTy = Constraint> class ConstraintWalker {
+  static_assert(std::is_same_v<std::remove_const_t<ConstraintTy>, Constraint>,
+                "Walker only supports (const) Constraint.");
+
+public:
+  virtual ~ConstraintWalker() = default;
+
+  void walk(ConstraintTy &Root) {
+    struct Frame {
+      ConstraintTy *C;
+      unsigned NextOperand;
+      unsigned NumOperands;
+    };
+    llvm::SmallVector<Frame, 32> Stack;
+    auto Enter = [this, &Stack](ConstraintTy *C) {
+      Stack.push_back({C, 0, preVisit(*C) ? getNumOperands(*C) : 0});
+    };
+
+    Enter(&Root);
+    while (!Stack.empty()) {
+      auto &Top = Stack.back();
+      if (Top.NextOperand == Top.NumOperands) {
+        ConstraintTy *C = Top.C;
+        Stack.pop_back();
+        postVisit(*C);
+        continue;
+      }
+      if (Top.NextOperand > 0) {
+        inVisit(*Top.C, Top.NextOperand);
+      }
+      // Enter invalidates Top, so the operand index is advanced before.
+      ConstraintTy *Operand = getOperand(*Top.C, Top.NextOperand++);
+      Enter(Operand);
+    }
+  }
+
+  /// \returns number of operands of \p C
+  static unsigned getNumOperands(const Constraint &C) {
+    if (llvm::isa<BinaryConstraint>(C)) {
+      return 2;
+    }
+    if (llvm::isa<UnaryConstraint>(C)) {
+      return 1;
+    }
+    if (const auto *N = llvm::dyn_cast<NaryConstraint>(&C); N) {
+      return N->getNumOperands();
+    }
+    return 0;
+  }
+
+  /// \returns operand \p Idx of \p C
+  static Constraint *getOperand(const Constraint &C, unsigned Idx) {
+    if (const auto *B = llvm::dyn_cast<BinaryConstraint>(&C); B) {
+      return Idx == 0 ? B->getLeftOperand() : B->getRightOperand();
+    }
+    if (const auto *U = llvm::dyn_cast<UnaryConstraint>(&C); U) {
+      return U->getOperand();
+    }
+    return llvm::cast<NaryConstraint>(C).getOperand(Idx);
+  }
+
+protected:
+  /// Called before the operands of \p C are walked.
+  ///
+  /// \returns false to skip the operands of \p C
+  virtual bool preVisit(ConstraintTy & /*C*/) { return true; }
+
+  /// Called before operand \p Idx of \p C is walked, except for the first.
+  virtual void inVisit(ConstraintTy & /*C*/, unsigned /*Idx*/) {}
+
+  /// Called after all operands of \p C were walked.
+  virtual void postVisit(ConstraintTy & /*C*/) {}
+};
+
 } // namespace vara::feature
 #endif // VARA_FEATURE_CONSTRAINT_H
@@ -0,0 +1,109 @@
+#ifndef VARA_FEATURE_CONSTRAINTEVALUATOR_H
+#define VARA_FEATURE_CONSTRAINTEVALUATOR_H
+
+#include "vara/Feature/Constraint.h"
+
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/SmallVector.h"
+
+#include <cstdint>
+#include <vector>
+
+namespace vara::feature {
+
+class Feature;
+class FeatureModel;
+
+//===----------------------------------------------------------------------===//
+//                        ConstraintEvaluator Class
+//===----------------------------------------------------------------------===//
+
+/// \brief Evaluates the constraints of a \a FeatureModel under an assignment
+/// of feature values, which is changed one feature at a time.
+///
+/// All constraint trees are flattened into one node array. Each feature keeps
+/// a watch list of the nodes referencing it, so a change only re-evaluates the
+/// paths from these nodes up to their top-level constraints, stopping as soon
+/// as a node keeps its value. Conjunctions, disjunctions and xors count their
+/// satisfied operands, which makes updating them independent of their arity.
+///
+/// Binary features are 1 if selected and 0 otherwise, numeric features take
+/// their value. Initially, only the root feature is selected. The evaluator
+/// works on the constraints present at construction.
+class ConstraintEvaluator {
+public:
+  /// Top-level constraints whose truth value changed with an update.
+  struct ChangeSet {
+    std::vector<const Constraint *> Violated;
+    std::vector<const Constraint *> Satisfied;
+  };
+
+  explicit ConstraintEvaluator(const FeatureModel &FM);
+
+  /// Assign a new value to a feature.
+  ///
+  /// \returns the constraints which became violated or satisfied
+  ChangeSet setValue(const Feature &F, int64_t Value);
+
+  /// Select or deselect a feature.
+  ///
+  /// \returns the constraints which became violated or satisfied
+  ChangeSet select(const Feature &F, bool Selected = true) {
+    return setValue(F, Selected ? 1 : 0);
+  }
+
+  [[nodiscard]] int64_t getValue(const Feature &F) const {
+    return FeatureValues.lookup(&F);
+  }
+
+  /// \returns whether top-level constraint \p C holds, unknown constraints
+  ///          are considered satisfied
+  [[nodiscard]] bool isSatisfied(const Constraint &C) const;
+
+  /// \returns whether all constraints hold
+  [[nodiscard]] bool isSatisfied() const { return NumViolated == 0; }
+
+  [[nodiscard]] unsigned getNumViolated() const { return NumViolated; }
+
+  /// \returns all currently violated top-level constraints
+  [[nodiscard]] std::vector<const Constraint *> getViolated() const;
+
+private:
+  static constexpr unsigned NoParent = ~0U;
+
+  struct Node {
+    Constraint::ConstraintKind Kind;
+    unsigned Parent;
+    unsigned FirstOperand;
+    unsigned NumOperands;
+    /// Number of operands evaluating to true, only maintained for
+    /// conjunctions, disjunctions and xors.
+    unsigned NumTrue;
+    int64_t Value;
+  };
+
+  class NodeBuilder;
+
+  [[nodiscard]] int64_t operandValue(const Node &N, unsigned Idx) const {
+    return Nodes[Operands[N.FirstOperand + Idx]].Value;
+  }
+
+  [[nodiscard]] int64_t compute(const Node &N) const;
+
+  /// Root node index of each top-level constraint.
+  llvm::DenseMap<const Constraint *, unsigned> Roots;
+  llvm::DenseMap<const Feature *, int64_t> FeatureValues;
+  llvm::DenseMap<const Feature *, llvm::SmallVector<unsigned, 4>> Watches;
+  std::vector<Node> Nodes;
+  std::vector<unsigned> Operands;
+  /// Top-level constraint of each root node.
+  llvm::DenseMap<unsigned, const Constraint *> Constraints;
+  /// Root nodes in the order of the constraints in the model.
+  std::vector<unsigned> RootNodes;
+  unsigned NumViolated{0};
+};
+
+} // namespace vara::feature
+
+#endif // VARA_FEATURE_CONSTRAINTEVALUATOR_H
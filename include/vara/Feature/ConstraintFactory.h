@@ -0,0 +1,179 @@
+#ifndef VARA_FEATURE_CONSTRAINTFACTORY_H
+#define VARA_FEATURE_CONSTRAINTFACTORY_H
+
+#include "vara/Feature/Constraint.h"
+
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/FoldingSet.h"
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/Support/Allocator.h"
+
+#include <memory>
+#include <vector>
+
+namespace vara::feature {
+
+class Feature;
+class FeatureModel;
+
+//===----------------------------------------------------------------------===//
+//                          InternedConstraint Class
+//===----------------------------------------------------------------------===//
+
+/// \brief Immutable node of a hash-consed constraint DAG.
+///
+/// Nodes are structurally unique within their \a ConstraintFactory, i.e., two
+/// nodes of the same factory are equal iff their pointers are equal. Every node
+/// carries a dense id which can be used to memoize per node results.
+class InternedConstraint : public llvm::FoldingSetNode {
+  friend class ConstraintFactory;
+
+public:
+  using ConstraintKind = Constraint::ConstraintKind;
+
+  InternedConstraint(const InternedConstraint &) = delete;
+  InternedConstraint &operator=(const InternedConstraint &) = delete;
+  InternedConstraint(InternedConstraint &&) = delete;
+  InternedConstraint &operator=(InternedConstraint &&) = delete;
+  ~InternedConstraint() = default;
+
+  [[nodiscard]] ConstraintKind getKind() const { return Kind; }
+
+  /// Dense id in [0, ConstraintFactory::size()).
+  [[nodiscard]] unsigned getID() const { return ID; }
+
+  [[nodiscard]] llvm::ArrayRef<const InternedConstraint *> operands() const {
+    return Operands;
+  }
+
+  [[nodiscard]] const InternedConstraint *getOperand(unsigned Idx) const {
+    return Operands[Idx];
+  }
+
+  /// \returns the referenced feature, only valid for \a CK_FEATURE nodes
+  [[nodiscard]] Feature *getFeature() const {
+    assert(Kind == ConstraintKind::CK_FEATURE);
+    return F;
+  }
+
+  /// \returns the integer value, only valid for \a CK_INTEGER nodes
+  [[nodiscard]] int getValue() const {
+    assert(Kind == ConstraintKind::CK_INTEGER);
+    return Value;
+  }
+
+  void Profile(llvm::FoldingSetNodeID &ID) const {
+    profile(ID, Kind, Operands, F, Value);
+  }
+
+private:
+  InternedConstraint(ConstraintKind Kind, unsigned ID,
+                     llvm::ArrayRef<const InternedConstraint *> Operands,
+                     Feature *F, int Value)
+      : Kind(Kind), ID(ID), Operands(Operands), F(F), Value(Value) {}
+
+  static void profile(llvm::FoldingSetNodeID &ID, ConstraintKind Kind,
+                      llvm::ArrayRef<const InternedConstraint *> Operands,
+                      Feature *F, int Value) {
+    ID.AddInteger(static_cast<unsigned>(Kind));
+    for (const auto *Op : Operands) {
+      ID.AddPointer(Op);
+    }
+    ID.AddPointer(F);
+    ID.AddInteger(Value);
+  }
+
+  const ConstraintKind Kind;
+  const unsigned ID;
+  const llvm::ArrayRef<const InternedConstraint *> Operands;
+  Feature *const F;
+  const int Value;
+};
+
+//===----------------------------------------------------------------------===//
+//                          ConstraintFactory Class
+//===----------------------------------------------------------------------===//
+
+/// \brief Hash-consing factory for constraints of a \a FeatureModel.
+///
+/// The factory interns constraints structurally, so identical subterms are
+/// stored only once and shared between all constraints that contain them.
+/// Features are resolved by name against the feature model of the factory.
+/// Nodes point to the features of that model, so a factory is created for a
+/// model on demand instead of being kept by the model across modifications.
+class ConstraintFactory {
+public:
+  using ConstraintKind = Constraint::ConstraintKind;
+
+  /// Create a factory without a feature model, which interns all features by
+  /// identity.
+  ConstraintFactory() = default;
+  explicit ConstraintFactory(const FeatureModel &FM) : FM(&FM) {}
+  ConstraintFactory(const ConstraintFactory &) = delete;
+  ConstraintFactory &operator=(const ConstraintFactory &) = delete;
+  ConstraintFactory(ConstraintFactory &&) = delete;
+  ConstraintFactory &operator=(ConstraintFactory &&) = delete;
+  ~ConstraintFactory() = default;
+
+  const InternedConstraint *getFeature(Feature *F);
+
+  const InternedConstraint *getInteger(int Value);
+
+  const InternedConstraint *getUnary(ConstraintKind Kind,
+                                     const InternedConstraint *Operand);
+
+  const InternedConstraint *getBinary(ConstraintKind Kind,
+                                      const InternedConstraint *LeftOperand,
+                                      const InternedConstraint *RightOperand);
+
+  const InternedConstraint *
+  getNary(ConstraintKind Kind,
+          llvm::ArrayRef<const InternedConstraint *> Operands);
+
+  /// Intern a constraint tree. Features which are not part of the feature
+  /// model are interned by identity.
+  ///
+  /// \returns the unique node representing the constraint
+  const InternedConstraint *intern(const Constraint &C);
+
+  /// Create a new constraint tree from an interned node. Feature constraints
+  /// point to the features of the model.
+  ///
+  /// \returns root of the created constraint tree
+  static std::unique_ptr<Constraint> materialize(const InternedConstraint *N);
+
+  /// Create a new constraint tree from an interned node. Feature constraints
+  /// are created by \p CreateFeature.
+  ///
+  /// \returns root of the created constraint tree
+  static std::unique_ptr<Constraint> materialize(
+      const InternedConstraint *N,
+      llvm::function_ref<std::unique_ptr<Constraint>(Feature *)> CreateFeature);
+
+  /// \returns number of unique nodes
+  [[nodiscard]] unsigned size() const { return NumNodes; }
+
+  /// \returns number of nodes that were requested, including shared ones
+  [[nodiscard]] unsigned getNumRequests() const { return NumRequests; }
+
+  /// \returns bytes allocated for nodes and operand lists
+  [[nodiscard]] size_t getMemorySize() const {
+    return Allocator.getTotalMemory();
+  }
+
+private:
+  const InternedConstraint *
+  getOrCreate(ConstraintKind Kind,
+              llvm::ArrayRef<const InternedConstraint *> Operands,
+              Feature *F = nullptr, int Value = 0);
+
+  const FeatureModel *FM{nullptr};
+  llvm::BumpPtrAllocator Allocator;
+  llvm::FoldingSet<InternedConstraint> Nodes;
+  unsigned NumNodes{0};
+  unsigned NumRequests{0};
+};
+
+} // namespace vara::feature
+
+#endif // VARA_FEATURE_CONSTRAINTFACTORY_H
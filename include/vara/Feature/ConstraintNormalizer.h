@@ -0,0 +1,67 @@
+#ifndef VARA_FEATURE_CONSTRAINTNORMALIZER_H
+#define VARA_FEATURE_CONSTRAINTNORMALIZER_H
+
+#include "vara/Feature/Constraint.h"
+
+#include <memory>
+#include <variant>
+#include <vector>
+
+namespace vara::feature {
+
+class Feature;
+class FeatureModel;
+
+//===----------------------------------------------------------------------===//
+//                        ConstraintNormalizer Class
+//===----------------------------------------------------------------------===//
+
+/// \brief Rewrites constraints into a simplified normal form.
+///
+/// The normal form is a negation normal form, i.e., boolean constraints only
+/// consist of conjunctions, disjunctions, xors, equivalences and negated
+/// atoms. Implications and exclusions are expanded, negations are pushed
+/// through xors and equivalences without duplicating operands, chains of
+/// conjunctions and disjunctions are flattened, deduplicated and rebuilt as
+/// n-ary constraints, and constant integer arithmetic is folded. Constraints
+/// which are already implied by the feature tree can be detected and dropped.
+///
+/// Normalized subterms are interned in a \a ConstraintFactory, so duplicates
+/// are found by comparing nodes, and constraints are traversed with explicit
+/// stacks, so deep constraints do not exhaust the call stack.
+class ConstraintNormalizer {
+public:
+  /// A normalized constraint is either a constant truth value or a new
+  /// constraint tree.
+  using NormalizedTy = std::variant<bool, std::unique_ptr<Constraint>>;
+
+  /// \param FM optional feature model, which is used to resolve the features
+  ///           of normalized constraints
+  explicit ConstraintNormalizer(const FeatureModel *FM = nullptr) : FM(FM) {}
+
+  /// Normalize a single constraint.
+  ///
+  /// \returns truth value if the constraint is constant, otherwise the
+  ///          normalized constraint
+  [[nodiscard]] NormalizedTy normalize(const Constraint &C) const;
+
+  /// Checks whether a normalized constraint is always satisfied by the tree
+  /// semantics of its features, e.g., a child implies its parent, a parent
+  /// implies its mandatory children, and alternatives exclude each other.
+  [[nodiscard]] static bool isImpliedByFeatureTree(const Constraint &C);
+
+  /// Normalize all constraints of the feature model. Tautologies, duplicates
+  /// and constraints implied by the feature tree are dropped.
+  ///
+  /// \returns normalized constraints, or only the constant constraint 0 if
+  ///          one of them is unsatisfiable
+  [[nodiscard]] std::vector<std::unique_ptr<Constraint>>
+  normalizeConstraints() const;
+
+private:
+  const FeatureModel *FM;
+};
+
+} // namespace vara::feature
+
+#endif // VARA_FEATURE_CONSTRAINTNORMALIZER_H
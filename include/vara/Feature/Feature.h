@@ -13,6 +13,9 @@
 #include "llvm/IR/Value.h"
 #include "llvm/Support/raw_ostream.h"
 
+#include <functional>
+#include <mutex>
+#include <optional>
 #include <set>
 #include <stack>
 #include <utility>
@@ -90,18 +93,37 @@ public:
 
   //===--------------------------------------------------------------------===//
   // Locations
-  [[nodiscard]] bool hasLocations() const { return !Locations.empty(); }
+
+  /// Creates the locations of a feature, which are loaded on first access.
+  /// Returns std::nullopt if the locations cannot be created.
+  using LocationLoader =
+      std::function<std::optional<std::vector<FeatureSourceRange>>()>;
+
+  [[nodiscard]] bool hasLocations() const {
+    loadLocations();
+    return !Locations.empty();
+  }
+
+  /// \returns true if loading the locations of this feature failed, so it
+  ///          lacks the locations it was created with
+  [[nodiscard]] bool hasLocationError() const {
+    loadLocations();
+    return LocationError;
+  }
 
   void addLocation(FeatureSourceRange &Fsr) {
+    loadLocations();
     Locations.push_back(std::move(Fsr));
   }
   std::vector<FeatureSourceRange>::iterator
   removeLocation(const FeatureSourceRange &Fsr) {
+    loadLocations();
     return Locations.erase(std::find(Locations.begin(), Locations.end(), Fsr));
   }
 
   bool updateLocation(const FeatureSourceRange &OldFsr,
                       FeatureSourceRange NewFsr) {
+    loadLocations();
     auto Loc = std::find(Locations.begin(), Locations.end(), OldFsr);
     if (Loc != Locations.end()) {
       *Loc = std::move(NewFsr);
@@ -111,13 +133,16 @@ public:
   }
 
   [[nodiscard]] std::vector<FeatureSourceRange>::iterator getLocationsBegin() {
+    loadLocations();
     return Locations.begin();
   }
   [[nodiscard]] std::vector<FeatureSourceRange>::iterator getLocationsEnd() {
+    loadLocations();
     return Locations.end();
   }
   using locations_iterator = typename std::vector<FeatureSourceRange>::iterator;
   [[nodiscard]] llvm::iterator_range<locations_iterator> getLocations() {
+    loadLocations();
     return llvm::make_range(Locations.begin(), Locations.end());
   }
 
@@ -187,11 +212,33 @@ protected:
         Name(std::move(Name)), Locations(std::move(Locations)), Opt(Opt) {}
 
 private:
-  void addConstraint(Constraint *C) {
+  /// Defer creating the locations until they are accessed.
+  void setLocationLoader(LocationLoader Loader) {
+    this->Loader = std::move(Loader);
+  }
+
+  void loadLocations() const {
+    std::call_once(LocationsLoaded, [this]() {
+      if (Loader) {
+        if (auto Loaded = Loader(); Loaded) {
+          Locations.insert(Locations.end(),
+                           std::make_move_iterator(Loaded->begin()),
+                           std::make_move_iterator(Loaded->end()));
+        } else {
+          LocationError = true;
+        }
+        Loader = nullptr;
+      }
+    });
+  }
+
+  /// Add a constraint which references this feature, \p Root is the root of
+  /// its constraint tree.
+  void addConstraint(Constraint *C, Constraint &Root) {
     Constraints.push_back(C);
-    if (auto *I = llvm::dyn_cast<ImpliesConstraint>(C->getRoot()); I) {
+    if (auto *I = llvm::dyn_cast<ImpliesConstraint>(&Root); I) {
       Implications.push_back(I);
-    } else if (auto *E = llvm::dyn_cast<ExcludesConstraint>(C->getRoot()); E) {
+    } else if (auto *E = llvm::dyn_cast<ExcludesConstraint>(&Root); E) {
       Excludes.push_back(E);
     }
   }
@@ -211,7 +258,10 @@ private:
 
   const FeatureKind Kind;
   string Name;
-  std::vector<FeatureSourceRange> Locations;
+  mutable std::vector<FeatureSourceRange> Locations;
+  mutable LocationLoader Loader;
+  mutable std::once_flag LocationsLoaded;
+  mutable bool LocationError{false};
   std::vector<Constraint *> Constraints;
   std::vector<ExcludesConstraint *> Excludes;
   std::vector<ImpliesConstraint *> Implications;
@@ -236,6 +286,8 @@ public:
 
 /// Options with numeric values.
 class NumericFeature : public Feature {
+  friend class detail::FeatureModelModification;
+
 public:
   using ValuesVariantType =
       typename std::variant<std::pair<int, int>, std::vector<int>>;
@@ -2,15 +2,22 @@
 #define VARA_FEATURE_FEATUREMODEL_H
 
 #include "vara/Feature/Constraint.h"
+#include "vara/Feature/FeatureOrdering.h"
 #include "vara/Feature/FeatureTreeNode.h"
 #include "vara/Feature/OrderedFeatureVector.h"
 #include "vara/Feature/Relationship.h"
 
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/DenseMap.h"
 #include "llvm/ADT/SmallSet.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/StringMap.h"
 #include "llvm/Support/GraphWriter.h"
 
 #include <algorithm>
+#include <map>
 #include <numeric>
+#include <optional>
 #include <queue>
 #include <utility>
 
@@ -20,6 +27,26 @@ namespace detail {
 class FeatureModelModification;
 } // namespace detail
 
+//===----------------------------------------------------------------------===//
+//                           ConstraintOccurrence
+//===----------------------------------------------------------------------===//
+
+/// \brief Polarity of a feature inside a constraint, i.e., whether selecting
+/// the feature can only help (positive) or only hurt (negative) to satisfy
+/// it. Non-monotone contexts, like equivalences or comparisons, are both.
+enum class OccurrencePolarity : unsigned char {
+  OP_POSITIVE = 1,
+  OP_NEGATIVE = 2,
+  OP_BOTH = OP_POSITIVE | OP_NEGATIVE
+};
+
+/// \brief Occurrence of a feature in a top-level constraint of a
+/// \a FeatureModel.
+struct ConstraintOccurrence {
+  Constraint *C;
+  OccurrencePolarity Polarity;
+};
+
 //===----------------------------------------------------------------------===//
 //                               FeatureModel
 //===----------------------------------------------------------------------===//
@@ -31,26 +58,35 @@ class FeatureModel {
 
 public:
   using FeatureMapTy = llvm::StringMap<std::unique_ptr<Feature>>;
-  using OrderedFeatureTy = OrderedFeatureVector;
+  using OrderedFeatureTy = FeatureOrdering;
   using ConstraintTy = Constraint;
   using ConstraintContainerTy = std::vector<std::unique_ptr<ConstraintTy>>;
   using RelationshipTy = Relationship;
   using RelationshipContainerTy = std::vector<std::unique_ptr<RelationshipTy>>;
+  /// Constraints by their position, which stays valid while other
+  /// constraints are removed, so a removed one can be put back in place.
+  using ConstraintMapTy = std::map<size_t, std::unique_ptr<ConstraintTy>>;
+  using OccurrenceContainerTy = llvm::SmallVector<ConstraintOccurrence, 4>;
 
   FeatureModel(std::string Name, fs::path RootPath, std::string Commit,
                FeatureMapTy Features, ConstraintContainerTy Constraints,
                RelationshipContainerTy Relationships, Feature *Root)
       : Name(std::move(Name)), Path(std::move(RootPath)),
         Commit(std::move(Commit)), Features(std::move(Features)),
-        Constraints(std::move(Constraints)),
         Relationships(std::move(Relationships)), Root(Root) {
     // Insert all values into ordered data structure.
     for (const auto &KV : this->Features) {
       OrderedFeatures.insert(KV.getValue().get());
     }
+    for (auto &C : Constraints) {
+      insertConstraint(std::move(C));
+    }
+    for (size_t I = 0; I < this->Relationships.size(); ++I) {
+      RelationshipPositions[this->Relationships[I].get()] = I;
+    }
   }
 
-  [[nodiscard]] unsigned int size() { return Features.size(); }
+  [[nodiscard]] unsigned int size() const { return Features.size(); }
 
   [[nodiscard]] llvm::StringRef getName() const { return Name; }
 
@@ -64,32 +100,83 @@ public:
 
   //===--------------------------------------------------------------------===//
   // Ordered feature iterator
-  OrderedFeatureVector::ordered_feature_iterator begin() {
+  FeatureOrdering::ordered_feature_iterator begin() {
     return OrderedFeatures.begin();
   }
-  [[nodiscard]] OrderedFeatureVector::const_ordered_feature_iterator
+  [[nodiscard]] FeatureOrdering::const_ordered_feature_iterator
   begin() const {
     return OrderedFeatures.begin();
   }
 
-  OrderedFeatureVector::ordered_feature_iterator end() {
+  FeatureOrdering::ordered_feature_iterator end() {
     return OrderedFeatures.end();
   }
-  [[nodiscard]] OrderedFeatureVector::const_ordered_feature_iterator
+  [[nodiscard]] FeatureOrdering::const_ordered_feature_iterator
   end() const {
     return OrderedFeatures.end();
   }
 
-  llvm::iterator_range<OrderedFeatureVector::ordered_feature_iterator>
+  llvm::iterator_range<FeatureOrdering::ordered_feature_iterator>
   features() {
     return llvm::make_range(begin(), end());
   }
   [[nodiscard]] llvm::iterator_range<
-      OrderedFeatureVector::const_ordered_feature_iterator>
+      FeatureOrdering::const_ordered_feature_iterator>
   features() const {
     return llvm::make_range(begin(), end());
   }
 
+  //===--------------------------------------------------------------------===//
+  // Constraints
+
+  using const_constraint_iterator = llvm::mapped_iterator<
+      ConstraintMapTy::const_iterator,
+      const std::unique_ptr<ConstraintTy> &(*)(
+          const ConstraintMapTy::value_type &)>;
+
+  [[nodiscard]] llvm::iterator_range<const_constraint_iterator>
+  constraints() const {
+    return llvm::make_range(
+        const_constraint_iterator(Constraints.begin(), &getConstraint),
+        const_constraint_iterator(Constraints.end(), &getConstraint));
+  }
+
+  /// Lookup the position of a top-level \a Constraint, which stays the same
+  /// while the constraint is part of this model and is never reused.
+  ///
+  /// \returns the position or std::nullopt if \p C is not part of this model
+  [[nodiscard]] std::optional<size_t>
+  getConstraintPosition(const Constraint &C) const {
+    if (auto Search = ConstraintPositions.find(&C);
+        Search != ConstraintPositions.end()) {
+      return Search->second;
+    }
+    return std::nullopt;
+  }
+
+  /// Lookup the top-level constraint at a position reported by
+  /// \a getConstraintPosition.
+  ///
+  /// \returns the constraint or nullptr if it was removed
+  [[nodiscard]] Constraint *getConstraintAt(size_t Pos) const {
+    auto Search = Constraints.find(Pos);
+    return Search != Constraints.end() ? Search->second.get() : nullptr;
+  }
+
+  /// Lookup all top-level constraints mentioning a \a Feature, each reported
+  /// once with the combined polarity of all occurrences inside.
+  ///
+  /// \param[in] F feature of this model
+  ///
+  /// \returns occurrences of \p F in insertion order of the constraints
+  [[nodiscard]] llvm::ArrayRef<ConstraintOccurrence>
+  getOccurrences(const Feature &F) const {
+    if (auto Search = Occurrences.find(&F); Search != Occurrences.end()) {
+      return Search->second;
+    }
+    return {};
+  }
+
   //===--------------------------------------------------------------------===//
   // Utility
 
@@ -116,12 +203,57 @@ protected:
   fs::path Path;
   std::string Commit;
   FeatureMapTy Features;
-  ConstraintContainerTy Constraints;
+  ConstraintMapTy Constraints;
   RelationshipContainerTy Relationships;
   Feature *Root{nullptr};
 
   FeatureModel() = default;
 
+  /// \brief Binds feature constraints to the features of this model.
+  class FeatureResolver : public ConstraintWalker<> {
+  public:
+    FeatureResolver(const FeatureModel *FM) : FM(FM) {}
+
+    /// \returns false if a constraint referenced an unknown feature
+    [[nodiscard]] bool succeeded() const { return Succeeded; }
+
+    /// Detach all walked feature constraints from their features again.
+    void unbind() {
+      for (auto *P : Bound) {
+        P->getFeature()->removeConstraintNonPreserve(P);
+      }
+      Bound.clear();
+    }
+
+  protected:
+    bool preVisit(Constraint &C) override {
+      // Walks start at the root of a constraint, so features do not need to
+      // search for it.
+      if (!C.getParent()) {
+        Root = &C;
+      }
+      if (auto *P = llvm::dyn_cast<PrimaryFeatureConstraint>(&C); P) {
+        auto *F = FM->getFeature(P->getFeature()->getName());
+        if (!F) {
+          llvm::errs() << "error: Constraint references unknown feature \'"
+                       << P->getFeature()->getName() << "\'.\n";
+          Succeeded = false;
+          return false;
+        }
+        P->setFeature(F);
+        F->addConstraint(P, *Root);
+        Bound.push_back(P);
+      }
+      return true;
+    }
+
+  private:
+    const FeatureModel *FM;
+    Constraint *Root{nullptr};
+    std::vector<PrimaryFeatureConstraint *> Bound;
+    bool Succeeded{true};
+  };
+
 private:
   /// Insert a \a Feature into existing model.
   ///
@@ -131,9 +263,87 @@ private:
   Feature *addFeature(std::unique_ptr<Feature> Feature);
 
   /// Delete a \a Feature.
-  void removeFeature(Feature &Feature);
+  ///
+  /// \returns the removed \a Feature, which can be inserted again
+  std::unique_ptr<Feature> removeFeature(Feature &Feature);
+
+  /// Insert a top-level \a Constraint into existing model. Features are
+  /// looked up by name.
+  ///
+  /// \param[in] Constraint constraint to be inserted
+  /// \param[in] Pos position reported by \a removeConstraint, appended if
+  ///                not given
+  ///
+  /// \returns ptr to inserted \a Constraint or nullptr if it references an
+  ///          unknown feature
+  Constraint *addConstraint(std::unique_ptr<Constraint> Constraint,
+                            std::optional<size_t> Pos = std::nullopt);
+
+  /// Delete a top-level \a Constraint and detach it from its features.
+  ///
+  /// \param[out] Pos position the constraint had among the constraints
+  ///
+  /// \returns the removed \a Constraint or nullptr if it is not part of this
+  ///          model
+  std::unique_ptr<Constraint> removeConstraint(Constraint &C,
+                                               size_t *Pos = nullptr);
+
+  /// Store a top-level \a Constraint at the given position, or behind all
+  /// others, and record its feature occurrences.
+  Constraint *insertConstraint(std::unique_ptr<Constraint> C,
+                               std::optional<size_t> Pos = std::nullopt);
+
+  static const std::unique_ptr<ConstraintTy> &
+  getConstraint(const ConstraintMapTy::value_type &KV) {
+    return KV.second;
+  }
+
+  /// Record all feature occurrences of a top-level \a Constraint.
+  void indexConstraint(Constraint &C);
+
+  /// Insert a \a Relationship, which is linked into the tree by the caller.
+  Relationship *addRelationship(std::unique_ptr<Relationship> R);
+
+  /// Delete a \a Relationship, which was unlinked from the tree by the caller.
+  ///
+  /// \returns the removed \a Relationship, which can be inserted again
+  std::unique_ptr<Relationship> removeRelationship(Relationship &R);
+
+  /// Restore the ordering of a \a Feature and its subtree after it was moved.
+  void reorderFeature(Feature &F);
+
+  /// Take a \a Feature and its subtree out of the ordering in a single pass.
+  void unorderFeature(Feature &F);
+
+  [[nodiscard]] bool isOrderingDeferred() const { return OrderingDeferred; }
+
+  /// Stop maintaining the ordering of features while the model is modified in
+  /// bulk. Iterating features is not allowed until \a restoreOrdering.
+  void deferOrdering() { OrderingDeferred = true; }
+
+  /// Order the features changed since \a deferOrdering again. Only their
+  /// subtrees are reordered, unless they make up a large part of the model,
+  /// which is rebuilt from the tree in a single pass then.
+  void restoreOrdering();
+
+  /// Rebuild the ordering of all features from the tree in a single pass.
+  void rebuildOrdering();
+
+  /// Maintain the ordering of features again without updating it, which is
+  /// only valid if all changes since \a deferOrdering were reverted.
+  void resumeOrdering() {
+    OrderingDeferred = false;
+    Unordered.clear();
+  }
 
   OrderedFeatureTy OrderedFeatures;
+  bool OrderingDeferred{false};
+  /// Features added, removed or moved while the ordering was deferred.
+  llvm::SmallVector<Feature *, 8> Unordered;
+  llvm::DenseMap<const Feature *, OccurrenceContainerTy> Occurrences;
+  llvm::DenseMap<const Constraint *, size_t> ConstraintPositions;
+  size_t NextConstraintPosition{0};
+  llvm::DenseMap<const Relationship *, size_t> RelationshipPositions;
 };
 
 //===----------------------------------------------------------------------===//
@@ -155,6 +365,8 @@ public:
     Children.clear();
   }
 
+  using FeatureModel::getFeature;
+
   /// Try to create a new \a Feature.
   ///
   /// \param[in] FeatureName name of the \a Feature
@@ -182,6 +394,15 @@ public:
     return this;
   }
 
+  /// Create the locations of a \a Feature only when they are first accessed.
+  FeatureModelBuilder *setLocationLoader(const std::string &FeatureName,
+                                         Feature::LocationLoader Loader) {
+    if (auto Search = Features.find(FeatureName); Search != Features.end()) {
+      Search->second->setLocationLoader(std::move(Loader));
+    }
+    return this;
+  }
+
   FeatureModelBuilder *
   emplaceRelationship(Relationship::RelationshipKind RK,
                       const std::vector<std::string> &FeatureNames,
@@ -222,21 +443,6 @@ public:
   std::unique_ptr<FeatureModel> buildFeatureModel();
 
 private:
-  class BuilderVisitor : public ConstraintVisitor {
-
-  public:
-    BuilderVisitor(FeatureModelBuilder *Builder) : Builder(Builder) {}
-
-    void visit(PrimaryFeatureConstraint *C) override {
-      auto *F = Builder->getFeature(C->getFeature()->getName());
-      C->setFeature(F);
-      F->addConstraint(C);
-    };
-
-  private:
-    FeatureModelBuilder *Builder;
-  };
-
   using EdgeMapType = typename llvm::StringMap<llvm::SmallSet<std::string, 3>>;
   using RelationshipEdgeType = typename llvm::StringMap<std::vector<
       std::pair<Relationship::RelationshipKind, std::vector<std::string>>>>;
@@ -274,21 +480,45 @@ inline llvm::raw_ostream &operator<<(llvm::raw_ostream &Out,
   return Out;
 }
 
+namespace vara::feature {
+
+/// \brief Options to render only a part of a feature model as graph.
+struct FeatureModelGraphOptions {
+  /// Name of the feature whose subtree is rendered, the whole model if empty.
+  std::string Root;
+
+  /// Maximal depth of rendered features below the rendered root, unlimited if
+  /// negative. Features with hidden children are drawn dashed.
+  int MaxDepth{-1};
+
+  /// Render groups as a single node listing their members instead of the
+  /// subtrees of the members.
+  bool CollapseGroups{false};
+};
+
+} // namespace vara::feature
+
 namespace llvm {
 
 //===----------------------------------------------------------------------===//
 //                     GraphWriter for FeatureModel
 //===----------------------------------------------------------------------===//
 
+/// Streams the tree of a feature model as DOT. Nodes are emitted in a single
+/// iterative pass, so writing is linear in the size of the rendered part and
+/// does not recurse with the depth of the model.
 template <> struct GraphWriter<vara::feature::FeatureModel *> {
   using GraphType = typename vara::feature::FeatureModel *;
 
   raw_ostream &O;
   const GraphType &G;
+  vara::feature::FeatureModelGraphOptions Options;
 
   using NodeRef = typename vara::feature::FeatureTreeNode *;
 
-  GraphWriter(raw_ostream &O, const GraphType &G, bool SN) : O(O), G(G) {}
+  GraphWriter(raw_ostream &O, const GraphType &G, bool SN,
+              vara::feature::FeatureModelGraphOptions Options = {})
+      : O(O), G(G), Options(std::move(Options)) {}
 
   void writeGraph(const std::string &Title = "") {
     // Output the header for the graph
@@ -318,105 +548,171 @@ template <> struct GraphWriter<vara::feature::FeatureModel *> {
   }
 
   /// Output tree structure of feature model and additional edges.
-  void writeNodes() { emitCluster(G->getRoot()); }
+  void writeNodes() {
+    NodeRef Start = Options.Root.empty() ? G->getRoot()
+                                         : G->getFeature(Options.Root);
+    if (Start) {
+      emitCluster(Start);
+    }
+  }
 
   void writeFooter() { O << "}\n"; }
 
-  using FeatureEdgeSetTy = llvm::SmallSet<
-      std::pair<vara::feature::Feature *, vara::feature::Feature *>, 10>;
-
-  /// Checks whether an edge would be a duplicate.
+  /// Output feature model (tree) starting at \p Start.
   ///
-  /// \param[in] Edge may be already visited.
-  /// \param[in] Skip contains existing edges.
-  static bool
-  visited(std::pair<vara::feature::Feature *, vara::feature::Feature *> Edge,
-          const FeatureEdgeSetTy &Skip) {
-    return std::any_of(Skip.begin(), Skip.end(), [Edge](const auto &P) {
-      return P.first == Edge.first && P.second == Edge.second;
-    });
-  }
-
-  /// Output feature model (tree) recursively.
-  ///
-  /// \param[in] Node Root of subtree.
-  /// \param[in] Indent Value to indent statements in dot file.
-  void emitCluster(NodeRef Node, const int Indent = 0) {
-    O.indent(Indent);
-    emitNode(Node);
-    if (Node->begin() != Node->end()) {
+  /// Each node with visible children opens a cluster, which is closed after
+  /// the last child has been emitted. Open clusters are kept on an explicit
+  /// stack instead of the call stack.
+  void emitCluster(NodeRef Start) {
+    struct Frame {
+      NodeRef Node;
+      decltype(std::declval<NodeRef>()->begin()) Next;
+      int Indent;
+      int Depth;
+    };
+    llvm::SmallVector<Frame, 16> Stack;
+
+    // Emits a node and opens its cluster. Returns true if the cluster has to
+    // be filled with the children of the node.
+    auto Enter = [this, &Stack](NodeRef Node, int Indent, int Depth) {
+      bool HasChildren = Node->begin() != Node->end();
+      bool Expand = HasChildren && isExpanded(Node, Depth);
+      O.indent(Indent);
+      emitNode(Node, HasChildren && !Expand);
+      if (!Expand) {
+        return false;
+      }
       O.indent(Indent + 2) << "subgraph cluster_" << static_cast<void *>(Node)
                            << " {\n";
       O.indent(Indent + 4) << "label=\"\";\n";
       O.indent(Indent + 4) << "margin=0;\n";
       O.indent(Indent + 4) << "style=invis;\n";
-      for (auto *Child : *Node) {
-        emitCluster(Child, Indent + 2);
-        O.indent(Indent + 2);
-        if (auto *F = llvm::dyn_cast<vara::feature::Feature>(Child); F) {
-          emitEdge(
-              Node, F,
-              llvm::formatv("arrowhead={0}", F->isOptional() ? "odot" : "dot"));
-        } else {
-          emitEdge(Node, Child, "arrowhead=none");
+      Stack.push_back({Node, Node->begin(), Indent, Depth});
+      return true;
+    };
+
+    // Closes the cluster on top of the stack.
+    auto Leave = [this, &Stack]() {
+      Frame Top = Stack.pop_back_val();
+      O.indent(Top.Indent + 4) << "{\n";
+      O.indent(Top.Indent + 6) << "rank=same;\n";
+      for (auto *Child : *Top.Node) {
+        O.indent(Top.Indent + 6)
+            << "node_" << static_cast<void *>(Child) << ";\n";
+      }
+      O.indent(Top.Indent + 4) << "}\n";
+      O.indent(Top.Indent + 2) << "}\n";
+      return Top.Node;
+    };
+
+    Enter(Start, 0, 0);
+    while (!Stack.empty()) {
+      Frame &Top = Stack.back();
+      if (Top.Next == Top.Node->end()) {
+        NodeRef Child = Leave();
+        if (!Stack.empty()) {
+          emitChildEdge(Stack.back().Node, Child, Stack.back().Indent);
         }
+        continue;
       }
-      O.indent(Indent + 4) << "{\n";
-      O.indent(Indent + 6) << "rank=same;\n";
-      for (auto *Child : *Node) {
-        O.indent(Indent + 6) << "node_" << static_cast<void *>(Child) << ";\n";
+      NodeRef Parent = Top.Node;
+      NodeRef Child = *Top.Next++;
+      int Indent = Top.Indent;
+      int Depth = Top.Depth + llvm::isa<vara::feature::Feature>(Child);
+      if (!Enter(Child, Indent + 2, Depth)) {
+        emitChildEdge(Parent, Child, Indent);
       }
-      O.indent(Indent + 4) << "}\n";
-      O.indent(Indent + 2) << "}\n";
     }
   }
 
+  /// Checks whether the children of \p Node are rendered.
+  [[nodiscard]] bool isExpanded(NodeRef Node, int Depth) const {
+    if (llvm::isa<vara::feature::Relationship>(Node)) {
+      return !Options.CollapseGroups;
+    }
+    return Options.MaxDepth < 0 || Depth < Options.MaxDepth;
+  }
+
   /// Output \a Feature node with custom attributes.
-  void emitNode(NodeRef Node) {
-    std::string Label;
-    std::string Shape;
+  ///
+  /// \param[in] Node Node to output.
+  /// \param[in] Truncated Whether children of the node are hidden.
+  void emitNode(NodeRef Node, bool Truncated = false) {
+    O.indent(2) << "node_" << static_cast<void *>(Node) << " [";
+    if (auto *F = llvm::dyn_cast<vara::feature::Feature>(Node); F) {
+      O << "shape=box";
+    } else {
+      O << "shape=ellipse";
+    }
+    O << " margin=.1 fontsize=12 fontname=\"CMU Typewriter\"";
+    if (Truncated && llvm::isa<vara::feature::Feature>(Node)) {
+      O << " style=dashed";
+    }
+    O << " label=";
+    emitLabel(Node);
+    O << "];\n";
+  }
+
+  /// Output the label of \p Node.
+  void emitLabel(NodeRef Node) {
+    constexpr const char *TableStart =
+        "<<table align=\"center\" valign=\"middle\" border=\"0\" "
+        "cellborder=\"0\" cellpadding=\"5\">";
+    constexpr const char *TableEnd = "</table>>";
+
     if (auto *F = llvm::dyn_cast<vara::feature::Feature>(Node); F) {
-      Shape = "box";
-      std::stringstream CS;
+      O << TableStart << "<tr><td><b>" << DOT::EscapeString(F->getName().str())
+        << "</b></td></tr>";
       for (const auto &C : F->constraints()) {
-        CS << "<tr><td>" << DOT::EscapeString(C->getRoot()->toHTML())
-           << "</td></tr>";
+        O << "<tr><td>" << DOT::EscapeString(C->getRoot()->toHTML())
+          << "</td></tr>";
       }
-      Label = llvm::formatv(
-          "<<table align=\"center\" valign=\"middle\" border=\"0\" "
-          "cellborder=\"0\" "
-          "cellpadding=\"5\">{0}{1}{2}</table>>",
-          llvm::formatv("<tr><td><b>{0}</b></td></tr>",
-                        DOT::EscapeString(F->getName().str())),
-          CS.str(),
-          (F->hasLocations() ? llvm::formatv("<hr/><tr><td>{0}</td></tr>",
-                                             DOT::EscapeString(""))
-                                   .str()
-                             : ""));
-    } else {
-      Shape = "ellipse";
-      if (auto *R = llvm::dyn_cast<vara::feature::Relationship>(Node); R) {
-        switch (R->getKind()) {
-        case vara::feature::Relationship::RelationshipKind::RK_ALTERNATIVE:
-          Label = "ALTERNATIVE";
-          break;
-        case vara::feature::Relationship::RelationshipKind::RK_OR:
-          Label = "OR";
-          break;
-        }
-      } else {
-        Label = "error";
+      if (F->hasLocations()) {
+        O << "<hr/><tr><td></td></tr>";
       }
+      O << TableEnd;
+      return;
+    }
+
+    auto *R = llvm::dyn_cast<vara::feature::Relationship>(Node);
+    if (!R) {
+      O << "error";
+      return;
+    }
+    llvm::StringRef Kind;
+    switch (R->getKind()) {
+    case vara::feature::Relationship::RelationshipKind::RK_ALTERNATIVE:
+      Kind = "ALTERNATIVE";
+      break;
+    case vara::feature::Relationship::RelationshipKind::RK_OR:
+      Kind = "OR";
+      break;
+    }
+    if (!Options.CollapseGroups) {
+      O << Kind;
+      return;
+    }
+    O << TableStart << "<tr><td><b>" << Kind << "</b></td></tr>";
+    for (auto *Child : *R) {
+      if (auto *F = llvm::dyn_cast<vara::feature::Feature>(Child); F) {
+        O << "<tr><td>" << DOT::EscapeString(F->getName().str())
+          << "</td></tr>";
+      }
+    }
+    O << TableEnd;
+  }
+
+  /// Output the tree edge from \p Parent to \p Child.
+  void emitChildEdge(NodeRef Parent, NodeRef Child, int Indent) {
+    O.indent(Indent + 2);
+    if (auto *F = llvm::dyn_cast<vara::feature::Feature>(Child); F) {
+      emitEdge(Parent, F, F->isOptional() ? "arrowhead=odot" : "arrowhead=dot");
+    } else {
+      emitEdge(Parent, Child, "arrowhead=none");
     }
-    O.indent(2) << "node_" << static_cast<void *>(Node) << " ["
-                << "shape=" << Shape
-                << " margin=.1 fontsize=12 fontname=\"CMU "
-                   "Typewriter\" label="
-                << Label << "];\n";
   }
 
-  void emitEdge(NodeRef SrcNode, NodeRef DestNode,
-                const std::string &Attrs = "") {
+  void emitEdge(NodeRef SrcNode, NodeRef DestNode, llvm::StringRef Attrs = "") {
     O.indent(2) << "node_" << static_cast<void *>(SrcNode) << " -> node_"
                 << static_cast<void *>(DestNode);
     if (!Attrs.empty()) {
@@ -434,29 +730,51 @@ namespace vara::feature {
 //                        FeatureModelConsistencyRules
 //===----------------------------------------------------------------------===//
 
+/// \brief Checks a FeatureModel against a set of consistency rules.
+///
+/// Every rule checks the whole model with \a check(FM) and a single Feature
+/// with \a check(FM, F), so a change to a consistent model can be verified by
+/// checking only the Features it touched.
 template <typename... Rules> class FeatureModelConsistencyChecker {
 public:
   static bool isFeatureModelValid(FeatureModel &FM) {
     return (Rules::check(FM) && ... && true);
   }
+
+  /// Check only the given Features of a model, which is sufficient if the
+  /// model was consistent before they were changed.
+  template <typename FeatureRangeTy>
+  static bool areFeaturesValid(FeatureModel &FM, FeatureRangeTy &&Features) {
+    return std::all_of(std::begin(Features), std::end(Features),
+                       [&FM](Feature *F) {
+                         return (Rules::check(FM, *F) && ... && true);
+                       });
+  }
 };
 
 struct EveryFeatureRequiresParent {
   static bool check(FeatureModel &FM) {
-    return std::all_of(FM.begin(), FM.end(), [](Feature *F) {
-      return llvm::isa<RootFeature>(F) || F->getParentFeature();
-    });
+    return std::all_of(FM.begin(), FM.end(),
+                       [&FM](Feature *F) { return check(FM, *F); });
+  }
+
+  static bool check(FeatureModel & /*FM*/, Feature &F) {
+    return llvm::isa<RootFeature>(F) || F.getParentFeature();
   }
 };
 
 struct CheckFeatureParentChildRelationShip {
   static bool check(FeatureModel &FM) {
-    return std::all_of(FM.begin(), FM.end(), [](Feature *F) {
-      return llvm::isa<RootFeature>(F) ||
-             // Every parent of a Feature needs to have it as a child.
-             std::any_of(F->getParent()->begin(), F->getParent()->end(),
-                         [F](FeatureTreeNode *Child) { return F == Child; });
-    });
+    return std::all_of(FM.begin(), FM.end(),
+                       [&FM](Feature *F) { return check(FM, *F); });
+  }
+
+  static bool check(FeatureModel & /*FM*/, Feature &F) {
+    return llvm::isa<RootFeature>(F) ||
+           // Every parent of a Feature needs to have it as a child.
+           (F.getParent() &&
+            std::any_of(F.getParent()->begin(), F.getParent()->end(),
+                        [&F](FeatureTreeNode *Child) { return &F == Child; }));
   }
 };
 
@@ -468,6 +786,12 @@ struct ExactlyOneRootNode {
                                   return Sum + llvm::isa<RootFeature>(F);
                                 });
   }
+
+  /// A changed Feature must not be a second root.
+  static bool check(FeatureModel &FM, Feature &F) {
+    return llvm::isa_and_nonnull<RootFeature>(FM.getRoot()) &&
+           (!llvm::isa<RootFeature>(F) || &F == FM.getRoot());
+  }
 };
 
 } // namespace vara::feature
@@ -3,10 +3,17 @@
 
 #include "vara/Feature/FeatureModel.h"
 
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/Twine.h"
+#include "llvm/Support/MemoryBuffer.h"
+
 #include "libxml/parser.h"
 #include "libxml/tree.h"
 
 #include <memory>
+#include <system_error>
+#include <variant>
+#include <vector>
 
 namespace vara::feature {
 
@@ -16,8 +23,16 @@ namespace vara::feature {
 
 /// \brief Base class for parsers with different input formats.
 class FeatureModelParser {
+public:
+  /// Input of a parser, which is either owned by the parser or a reference to
+  /// a buffer that outlives the parser.
+  using InputTy =
+      std::variant<std::string, std::unique_ptr<llvm::MemoryBuffer>,
+                   llvm::MemoryBufferRef,
+                   std::shared_ptr<const llvm::MemoryBuffer>>;
+
 protected:
-  explicit FeatureModelParser() = default;
+  explicit FeatureModelParser(InputTy Input) : Input(std::move(Input)) {}
 
 public:
   using UniqueXmlDoc = std::unique_ptr<xmlDoc, void (*)(xmlDocPtr)>;
@@ -35,6 +50,61 @@ public:
   /// Checks whether input is a valid feature model as acyclic graph with unique
   /// nodes and tree like structure. Tests precondition of \a buildFeatureModel.
   virtual bool verifyFeatureModel() = 0;
+
+  /// Update an existing \a FeatureModel to the parsed one in place. Features
+  /// are matched by name, so pointers to unchanged features stay valid.
+  ///
+  /// \returns false if parsing failed or the parsed model has a different root
+  bool updateFeatureModel(FeatureModel &FM);
+
+  /// Skip the validation against the DTD for trusted input, e.g., models
+  /// written by this library. Malformed XML is still rejected.
+  void setTrustedInput(bool Trusted = true) { this->Trusted = Trusted; }
+
+protected:
+  /// Parse a DTD and compile its content models, so it can be shared by
+  /// concurrent validations.
+  ///
+  /// \returns the parsed DTD
+  static UniqueXmlDtd parseDtd(const std::string &Raw);
+
+  /// \returns parser context of the calling thread, which is reused by all
+  ///          parses on this thread
+  static xmlParserCtxtPtr getParserContext();
+
+  /// Map a file into memory, if possible, instead of reading it.
+  ///
+  /// \returns buffer of the file or nullptr if it cannot be read
+  static std::unique_ptr<llvm::MemoryBuffer> readFile(const llvm::Twine &Path);
+
+  /// \returns the input to parse
+  [[nodiscard]] llvm::StringRef getInput() const {
+    if (const auto *Str = std::get_if<std::string>(&Input); Str) {
+      return *Str;
+    }
+    if (const auto *Buffer =
+            std::get_if<std::unique_ptr<llvm::MemoryBuffer>>(&Input);
+        Buffer) {
+      return (*Buffer)->getBuffer();
+    }
+    if (const auto *Shared =
+            std::get_if<std::shared_ptr<const llvm::MemoryBuffer>>(&Input);
+        Shared) {
+      return (*Shared)->getBuffer();
+    }
+    return std::get<llvm::MemoryBufferRef>(Input).getBuffer();
+  }
+
+  /// Share the input with objects outliving the parser. Input which is not
+  /// owned by the parser is copied.
+  ///
+  /// \returns the shared input
+  std::shared_ptr<const llvm::MemoryBuffer> retainInput();
+
+  bool Trusted{false};
+
+private:
+  InputTy Input;
 };
 
 //===----------------------------------------------------------------------===//
@@ -44,27 +114,102 @@ public:
 /// \brief Parsers for feature models in XML.
 class FeatureModelXmlParser : public FeatureModelParser {
 public:
-  explicit FeatureModelXmlParser(std::string Xml) : Xml(std::move(Xml)) {}
+  /// \param Xml feature model in XML
+  /// \param Streaming read the document with a streaming reader, which feeds
+  ///                  the builder as elements close, instead of building a
+  ///                  DOM first
+  explicit FeatureModelXmlParser(std::string Xml, bool Streaming = false)
+      : FeatureModelParser(std::move(Xml)), Streaming(Streaming) {}
+  /// Parse a buffer without copying it, which has to outlive the parser.
+  explicit FeatureModelXmlParser(llvm::MemoryBufferRef Xml,
+                                 bool Streaming = false)
+      : FeatureModelParser(Xml), Streaming(Streaming) {}
+  explicit FeatureModelXmlParser(std::unique_ptr<llvm::MemoryBuffer> Xml,
+                                 bool Streaming = false)
+      : FeatureModelParser(std::move(Xml)), Streaming(Streaming) {}
+
+  /// Create a parser for a file, which is mapped into memory if possible.
+  ///
+  /// \returns a parser or nullptr if the file cannot be read
+  static std::unique_ptr<FeatureModelXmlParser>
+  fromFile(const llvm::Twine &Path, bool Streaming = false);
 
   std::unique_ptr<FeatureModel> buildFeatureModel() override;
 
   bool verifyFeatureModel() override;
 
+  /// Record the locations of features as ranges of the input, which are only
+  /// parsed when the locations of a feature are first accessed. The feature
+  /// model keeps the input alive, so borrowed input is copied.
+  ///
+  /// Building fails for input which is not encoded in UTF-8 or has an
+  /// internal DTD subset, as a range could not be parsed on its own.
+  void setLazyLocations(bool Lazy = true) { LazyLocations = Lazy; }
+
 private:
-  std::string Xml;
+  /// Content of a configurationOption element.
+  struct ConfigurationOption {
+    std::string Name{"root"};
+    bool Opt{false};
+    int MinValue{0};
+    int MaxValue{0};
+    std::vector<int> Values;
+    std::string Parent;
+    std::vector<std::string> Children;
+    std::vector<std::string> ImpliedOptions;
+    std::vector<std::string> ExcludedOptions;
+    std::vector<FeatureSourceRange> SourceRanges;
+    /// Raw locations element, if locations are loaded lazily.
+    llvm::StringRef Locations;
+  };
+
+  class StreamParser;
+
+  bool Streaming;
+  bool LazyLocations{false};
   FeatureModelBuilder FMB;
+  /// Input shared with the lazily loaded locations.
+  std::shared_ptr<const llvm::MemoryBuffer> RetainedInput;
+  /// Input behind the last locations element that was recorded.
+  llvm::StringRef UnscannedInput;
+
+  /// Record the next locations element of the input for \p Option.
+  bool recordLocations(ConfigurationOption &Option);
+
+  /// Add a parsed configurationOption to the builder.
+  bool addConfigurationOption(ConfigurationOption &Option, bool Num);
+
+  /// Parse and validate the document in a single pass with a streaming
+  /// reader.
+  ///
+  /// \param Build whether to feed the builder while parsing
+  ///
+  /// \returns true iff the document is valid
+  bool parseStream(bool Build);
 
   bool parseConfigurationOption(xmlNode *Node, bool Num);
   bool parseOptions(xmlNode *Node, bool Num);
   bool parseConstraints(xmlNode *Node);
   bool parseVm(xmlNode *Node);
 
-  static FeatureSourceRange::FeatureSourceLocation
+  static std::optional<FeatureSourceRange::FeatureSourceLocation>
   createFeatureSourceLocation(xmlNode *Node);
-  static FeatureSourceRange createFeatureSourceRange(xmlNode *Head);
+  static std::optional<FeatureSourceRange>
+  createFeatureSourceRange(xmlNode *Head);
+  static std::optional<std::vector<FeatureSourceRange>>
+  createFeatureSourceRanges(xmlNode *Node);
+  /// Parse a raw locations element.
+  static std::optional<std::vector<FeatureSourceRange>>
+  loadFeatureSourceRanges(llvm::StringRef Locations);
+
+  /// Check that locations can be parsed without the rest of the input, which
+  /// requires UTF-8 input without an internal DTD subset.
+  bool canLoadLocationsLazily();
 
   UniqueXmlDoc parseDoc();
-  static UniqueXmlDtd createDtd();
+
+  /// \returns DTD for feature models in XML, which is parsed once per process
+  static xmlDtdPtr getDtd();
 };
 
 //===----------------------------------------------------------------------===//
@@ -76,7 +221,19 @@ private:
 /// in an XML structure.
 class FeatureModelSxfmParser : public FeatureModelParser {
 public:
-  explicit FeatureModelSxfmParser(std::string Sxfm) : Sxfm(std::move(Sxfm)) {}
+  explicit FeatureModelSxfmParser(std::string Sxfm)
+      : FeatureModelParser(std::move(Sxfm)) {}
+  /// Parse a buffer without copying it, which has to outlive the parser.
+  explicit FeatureModelSxfmParser(llvm::MemoryBufferRef Sxfm)
+      : FeatureModelParser(Sxfm) {}
+  explicit FeatureModelSxfmParser(std::unique_ptr<llvm::MemoryBuffer> Sxfm)
+      : FeatureModelParser(std::move(Sxfm)) {}
+
+  /// Create a parser for a file, which is mapped into memory if possible.
+  ///
+  /// \returns a parser or nullptr if the file cannot be read
+  static std::unique_ptr<FeatureModelSxfmParser>
+  fromFile(const llvm::Twine &Path);
 
   /// This method checks if the given feature model is valid
   ///
@@ -90,10 +247,11 @@ public:
 
 private:
   /// Returns a pointer to the dtd representation of the xml file, which
-  /// is needed to verify the structure of the xml file.
+  /// is needed to verify the structure of the xml file. The dtd is parsed
+  /// once per process.
   ///
   /// \returns a pointer to the dtd representation
-  static UniqueXmlDtd createDtd();
+  static xmlDtdPtr getDtd();
 
   /// Parses the given xml file by using libxml2 and returns a pointer to
   /// the xml document.
@@ -118,12 +276,22 @@ private:
   bool parseFeatureTree(xmlNode *FeatureTree);
 
   /// Processes the constraints (i.e., cross-tree constraints) embedded in the
-  /// xml file.
+  /// xml file. Every line contains a single clause in conjunctive normal form,
+  /// e.g., 'c1: ~id_a or id_b', where the literals refer to the ids given in
+  /// the feature tree.
   ///
   /// \param Constraints the node containing the constraint string
   ///
   /// \returns true iff parsing and processing the constraints was successful
-  static bool parseConstraints(xmlNode *Constraints);
+  bool parseConstraints(xmlNode *Constraints);
+
+  /// Parses a single clause (i.e., the part after the label of a constraint
+  /// line) into a disjunction of (negated) features.
+  ///
+  /// \param Clause the clause to parse
+  ///
+  /// \returns the parsed constraint or nullptr if the clause is malformed
+  std::unique_ptr<Constraint> parseClause(llvm::StringRef Clause);
 
   /// This method extracts the cardinality from the given line.
   /// The cardinality is wrapped in square brackets (e.g., [1,1])
@@ -146,11 +314,72 @@ private:
   /// UINT_MAX for wildcard, or the number itself.
   static std::optional<int> parseCardinality(llvm::StringRef CardinalityString);
 
-  std::string Sxfm;
   FeatureModelBuilder FMB;
   std::string Indentation = "\t";
+  /// Maps the ids of the feature tree to the names of the features, as
+  /// constraints reference features by their id.
+  llvm::StringMap<std::string> IdToName;
+};
+
+//===----------------------------------------------------------------------===//
+//                          FeatureModelBinaryParser Class
+//===----------------------------------------------------------------------===//
+
+/// \brief Loader for feature models written by \a FeatureModelBinaryWriter.
+///
+/// The model is decoded in a single linear pass over the input. Malformed
+/// input is detected, but there is no schema validation.
+class FeatureModelBinaryParser : public FeatureModelParser {
+public:
+  explicit FeatureModelBinaryParser(std::string Binary)
+      : FeatureModelParser(std::move(Binary)) {}
+  /// Parse a buffer without copying it, which has to outlive the parser.
+  explicit FeatureModelBinaryParser(llvm::MemoryBufferRef Binary)
+      : FeatureModelParser(Binary) {}
+  explicit FeatureModelBinaryParser(std::unique_ptr<llvm::MemoryBuffer> Binary)
+      : FeatureModelParser(std::move(Binary)) {}
+
+  /// Create a parser for a file, which is mapped into memory if possible.
+  ///
+  /// \returns a parser or nullptr if the file cannot be read
+  static std::unique_ptr<FeatureModelBinaryParser>
+  fromFile(const llvm::Twine &Path);
+
+  /// \returns whether the input starts like a binary feature model
+  static bool isBinaryFeatureModel(llvm::StringRef Input);
+
+  std::unique_ptr<FeatureModel> buildFeatureModel() override;
+
+  bool verifyFeatureModel() override;
+
+private:
+  /// Decode the input into a builder.
+  ///
+  /// \returns true iff the input is well-formed
+  bool decode(FeatureModelBuilder &FMB);
+};
+
+/// Result of loading one feature model of a batch.
+struct LoadedFeatureModel {
+  std::unique_ptr<FeatureModel> FM;
+  /// Why loading failed, if there is no feature model.
+  std::error_code Error;
+
+  explicit operator bool() const { return FM != nullptr; }
 };
 
+/// Load xml feature models from files in parallel.
+///
+/// libxml2 is initialized once up front and each worker parses with its own
+/// parser context. Files which cannot be read keep the error of reading them,
+/// invalid feature models are reported as \a std::errc::invalid_argument.
+///
+/// \param Threads number of workers, or 0 to use all hardware threads
+///
+/// \returns the feature models in the order of \p Paths
+std::vector<LoadedFeatureModel>
+loadFeatureModels(llvm::ArrayRef<std::string> Paths, unsigned Threads = 0);
+
 } // namespace vara::feature
 
 #endif // VARA_FEATURE_FEATUREMODELPARSER_H
@@ -6,12 +6,17 @@
 #include "llvm/ADT/StringRef.h"
 
 #include <algorithm>
+#include <iterator>
 #include <memory>
+#include <optional>
+#include <set>
 #include <tuple>
 #include <type_traits>
 
 namespace vara::feature {
 
+class FeatureModelHistory;
+
 namespace detail {
 class CopyTransactionMode;
 class ModifyTransactionMode;
@@ -67,11 +72,22 @@ public:
   /// \brief Commit and finalize the FeatureModelTransaction.
   /// In CopyMode a new FeatureModel is returned.
   /// In ModifyMode the specified changes are applied to the underlying
-  /// FeatureModel.
+  /// FeatureModel. If one of them fails, or the Features they touched are
+  /// inconsistent afterwards, all of them are reverted.
   ///
-  /// \returns a FeatureModel or nothing
+  /// \returns a FeatureModel in CopyMode, otherwise, whether the changes were
+  ///          applied
   decltype(auto) commit() { return this->commitImpl(); }
 
+  /// \brief Commit in ModifyMode and record the applied changes in \p
+  /// History, so they can be undone later.
+  ///
+  /// \returns false if the changes were reverted, like \a commit()
+  bool commit(FeatureModelHistory &History) {
+    static_assert(!IsCopyMode, "Only modify transactions have a history.");
+    return this->commitImpl(&History);
+  }
+
   /// Abort the current Transaction, throwing away all changes.
   void abort() { this->abortImpl(); }
 
@@ -88,6 +104,174 @@ public:
     }
   }
 
+  /// \brief Add a top-level Constraint to the FeatureModel
+  ///
+  /// \returns a pointer to the inserted Constraint in CopyMode, otherwise,
+  ///          nothing.
+  decltype(auto) addConstraint(std::unique_ptr<Constraint> NewConstraint) {
+    if constexpr (IsCopyMode) {
+      return this->addConstraintImpl(std::move(NewConstraint));
+    } else {
+      this->addConstraintImpl(std::move(NewConstraint));
+    }
+  }
+
+  /// \brief Remove a Feature from the FeatureModel together with all
+  /// top-level Constraints mentioning it. The Feature must not have children.
+  ///
+  /// \returns whether the Feature was removed in CopyMode, otherwise,
+  ///          nothing.
+  decltype(auto) removeFeature(Feature *F) {
+    if constexpr (IsCopyMode) {
+      return this->removeFeatureImpl(F);
+    } else {
+      this->removeFeatureImpl(F);
+    }
+  }
+
+  /// \brief Remove a Feature together with its subtree, the Relationships in
+  /// it and all top-level Constraints mentioning one of the removed Features.
+  ///
+  /// \returns whether the subtree was removed in CopyMode, otherwise,
+  ///          nothing.
+  decltype(auto) removeSubtree(Feature *F) {
+    if constexpr (IsCopyMode) {
+      return this->removeSubtreeImpl(F);
+    } else {
+      this->removeSubtreeImpl(F);
+    }
+  }
+
+  /// \brief Move a Feature and its subtree below a new parent Feature.
+  ///
+  /// \returns whether the Feature was moved in CopyMode, otherwise, nothing.
+  decltype(auto) setParent(Feature *F, Feature *Parent) {
+    if constexpr (IsCopyMode) {
+      return this->setParentImpl(F, Parent);
+    } else {
+      this->setParentImpl(F, Parent);
+    }
+  }
+
+  /// \brief Remove a top-level Constraint from the FeatureModel.
+  ///
+  /// \returns whether the Constraint was removed in CopyMode, otherwise,
+  ///          nothing.
+  decltype(auto) removeConstraint(Constraint *C) {
+    if constexpr (IsCopyMode) {
+      return this->removeConstraintImpl(C);
+    } else {
+      this->removeConstraintImpl(C);
+    }
+  }
+
+  /// \brief Group children of a Feature into a new Relationship.
+  ///
+  /// \returns a pointer to the inserted Relationship in CopyMode, otherwise,
+  ///          nothing.
+  decltype(auto) addRelationship(Relationship::RelationshipKind Kind,
+                                 Feature *Parent,
+                                 std::vector<Feature *> Children) {
+    if constexpr (IsCopyMode) {
+      return this->addRelationshipImpl(Kind, Parent, std::move(Children));
+    } else {
+      this->addRelationshipImpl(Kind, Parent, std::move(Children));
+    }
+  }
+
+  /// \brief Dissolve a Relationship, its children become children of its
+  /// parent Feature.
+  ///
+  /// \returns whether the Relationship was removed in CopyMode, otherwise,
+  ///          nothing.
+  decltype(auto) removeRelationship(Relationship *R) {
+    if constexpr (IsCopyMode) {
+      return this->removeRelationshipImpl(R);
+    } else {
+      this->removeRelationshipImpl(R);
+    }
+  }
+
+  /// \brief Turn a Relationship into one of another kind with the same
+  /// children, e.g., an OR group into an ALTERNATIVE group.
+  ///
+  /// \returns a pointer to the resulting Relationship in CopyMode, otherwise,
+  ///          nothing.
+  decltype(auto) setRelationshipKind(Relationship *R,
+                                     Relationship::RelationshipKind Kind) {
+    if constexpr (IsCopyMode) {
+      return this->setRelationshipKindImpl(R, Kind);
+    } else {
+      this->setRelationshipKindImpl(R, Kind);
+    }
+  }
+
+  /// \brief Change whether a Feature is optional.
+  decltype(auto) setOptional(Feature *F, bool Opt) {
+    if constexpr (IsCopyMode) {
+      return this->setOptionalImpl(F, Opt);
+    } else {
+      this->setOptionalImpl(F, Opt);
+    }
+  }
+
+  /// \brief Change the values of a NumericFeature.
+  decltype(auto) setValues(NumericFeature *F,
+                           NumericFeature::ValuesVariantType Values) {
+    if constexpr (IsCopyMode) {
+      return this->setValuesImpl(F, std::move(Values));
+    } else {
+      this->setValuesImpl(F, std::move(Values));
+    }
+  }
+
+  /// \brief Replace the locations of a Feature.
+  decltype(auto) setLocations(Feature *F,
+                              std::vector<FeatureSourceRange> Locations) {
+    if constexpr (IsCopyMode) {
+      return this->setLocationsImpl(F, std::move(Locations));
+    } else {
+      this->setLocationsImpl(F, std::move(Locations));
+    }
+  }
+
+  /// \brief Add a location to a Feature.
+  decltype(auto) addLocation(Feature *F, FeatureSourceRange Location) {
+    if constexpr (IsCopyMode) {
+      return this->editLocationImpl(F, std::nullopt, std::move(Location));
+    } else {
+      this->editLocationImpl(F, std::nullopt, std::move(Location));
+    }
+  }
+
+  /// \brief Remove a location from a Feature.
+  ///
+  /// \returns whether the Feature had the location in CopyMode, otherwise,
+  ///          nothing.
+  decltype(auto) removeLocation(Feature *F, FeatureSourceRange Location) {
+    if constexpr (IsCopyMode) {
+      return this->editLocationImpl(F, std::move(Location), std::nullopt);
+    } else {
+      this->editLocationImpl(F, std::move(Location), std::nullopt);
+    }
+  }
+
+  /// \brief Replace a location of a Feature, keeping its position among the
+  /// other locations.
+  ///
+  /// \returns whether the Feature had the old location in CopyMode,
+  ///          otherwise, nothing.
+  decltype(auto) updateLocation(Feature *F, FeatureSourceRange OldLocation,
+                                FeatureSourceRange NewLocation) {
+    if constexpr (IsCopyMode) {
+      return this->editLocationImpl(F, std::move(OldLocation),
+                                    std::move(NewLocation));
+    } else {
+      this->editLocationImpl(F, std::move(OldLocation),
+                             std::move(NewLocation));
+    }
+  }
+
 private:
   FeatureModelTransaction(FeatureModel &FM) : TransactionBaseTy(FM) {}
 };
@@ -112,6 +296,21 @@ using FeatureModelModifyTransaction =
 void addFeature(FeatureModel *FM, std::unique_ptr<Feature> NewFeature,
                 Feature *Parent = nullptr);
 
+/// Turn a FeatureModel into another one with a single modify transaction.
+///
+/// Features are matched by name, so unchanged Features, including features
+/// that were moved or whose properties changed, keep their identity.
+/// Features whose kind changed are replaced. Constraints are matched by their
+/// kind and textual representation. Properties of the model itself, like its
+/// name, are left untouched.
+///
+/// \param FM model to update
+/// \param Target model to turn \p FM into
+///
+/// \returns false if the models have different roots or the update could not
+///          be applied, both leave \p FM untouched
+bool updateFeatureModel(FeatureModel &FM, FeatureModel &Target);
+
 //===----------------------------------------------------------------------===//
 //                    Transaction Implementation Details
 //===----------------------------------------------------------------------===//
@@ -121,17 +320,70 @@ namespace detail {
 class CopyTransactionMode {};
 class ModifyTransactionMode {};
 
+/// \brief Base class of all modifications of a FeatureModel.
+///
+/// Every modification records what it changed while it is executed, so it
+/// can be reverted with \a undo and executed again afterwards. Objects removed
+/// from the model are kept alive by the modification, so reverting restores
+/// the very same objects and pointers to them stay valid.
 class FeatureModelModification {
   friend class FeatureModelCopyTransactionBase;
   friend class FeatureModelModifyTransactionBase;
+  friend class vara::feature::FeatureModelHistory;
 
 public:
+  using ModificationListTy =
+      std::vector<std::unique_ptr<FeatureModelModification>>;
+
   virtual ~FeatureModelModification() = default;
 
   /// \brief Execute the modification on the given FeatureModel.
-  virtual void exec(FeatureModel &FM) = 0;
+  ///
+  /// \returns false if the modification could not be applied, which leaves
+  ///          the FeatureModel unchanged
+  virtual bool exec(FeatureModel &FM) = 0;
+
+  /// \brief Revert the last successful execution of the modification.
+  virtual void undo(FeatureModel &FM) = 0;
+
+  /// \brief Collect the Features changed by the last successful execution,
+  /// which have to be checked for consistency afterwards.
+  virtual void
+  getTouchedFeatures(std::vector<Feature *> & /*Touched*/) const {}
 
 protected:
+  /// \brief Execute \p Modifications in order. If one of them fails, the
+  /// already applied ones are reverted in reverse order.
+  ///
+  /// \returns false if the modifications were reverted
+  static bool execAll(FeatureModel &FM,
+                      const ModificationListTy &Modifications) {
+    // Apply all modifications to the tree first and order only the changed
+    // features afterwards, so bulk changes do not search the ordering every
+    // time and modifications that keep the tree leave the ordering alone.
+    FM.deferOrdering();
+    for (auto It = Modifications.begin(); It != Modifications.end(); ++It) {
+      if (!(*It)->exec(FM)) {
+        std::for_each(std::make_reverse_iterator(It), Modifications.rend(),
+                      [&FM](const auto &M) { M->undo(FM); });
+        // Deferred changes do not touch the ordering, which is still valid.
+        FM.resumeOrdering();
+        return false;
+      }
+    }
+    FM.restoreOrdering();
+    return true;
+  }
+
+  /// \brief Revert \p Modifications, which were executed by \a execAll.
+  static void undoAll(FeatureModel &FM,
+                      const ModificationListTy &Modifications) {
+    FM.deferOrdering();
+    std::for_each(Modifications.rbegin(), Modifications.rend(),
+                  [&FM](const auto &M) { M->undo(FM); });
+    FM.restoreOrdering();
+  }
+
   /// \brief Set the parent of a \a Feature.
   static void setParent(Feature &F, Feature *Parent) { F.setParent(Parent); }
 
@@ -144,6 +396,58 @@ protected:
   /// \brief Remove \a Feature Child from F.
   static void removeChild(Feature &F, Feature &Child) { F.removeEdge(&Child); }
 
+  /// \brief Unlink a node from its parent node in the tree.
+  static void detach(FeatureTreeNode &N) {
+    if (auto *Parent = N.getParent(); Parent) {
+      Parent->removeEdge(&N);
+      N.setParent(nullptr);
+    }
+  }
+
+  /// \brief Link a node as child of another node in the tree.
+  static void attach(FeatureTreeNode &N, FeatureTreeNode &Parent) {
+    N.setParent(&Parent);
+    Parent.addEdge(&N);
+  }
+
+  /// \brief Restore the ordering of a moved \a Feature and its subtree.
+  static void reorderFeature(FeatureModel &FM, Feature &F) {
+    FM.reorderFeature(F);
+  }
+
+  /// \brief Apply \p Change to the subtree of \p F and update the ordering
+  /// once for the whole subtree instead of once per changed Feature.
+  ///
+  /// \returns the result of \p Change
+  template <typename ChangeTy>
+  static bool changeSubtree(FeatureModel &FM, Feature &F, ChangeTy Change) {
+    if (FM.isOrderingDeferred()) {
+      return Change();
+    }
+    FM.unorderFeature(F);
+    FM.deferOrdering();
+    bool Changed = Change();
+    // Apart from the subtree, the ordering was not touched.
+    FM.resumeOrdering();
+    if (FM.getFeature(F.getName()) == &F) {
+      FM.reorderFeature(F);
+    }
+    return Changed;
+  }
+
+  static void setOptional(Feature &F, bool Opt) { F.Opt = Opt; }
+
+  /// \brief The locations of a \a Feature, loading pending ones first.
+  static std::vector<FeatureSourceRange> &getLocations(Feature &F) {
+    F.loadLocations();
+    return F.Locations;
+  }
+
+  static void setValues(NumericFeature &F,
+                        NumericFeature::ValuesVariantType Values) {
+    F.Values = std::move(Values);
+  }
+
   /// \brief Adds a new \a Feature to the FeatureModel.
   ///
   /// \param FM model to add to
@@ -159,8 +463,47 @@ protected:
   ///
   /// \param FM model to remove from
   /// \param F the Feature to delete
-  static void removeFeature(FeatureModel &FM, Feature &F) {
-    FM.removeFeature(F);
+  ///
+  /// \returns the removed Feature
+  static std::unique_ptr<Feature> removeFeature(FeatureModel &FM, Feature &F) {
+    return FM.removeFeature(F);
+  }
+
+  /// \brief Adds a new top-level \a Constraint to the FeatureModel and
+  /// records its feature occurrences.
+  ///
+  /// \param FM model to add to
+  /// \param NewConstraint the Constraint to add, features are looked up by
+  ///                      name
+  /// \param Pos position reported by \a removeConstraint, appended if not
+  ///            given
+  ///
+  /// \returns A pointer to the inserted Constraint.
+  static Constraint *addConstraint(FeatureModel &FM,
+                                   std::unique_ptr<Constraint> NewConstraint,
+                                   std::optional<size_t> Pos = std::nullopt) {
+    return FM.addConstraint(std::move(NewConstraint), Pos);
+  }
+
+  /// \brief Remove a top-level \a Constraint from the FeatureModel.
+  ///
+  /// \param[out] Pos position the Constraint had among the constraints
+  ///
+  /// \returns the removed Constraint or nullptr if it is not part of the
+  ///          model.
+  static std::unique_ptr<Constraint>
+  removeConstraint(FeatureModel &FM, Constraint &C, size_t *Pos = nullptr) {
+    return FM.removeConstraint(C, Pos);
+  }
+
+  static Relationship *addRelationship(FeatureModel &FM,
+                                       std::unique_ptr<Relationship> R) {
+    return FM.addRelationship(std::move(R));
+  }
+
+  static std::unique_ptr<Relationship> removeRelationship(FeatureModel &FM,
+                                                          Relationship &R) {
+    return FM.removeRelationship(R);
   }
 
   template <typename ModTy, typename... ArgTys>
@@ -178,13 +521,23 @@ class AddFeatureToModel : public FeatureModelModification {
   friend class FeatureModelModification;
 
 public:
-  void exec(FeatureModel &FM) override { (*this)(FM); }
+  bool exec(FeatureModel &FM) override { return (*this)(FM); }
+
+  void undo(FeatureModel &FM) override {
+    detach(*InsertedFeature);
+    NewFeature = removeFeature(FM, *InsertedFeature);
+  }
+
+  void getTouchedFeatures(std::vector<Feature *> &Touched) const override {
+    Touched.push_back(InsertedFeature);
+  }
 
   Feature *operator()(FeatureModel &FM) {
-    auto *InsertedFeature = addFeature(FM, std::move(NewFeature));
-    if (!InsertedFeature) {
+    if (!NewFeature || FM.getFeature(NewFeature->getName()) ||
+        (Parent && FM.getFeature(Parent->getName()) != Parent)) {
       return nullptr;
     }
+    InsertedFeature = addFeature(FM, std::move(NewFeature));
     if (Parent) {
       setParent(*InsertedFeature, Parent);
       addChild(*Parent, *InsertedFeature);
@@ -193,6 +546,8 @@ public:
       setParent(*InsertedFeature, FM.getRoot());
       addChild(*FM.getRoot(), *InsertedFeature);
     }
+    // The feature was ordered before it had a parent.
+    reorderFeature(FM, *InsertedFeature);
     return InsertedFeature;
   }
 
@@ -203,11 +558,491 @@ private:
 
   std::unique_ptr<Feature> NewFeature;
   Feature *Parent;
+  Feature *InsertedFeature{nullptr};
+};
+
+class AddConstraintToModel : public FeatureModelModification {
+  friend class FeatureModelModification;
+
+public:
+  bool exec(FeatureModel &FM) override { return (*this)(FM); }
+
+  void undo(FeatureModel &FM) override {
+    NewConstraint = removeConstraint(FM, *InsertedConstraint);
+  }
+
+  Constraint *operator()(FeatureModel &FM) {
+    if (!NewConstraint) {
+      return nullptr;
+    }
+    return InsertedConstraint = addConstraint(FM, std::move(NewConstraint));
+  }
+
+private:
+  AddConstraintToModel(std::unique_ptr<Constraint> NewConstraint)
+      : NewConstraint(std::move(NewConstraint)) {}
+
+  std::unique_ptr<Constraint> NewConstraint;
+  Constraint *InsertedConstraint{nullptr};
+};
+
+class RemoveFeatureFromModel : public FeatureModelModification {
+  friend class FeatureModelModification;
+
+public:
+  bool exec(FeatureModel &FM) override { return (*this)(FM); }
+
+  void undo(FeatureModel &FM) override {
+    addFeature(FM, std::move(Removed));
+    attach(*F, *Parent);
+    reorderFeature(FM, *F);
+    while (!RemovedConstraints.empty()) {
+      auto [C, Pos] = std::move(RemovedConstraints.back());
+      RemovedConstraints.pop_back();
+      addConstraint(FM, std::move(C), Pos);
+    }
+  }
+
+  bool operator()(FeatureModel &FM) {
+    if (F == FM.getRoot() || F->begin() != F->end()) {
+      return false;
+    }
+    // Constraints would otherwise reference a deleted feature.
+    std::vector<Constraint *> Mentioning;
+    for (const auto &O : FM.getOccurrences(*F)) {
+      Mentioning.push_back(O.C);
+    }
+    for (auto *C : Mentioning) {
+      size_t Pos;
+      auto Constraint = removeConstraint(FM, *C, &Pos);
+      RemovedConstraints.emplace_back(std::move(Constraint), Pos);
+    }
+    Parent = F->getParent();
+    detach(*F);
+    Removed = removeFeature(FM, *F);
+    return true;
+  }
+
+private:
+  RemoveFeatureFromModel(Feature *F) : F(F) {}
+
+  Feature *F;
+  FeatureTreeNode *Parent{nullptr};
+  std::unique_ptr<Feature> Removed;
+  std::vector<std::pair<std::unique_ptr<Constraint>, size_t>>
+      RemovedConstraints;
+};
+
+class SetParentOfFeature : public FeatureModelModification {
+  friend class FeatureModelModification;
+
+public:
+  bool exec(FeatureModel &FM) override { return (*this)(FM); }
+
+  void undo(FeatureModel &FM) override {
+    detach(*F);
+    attach(*F, *OldParent);
+    reorderFeature(FM, *F);
+  }
+
+  void getTouchedFeatures(std::vector<Feature *> &Touched) const override {
+    Touched.push_back(F);
+  }
+
+  bool operator()(FeatureModel &FM) {
+    // Both features may have been removed earlier in the same transaction.
+    if (!F || !Parent || FM.getFeature(F->getName()) != F ||
+        FM.getFeature(Parent->getName()) != Parent) {
+      return false;
+    }
+    // A feature cannot be moved into its own subtree.
+    for (FeatureTreeNode *N = Parent; N; N = N->getParent()) {
+      if (N == F) {
+        return false;
+      }
+    }
+    OldParent = F->getParent();
+    detach(*F);
+    attach(*F, *Parent);
+    reorderFeature(FM, *F);
+    return true;
+  }
+
+private:
+  SetParentOfFeature(Feature *F, Feature *Parent) : F(F), Parent(Parent) {}
+
+  Feature *F;
+  Feature *Parent;
+  FeatureTreeNode *OldParent{nullptr};
+};
+
+class RemoveConstraintFromModel : public FeatureModelModification {
+  friend class FeatureModelModification;
+
+public:
+  bool exec(FeatureModel &FM) override { return (*this)(FM); }
+
+  void undo(FeatureModel &FM) override {
+    addConstraint(FM, std::move(Removed), Pos);
+  }
+
+  bool operator()(FeatureModel &FM) {
+    Removed = removeConstraint(FM, *C, &Pos);
+    return Removed != nullptr;
+  }
+
+private:
+  RemoveConstraintFromModel(Constraint *C) : C(C) {}
+
+  Constraint *C;
+  std::unique_ptr<Constraint> Removed;
+  size_t Pos{0};
+};
+
+class AddRelationshipToModel : public FeatureModelModification {
+  friend class FeatureModelModification;
+  friend class SetRelationshipKind;
+
+public:
+  bool exec(FeatureModel &FM) override { return (*this)(FM); }
+
+  void undo(FeatureModel &FM) override {
+    for (auto *F : Children) {
+      detach(*F);
+      attach(*F, *Parent);
+    }
+    detach(*Inserted);
+    Removed = removeRelationship(FM, *Inserted);
+  }
+
+  void getTouchedFeatures(std::vector<Feature *> &Touched) const override {
+    Touched.insert(Touched.end(), Children.begin(), Children.end());
+  }
+
+  Relationship *operator()(FeatureModel &FM) {
+    if (!std::all_of(Children.begin(), Children.end(),
+                     [this](Feature *F) { return F->getParent() == Parent; })) {
+      return nullptr;
+    }
+    // Executing again restores the same Relationship.
+    if (!Removed) {
+      Removed = std::make_unique<Relationship>(Kind);
+    }
+    Inserted = addRelationship(FM, std::move(Removed));
+    attach(*Inserted, *Parent);
+    for (auto *F : Children) {
+      detach(*F);
+      attach(*F, *Inserted);
+    }
+    return Inserted;
+  }
+
+private:
+  AddRelationshipToModel(Relationship::RelationshipKind Kind, Feature *Parent,
+                         std::vector<Feature *> Children)
+      : Kind(Kind), Parent(Parent), Children(std::move(Children)) {}
+
+  Relationship::RelationshipKind Kind;
+  Feature *Parent;
+  std::vector<Feature *> Children;
+  Relationship *Inserted{nullptr};
+  std::unique_ptr<Relationship> Removed;
+};
+
+class RemoveRelationshipFromModel : public FeatureModelModification {
+  friend class FeatureModelModification;
+
+public:
+  bool exec(FeatureModel &FM) override { return (*this)(FM); }
+
+  void undo(FeatureModel &FM) override {
+    addRelationship(FM, std::move(Removed));
+    attach(*R, *Parent);
+    for (auto *Child : Children) {
+      detach(*Child);
+      attach(*Child, *R);
+    }
+  }
+
+  void getTouchedFeatures(std::vector<Feature *> &Touched) const override {
+    for (auto *Child : Children) {
+      if (auto *F = llvm::dyn_cast<Feature>(Child); F) {
+        Touched.push_back(F);
+      }
+    }
+  }
+
+  bool operator()(FeatureModel &FM) {
+    Parent = R->getParent();
+    if (!Parent) {
+      return false;
+    }
+    Children.assign(R->begin(), R->end());
+    for (auto *Child : Children) {
+      detach(*Child);
+      attach(*Child, *Parent);
+    }
+    detach(*R);
+    Removed = removeRelationship(FM, *R);
+    return true;
+  }
+
+private:
+  RemoveRelationshipFromModel(Relationship *R) : R(R) {}
+
+  Relationship *R;
+  FeatureTreeNode *Parent{nullptr};
+  std::vector<FeatureTreeNode *> Children;
+  std::unique_ptr<Relationship> Removed;
+};
+
+class SetFeatureProperties : public FeatureModelModification {
+  friend class FeatureModelModification;
+
+public:
+  bool exec(FeatureModel &FM) override { return (*this)(FM); }
+
+  void undo(FeatureModel & /*FM*/) override { swap(); }
+
+  void getTouchedFeatures(std::vector<Feature *> &Touched) const override {
+    Touched.push_back(F);
+  }
+
+  bool operator()(FeatureModel & /*FM*/) {
+    if (Values && !llvm::isa<NumericFeature>(F)) {
+      return false;
+    }
+    swap();
+    return true;
+  }
+
+private:
+  SetFeatureProperties(
+      Feature *F, std::optional<bool> Opt,
+      std::optional<NumericFeature::ValuesVariantType> Values = std::nullopt,
+      std::optional<std::vector<FeatureSourceRange>> Locations = std::nullopt)
+      : F(F), Opt(Opt), Values(std::move(Values)),
+        Locations(std::move(Locations)) {}
+
+  /// Exchange the given properties with the current ones, so the previous
+  /// properties are kept for the next call.
+  void swap() {
+    if (Opt) {
+      bool Previous = F->isOptional();
+      setOptional(*F, *Opt);
+      Opt = Previous;
+    }
+    if (Values) {
+      auto *N = llvm::cast<NumericFeature>(F);
+      auto Previous = N->getValues();
+      setValues(*N, std::move(*Values));
+      Values = std::move(Previous);
+    }
+    if (Locations) {
+      std::swap(getLocations(*F), *Locations);
+    }
+  }
+
+  Feature *F;
+  std::optional<bool> Opt;
+  std::optional<NumericFeature::ValuesVariantType> Values;
+  std::optional<std::vector<FeatureSourceRange>> Locations;
+};
+
+class EditFeatureLocation : public FeatureModelModification {
+  friend class FeatureModelModification;
+
+public:
+  bool exec(FeatureModel &FM) override { return (*this)(FM); }
+
+  void undo(FeatureModel & /*FM*/) override {
+    auto &Locations = getLocations(*F);
+    if (!Old) {
+      Locations.erase(Locations.begin() + Index);
+    } else if (!New) {
+      Locations.insert(Locations.begin() + Index, *Old);
+    } else {
+      Locations[Index] = *Old;
+    }
+  }
+
+  void getTouchedFeatures(std::vector<Feature *> &Touched) const override {
+    Touched.push_back(F);
+  }
+
+  bool operator()(FeatureModel & /*FM*/) {
+    auto &Locations = getLocations(*F);
+    if (!Old) {
+      Index = Locations.size();
+      Locations.push_back(*New);
+      return true;
+    }
+    auto Pos = std::find(Locations.begin(), Locations.end(), *Old);
+    if (Pos == Locations.end()) {
+      return false;
+    }
+    Index = std::distance(Locations.begin(), Pos);
+    if (New) {
+      *Pos = *New;
+    } else {
+      Locations.erase(Pos);
+    }
+    return true;
+  }
+
+private:
+  /// Adds \p New if no \p Old location is given, removes \p Old if no \p New
+  /// location is given, replaces \p Old by \p New otherwise.
+  EditFeatureLocation(Feature *F, std::optional<FeatureSourceRange> Old,
+                      std::optional<FeatureSourceRange> New)
+      : F(F), Old(std::move(Old)), New(std::move(New)) {}
+
+  Feature *F;
+  std::optional<FeatureSourceRange> Old;
+  std::optional<FeatureSourceRange> New;
+  size_t Index{0};
+};
+
+/// \brief Base class of modifications that are made up of other
+/// modifications, which are planned when it is executed the first time.
+class CompoundModification : public FeatureModelModification {
+public:
+  bool exec(FeatureModel &FM) override {
+    if (Steps.empty() && !plan(FM)) {
+      return false;
+    }
+    for (auto It = Steps.begin(); It != Steps.end(); ++It) {
+      if (!(*It)->exec(FM)) {
+        std::for_each(std::make_reverse_iterator(It), Steps.rend(),
+                      [&FM](const auto &M) { M->undo(FM); });
+        return false;
+      }
+    }
+    return true;
+  }
+
+  void undo(FeatureModel &FM) override {
+    std::for_each(Steps.rbegin(), Steps.rend(),
+                  [&FM](const auto &M) { M->undo(FM); });
+  }
+
+  void getTouchedFeatures(std::vector<Feature *> &Touched) const override {
+    for (const auto &Step : Steps) {
+      Step->getTouchedFeatures(Touched);
+    }
+  }
+
+protected:
+  /// \brief Fill \a Steps according to the current state of the model.
+  ///
+  /// \returns false if the modification cannot be applied
+  virtual bool plan(FeatureModel &FM) = 0;
+
+  ModificationListTy Steps;
+};
+
+class RemoveSubtreeFromModel : public CompoundModification {
+  friend class FeatureModelModification;
+
+public:
+  bool exec(FeatureModel &FM) override {
+    return changeSubtree(
+        FM, *F, [this, &FM]() { return CompoundModification::exec(FM); });
+  }
+
+  void undo(FeatureModel &FM) override {
+    changeSubtree(FM, *F, [this, &FM]() {
+      CompoundModification::undo(FM);
+      return true;
+    });
+  }
+
+  bool operator()(FeatureModel &FM) { return exec(FM); }
+
+private:
+  RemoveSubtreeFromModel(Feature *F) : F(F) {}
+
+  bool plan(FeatureModel &FM) override {
+    if (F == FM.getRoot()) {
+      return false;
+    }
+    // Relationships are dissolved first, so the Features can be removed
+    // bottom-up as leaves.
+    std::vector<FeatureTreeNode *> Nodes{F};
+    std::vector<Feature *> Features;
+    for (size_t I = 0; I < Nodes.size(); ++I) {
+      if (auto *R = llvm::dyn_cast<Relationship>(Nodes[I]); R) {
+        Steps.push_back(
+            make_unique_modification<RemoveRelationshipFromModel>(R));
+      } else if (auto *Child = llvm::dyn_cast<Feature>(Nodes[I]); Child) {
+        Features.push_back(Child);
+      }
+      for (auto *Child : Nodes[I]->children()) {
+        Nodes.push_back(Child);
+      }
+    }
+    std::for_each(Features.rbegin(), Features.rend(), [this](Feature *Child) {
+      Steps.push_back(make_unique_modification<RemoveFeatureFromModel>(Child));
+    });
+    return true;
+  }
+
+  Feature *F;
+};
+
+class SetRelationshipKind : public CompoundModification {
+  friend class FeatureModelModification;
+
+public:
+  Relationship *operator()(FeatureModel &FM) {
+    if (!exec(FM)) {
+      return nullptr;
+    }
+    return Added ? Added->Inserted : R;
+  }
+
+private:
+  SetRelationshipKind(Relationship *R, Relationship::RelationshipKind Kind)
+      : R(R), Kind(Kind) {}
+
+  bool plan(FeatureModel & /*FM*/) override {
+    if (R->getKind() == Kind) {
+      return true;
+    }
+    auto *Parent = llvm::dyn_cast_or_null<Feature>(R->getParent());
+    if (!Parent) {
+      return false;
+    }
+    std::vector<Feature *> Children;
+    for (auto *Child : R->children()) {
+      if (auto *F = llvm::dyn_cast<Feature>(Child); F) {
+        Children.push_back(F);
+      }
+    }
+    // The kind of a Relationship is fixed, so it is replaced.
+    auto Add = make_unique_modification<AddRelationshipToModel>(
+        Kind, Parent, std::move(Children));
+    Added = Add.get();
+    Steps.push_back(make_unique_modification<RemoveRelationshipFromModel>(R));
+    Steps.push_back(std::move(Add));
+    return true;
+  }
+
+  Relationship *R;
+  Relationship::RelationshipKind Kind;
+  AddRelationshipToModel *Added{nullptr};
 };
 
 class FeatureModelCopyTransactionBase {
 protected:
-  FeatureModelCopyTransactionBase(FeatureModel &FM) : FM(FM.clone()) {}
+  FeatureModelCopyTransactionBase(FeatureModel &FM) : FM(FM.clone()) {
+    // The clone keeps the order of the constraints.
+    auto Copied = this->FM->constraints().begin();
+    for (const auto &C : FM.constraints()) {
+      ConstraintPositions[C.get()] =
+          *this->FM->getConstraintPosition(**Copied++);
+    }
+  }
 
   [[nodiscard]] inline std::unique_ptr<FeatureModel> commitImpl() {
     if (FM) {
@@ -232,7 +1067,10 @@ protected:
     if (Parent) {
       // To correctly add a parent, we need to translate it to a Feature in
       // our copied FeatureModel
-      Feature *TranslatedParent = FM->getFeature(Parent->getName());
+      Feature *TranslatedParent = translate(Parent);
+      if (!TranslatedParent) {
+        return nullptr;
+      }
       return FeatureModelModification::make_modification<AddFeatureToModel>(
           std::move(NewFeature), TranslatedParent)(*FM);
     }
@@ -241,27 +1079,170 @@ protected:
         std::move(NewFeature))(*FM);
   }
 
+  Constraint *addConstraintImpl(std::unique_ptr<Constraint> NewConstraint) {
+    if (!FM) {
+      return nullptr;
+    }
+
+    // Features are resolved by name, so the Constraint is bound to our
+    // copied FeatureModel.
+    return FeatureModelModification::make_modification<AddConstraintToModel>(
+        std::move(NewConstraint))(*FM);
+  }
+
+  bool removeFeatureImpl(Feature *F) {
+    auto *Translated = translate(F);
+    return Translated &&
+           FeatureModelModification::make_modification<RemoveFeatureFromModel>(
+               Translated)(*FM);
+  }
+
+  bool removeSubtreeImpl(Feature *F) {
+    auto *Translated = translate(F);
+    return Translated &&
+           FeatureModelModification::make_modification<RemoveSubtreeFromModel>(
+               Translated)(*FM);
+  }
+
+  bool setParentImpl(Feature *F, Feature *Parent) {
+    auto *TranslatedF = translate(F);
+    auto *TranslatedParent = translate(Parent);
+    return TranslatedF && TranslatedParent &&
+           FeatureModelModification::make_modification<SetParentOfFeature>(
+               TranslatedF, TranslatedParent)(*FM);
+  }
+
+  bool removeConstraintImpl(Constraint *C) {
+    auto *Translated = translate(C);
+    return Translated &&
+           FeatureModelModification::make_modification<
+               RemoveConstraintFromModel>(Translated)(*FM);
+  }
+
+  Relationship *addRelationshipImpl(Relationship::RelationshipKind Kind,
+                                    Feature *Parent,
+                                    std::vector<Feature *> Children) {
+    auto *TranslatedParent = translate(Parent);
+    if (!TranslatedParent) {
+      return nullptr;
+    }
+    for (auto *&Child : Children) {
+      if (!(Child = translate(Child))) {
+        return nullptr;
+      }
+    }
+    return FeatureModelModification::make_modification<AddRelationshipToModel>(
+        Kind, TranslatedParent, std::move(Children))(*FM);
+  }
+
+  bool removeRelationshipImpl(Relationship *R) {
+    auto *Translated = translate(R);
+    return Translated && FeatureModelModification::make_modification<
+                             RemoveRelationshipFromModel>(Translated)(*FM);
+  }
+
+  Relationship *setRelationshipKindImpl(Relationship *R,
+                                        Relationship::RelationshipKind Kind) {
+    auto *Translated = translate(R);
+    if (!Translated) {
+      return nullptr;
+    }
+    return FeatureModelModification::make_modification<SetRelationshipKind>(
+        Translated, Kind)(*FM);
+  }
+
+  bool setOptionalImpl(Feature *F, bool Opt) {
+    auto *Translated = translate(F);
+    return Translated &&
+           FeatureModelModification::make_modification<SetFeatureProperties>(
+               Translated, Opt)(*FM);
+  }
+
+  bool setValuesImpl(NumericFeature *F,
+                     NumericFeature::ValuesVariantType Values) {
+    auto *Translated = translate(F);
+    return Translated &&
+           FeatureModelModification::make_modification<SetFeatureProperties>(
+               Translated, std::nullopt, std::move(Values))(*FM);
+  }
+
+  bool setLocationsImpl(Feature *F,
+                        std::vector<FeatureSourceRange> Locations) {
+    auto *Translated = translate(F);
+    return Translated &&
+           FeatureModelModification::make_modification<SetFeatureProperties>(
+               Translated, std::nullopt, std::nullopt,
+               std::move(Locations))(*FM);
+  }
+
+  bool editLocationImpl(Feature *F, std::optional<FeatureSourceRange> Old,
+                        std::optional<FeatureSourceRange> New) {
+    auto *Translated = translate(F);
+    return Translated &&
+           FeatureModelModification::make_modification<EditFeatureLocation>(
+               Translated, std::move(Old), std::move(New))(*FM);
+  }
+
 private:
+  /// Translate a Feature of the original model, or of the copy, into the
+  /// copy.
+  Feature *translate(Feature *F) {
+    return F && FM ? FM->getFeature(F->getName()) : nullptr;
+  }
+
+  /// Translate a Constraint of the original model, or of the copy, into the
+  /// copy. Constraints of the original are looked up by the position their
+  /// clone got, which is not shifted by earlier removals.
+  Constraint *translate(Constraint *C) {
+    if (!C || !FM) {
+      return nullptr;
+    }
+    if (FM->getConstraintPosition(*C)) {
+      return C;
+    }
+    auto Search = ConstraintPositions.find(C);
+    return Search != ConstraintPositions.end()
+               ? FM->getConstraintAt(Search->second)
+               : nullptr;
+  }
+
+  /// Translate a Relationship by its parent and its children.
+  Relationship *translate(Relationship *R) {
+    auto *Parent = R ? R->getParent() : nullptr;
+    auto *TranslatedParent = translate(llvm::dyn_cast_or_null<Feature>(Parent));
+    if (!TranslatedParent) {
+      return nullptr;
+    }
+    auto Names = [](FeatureTreeNode &N) {
+      std::set<std::string> Names;
+      for (auto *Child : N.children()) {
+        if (auto *F = llvm::dyn_cast<Feature>(Child); F) {
+          Names.insert(F->getName().str());
+        }
+      }
+      return Names;
+    };
+    auto Expected = Names(*R);
+    for (auto *Child : TranslatedParent->children()) {
+      auto *Candidate = llvm::dyn_cast<Relationship>(Child);
+      if (Candidate && Candidate->getKind() == R->getKind() &&
+          Names(*Candidate) == Expected) {
+        return Candidate;
+      }
+    }
+    return nullptr;
+  }
+
   std::unique_ptr<FeatureModel> FM;
+  /// Positions of the cloned constraints by their original.
+  llvm::DenseMap<const Constraint *, size_t> ConstraintPositions;
 };
 
 class FeatureModelModifyTransactionBase {
 protected:
   FeatureModelModifyTransactionBase(FeatureModel &FM) : FM(&FM) {}
 
-  void commitImpl() {
-    assert(FM && "Cannot commit Modifications without a FeatureModel present.");
-    if (FM) {
-      std::for_each(
-          Modifications.begin(), Modifications.end(),
-          [this](const std::unique_ptr<FeatureModelModification> &FMM) {
-            FMM->exec(*FM);
-          });
-      ConsistencyCheck::isFeatureModelValid(*FM);
-      // TODO (se-passau/VaRA#723): implement rollback
-      FM = nullptr;
-    }
-  };
+  bool commitImpl(FeatureModelHistory *History = nullptr);
 
   void abortImpl() { Modifications.clear(); };
 
@@ -278,13 +1259,188 @@ protected:
             std::move(NewFeature), Parent));
   }
 
+  void addConstraintImpl(std::unique_ptr<Constraint> NewConstraint) {
+    assert(FM && "");
+
+    Modifications.push_back(FeatureModelModification::make_unique_modification<
+                            AddConstraintToModel>(std::move(NewConstraint)));
+  }
+
+  void removeFeatureImpl(Feature *F) {
+    assert(FM && "");
+
+    Modifications.push_back(FeatureModelModification::make_unique_modification<
+                            RemoveFeatureFromModel>(F));
+  }
+
+  void removeSubtreeImpl(Feature *F) {
+    assert(FM && "");
+
+    Modifications.push_back(FeatureModelModification::make_unique_modification<
+                            RemoveSubtreeFromModel>(F));
+  }
+
+  void setParentImpl(Feature *F, Feature *Parent) {
+    assert(FM && "");
+
+    Modifications.push_back(
+        FeatureModelModification::make_unique_modification<SetParentOfFeature>(
+            F, Parent));
+  }
+
+  void removeConstraintImpl(Constraint *C) {
+    assert(FM && "");
+
+    Modifications.push_back(FeatureModelModification::make_unique_modification<
+                            RemoveConstraintFromModel>(C));
+  }
+
+  void addRelationshipImpl(Relationship::RelationshipKind Kind,
+                           Feature *Parent, std::vector<Feature *> Children) {
+    assert(FM && "");
+
+    Modifications.push_back(FeatureModelModification::make_unique_modification<
+                            AddRelationshipToModel>(Kind, Parent,
+                                                    std::move(Children)));
+  }
+
+  void removeRelationshipImpl(Relationship *R) {
+    assert(FM && "");
+
+    Modifications.push_back(FeatureModelModification::make_unique_modification<
+                            RemoveRelationshipFromModel>(R));
+  }
+
+  void setRelationshipKindImpl(Relationship *R,
+                               Relationship::RelationshipKind Kind) {
+    assert(FM && "");
+
+    Modifications.push_back(FeatureModelModification::make_unique_modification<
+                            SetRelationshipKind>(R, Kind));
+  }
+
+  void setOptionalImpl(Feature *F, bool Opt) {
+    assert(FM && "");
+
+    Modifications.push_back(FeatureModelModification::make_unique_modification<
+                            SetFeatureProperties>(F, Opt));
+  }
+
+  void setValuesImpl(NumericFeature *F,
+                     NumericFeature::ValuesVariantType Values) {
+    assert(FM && "");
+
+    Modifications.push_back(FeatureModelModification::make_unique_modification<
+                            SetFeatureProperties>(F, std::nullopt,
+                                                  std::move(Values)));
+  }
+
+  void setLocationsImpl(Feature *F, std::vector<FeatureSourceRange> Locations) {
+    assert(FM && "");
+
+    Modifications.push_back(FeatureModelModification::make_unique_modification<
+                            SetFeatureProperties>(F, std::nullopt, std::nullopt,
+                                                  std::move(Locations)));
+  }
+
+  void editLocationImpl(Feature *F, std::optional<FeatureSourceRange> Old,
+                        std::optional<FeatureSourceRange> New) {
+    assert(FM && "");
+
+    Modifications.push_back(FeatureModelModification::make_unique_modification<
+                            EditFeatureLocation>(F, std::move(Old),
+                                                 std::move(New)));
+  }
+
 private:
+  /// Check the Features touched by the executed modifications, the rest of
+  /// the model was consistent before the transaction.
+  bool isConsistent() {
+    std::vector<Feature *> Touched;
+    for (const auto &M : Modifications) {
+      M->getTouchedFeatures(Touched);
+    }
+    // Features removed later on are kept alive by their modification.
+    Touched.erase(std::remove_if(Touched.begin(), Touched.end(),
+                                 [this](Feature *F) {
+                                   return FM->getFeature(F->getName()) != F;
+                                 }),
+                  Touched.end());
+    return ConsistencyCheck::areFeaturesValid(*FM, Touched);
+  }
+
   FeatureModel *FM;
-  std::vector<std::unique_ptr<FeatureModelModification>> Modifications;
+  FeatureModelModification::ModificationListTy Modifications;
 };
 
 } // namespace detail
 
+//===----------------------------------------------------------------------===//
+//                          FeatureModelHistory Class
+//===----------------------------------------------------------------------===//
+
+/// \brief Undo history of a FeatureModel that is changed by modify
+/// transactions.
+///
+/// Transactions committed into a history keep their modifications, which
+/// revert and reapply themselves in place, so no copy of the model is needed
+/// per step. While a history is used, the model must only be changed by
+/// transactions committed into it.
+class FeatureModelHistory {
+  friend class detail::FeatureModelModifyTransactionBase;
+
+public:
+  explicit FeatureModelHistory(FeatureModel &FM) : FM(FM) {}
+
+  [[nodiscard]] bool canUndo() const { return !Done.empty(); }
+  [[nodiscard]] bool canRedo() const { return !Undone.empty(); }
+
+  /// \brief Revert the last committed transaction.
+  ///
+  /// \returns false if there is nothing to undo
+  bool undo();
+
+  /// \brief Apply the last reverted transaction again.
+  ///
+  /// \returns false if there is nothing to redo
+  bool redo();
+
+private:
+  /// Record a committed transaction, which discards all reverted ones.
+  void record(detail::FeatureModelModification::ModificationListTy Step) {
+    Done.push_back(std::move(Step));
+    Undone.clear();
+  }
+
+  FeatureModel &FM;
+  std::vector<detail::FeatureModelModification::ModificationListTy> Done;
+  std::vector<detail::FeatureModelModification::ModificationListTy> Undone;
+};
+
+namespace detail {
+
+inline bool
+FeatureModelModifyTransactionBase::commitImpl(FeatureModelHistory *History) {
+  assert(FM && "Cannot commit Modifications without a FeatureModel present.");
+  if (!FM) {
+    return false;
+  }
+  // A failing modification reverts the whole transaction.
+  bool Committed = FeatureModelModification::execAll(*FM, Modifications);
+  if (Committed && !isConsistent()) {
+    FeatureModelModification::undoAll(*FM, Modifications);
+    Committed = false;
+  }
+  if (Committed && History) {
+    History->record(std::move(Modifications));
+  }
+  Modifications.clear();
+  FM = nullptr;
+  return Committed;
+}
+
+} // namespace detail
+
 } // namespace vara::feature
 
 #endif // VARA_FEATURE_FEATUREMODELTRANSACTION_H
@@ -3,12 +3,15 @@
 
 #include "vara/Feature/FeatureModel.h"
 
-#include "libxml/tree.h"
-#include "libxml/xmlwriter.h"
+#include "llvm/Support/raw_ostream.h"
 
 #include <memory>
 
 namespace vara::feature {
+namespace detail {
+class XmlFeatureIndex;
+class XmlStreamWriter;
+} // namespace detail
 
 //===----------------------------------------------------------------------===//
 //                               FeatureModelParser Class
@@ -34,7 +37,11 @@ public:
 //                               FeatureModelXmlParser Class
 //===----------------------------------------------------------------------===//
 
-/// \brief Parsers for feature models in XML.
+/// \brief Writer for feature models in XML.
+///
+/// The xml is streamed directly to the output, so no document is built in
+/// memory. Children, implied and excluded options of all features are
+/// collected once per model up front, so writing is linear in model size.
 class FeatureModelXmlWriter : public FeatureModelWriter {
 public:
   explicit FeatureModelXmlWriter(const FeatureModel &Fm) : Fm{Fm} {}
@@ -42,16 +49,88 @@ public:
   int writeFeatureModel(std::string Path) override;
   std::optional<std::string> writeFeatureModel() override;
 
+  /// Write the xml to \p OS. Only file streams track failed writes, so
+  /// those are detected by the overload for them.
+  ///
+  /// \returns 0 on success, a negative value if writing failed
+  int writeFeatureModel(llvm::raw_ostream &OS);
+  int writeFeatureModel(llvm::raw_fd_ostream &OS);
+
+private:
+  void writeVm(detail::XmlStreamWriter &Writer);
+  void writeBinaryFeatures(detail::XmlStreamWriter &Writer,
+                           const detail::XmlFeatureIndex &Index);
+  void writeNumericFeatures(detail::XmlStreamWriter &Writer,
+                            const detail::XmlFeatureIndex &Index);
+  void writeBooleanConstraints(detail::XmlStreamWriter &Writer);
+  static void writeFeature(detail::XmlStreamWriter &Writer,
+                           const detail::XmlFeatureIndex &Index, unsigned Id);
+  static void writeSourceRange(detail::XmlStreamWriter &Writer,
+                               FeatureSourceRange &Location);
+
+  const FeatureModel &Fm;
+};
+
+//===----------------------------------------------------------------------===//
+//                          FeatureModelDimacsWriter Class
+//===----------------------------------------------------------------------===//
+
+/// \brief Writer for the boolean semantics of feature models as CNF in DIMACS
+/// format.
+///
+/// Every feature is mapped to a variable, which is listed as `c <id> <name>`
+/// before the problem line. The CNF encodes the feature tree, relationship
+/// groups and all constraints; non-clausal constraints are encoded with a
+/// polarity-aware Tseitin transformation, which defines every xor and
+/// equivalence by a variable of its own. Numeric sub-terms cannot be encoded
+/// in CNF and are abstracted by free variables.
+///
+/// Clauses are written directly to the output stream. As the problem line
+/// needs the number of clauses up front, the model is encoded twice from the
+/// same normalized constraints: once to count and once to emit, so no clause
+/// set is ever built in memory.
+class FeatureModelDimacsWriter : public FeatureModelWriter {
+public:
+  explicit FeatureModelDimacsWriter(const FeatureModel &Fm) : Fm{Fm} {}
+
+  int writeFeatureModel(std::string Path) override;
+  std::optional<std::string> writeFeatureModel() override;
+
+  /// Write the CNF to \p OS. Only file streams track failed writes, so
+  /// those are detected by the overload for them.
+  ///
+  /// \returns 0 on success, a negative value if writing failed
+  int writeFeatureModel(llvm::raw_ostream &OS);
+  int writeFeatureModel(llvm::raw_fd_ostream &OS);
+
 private:
-  int writeFeatureModel(xmlTextWriterPtr Writer);
-  int writeVm(xmlTextWriterPtr Writer);
-  int writeBinaryFeatures(xmlTextWriterPtr Writer);
-  int writeNumericFeatures(xmlTextWriterPtr Writer);
-  int writeBooleanConstraints(xmlTextWriterPtr Writer);
-  static int writeFeature(xmlTextWriterPtr Writer, Feature &Feature1);
-  static int writeSourceRange(xmlTextWriterPtr Writer,
-                              FeatureSourceRange &Location);
+  const FeatureModel &Fm;
+};
 
+//===----------------------------------------------------------------------===//
+//                          FeatureModelBinaryWriter Class
+//===----------------------------------------------------------------------===//
+
+/// \brief Writer for feature models in a compact binary format, which can be
+/// loaded with \a FeatureModelBinaryParser without any validation overhead.
+///
+/// All strings are stored once in a string table, features reference their
+/// parents by index, and constraints are flattened in pre-order.
+class FeatureModelBinaryWriter : public FeatureModelWriter {
+public:
+  explicit FeatureModelBinaryWriter(const FeatureModel &Fm) : Fm{Fm} {}
+
+  int writeFeatureModel(std::string Path) override;
+  std::optional<std::string> writeFeatureModel() override;
+
+  /// Write the binary model to \p OS. Only file streams track failed writes, so
+  /// those are detected by the overload for them.
+  ///
+  /// \returns 0 on success, a negative value if writing failed
+  int writeFeatureModel(llvm::raw_ostream &OS);
+  int writeFeatureModel(llvm::raw_fd_ostream &OS);
+
+private:
   const FeatureModel &Fm;
 };
 
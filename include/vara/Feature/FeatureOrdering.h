@@ -0,0 +1,125 @@
+#ifndef VARA_FEATURE_FEATUREORDERING_H
+#define VARA_FEATURE_FEATUREORDERING_H
+
+#include "vara/Feature/Feature.h"
+
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/SmallPtrSet.h"
+
+#include <iterator>
+#include <set>
+
+namespace vara::feature {
+
+//===----------------------------------------------------------------------===//
+//                            FeatureOrdering Class
+//===----------------------------------------------------------------------===//
+
+/// \brief Ordering of the features of a \a FeatureModel, comparing with \a
+/// Feature::operator<.
+///
+/// Every feature is indexed by its node in the ordering, so removing features
+/// or inserting a block of them does not depend on the number of features.
+/// Positions are only compared when a feature is inserted. A feature must
+/// therefore be removed before it, or one of its ancestors, is moved or
+/// renamed, and inserted again afterwards.
+class FeatureOrdering {
+  struct FeatureLess {
+    bool operator()(const Feature *A, const Feature *B) const {
+      return *A < *B;
+    }
+  };
+  using FeatureSetTy = std::multiset<Feature *, FeatureLess>;
+
+public:
+  using ordered_feature_iterator = FeatureSetTy::iterator;
+  using const_ordered_feature_iterator = FeatureSetTy::const_iterator;
+
+  FeatureOrdering() = default;
+  FeatureOrdering(const FeatureOrdering &) = delete;
+  FeatureOrdering &operator=(const FeatureOrdering &) = delete;
+  FeatureOrdering(FeatureOrdering &&) = delete;
+  FeatureOrdering &operator=(FeatureOrdering &&) = delete;
+  ~FeatureOrdering() = default;
+
+  /// Insert a feature at its position. A feature that is already ordered is
+  /// removed first, so this also orders a feature again after it was moved.
+  void insert(Feature *F);
+
+  /// Append a feature that is not ordered before the last feature, which
+  /// avoids searching for its position.
+  void push_back(Feature *F) {
+    assert((Features.empty() || !(*F < **Features.rbegin())) &&
+           "Appended feature breaks the ordering.");
+    insert(Features.end(), F);
+  }
+
+  /// Remove a feature, which needs no comparison and thus works for features
+  /// that were already moved.
+  void remove(Feature *F) {
+    if (auto Search = Positions.find(F); Search != Positions.end()) {
+      Features.erase(Search->second);
+      Positions.erase(Search);
+    }
+  }
+
+  /// Remove all features of a set.
+  void remove(const llvm::SmallPtrSetImpl<Feature *> &Removed) {
+    for (auto *F : Removed) {
+      remove(F);
+    }
+  }
+
+  /// Insert ordered features that are contiguous in the ordering, e.g., a
+  /// subtree, with a single search for their position. None of them may be
+  /// ordered yet.
+  template <class FeatureIterTy>
+  void insertBlock(FeatureIterTy Begin, FeatureIterTy End) {
+    if (Begin == End) {
+      return;
+    }
+    // Each following feature is placed right behind its predecessor.
+    auto Hint = insert(Features.upper_bound(*Begin), *Begin);
+    for (++Begin; Begin != End; ++Begin) {
+      Hint = insert(std::next(Hint), *Begin);
+    }
+  }
+
+  /// Remove all features.
+  void clear() {
+    Features.clear();
+    Positions.clear();
+  }
+
+  [[nodiscard]] unsigned int size() const { return Features.size(); }
+
+  [[nodiscard]] bool empty() const { return Features.empty(); }
+
+  ordered_feature_iterator begin() { return Features.begin(); }
+  [[nodiscard]] const_ordered_feature_iterator begin() const {
+    return Features.begin();
+  }
+
+  ordered_feature_iterator end() { return Features.end(); }
+  [[nodiscard]] const_ordered_feature_iterator end() const {
+    return Features.end();
+  }
+
+private:
+  /// Insert a feature that is not ordered yet right before \p Hint, if that
+  /// keeps the ordering.
+  ordered_feature_iterator insert(const_ordered_feature_iterator Hint,
+                                  Feature *F) {
+    assert(!Positions.count(F) && "Feature is already ordered.");
+    auto Inserted = Features.insert(Hint, F);
+    Positions[F] = Inserted;
+    return Inserted;
+  }
+
+  FeatureSetTy Features;
+  llvm::DenseMap<const Feature *, ordered_feature_iterator> Positions;
+};
+
+} // namespace vara::feature
+
+#endif // VARA_FEATURE_FEATUREORDERING_H
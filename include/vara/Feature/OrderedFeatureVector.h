@@ -3,6 +3,10 @@
 
 #include "vara/Feature/Feature.h"
 
+#include "llvm/ADT/SmallPtrSet.h"
+
+#include <algorithm>
+
 namespace vara::feature {
 
 //===----------------------------------------------------------------------===//
@@ -34,12 +38,45 @@ public:
   /// Insert feature while preserving ordering.
   void insert(Feature *F);
 
+  /// Append a feature that is not ordered before the last feature, which
+  /// avoids searching for its position.
+  void push_back(Feature *F) {
+    assert((Features.empty() || !(*F < *Features.back())) &&
+           "Appended feature breaks the ordering.");
+    Features.push_back(F);
+  }
+
   /// Remove feature.
   void remove(Feature *F) {
     Features.erase(std::remove(Features.begin(), Features.end(), F),
                    Features.end());
   }
 
+  /// Remove all features of a set in a single pass.
+  void remove(const llvm::SmallPtrSetImpl<Feature *> &Removed) {
+    Features.erase(std::remove_if(Features.begin(), Features.end(),
+                                  [&Removed](Feature *F) {
+                                    return Removed.count(F) != 0;
+                                  }),
+                   Features.end());
+  }
+
+  /// Insert ordered features that are contiguous in the ordering, e.g., a
+  /// subtree, with a single search for their position.
+  template <class FeatureIterTy>
+  void insertBlock(FeatureIterTy Begin, FeatureIterTy End) {
+    if (Begin == End) {
+      return;
+    }
+    Features.insert(
+        std::upper_bound(Features.begin(), Features.end(), *Begin,
+                         [](Feature *A, Feature *B) { return *A < *B; }),
+        Begin, End);
+  }
+
+  /// Remove all features.
+  void clear() { Features.clear(); }
+
   template <class FeatureIterTy>
   void insert(llvm::iterator_range<FeatureIterTy> Iter) {
     for (const auto &F : Iter) {
@@ -0,0 +1,161 @@
+#ifndef VARA_FEATURE_VERSIONEDFEATUREMODEL_H
+#define VARA_FEATURE_VERSIONEDFEATUREMODEL_H
+
+#include "vara/Feature/FeatureModel.h"
+#include "vara/Feature/FeatureModelTransaction.h"
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace vara::feature {
+
+class VersionedFeatureModel;
+
+namespace detail {
+
+/// \brief Published version of a FeatureModel, which is never changed.
+struct FeatureModelVersion {
+  std::unique_ptr<FeatureModel> FM;
+  uint64_t Number;
+  /// Epoch in which the version was replaced by a newer one.
+  uint64_t RetiredAt{0};
+};
+
+/// \brief Announces the epoch a reader entered, or \a Idle.
+struct ReaderSlot {
+  static constexpr uint64_t Idle = UINT64_MAX;
+
+  std::atomic<uint64_t> Epoch{Idle};
+  std::atomic<bool> InUse{false};
+  ReaderSlot *Next{nullptr};
+};
+
+} // namespace detail
+
+//===----------------------------------------------------------------------===//
+//                          FeatureModelSnapshot Class
+//===----------------------------------------------------------------------===//
+
+/// \brief Pins a version of a \a VersionedFeatureModel for reading.
+///
+/// The version stays alive and unchanged until the snapshot is destroyed, no
+/// matter how many newer versions are published meanwhile.
+class FeatureModelSnapshot {
+  friend class VersionedFeatureModel;
+
+public:
+  FeatureModelSnapshot(const FeatureModelSnapshot &) = delete;
+  FeatureModelSnapshot &operator=(const FeatureModelSnapshot &) = delete;
+  FeatureModelSnapshot(FeatureModelSnapshot &&Other) noexcept
+      : Slot(Other.Slot), Version(Other.Version) {
+    Other.Slot = nullptr;
+  }
+  FeatureModelSnapshot &operator=(FeatureModelSnapshot &&Other) noexcept {
+    if (this != &Other) {
+      release();
+      Slot = Other.Slot;
+      Version = Other.Version;
+      Other.Slot = nullptr;
+    }
+    return *this;
+  }
+  ~FeatureModelSnapshot() { release(); }
+
+  [[nodiscard]] const FeatureModel &operator*() const { return *Version->FM; }
+  [[nodiscard]] const FeatureModel *operator->() const {
+    return Version->FM.get();
+  }
+  [[nodiscard]] const FeatureModel *get() const { return Version->FM.get(); }
+
+  /// Number of the pinned version, starting with 0 for the initial model.
+  [[nodiscard]] uint64_t getVersion() const { return Version->Number; }
+
+private:
+  FeatureModelSnapshot(detail::ReaderSlot *Slot,
+                       const detail::FeatureModelVersion *Version)
+      : Slot(Slot), Version(Version) {}
+
+  void release();
+
+  detail::ReaderSlot *Slot;
+  const detail::FeatureModelVersion *Version;
+};
+
+//===----------------------------------------------------------------------===//
+//                          VersionedFeatureModel Class
+//===----------------------------------------------------------------------===//
+
+/// \brief FeatureModel that is read concurrently while it is updated.
+///
+/// Updates never change a published model but publish a new version, so
+/// readers see a consistent model without locking. Replaced versions are
+/// reclaimed epoch based: a reader announces the epoch it entered in a slot
+/// of its own, and a version retired in an earlier epoch than every announced
+/// one cannot be reached by any reader anymore.
+///
+/// Taking and releasing snapshots is lock-free and never waits for writers.
+/// Writers are serialized among each other and reclaim retired versions
+/// whenever they publish, or on \a reclaim.
+class VersionedFeatureModel {
+public:
+  explicit VersionedFeatureModel(std::unique_ptr<FeatureModel> FM);
+  VersionedFeatureModel(const VersionedFeatureModel &) = delete;
+  VersionedFeatureModel &operator=(const VersionedFeatureModel &) = delete;
+  VersionedFeatureModel(VersionedFeatureModel &&) = delete;
+  VersionedFeatureModel &operator=(VersionedFeatureModel &&) = delete;
+  /// All snapshots must be released before.
+  ~VersionedFeatureModel();
+
+  /// \brief Pin the current version for reading.
+  [[nodiscard]] FeatureModelSnapshot snapshot() const;
+
+  /// \brief Publish a new version, which replaces the current one for all
+  /// snapshots taken afterwards.
+  void publish(std::unique_ptr<FeatureModel> FM);
+
+  /// \brief Apply a copy transaction to the current version and publish the
+  /// result.
+  ///
+  /// \param Modify callable that is passed the open
+  ///               \a FeatureModelCopyTransaction
+  ///
+  /// \returns false if the transaction did not produce a model
+  template <typename ModifyTy> bool update(ModifyTy &&Modify) {
+    std::lock_guard<std::mutex> Lock(WriterMutex);
+    auto FT =
+        FeatureModelCopyTransaction::openTransaction(*Current.load()->FM);
+    Modify(FT);
+    auto Next = FT.commit();
+    if (!Next) {
+      return false;
+    }
+    publishLocked(std::move(Next));
+    return true;
+  }
+
+  /// \brief Free all retired versions that are no longer pinned.
+  void reclaim();
+
+  /// Number of retired versions that were not reclaimed yet.
+  [[nodiscard]] size_t getNumRetired() const;
+
+private:
+  void publishLocked(std::unique_ptr<FeatureModel> FM);
+  void reclaimLocked();
+  detail::ReaderSlot *acquireSlot() const;
+
+  std::atomic<detail::FeatureModelVersion *> Current;
+  std::atomic<uint64_t> Epoch{0};
+  /// Slots are only added and reused, never freed while readers may exist.
+  mutable std::atomic<detail::ReaderSlot *> Slots{nullptr};
+
+  mutable std::mutex WriterMutex;
+  std::vector<std::unique_ptr<detail::FeatureModelVersion>> Retired;
+};
+
+} // namespace vara::feature
+
+#endif // VARA_FEATURE_VERSIONEDFEATUREMODEL_H
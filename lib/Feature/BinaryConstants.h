@@ -0,0 +1,273 @@
+#ifndef VARA_FEATURE_BINARYCONSTANTS_H
+#define VARA_FEATURE_BINARYCONSTANTS_H
+
+#include "vara/Feature/Constraint.h"
+#include "vara/Feature/Feature.h"
+#include "vara/Feature/FeatureSourceRange.h"
+#include "vara/Feature/Relationship.h"
+
+#include "llvm/Support/ErrorHandling.h"
+
+#include <cstdint>
+#include <optional>
+
+namespace vara::feature {
+
+/// Layout of binary feature models. All integers are little endian.
+///
+///   magic "VFMB", u32 version
+///   u32 #strings, { u32 length, bytes }
+///   u32 name, u32 path, u32 commit
+///   u32 #features, { u8 kind, u8 optional, u32 name, u32 parent + 1,
+///                    [u8 values kind, (i32 min, i32 max) |
+///                                     (u32 #values, { i32 })],
+///                    u32 #locations, { u8 category, u8 flags, u32 path,
+///                                      [i32 line, i32 column] x 2 } }
+///   u32 #relationships, { u8 kind, u32 parent, u32 #children, { u32 } }
+///   u32 #constraints, constraint nodes in pre-order, each
+///                     { u8 kind, u32 name | i32 value | u32 #operands }
+///
+/// Strings are referenced by their index in the string table, features by
+/// their index in the feature list, which is ordered parents first. Kinds are
+/// stored as the tags below, which must never change, and not as the values
+/// of the in-memory enums.
+class BinaryConstants {
+public:
+  BinaryConstants() = delete;
+  BinaryConstants(const BinaryConstants &) = delete;
+  BinaryConstants &operator=(const BinaryConstants &) = delete;
+  BinaryConstants(BinaryConstants &&) noexcept = delete;
+  BinaryConstants &operator=(BinaryConstants &&) noexcept = delete;
+  ~BinaryConstants() = delete;
+
+  static constexpr char MAGIC[] = "VFMB";
+  static constexpr uint32_t VERSION = 1;
+
+  static constexpr uint8_t VALUES_RANGE = 0;
+  static constexpr uint8_t VALUES_LIST = 1;
+
+  static constexpr uint8_t LOCATION_START = 1;
+  static constexpr uint8_t LOCATION_END = 2;
+
+  static constexpr uint32_t NO_PARENT = 0;
+
+  static constexpr uint8_t FEATURE_BINARY = 0;
+  static constexpr uint8_t FEATURE_NUMERIC = 1;
+  static constexpr uint8_t FEATURE_ROOT = 2;
+  static constexpr uint8_t FEATURE_UNKNOWN = 3;
+
+  static constexpr uint8_t RELATIONSHIP_ALTERNATIVE = 0;
+  static constexpr uint8_t RELATIONSHIP_OR = 1;
+
+  static constexpr uint8_t CATEGORY_NECESSARY = 0;
+  static constexpr uint8_t CATEGORY_INESSENTIAL = 1;
+
+  static constexpr uint8_t CONSTRAINT_OR = 1;
+  static constexpr uint8_t CONSTRAINT_XOR = 2;
+  static constexpr uint8_t CONSTRAINT_AND = 3;
+  static constexpr uint8_t CONSTRAINT_EQUALS = 4;
+  static constexpr uint8_t CONSTRAINT_IMPLIES = 5;
+  static constexpr uint8_t CONSTRAINT_EXCLUDES = 6;
+  static constexpr uint8_t CONSTRAINT_EQUIVALENCE = 7;
+  static constexpr uint8_t CONSTRAINT_ADDITION = 8;
+  static constexpr uint8_t CONSTRAINT_SUBTRACTION = 9;
+  static constexpr uint8_t CONSTRAINT_MULTIPLICATION = 10;
+  static constexpr uint8_t CONSTRAINT_DIVISION = 11;
+  static constexpr uint8_t CONSTRAINT_LESS = 12;
+  static constexpr uint8_t CONSTRAINT_GREATER = 13;
+  static constexpr uint8_t CONSTRAINT_LESSEQUAL = 14;
+  static constexpr uint8_t CONSTRAINT_GREATEREQUAL = 15;
+  static constexpr uint8_t CONSTRAINT_NOT = 17;
+  static constexpr uint8_t CONSTRAINT_NEG = 18;
+  static constexpr uint8_t CONSTRAINT_NARY_OR = 20;
+  static constexpr uint8_t CONSTRAINT_NARY_AND = 21;
+  static constexpr uint8_t CONSTRAINT_NARY_XOR = 22;
+  static constexpr uint8_t CONSTRAINT_INTEGER = 24;
+  static constexpr uint8_t CONSTRAINT_FEATURE = 25;
+
+  static uint8_t getTag(Feature::FeatureKind Kind) {
+    using FK = Feature::FeatureKind;
+    switch (Kind) {
+    case FK::FK_BINARY:
+      return FEATURE_BINARY;
+    case FK::FK_NUMERIC:
+      return FEATURE_NUMERIC;
+    case FK::FK_ROOT:
+      return FEATURE_ROOT;
+    case FK::FK_UNKNOWN:
+      return FEATURE_UNKNOWN;
+    }
+    llvm_unreachable("Unknown feature kind.");
+  }
+
+  static std::optional<Feature::FeatureKind> getFeatureKind(uint8_t Tag) {
+    using FK = Feature::FeatureKind;
+    switch (Tag) {
+    case FEATURE_BINARY:
+      return FK::FK_BINARY;
+    case FEATURE_NUMERIC:
+      return FK::FK_NUMERIC;
+    case FEATURE_ROOT:
+      return FK::FK_ROOT;
+    case FEATURE_UNKNOWN:
+      return FK::FK_UNKNOWN;
+    default:
+      return std::nullopt;
+    }
+  }
+
+  static uint8_t getTag(Relationship::RelationshipKind Kind) {
+    switch (Kind) {
+    case Relationship::RelationshipKind::RK_ALTERNATIVE:
+      return RELATIONSHIP_ALTERNATIVE;
+    case Relationship::RelationshipKind::RK_OR:
+      return RELATIONSHIP_OR;
+    }
+    llvm_unreachable("Unknown relationship kind.");
+  }
+
+  static std::optional<Relationship::RelationshipKind>
+  getRelationshipKind(uint8_t Tag) {
+    switch (Tag) {
+    case RELATIONSHIP_ALTERNATIVE:
+      return Relationship::RelationshipKind::RK_ALTERNATIVE;
+    case RELATIONSHIP_OR:
+      return Relationship::RelationshipKind::RK_OR;
+    default:
+      return std::nullopt;
+    }
+  }
+
+  static uint8_t getTag(FeatureSourceRange::Category Category) {
+    switch (Category) {
+    case FeatureSourceRange::Category::necessary:
+      return CATEGORY_NECESSARY;
+    case FeatureSourceRange::Category::inessential:
+      return CATEGORY_INESSENTIAL;
+    }
+    llvm_unreachable("Unknown location category.");
+  }
+
+  static std::optional<FeatureSourceRange::Category> getCategory(uint8_t Tag) {
+    switch (Tag) {
+    case CATEGORY_NECESSARY:
+      return FeatureSourceRange::Category::necessary;
+    case CATEGORY_INESSENTIAL:
+      return FeatureSourceRange::Category::inessential;
+    default:
+      return std::nullopt;
+    }
+  }
+
+  static uint8_t getTag(Constraint::ConstraintKind Kind) {
+    using CK = Constraint::ConstraintKind;
+    switch (Kind) {
+    case CK::CK_OR:
+      return CONSTRAINT_OR;
+    case CK::CK_XOR:
+      return CONSTRAINT_XOR;
+    case CK::CK_AND:
+      return CONSTRAINT_AND;
+    case CK::CK_EQUALS:
+      return CONSTRAINT_EQUALS;
+    case CK::CK_IMPLIES:
+      return CONSTRAINT_IMPLIES;
+    case CK::CK_EXCLUDES:
+      return CONSTRAINT_EXCLUDES;
+    case CK::CK_EQUIVALENCE:
+      return CONSTRAINT_EQUIVALENCE;
+    case CK::CK_ADDITION:
+      return CONSTRAINT_ADDITION;
+    case CK::CK_SUBTRACTION:
+      return CONSTRAINT_SUBTRACTION;
+    case CK::CK_MULTIPLICATION:
+      return CONSTRAINT_MULTIPLICATION;
+    case CK::CK_DIVISION:
+      return CONSTRAINT_DIVISION;
+    case CK::CK_LESS:
+      return CONSTRAINT_LESS;
+    case CK::CK_GREATER:
+      return CONSTRAINT_GREATER;
+    case CK::CK_LESSEQUAL:
+      return CONSTRAINT_LESSEQUAL;
+    case CK::CK_GREATEREQUAL:
+      return CONSTRAINT_GREATEREQUAL;
+    case CK::CK_NOT:
+      return CONSTRAINT_NOT;
+    case CK::CK_NEG:
+      return CONSTRAINT_NEG;
+    case CK::CK_NARY_OR:
+      return CONSTRAINT_NARY_OR;
+    case CK::CK_NARY_AND:
+      return CONSTRAINT_NARY_AND;
+    case CK::CK_NARY_XOR:
+      return CONSTRAINT_NARY_XOR;
+    case CK::CK_INTEGER:
+      return CONSTRAINT_INTEGER;
+    case CK::CK_FEATURE:
+      return CONSTRAINT_FEATURE;
+    case CK::CK_BINARY:
+    case CK::CK_UNARY:
+    case CK::CK_NARY:
+    case CK::CK_PRIMARY:
+      break;
+    }
+    llvm_unreachable("Constraints of abstract kinds do not exist.");
+  }
+
+  static std::optional<Constraint::ConstraintKind>
+  getConstraintKind(uint8_t Tag) {
+    using CK = Constraint::ConstraintKind;
+    switch (Tag) {
+    case CONSTRAINT_OR:
+      return CK::CK_OR;
+    case CONSTRAINT_XOR:
+      return CK::CK_XOR;
+    case CONSTRAINT_AND:
+      return CK::CK_AND;
+    case CONSTRAINT_EQUALS:
+      return CK::CK_EQUALS;
+    case CONSTRAINT_IMPLIES:
+      return CK::CK_IMPLIES;
+    case CONSTRAINT_EXCLUDES:
+      return CK::CK_EXCLUDES;
+    case CONSTRAINT_EQUIVALENCE:
+      return CK::CK_EQUIVALENCE;
+    case CONSTRAINT_ADDITION:
+      return CK::CK_ADDITION;
+    case CONSTRAINT_SUBTRACTION:
+      return CK::CK_SUBTRACTION;
+    case CONSTRAINT_MULTIPLICATION:
+      return CK::CK_MULTIPLICATION;
+    case CONSTRAINT_DIVISION:
+      return CK::CK_DIVISION;
+    case CONSTRAINT_LESS:
+      return CK::CK_LESS;
+    case CONSTRAINT_GREATER:
+      return CK::CK_GREATER;
+    case CONSTRAINT_LESSEQUAL:
+      return CK::CK_LESSEQUAL;
+    case CONSTRAINT_GREATEREQUAL:
+      return CK::CK_GREATEREQUAL;
+    case CONSTRAINT_NOT:
+      return CK::CK_NOT;
+    case CONSTRAINT_NEG:
+      return CK::CK_NEG;
+    case CONSTRAINT_NARY_OR:
+      return CK::CK_NARY_OR;
+    case CONSTRAINT_NARY_AND:
+      return CK::CK_NARY_AND;
+    case CONSTRAINT_NARY_XOR:
+      return CK::CK_NARY_XOR;
+    case CONSTRAINT_INTEGER:
+      return CK::CK_INTEGER;
+    case CONSTRAINT_FEATURE:
+      return CK::CK_FEATURE;
+    default:
+      return std::nullopt;
+    }
+  }
+};
+} // namespace vara::feature
+
+#endif // VARA_FEATURE_BINARYCONSTANTS_H
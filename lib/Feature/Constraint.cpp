@@ -1,11 +1,211 @@
 #include "vara/Feature/Constraint.h"
 #include "vara/Feature/Feature.h"
 
+#include "llvm/Support/ErrorHandling.h"
+
+#include <algorithm>
+#include <iterator>
+
 namespace vara::feature {
+
+namespace {
+
+using CK = Constraint::ConstraintKind;
+
+llvm::StringRef getOperatorSymbol(CK Kind, bool HTML) {
+  switch (Kind) {
+  case CK::CK_OR:
+  case CK::CK_NARY_OR:
+    return " | ";
+  case CK::CK_XOR:
+  case CK::CK_NARY_XOR:
+    return " ^ ";
+  case CK::CK_AND:
+  case CK::CK_NARY_AND:
+    return HTML ? " &amp; " : " & ";
+  case CK::CK_EQUALS:
+    return " = ";
+  case CK::CK_IMPLIES:
+    return HTML ? " =&gt; " : " => ";
+  case CK::CK_EXCLUDES:
+    return HTML ? " =&gt; !" : " => !";
+  case CK::CK_EQUIVALENCE:
+    return HTML ? " &lt;=&gt; " : " <=> ";
+  case CK::CK_ADDITION:
+    return " + ";
+  case CK::CK_SUBTRACTION:
+    return " - ";
+  case CK::CK_MULTIPLICATION:
+    return " * ";
+  case CK::CK_DIVISION:
+    return " / ";
+  case CK::CK_LESS:
+    return HTML ? " &lt; " : " < ";
+  case CK::CK_GREATER:
+    return HTML ? " &gt; " : " > ";
+  case CK::CK_LESSEQUAL:
+    return HTML ? " &lt;= " : " <= ";
+  case CK::CK_GREATEREQUAL:
+    return HTML ? " &gt;= " : " >= ";
+  case CK::CK_NOT:
+    return "!";
+  case CK::CK_NEG:
+    return "~";
+  default:
+    llvm_unreachable("Constraint kind without operator.");
+  }
+}
+
+/// Streams a constraint tree in infix notation.
+class ConstraintPrinter : public ConstraintWalker<const Constraint> {
+public:
+  ConstraintPrinter(llvm::raw_ostream &OS, bool HTML) : OS(OS), HTML(HTML) {}
+
+protected:
+  bool preVisit(const Constraint &C) override {
+    if (llvm::isa<PrimaryConstraint>(C)) {
+      OS << C.toString();
+    } else if (llvm::isa<UnaryConstraint>(C)) {
+      OS << getOperatorSymbol(C.getKind(), HTML);
+    } else {
+      OS << '(';
+    }
+    return true;
+  }
+
+  void inVisit(const Constraint &C, unsigned /*Idx*/) override {
+    OS << getOperatorSymbol(C.getKind(), HTML);
+  }
+
+  void postVisit(const Constraint &C) override {
+    if (llvm::isa<BinaryConstraint>(C) || llvm::isa<NaryConstraint>(C)) {
+      OS << ')';
+    }
+  }
+
+private:
+  llvm::raw_ostream &OS;
+  bool HTML;
+};
+
+/// Clones a constraint tree bottom-up, keeping the clones of already walked
+/// operands on a stack.
+class ConstraintCloner : public ConstraintWalker<> {
+public:
+  std::unique_ptr<Constraint> takeClone() {
+    assert(Clones.size() == 1 && "Walk did not finish.");
+    return std::move(Clones.back());
+  }
+
+protected:
+  void postVisit(Constraint &C) override {
+    if (llvm::isa<PrimaryConstraint>(C)) {
+      Clones.push_back(C.clone());
+      return;
+    }
+
+    auto Operands = Clones.end() - getNumOperands(C);
+    std::unique_ptr<Constraint> Clone;
+    if (llvm::isa<BinaryConstraint>(C)) {
+      Clone = BinaryConstraint::create(C.getKind(), std::move(Operands[0]),
+                                       std::move(Operands[1]));
+    } else if (llvm::isa<UnaryConstraint>(C)) {
+      Clone = UnaryConstraint::create(C.getKind(), std::move(Operands[0]));
+    } else {
+      Clone = NaryConstraint::create(
+          C.getKind(),
+          NaryConstraint::OperandContainerTy(
+              std::make_move_iterator(Operands),
+              std::make_move_iterator(Clones.end())));
+    }
+    Clones.erase(Operands, Clones.end());
+    Clones.push_back(std::move(Clone));
+  }
+
+private:
+  std::vector<std::unique_ptr<Constraint>> Clones;
+};
+
+} // namespace
+
+//===----------------------------------------------------------------------===//
+//                               Constraint
+//===----------------------------------------------------------------------===//
+
+std::unique_ptr<Constraint> Constraint::clone() {
+  ConstraintCloner Cloner;
+  Cloner.walk(*this);
+  return Cloner.takeClone();
+}
+
+std::string Constraint::toString() const {
+  std::string Str;
+  llvm::raw_string_ostream OS(Str);
+  print(OS);
+  return OS.str();
+}
+
+std::string Constraint::toHTML() const {
+  std::string Str;
+  llvm::raw_string_ostream OS(Str);
+  printHTML(OS);
+  return OS.str();
+}
+
+void Constraint::print(llvm::raw_ostream &OS) const {
+  ConstraintPrinter(OS, false).walk(*this);
+}
+
+void Constraint::printHTML(llvm::raw_ostream &OS) const {
+  ConstraintPrinter(OS, true).walk(*this);
+}
+
+void Constraint::destroyOperands() {
+  std::vector<std::unique_ptr<Constraint>> Worklist;
+  takeOperands(*this, Worklist);
+  while (!Worklist.empty()) {
+    // Each constraint is destroyed after its operands were taken, so
+    // destructors never recurse.
+    auto C = std::move(Worklist.back());
+    Worklist.pop_back();
+    takeOperands(*C, Worklist);
+  }
+}
+
+std::vector<std::unique_ptr<Constraint>>
+Constraint::releaseOperands(std::unique_ptr<Constraint> C) {
+  std::vector<std::unique_ptr<Constraint>> Operands;
+  takeOperands(*C, Operands);
+  for (auto &Operand : Operands) {
+    Operand->setParent(nullptr);
+  }
+  return Operands;
+}
+
+void Constraint::takeOperands(
+    Constraint &C, std::vector<std::unique_ptr<Constraint>> &Operands) {
+  auto Take = [&Operands](std::unique_ptr<Constraint> &Operand) {
+    if (Operand) {
+      Operands.push_back(std::move(Operand));
+    }
+  };
+  if (auto *B = llvm::dyn_cast<BinaryConstraint>(&C); B) {
+    Take(B->LeftOperand);
+    Take(B->RightOperand);
+  } else if (auto *U = llvm::dyn_cast<UnaryConstraint>(&C); U) {
+    Take(U->Operand);
+  } else if (auto *N = llvm::dyn_cast<NaryConstraint>(&C); N) {
+    std::for_each(N->Operands.begin(), N->Operands.end(), Take);
+    N->Operands.clear();
+  }
+}
+
 void BinaryConstraint::accept(ConstraintVisitor &V) { return V.visit(this); }
 
 void UnaryConstraint::accept(ConstraintVisitor &V) { return V.visit(this); }
 
+void NaryConstraint::accept(ConstraintVisitor &V) { return V.visit(this); }
+
 void PrimaryIntegerConstraint::accept(ConstraintVisitor &V) {
   return V.visit(this);
 }
@@ -14,6 +214,129 @@ void PrimaryFeatureConstraint::accept(ConstraintVisitor &V) {
   return V.visit(this);
 }
 
+std::unique_ptr<Constraint>
+BinaryConstraint::create(ConstraintKind Kind, std::unique_ptr<Constraint> LHS,
+                         std::unique_ptr<Constraint> RHS) {
+  using CK = ConstraintKind;
+  switch (Kind) {
+  case CK::CK_OR:
+    return std::make_unique<OrConstraint>(std::move(LHS), std::move(RHS));
+  case CK::CK_XOR:
+    return std::make_unique<XorConstraint>(std::move(LHS), std::move(RHS));
+  case CK::CK_AND:
+    return std::make_unique<AndConstraint>(std::move(LHS), std::move(RHS));
+  case CK::CK_EQUALS:
+    return std::make_unique<EqualsConstraint>(std::move(LHS), std::move(RHS));
+  case CK::CK_IMPLIES:
+    return std::make_unique<ImpliesConstraint>(std::move(LHS), std::move(RHS));
+  case CK::CK_EXCLUDES:
+    return std::make_unique<ExcludesConstraint>(std::move(LHS),
+                                                std::move(RHS));
+  case CK::CK_EQUIVALENCE:
+    return std::make_unique<EquivalenceConstraint>(std::move(LHS),
+                                                   std::move(RHS));
+  case CK::CK_ADDITION:
+    return std::make_unique<AdditionConstraint>(std::move(LHS),
+                                                std::move(RHS));
+  case CK::CK_SUBTRACTION:
+    return std::make_unique<SubtractionConstraint>(std::move(LHS),
+                                                   std::move(RHS));
+  case CK::CK_MULTIPLICATION:
+    return std::make_unique<MultiplicationConstraint>(std::move(LHS),
+                                                      std::move(RHS));
+  case CK::CK_DIVISION:
+    return std::make_unique<DivisionConstraint>(std::move(LHS),
+                                                std::move(RHS));
+  case CK::CK_LESS:
+    return std::make_unique<LessConstraint>(std::move(LHS), std::move(RHS));
+  case CK::CK_GREATER:
+    return std::make_unique<GreaterConstraint>(std::move(LHS), std::move(RHS));
+  case CK::CK_LESSEQUAL:
+    return std::make_unique<LessEqualConstraint>(std::move(LHS),
+                                                 std::move(RHS));
+  case CK::CK_GREATEREQUAL:
+    return std::make_unique<GreaterEqualConstraint>(std::move(LHS),
+                                                    std::move(RHS));
+  default:
+    llvm_unreachable("Not a binary constraint kind.");
+  }
+}
+
+std::unique_ptr<Constraint>
+UnaryConstraint::create(ConstraintKind Kind,
+                        std::unique_ptr<Constraint> Operand) {
+  switch (Kind) {
+  case ConstraintKind::CK_NOT:
+    return std::make_unique<NotConstraint>(std::move(Operand));
+  case ConstraintKind::CK_NEG:
+    return std::make_unique<NegConstraint>(std::move(Operand));
+  default:
+    llvm_unreachable("Not a unary constraint kind.");
+  }
+}
+
+std::unique_ptr<Constraint>
+NaryConstraint::create(ConstraintKind Kind, OperandContainerTy Operands) {
+  switch (Kind) {
+  case ConstraintKind::CK_NARY_OR:
+    return std::make_unique<NaryOrConstraint>(std::move(Operands));
+  case ConstraintKind::CK_NARY_AND:
+    return std::make_unique<NaryAndConstraint>(std::move(Operands));
+  case ConstraintKind::CK_NARY_XOR:
+    return std::make_unique<NaryXorConstraint>(std::move(Operands));
+  default:
+    llvm_unreachable("Not a n-ary constraint kind.");
+  }
+}
+
+std::unique_ptr<Constraint>
+NaryConstraint::flatten(std::unique_ptr<Constraint> C) {
+  using CK = ConstraintKind;
+  CK BinaryKind;
+  CK NaryKind;
+  switch (C->getKind()) {
+  case CK::CK_OR:
+  case CK::CK_NARY_OR:
+    BinaryKind = CK::CK_OR;
+    NaryKind = CK::CK_NARY_OR;
+    break;
+  case CK::CK_AND:
+  case CK::CK_NARY_AND:
+    BinaryKind = CK::CK_AND;
+    NaryKind = CK::CK_NARY_AND;
+    break;
+  case CK::CK_XOR:
+  case CK::CK_NARY_XOR:
+    BinaryKind = CK::CK_XOR;
+    NaryKind = CK::CK_NARY_XOR;
+    break;
+  default:
+    return C;
+  }
+
+  // Chains are unfolded with an explicit worklist, as they may be far deeper
+  // than the stack allows.
+  OperandContainerTy Operands;
+  OperandContainerTy Worklist;
+  Worklist.push_back(std::move(C));
+  while (!Worklist.empty()) {
+    auto Current = std::move(Worklist.back());
+    Worklist.pop_back();
+    if (Current->getKind() == BinaryKind) {
+      auto *B = llvm::cast<BinaryConstraint>(Current.get());
+      Worklist.push_back(std::move(B->RightOperand));
+      Worklist.push_back(std::move(B->LeftOperand));
+    } else if (Current->getKind() == NaryKind) {
+      auto *N = llvm::cast<NaryConstraint>(Current.get());
+      std::move(N->Operands.rbegin(), N->Operands.rend(),
+                std::back_inserter(Worklist));
+    } else {
+      Operands.push_back(flatten(std::move(Current)));
+    }
+  }
+  return create(NaryKind, std::move(Operands));
+}
+
 Feature *PrimaryFeatureConstraint::getFeature() const {
   if (std::holds_alternative<Feature *>(FV)) {
     return std::get<Feature *>(FV);
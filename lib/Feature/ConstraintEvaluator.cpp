@@ -0,0 +1,250 @@
+#include "vara/Feature/ConstraintEvaluator.h"
+#include "vara/Feature/FeatureModel.h"
+
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/Support/ErrorHandling.h"
+
+#include <limits>
+
+namespace vara::feature {
+
+namespace {
+
+using CK = Constraint::ConstraintKind;
+
+bool isCounting(CK Kind) {
+  switch (Kind) {
+  case CK::CK_OR:
+  case CK::CK_AND:
+  case CK::CK_XOR:
+  case CK::CK_NARY_OR:
+  case CK::CK_NARY_AND:
+  case CK::CK_NARY_XOR:
+    return true;
+  default:
+    return false;
+  }
+}
+
+// Arithmetic wraps around instead of overflowing.
+int64_t wrap(uint64_t Value) { return static_cast<int64_t>(Value); }
+
+} // namespace
+
+/// Appends the nodes of a constraint tree in pre-order, so operands are always
+/// stored behind their parent.
+class ConstraintEvaluator::NodeBuilder
+    : public ConstraintWalker<const Constraint> {
+public:
+  NodeBuilder(ConstraintEvaluator &E) : E(E) {}
+
+protected:
+  bool preVisit(const Constraint &C) override {
+    auto Idx = static_cast<unsigned>(E.Nodes.size());
+    unsigned Parent = NoParent;
+    if (!Stack.empty()) {
+      auto &Top = Stack.back();
+      Parent = Top.Idx;
+      E.Operands[E.Nodes[Parent].FirstOperand + Top.NextOperand++] = Idx;
+    }
+
+    int64_t Value = 0;
+    if (const auto *P = llvm::dyn_cast<PrimaryFeatureConstraint>(&C); P) {
+      Value = E.FeatureValues.lookup(P->getFeature());
+      E.Watches[P->getFeature()].push_back(Idx);
+    } else if (const auto *I = llvm::dyn_cast<PrimaryIntegerConstraint>(&C);
+               I) {
+      Value = I->getValue();
+    }
+
+    unsigned NumOperands = getNumOperands(C);
+    E.Nodes.push_back({C.getKind(), Parent,
+                       static_cast<unsigned>(E.Operands.size()), NumOperands,
+                       0, Value});
+    E.Operands.resize(E.Operands.size() + NumOperands);
+    Stack.push_back({Idx, 0});
+    return true;
+  }
+
+  void postVisit(const Constraint & /*C*/) override { Stack.pop_back(); }
+
+private:
+  struct Frame {
+    unsigned Idx;
+    unsigned NextOperand;
+  };
+
+  ConstraintEvaluator &E;
+  llvm::SmallVector<Frame, 32> Stack;
+};
+
+ConstraintEvaluator::ConstraintEvaluator(const FeatureModel &FM) {
+  if (FM.getRoot()) {
+    FeatureValues[FM.getRoot()] = 1;
+  }
+
+  for (const auto &C : FM.constraints()) {
+    auto Root = static_cast<unsigned>(Nodes.size());
+    Roots[C.get()] = Root;
+    Constraints[Root] = C.get();
+    RootNodes.push_back(Root);
+    NodeBuilder(*this).walk(*C);
+  }
+
+  // Operands are stored behind their parents, so a reverse sweep evaluates
+  // all nodes bottom-up.
+  for (auto Idx = Nodes.size(); Idx-- > 0;) {
+    auto &N = Nodes[Idx];
+    if (isCounting(N.Kind)) {
+      for (unsigned I = 0; I < N.NumOperands; ++I) {
+        N.NumTrue += operandValue(N, I) != 0;
+      }
+    }
+    if (N.NumOperands > 0) {
+      N.Value = compute(N);
+    }
+  }
+
+  for (unsigned Root : RootNodes) {
+    NumViolated += Nodes[Root].Value == 0;
+  }
+}
+
+ConstraintEvaluator::ChangeSet
+ConstraintEvaluator::setValue(const Feature &F, int64_t Value) {
+  ChangeSet Changes;
+  auto &Current = FeatureValues[&F];
+  if (Current == Value) {
+    return Changes;
+  }
+  Current = Value;
+
+  auto Search = Watches.find(&F);
+  if (Search == Watches.end()) {
+    return Changes;
+  }
+
+  // A feature may occur several times in the same constraint, so the truth
+  // values of top-level constraints are compared after all updates.
+  llvm::SmallDenseMap<unsigned, bool, 8> Touched;
+  for (unsigned Leaf : Search->second) {
+    unsigned Idx = Leaf;
+    int64_t Old = Nodes[Idx].Value;
+    Nodes[Idx].Value = Value;
+    while (true) {
+      int64_t New = Nodes[Idx].Value;
+      unsigned Parent = Nodes[Idx].Parent;
+      if (Parent == NoParent) {
+        Touched.try_emplace(Idx, Old != 0);
+        break;
+      }
+      auto &P = Nodes[Parent];
+      if (isCounting(P.Kind)) {
+        P.NumTrue = P.NumTrue + (New != 0) - (Old != 0);
+      }
+      Old = P.Value;
+      P.Value = compute(P);
+      if (Old == P.Value) {
+        break;
+      }
+      Idx = Parent;
+    }
+  }
+
+  // Report changes in the order of the constraints in the model.
+  llvm::SmallVector<std::pair<unsigned, bool>, 8> Changed(Touched.begin(),
+                                                         Touched.end());
+  llvm::sort(Changed);
+  for (const auto &KV : Changed) {
+    bool Now = Nodes[KV.first].Value != 0;
+    if (Now == KV.second) {
+      continue;
+    }
+    if (Now) {
+      --NumViolated;
+      Changes.Satisfied.push_back(Constraints.lookup(KV.first));
+    } else {
+      ++NumViolated;
+      Changes.Violated.push_back(Constraints.lookup(KV.first));
+    }
+  }
+  return Changes;
+}
+
+bool ConstraintEvaluator::isSatisfied(const Constraint &C) const {
+  auto Search = Roots.find(&C);
+  return Search == Roots.end() || Nodes[Search->second].Value != 0;
+}
+
+std::vector<const Constraint *> ConstraintEvaluator::getViolated() const {
+  std::vector<const Constraint *> Violated;
+  for (unsigned Root : RootNodes) {
+    if (Nodes[Root].Value == 0) {
+      Violated.push_back(Constraints.lookup(Root));
+    }
+  }
+  return Violated;
+}
+
+int64_t ConstraintEvaluator::compute(const Node &N) const {
+  switch (N.Kind) {
+  case CK::CK_OR:
+  case CK::CK_NARY_OR:
+    return N.NumTrue > 0;
+  case CK::CK_AND:
+  case CK::CK_NARY_AND:
+    return N.NumTrue == N.NumOperands;
+  case CK::CK_XOR:
+  case CK::CK_NARY_XOR:
+    return N.NumTrue % 2;
+  case CK::CK_NOT:
+    return operandValue(N, 0) == 0;
+  case CK::CK_NEG:
+    return wrap(-static_cast<uint64_t>(operandValue(N, 0)));
+  case CK::CK_INTEGER:
+  case CK::CK_FEATURE:
+    return N.Value;
+  default:
+    break;
+  }
+
+  int64_t LHS = operandValue(N, 0);
+  int64_t RHS = operandValue(N, 1);
+  switch (N.Kind) {
+  case CK::CK_IMPLIES:
+    return LHS == 0 || RHS != 0;
+  case CK::CK_EXCLUDES:
+    return LHS == 0 || RHS == 0;
+  case CK::CK_EQUIVALENCE:
+    return (LHS != 0) == (RHS != 0);
+  case CK::CK_EQUALS:
+    return LHS == RHS;
+  case CK::CK_ADDITION:
+    return wrap(static_cast<uint64_t>(LHS) + static_cast<uint64_t>(RHS));
+  case CK::CK_SUBTRACTION:
+    return wrap(static_cast<uint64_t>(LHS) - static_cast<uint64_t>(RHS));
+  case CK::CK_MULTIPLICATION:
+    return wrap(static_cast<uint64_t>(LHS) * static_cast<uint64_t>(RHS));
+  case CK::CK_DIVISION:
+    // Division by zero evaluates to zero.
+    if (RHS == 0) {
+      return 0;
+    }
+    if (LHS == std::numeric_limits<int64_t>::min() && RHS == -1) {
+      return LHS;
+    }
+    return LHS / RHS;
+  case CK::CK_LESS:
+    return LHS < RHS;
+  case CK::CK_GREATER:
+    return LHS > RHS;
+  case CK::CK_LESSEQUAL:
+    return LHS <= RHS;
+  case CK::CK_GREATEREQUAL:
+    return LHS >= RHS;
+  default:
+    llvm_unreachable("Unknown constraint kind.");
+  }
+}
+
+} // namespace vara::feature
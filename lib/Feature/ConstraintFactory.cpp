@@ -0,0 +1,192 @@
+#include "vara/Feature/ConstraintFactory.h"
+#include "vara/Feature/Feature.h"
+#include "vara/Feature/FeatureModel.h"
+
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/Support/ErrorHandling.h"
+
+#include <algorithm>
+#include <vector>
+
+namespace vara::feature {
+
+const InternedConstraint *ConstraintFactory::getFeature(Feature *F) {
+  return getOrCreate(ConstraintKind::CK_FEATURE, {}, F);
+}
+
+const InternedConstraint *ConstraintFactory::getInteger(int Value) {
+  return getOrCreate(ConstraintKind::CK_INTEGER, {}, nullptr, Value);
+}
+
+const InternedConstraint *
+ConstraintFactory::getUnary(ConstraintKind Kind,
+                            const InternedConstraint *Operand) {
+  return getOrCreate(Kind, {Operand});
+}
+
+const InternedConstraint *
+ConstraintFactory::getBinary(ConstraintKind Kind,
+                             const InternedConstraint *LeftOperand,
+                             const InternedConstraint *RightOperand) {
+  return getOrCreate(Kind, {LeftOperand, RightOperand});
+}
+
+const InternedConstraint *ConstraintFactory::getNary(
+    ConstraintKind Kind, llvm::ArrayRef<const InternedConstraint *> Operands) {
+  return getOrCreate(Kind, Operands);
+}
+
+namespace {
+
+/// Interns a constraint bottom-up without recursion, so deep constraints do
+/// not exhaust the stack.
+class ConstraintInterner : public ConstraintWalker<const Constraint> {
+public:
+  ConstraintInterner(ConstraintFactory &Factory, const FeatureModel *FM)
+      : Factory(Factory), FM(FM) {}
+
+  const InternedConstraint *takeResult() {
+    assert(Results.size() == 1 && "Walk did not finish.");
+    return Results.back();
+  }
+
+protected:
+  void postVisit(const Constraint &C) override {
+    if (const auto *I = llvm::dyn_cast<PrimaryIntegerConstraint>(&C); I) {
+      Results.push_back(Factory.getInteger(I->getValue()));
+      return;
+    }
+    if (const auto *P = llvm::dyn_cast<PrimaryFeatureConstraint>(&C); P) {
+      // Constraints which were not built by a builder reference detached
+      // features, so we need to resolve them in the feature model.
+      Feature *F = P->getFeature();
+      if (FM) {
+        if (auto *ModelFeature = FM->getFeature(F->getName()); ModelFeature) {
+          F = ModelFeature;
+        }
+      }
+      Results.push_back(Factory.getFeature(F));
+      return;
+    }
+
+    auto Operands = llvm::ArrayRef<const InternedConstraint *>(Results)
+                        .take_back(getNumOperands(C));
+    const InternedConstraint *N;
+    if (llvm::isa<BinaryConstraint>(C)) {
+      N = Factory.getBinary(C.getKind(), Operands[0], Operands[1]);
+    } else if (llvm::isa<UnaryConstraint>(C)) {
+      N = Factory.getUnary(C.getKind(), Operands[0]);
+    } else if (llvm::isa<NaryConstraint>(C)) {
+      N = Factory.getNary(C.getKind(), Operands);
+    } else {
+      llvm_unreachable("Unknown constraint kind.");
+    }
+    Results.resize(Results.size() - Operands.size());
+    Results.push_back(N);
+  }
+
+private:
+  ConstraintFactory &Factory;
+  const FeatureModel *FM;
+  std::vector<const InternedConstraint *> Results;
+};
+
+} // namespace
+
+const InternedConstraint *ConstraintFactory::intern(const Constraint &C) {
+  ConstraintInterner Interner(*this, FM);
+  Interner.walk(C);
+  return Interner.takeResult();
+}
+
+std::unique_ptr<Constraint>
+ConstraintFactory::materialize(const InternedConstraint *Root) {
+  return materialize(Root, [](Feature *F) {
+    return std::make_unique<PrimaryFeatureConstraint>(F);
+  });
+}
+
+std::unique_ptr<Constraint> ConstraintFactory::materialize(
+    const InternedConstraint *Root,
+    llvm::function_ref<std::unique_ptr<Constraint>(Feature *)> CreateFeature) {
+  // Operands are created before the constraints containing them. An explicit
+  // stack is used, so deep constraints do not exhaust the call stack.
+  struct Frame {
+    const InternedConstraint *N;
+    unsigned NextOperand;
+  };
+  llvm::SmallVector<Frame, 32> Stack{{Root, 0}};
+  std::vector<std::unique_ptr<Constraint>> Results;
+  while (!Stack.empty()) {
+    auto &Top = Stack.back();
+    if (Top.NextOperand < Top.N->operands().size()) {
+      // Pushing invalidates Top, so the operand index is advanced before.
+      const auto *Operand = Top.N->getOperand(Top.NextOperand++);
+      Stack.push_back({Operand, 0});
+      continue;
+    }
+    const auto *N = Top.N;
+    Stack.pop_back();
+
+    auto Operands = Results.end() - N->operands().size();
+    std::unique_ptr<Constraint> C;
+    switch (N->getKind()) {
+    case ConstraintKind::CK_FEATURE:
+      C = CreateFeature(N->getFeature());
+      break;
+    case ConstraintKind::CK_INTEGER:
+      C = std::make_unique<PrimaryIntegerConstraint>(N->getValue());
+      break;
+    case ConstraintKind::CK_NOT:
+    case ConstraintKind::CK_NEG:
+      C = UnaryConstraint::create(N->getKind(), std::move(Operands[0]));
+      break;
+    case ConstraintKind::CK_NARY_OR:
+    case ConstraintKind::CK_NARY_AND:
+    case ConstraintKind::CK_NARY_XOR:
+      C = NaryConstraint::create(N->getKind(),
+                                 NaryConstraint::OperandContainerTy(
+                                     std::make_move_iterator(Operands),
+                                     std::make_move_iterator(Results.end())));
+      break;
+    default:
+      C = BinaryConstraint::create(N->getKind(), std::move(Operands[0]),
+                                   std::move(Operands[1]));
+      break;
+    }
+    Results.erase(Operands, Results.end());
+    Results.push_back(std::move(C));
+  }
+  return std::move(Results.back());
+}
+
+const InternedConstraint *ConstraintFactory::getOrCreate(
+    ConstraintKind Kind, llvm::ArrayRef<const InternedConstraint *> Operands,
+    Feature *F, int Value) {
+  ++NumRequests;
+
+  llvm::FoldingSetNodeID ID;
+  InternedConstraint::profile(ID, Kind, Operands, F, Value);
+  void *InsertPos = nullptr;
+  if (auto *N = Nodes.FindNodeOrInsertPos(ID, InsertPos); N) {
+    return N;
+  }
+
+  // Operands are copied into the allocator, as the passed list is usually
+  // only a temporary.
+  const InternedConstraint **OperandStorage = nullptr;
+  if (!Operands.empty()) {
+    OperandStorage =
+        Allocator.Allocate<const InternedConstraint *>(Operands.size());
+    std::copy(Operands.begin(), Operands.end(), OperandStorage);
+  }
+  auto *N = new (Allocator.Allocate<InternedConstraint>()) InternedConstraint(
+      Kind, NumNodes++,
+      llvm::ArrayRef<const InternedConstraint *>(OperandStorage,
+                                                 Operands.size()),
+      F, Value);
+  Nodes.InsertNode(N, InsertPos);
+  return N;
+}
+
+} // namespace vara::feature
@@ -0,0 +1,814 @@
+#include "vara/Feature/ConstraintNormalizer.h"
+#include "vara/Feature/ConstraintFactory.h"
+#include "vara/Feature/Feature.h"
+#include "vara/Feature/FeatureModel.h"
+
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/Support/CheckedArithmetic.h"
+
+#include <algorithm>
+#include <climits>
+#include <optional>
+#include <vector>
+
+namespace vara::feature {
+
+using CK = Constraint::ConstraintKind;
+
+//===----------------------------------------------------------------------===//
+//                               Helpers
+//===----------------------------------------------------------------------===//
+
+/// \returns the value of a constant node, truth values are represented by the
+///          integers 0 and 1
+static std::optional<int> getConstant(const InternedConstraint *N) {
+  if (N->getKind() == CK::CK_INTEGER) {
+    return N->getValue();
+  }
+  return std::nullopt;
+}
+
+static bool isJunction(CK Kind) {
+  return Kind == CK::CK_OR || Kind == CK::CK_NARY_OR || Kind == CK::CK_AND ||
+         Kind == CK::CK_NARY_AND;
+}
+
+/// \returns the comparison which is satisfied iff \p Kind is not
+static CK getComplement(CK Kind) {
+  switch (Kind) {
+  case CK::CK_LESS:
+    return CK::CK_GREATEREQUAL;
+  case CK::CK_GREATER:
+    return CK::CK_LESSEQUAL;
+  case CK::CK_LESSEQUAL:
+    return CK::CK_GREATER;
+  default:
+    assert(Kind == CK::CK_GREATEREQUAL && "Equality has no complement.");
+    return CK::CK_LESS;
+  }
+}
+
+static bool isAncestor(const Feature *Ancestor, const Feature *F) {
+  for (const auto *P = F->getParentFeature(); P; P = P->getParentFeature()) {
+    if (P == Ancestor) {
+      return true;
+    }
+  }
+  return false;
+}
+
+/// Decide whether F is selected in every configuration, i.e., F is the root or
+/// a mandatory descendant of it.
+static bool isCoreFeature(const Feature *F) {
+  for (; F; F = F->getParentFeature()) {
+    if (llvm::isa<RootFeature>(F)) {
+      return true;
+    }
+    if (F->isOptional() || !llvm::isa_and_nonnull<Feature>(F->getParent())) {
+      return false;
+    }
+  }
+  return false;
+}
+
+/// Decide whether selecting X always selects Y, i.e., Y is an ancestor of X or
+/// a mandatory descendant of one of X's ancestors.
+static bool impliesFeature(const Feature *X, const Feature *Y) {
+  for (const auto *M = Y; M; M = M->getParentFeature()) {
+    if (M == X || isAncestor(M, X)) {
+      return true;
+    }
+    if (M->isOptional() || !llvm::isa_and_nonnull<Feature>(M->getParent())) {
+      return false;
+    }
+  }
+  return false;
+}
+
+/// Decide whether X and Y are located in different branches of the same
+/// alternative group.
+static bool excludesFeature(const Feature *X, const Feature *Y) {
+  for (const auto *A = X; A; A = A->getParentFeature()) {
+    auto *R = llvm::dyn_cast_or_null<Relationship>(A->getParent());
+    if (!R || R->getKind() != Relationship::RelationshipKind::RK_ALTERNATIVE) {
+      continue;
+    }
+    for (const auto *B = Y; B; B = B->getParentFeature()) {
+      if (B != A && B->getParent() == R) {
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+static bool collectLiterals(const Constraint &Root,
+                            llvm::SmallVectorImpl<const Feature *> &Positive,
+                            llvm::SmallVectorImpl<const Feature *> &Negative) {
+  llvm::SmallVector<const Constraint *, 16> Worklist{&Root};
+  while (!Worklist.empty()) {
+    const auto *C = Worklist.pop_back_val();
+    if (const auto *O = llvm::dyn_cast<OrConstraint>(C); O) {
+      Worklist.push_back(O->getRightOperand());
+      Worklist.push_back(O->getLeftOperand());
+      continue;
+    }
+    if (const auto *O = llvm::dyn_cast<NaryOrConstraint>(C); O) {
+      for (const auto &Operand : llvm::reverse(O->operands())) {
+        Worklist.push_back(Operand.get());
+      }
+      continue;
+    }
+    if (const auto *N = llvm::dyn_cast<NotConstraint>(C); N) {
+      const auto *P = llvm::dyn_cast<PrimaryFeatureConstraint>(N->getOperand());
+      if (!P) {
+        return false;
+      }
+      Negative.push_back(P->getFeature());
+      continue;
+    }
+    if (const auto *P = llvm::dyn_cast<PrimaryFeatureConstraint>(C); P) {
+      Positive.push_back(P->getFeature());
+      continue;
+    }
+    return false;
+  }
+  return true;
+}
+
+namespace {
+
+/// A constraint in a boolean position, which is negated if \a Negate is set,
+/// or in a numeric position.
+struct Term {
+  const Constraint *C;
+  bool Negate;
+  bool Numeric;
+};
+
+} // namespace
+
+/// Collect the operands of nested conjunctions or disjunctions of \p Kind
+/// from left to right. Implications and exclusions are expanded.
+static void collectJunction(const Constraint &Root, bool Negate, CK Kind,
+                            llvm::SmallVectorImpl<Term> &Operands) {
+  bool IsOr = Kind == CK::CK_OR;
+  // The right operand is pushed first, so the left one is collected first.
+  llvm::SmallVector<std::pair<const Constraint *, bool>, 16> Worklist{
+      {&Root, Negate}};
+  while (!Worklist.empty()) {
+    auto [C, Negated] = Worklist.pop_back_val();
+    // Polarity of the left and right operand, if C is a junction of Kind.
+    std::optional<std::pair<bool, bool>> Polarity;
+
+    switch (C->getKind()) {
+    case CK::CK_NOT:
+      Worklist.emplace_back(llvm::cast<NotConstraint>(C)->getOperand(),
+                            !Negated);
+      continue;
+    case CK::CK_NARY_OR:
+    case CK::CK_NARY_AND:
+      if ((C->getKind() == CK::CK_NARY_OR) == (IsOr != Negated)) {
+        for (const auto &Operand :
+             llvm::reverse(llvm::cast<NaryConstraint>(C)->operands())) {
+          Worklist.emplace_back(Operand.get(), Negated);
+        }
+        continue;
+      }
+      break;
+    case CK::CK_OR:
+      if (IsOr != Negated) {
+        Polarity = {Negated, Negated};
+      }
+      break;
+    case CK::CK_AND:
+      if (IsOr == Negated) {
+        Polarity = {Negated, Negated};
+      }
+      break;
+    case CK::CK_IMPLIES:
+      // (A => B) == (!A | B)
+      if (IsOr != Negated) {
+        Polarity = {!Negated, Negated};
+      }
+      break;
+    case CK::CK_EXCLUDES:
+      // (A => !B) == (!A | !B)
+      if (IsOr != Negated) {
+        Polarity = {!Negated, !Negated};
+      }
+      break;
+    default:
+      break;
+    }
+
+    if (!Polarity) {
+      Operands.push_back({C, Negated, false});
+      continue;
+    }
+    const auto *B = llvm::cast<BinaryConstraint>(C);
+    Worklist.emplace_back(B->getRightOperand(), Polarity->second);
+    Worklist.emplace_back(B->getLeftOperand(), Polarity->first);
+  }
+}
+
+//===----------------------------------------------------------------------===//
+//                            Normalization Class
+//===----------------------------------------------------------------------===//
+
+namespace {
+
+/// Normalizes constraints into nodes of a \a ConstraintFactory. Constant truth
+/// values are represented by the integer nodes 0 and 1, so a normalized node
+/// in a boolean position is constant iff it is an integer.
+class Normalization {
+public:
+  explicit Normalization(const FeatureModel *FM) : FM(FM) {}
+
+  /// Normalize a constraint in a boolean position. Operands are normalized
+  /// before the constraints containing them, using an explicit stack.
+  const InternedConstraint *normalize(const Constraint &C, bool Negate);
+
+  /// Create the constraint tree of a node in a boolean position.
+  ConstraintNormalizer::NormalizedTy materialize(const InternedConstraint *N);
+
+private:
+  /// A term whose operands are normalized before the term itself.
+  struct Frame {
+    Term T;
+    /// Kind of the normalized junction, if the term is one.
+    CK JunctionKind;
+    llvm::SmallVector<Term, 2> Operands;
+    unsigned NextOperand;
+  };
+
+  [[nodiscard]] Frame expand(Term T) const;
+
+  const InternedConstraint *
+  evaluate(const Frame &F,
+           llvm::ArrayRef<const InternedConstraint *> Operands);
+
+  const InternedConstraint *getTruthValue(bool Value) {
+    return Factory.getInteger(Value ? 1 : 0);
+  }
+
+  const InternedConstraint *getFeature(const PrimaryFeatureConstraint &C);
+
+  const InternedConstraint *
+  buildJunction(CK Kind, llvm::ArrayRef<const InternedConstraint *> Operands);
+
+  const InternedConstraint *
+  combine(CK Kind, llvm::ArrayRef<const InternedConstraint *> Normalized);
+
+  const InternedConstraint *
+  combineParity(llvm::ArrayRef<const InternedConstraint *> Normalized,
+                bool Negate);
+
+  const InternedConstraint *negate(const InternedConstraint *Root);
+
+  const InternedConstraint *compare(CK Kind, const InternedConstraint *LHS,
+                                    const InternedConstraint *RHS,
+                                    bool Negate);
+
+  const InternedConstraint *fold(CK Kind, const InternedConstraint *LHS,
+                                 const InternedConstraint *RHS);
+
+  const FeatureModel *FM;
+  ConstraintFactory Factory;
+  /// Features which are not part of the feature model, by name.
+  llvm::StringMap<std::unique_ptr<Feature>> DetachedFeatures;
+};
+
+} // namespace
+
+const InternedConstraint *Normalization::normalize(const Constraint &C,
+                                                   bool Negate) {
+  std::vector<Frame> Stack;
+  std::vector<const InternedConstraint *> Results;
+  Stack.push_back(expand({&C, Negate, false}));
+  while (!Stack.empty()) {
+    auto &Top = Stack.back();
+    if (Top.NextOperand < Top.Operands.size()) {
+      // Pushing invalidates Top, so the operand index is advanced before.
+      Term Operand = Top.Operands[Top.NextOperand++];
+      Stack.push_back(expand(Operand));
+      continue;
+    }
+    auto Operands = llvm::ArrayRef<const InternedConstraint *>(Results)
+                        .take_back(Top.Operands.size());
+    const auto *N = evaluate(Top, Operands);
+    Results.resize(Results.size() - Operands.size());
+    Results.push_back(N);
+    Stack.pop_back();
+  }
+  return Results.back();
+}
+
+ConstraintNormalizer::NormalizedTy
+Normalization::materialize(const InternedConstraint *N) {
+  if (auto Value = getConstant(N); Value) {
+    return *Value != 0;
+  }
+  return ConstraintFactory::materialize(
+      N, [this](Feature *F) -> std::unique_ptr<Constraint> {
+        // Detached features only live as long as the normalization, so the
+        // constraint gets its own copy.
+        if (DetachedFeatures.count(F->getName())) {
+          return std::make_unique<PrimaryFeatureConstraint>(
+              std::make_unique<Feature>(F->getName().str()));
+        }
+        return std::make_unique<PrimaryFeatureConstraint>(F);
+      });
+}
+
+Normalization::Frame Normalization::expand(Term T) const {
+  Frame F{T, T.C->getKind(), {}, 0};
+  if (T.Numeric) {
+    switch (T.C->getKind()) {
+    case CK::CK_INTEGER:
+    case CK::CK_FEATURE:
+      break;
+    case CK::CK_NEG:
+      F.Operands.push_back(
+          {llvm::cast<NegConstraint>(T.C)->getOperand(), false, true});
+      break;
+    case CK::CK_ADDITION:
+    case CK::CK_SUBTRACTION:
+    case CK::CK_MULTIPLICATION:
+    case CK::CK_DIVISION: {
+      const auto *B = llvm::cast<BinaryConstraint>(T.C);
+      F.Operands.push_back({B->getLeftOperand(), false, true});
+      F.Operands.push_back({B->getRightOperand(), false, true});
+      break;
+    }
+    default:
+      // Boolean terms in numeric positions are either 0 or 1.
+      F.Operands.push_back({T.C, false, false});
+      break;
+    }
+    return F;
+  }
+
+  // Negations are pushed into the negated constraint.
+  while (const auto *N = llvm::dyn_cast<NotConstraint>(F.T.C)) {
+    F.T.C = N->getOperand();
+    F.T.Negate = !F.T.Negate;
+  }
+  const Constraint &C = *F.T.C;
+  const bool Negate = F.T.Negate;
+  switch (C.getKind()) {
+  case CK::CK_FEATURE:
+  case CK::CK_INTEGER:
+    break;
+  case CK::CK_OR:
+  case CK::CK_NARY_OR:
+  case CK::CK_IMPLIES:
+  case CK::CK_EXCLUDES:
+    F.JunctionKind = Negate ? CK::CK_AND : CK::CK_OR;
+    collectJunction(C, Negate, F.JunctionKind, F.Operands);
+    break;
+  case CK::CK_AND:
+  case CK::CK_NARY_AND:
+    F.JunctionKind = Negate ? CK::CK_OR : CK::CK_AND;
+    collectJunction(C, Negate, F.JunctionKind, F.Operands);
+    break;
+  case CK::CK_EQUIVALENCE:
+  case CK::CK_XOR: {
+    // Xors and equivalences are kept, (A <=> B) == !(A ^ B), so each operand
+    // is normalized once.
+    const auto &B = llvm::cast<BinaryConstraint>(C);
+    F.Operands.push_back({B.getLeftOperand(), false, false});
+    F.Operands.push_back({B.getRightOperand(), false, false});
+    break;
+  }
+  case CK::CK_NARY_XOR:
+    for (const auto &Operand : llvm::cast<NaryXorConstraint>(C).operands()) {
+      F.Operands.push_back({Operand.get(), false, false});
+    }
+    break;
+  case CK::CK_LESS:
+  case CK::CK_GREATER:
+  case CK::CK_LESSEQUAL:
+  case CK::CK_GREATEREQUAL:
+  case CK::CK_EQUALS: {
+    const auto &B = llvm::cast<BinaryConstraint>(C);
+    F.Operands.push_back({B.getLeftOperand(), false, true});
+    F.Operands.push_back({B.getRightOperand(), false, true});
+    break;
+  }
+  default:
+    // Numeric terms in boolean positions are true iff they are not zero.
+    F.Operands.push_back({&C, false, true});
+    break;
+  }
+  return F;
+}
+
+const InternedConstraint *
+Normalization::evaluate(const Frame &F,
+                        llvm::ArrayRef<const InternedConstraint *> Operands) {
+  const Constraint &C = *F.T.C;
+  const bool Negate = F.T.Negate;
+  if (F.T.Numeric) {
+    switch (C.getKind()) {
+    case CK::CK_INTEGER:
+      return Factory.getInteger(
+          llvm::cast<PrimaryIntegerConstraint>(C).getValue());
+    case CK::CK_FEATURE:
+      return getFeature(llvm::cast<PrimaryFeatureConstraint>(C));
+    case CK::CK_NEG:
+      if (auto Value = getConstant(Operands[0]);
+          Value && *Value != INT_MIN) {
+        return Factory.getInteger(-*Value);
+      }
+      return Factory.getUnary(CK::CK_NEG, Operands[0]);
+    case CK::CK_ADDITION:
+    case CK::CK_SUBTRACTION:
+    case CK::CK_MULTIPLICATION:
+    case CK::CK_DIVISION:
+      return fold(C.getKind(), Operands[0], Operands[1]);
+    default:
+      // Truth values are already represented by 0 and 1.
+      return Operands[0];
+    }
+  }
+
+  switch (C.getKind()) {
+  case CK::CK_FEATURE: {
+    const auto *N = getFeature(llvm::cast<PrimaryFeatureConstraint>(C));
+    return Negate ? Factory.getUnary(CK::CK_NOT, N) : N;
+  }
+  case CK::CK_INTEGER:
+    return getTruthValue(
+        (llvm::cast<PrimaryIntegerConstraint>(C).getValue() != 0) != Negate);
+  case CK::CK_OR:
+  case CK::CK_NARY_OR:
+  case CK::CK_AND:
+  case CK::CK_NARY_AND:
+  case CK::CK_IMPLIES:
+  case CK::CK_EXCLUDES:
+    return combine(F.JunctionKind, Operands);
+  case CK::CK_EQUIVALENCE:
+  case CK::CK_XOR:
+    return combineParity(Operands,
+                         (C.getKind() == CK::CK_EQUIVALENCE) != Negate);
+  case CK::CK_NARY_XOR:
+    return combineParity(Operands, Negate);
+  case CK::CK_LESS:
+  case CK::CK_GREATER:
+  case CK::CK_LESSEQUAL:
+  case CK::CK_GREATEREQUAL:
+  case CK::CK_EQUALS:
+    return compare(C.getKind(), Operands[0], Operands[1], Negate);
+  default:
+    if (auto Value = getConstant(Operands[0]); Value) {
+      return getTruthValue((*Value != 0) != Negate);
+    }
+    return Negate ? Factory.getUnary(CK::CK_NOT, Operands[0]) : Operands[0];
+  }
+}
+
+const InternedConstraint *
+Normalization::getFeature(const PrimaryFeatureConstraint &C) {
+  llvm::StringRef Name = C.getFeature()->getName();
+  if (FM) {
+    if (auto *F = FM->getFeature(Name); F) {
+      return Factory.getFeature(F);
+    }
+  }
+  // Features are interned by identity, so every name gets a single feature.
+  auto &Detached = DetachedFeatures[Name];
+  if (!Detached) {
+    Detached = std::make_unique<Feature>(Name.str());
+  }
+  return Factory.getFeature(Detached.get());
+}
+
+const InternedConstraint *Normalization::buildJunction(
+    CK Kind, llvm::ArrayRef<const InternedConstraint *> Operands) {
+  if (Operands.size() == 1) {
+    return Operands.front();
+  }
+  if (Operands.size() == 2) {
+    return Factory.getBinary(Kind, Operands[0], Operands[1]);
+  }
+  return Factory.getNary(Kind == CK::CK_AND ? CK::CK_NARY_AND : CK::CK_NARY_OR,
+                         Operands);
+}
+
+/// Combine normalized operands into a conjunction or disjunction. Constants
+/// are folded, duplicates removed, and complementary literals detected.
+const InternedConstraint *Normalization::combine(
+    CK Kind, llvm::ArrayRef<const InternedConstraint *> Normalized) {
+  assert(Kind == CK::CK_AND || Kind == CK::CK_OR);
+  // true absorbs every disjunction, false every conjunction
+  const bool Absorbing = Kind == CK::CK_OR;
+
+  llvm::SmallVector<const InternedConstraint *, 8> Operands;
+  llvm::SmallPtrSet<const InternedConstraint *, 8> Seen;
+  for (const auto *N : Normalized) {
+    if (auto Value = getConstant(N); Value) {
+      if ((*Value != 0) == Absorbing) {
+        return getTruthValue(Absorbing);
+      }
+      continue;
+    }
+    if (Seen.insert(N).second) {
+      Operands.push_back(N);
+    }
+  }
+
+  for (const auto *N : Operands) {
+    if (N->getKind() == CK::CK_NOT && Seen.count(N->getOperand(0))) {
+      return getTruthValue(Absorbing);
+    }
+  }
+
+  if (Operands.empty()) {
+    return getTruthValue(!Absorbing);
+  }
+  return buildJunction(Kind, Operands);
+}
+
+/// Combine normalized operands into a xor, or into its negation. Constants
+/// only flip the parity, the remaining operands are kept as they are, so no
+/// operand is duplicated.
+const InternedConstraint *Normalization::combineParity(
+    llvm::ArrayRef<const InternedConstraint *> Normalized, bool Negate) {
+  llvm::SmallVector<const InternedConstraint *, 8> Operands;
+  for (const auto *N : Normalized) {
+    if (auto Value = getConstant(N); Value) {
+      Negate ^= *Value != 0;
+      continue;
+    }
+    Operands.push_back(N);
+  }
+
+  switch (Operands.size()) {
+  case 0:
+    // A xor without operands is false.
+    return getTruthValue(Negate);
+  case 1:
+    return Negate ? negate(Operands.front()) : Operands.front();
+  case 2: {
+    // (A ^ A) == false and (A ^ !A) == true
+    auto Strip = [](const InternedConstraint *N) {
+      return N->getKind() == CK::CK_NOT ? N->getOperand(0) : N;
+    };
+    if (Strip(Operands[0]) == Strip(Operands[1])) {
+      return getTruthValue((Operands[0] != Operands[1]) != Negate);
+    }
+    return Factory.getBinary(Negate ? CK::CK_EQUIVALENCE : CK::CK_XOR,
+                             Operands[0], Operands[1]);
+  }
+  default:
+    if (Negate) {
+      Operands.front() = negate(Operands.front());
+    }
+    return Factory.getNary(CK::CK_NARY_XOR, Operands);
+  }
+}
+
+/// Negate a normalized node. Negations are pushed through connectives and
+/// comparisons, so the result is normalized as well.
+const InternedConstraint *
+Normalization::negate(const InternedConstraint *Root) {
+  // Junctions negate all of their operands, parities only the first one.
+  auto GetNumNegated = [](const InternedConstraint *N) -> size_t {
+    if (isJunction(N->getKind())) {
+      return N->operands().size();
+    }
+    return N->getKind() == CK::CK_NARY_XOR ? 1 : 0;
+  };
+
+  struct Frame {
+    const InternedConstraint *N;
+    unsigned NextOperand;
+  };
+  llvm::SmallVector<Frame, 32> Stack{{Root, 0}};
+  std::vector<const InternedConstraint *> Results;
+  while (!Stack.empty()) {
+    auto &Top = Stack.back();
+    size_t NumNegated = GetNumNegated(Top.N);
+    if (Top.NextOperand < NumNegated) {
+      // Pushing invalidates Top, so the operand index is advanced before.
+      const auto *Operand = Top.N->getOperand(Top.NextOperand++);
+      Stack.push_back({Operand, 0});
+      continue;
+    }
+    const auto *N = Top.N;
+    Stack.pop_back();
+
+    auto Negated = llvm::ArrayRef<const InternedConstraint *>(Results)
+                       .take_back(NumNegated);
+    const InternedConstraint *Result;
+    switch (N->getKind()) {
+    case CK::CK_NOT:
+      Result = N->getOperand(0);
+      break;
+    case CK::CK_XOR:
+    case CK::CK_EQUIVALENCE:
+      // !(A ^ B) == (A <=> B), the operands stay unchanged.
+      Result = Factory.getBinary(N->getKind() == CK::CK_XOR
+                                     ? CK::CK_EQUIVALENCE
+                                     : CK::CK_XOR,
+                                 N->getOperand(0), N->getOperand(1));
+      break;
+    case CK::CK_NARY_XOR: {
+      // Negating one operand flips the parity.
+      llvm::SmallVector<const InternedConstraint *, 8> Operands(
+          N->operands().begin(), N->operands().end());
+      Operands.front() = Negated.front();
+      Result = Factory.getNary(CK::CK_NARY_XOR, Operands);
+      break;
+    }
+    case CK::CK_OR:
+    case CK::CK_NARY_OR:
+      Result = buildJunction(CK::CK_AND, Negated);
+      break;
+    case CK::CK_AND:
+    case CK::CK_NARY_AND:
+      Result = buildJunction(CK::CK_OR, Negated);
+      break;
+    case CK::CK_LESS:
+    case CK::CK_GREATER:
+    case CK::CK_LESSEQUAL:
+    case CK::CK_GREATEREQUAL:
+      Result = Factory.getBinary(getComplement(N->getKind()), N->getOperand(0),
+                                 N->getOperand(1));
+      break;
+    default:
+      Result = Factory.getUnary(CK::CK_NOT, N);
+      break;
+    }
+    Results.resize(Results.size() - Negated.size());
+    Results.push_back(Result);
+  }
+  return Results.back();
+}
+
+const InternedConstraint *Normalization::compare(CK Kind,
+                                                 const InternedConstraint *LHS,
+                                                 const InternedConstraint *RHS,
+                                                 bool Negate) {
+  auto L = getConstant(LHS);
+  auto R = getConstant(RHS);
+  if (L && R) {
+    bool Result;
+    switch (Kind) {
+    case CK::CK_LESS:
+      Result = *L < *R;
+      break;
+    case CK::CK_GREATER:
+      Result = *L > *R;
+      break;
+    case CK::CK_LESSEQUAL:
+      Result = *L <= *R;
+      break;
+    case CK::CK_GREATEREQUAL:
+      Result = *L >= *R;
+      break;
+    default:
+      Result = *L == *R;
+      break;
+    }
+    return getTruthValue(Result != Negate);
+  }
+
+  if (!Negate) {
+    return Factory.getBinary(Kind, LHS, RHS);
+  }
+  if (Kind == CK::CK_EQUALS) {
+    // There is no inequality constraint, so equality stays negated.
+    return Factory.getUnary(CK::CK_NOT, Factory.getBinary(Kind, LHS, RHS));
+  }
+  return Factory.getBinary(getComplement(Kind), LHS, RHS);
+}
+
+const InternedConstraint *Normalization::fold(CK Kind,
+                                              const InternedConstraint *LHS,
+                                              const InternedConstraint *RHS) {
+  auto L = getConstant(LHS);
+  auto R = getConstant(RHS);
+  switch (Kind) {
+  case CK::CK_ADDITION:
+    if (L && R) {
+      if (auto Sum = llvm::checkedAdd(*L, *R); Sum) {
+        return Factory.getInteger(*Sum);
+      }
+    } else if (L == 0) {
+      return RHS;
+    } else if (R == 0) {
+      return LHS;
+    }
+    break;
+  case CK::CK_SUBTRACTION:
+    if (L && R) {
+      if (auto Diff = llvm::checkedSub(*L, *R); Diff) {
+        return Factory.getInteger(*Diff);
+      }
+    } else if (R == 0) {
+      return LHS;
+    }
+    break;
+  case CK::CK_MULTIPLICATION:
+    if (L && R) {
+      if (auto Prod = llvm::checkedMul(*L, *R); Prod) {
+        return Factory.getInteger(*Prod);
+      }
+    } else if (L == 0 || R == 0) {
+      return Factory.getInteger(0);
+    } else if (L == 1) {
+      return RHS;
+    } else if (R == 1) {
+      return LHS;
+    }
+    break;
+  default:
+    if (L && R && *R != 0 && !(*L == INT_MIN && *R == -1)) {
+      return Factory.getInteger(*L / *R);
+    }
+    if (R == 1) {
+      return LHS;
+    }
+    break;
+  }
+  return Factory.getBinary(Kind, LHS, RHS);
+}
+
+//===----------------------------------------------------------------------===//
+//                        ConstraintNormalizer Class
+//===----------------------------------------------------------------------===//
+
+ConstraintNormalizer::NormalizedTy
+ConstraintNormalizer::normalize(const Constraint &C) const {
+  Normalization Normalizer(FM);
+  return Normalizer.materialize(Normalizer.normalize(C, false));
+}
+
+bool ConstraintNormalizer::isImpliedByFeatureTree(const Constraint &C) {
+  llvm::SmallVector<const Feature *, 4> Positive;
+  llvm::SmallVector<const Feature *, 4> Negative;
+  if (!collectLiterals(C, Positive, Negative)) {
+    return false;
+  }
+
+  if (std::any_of(Positive.begin(), Positive.end(), isCoreFeature)) {
+    return true;
+  }
+  for (const auto *X : Negative) {
+    for (const auto *Y : Positive) {
+      if (impliesFeature(X, Y)) {
+        return true;
+      }
+    }
+    for (const auto *Y : Negative) {
+      if (X != Y && excludesFeature(X, Y)) {
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+std::vector<std::unique_ptr<Constraint>>
+ConstraintNormalizer::normalizeConstraints() const {
+  assert(FM && "Normalizing constraints requires a feature model.");
+
+  std::vector<std::unique_ptr<Constraint>> Result;
+  // Duplicates are detected structurally, without printing constraints.
+  Normalization Normalizer(FM);
+  llvm::SmallPtrSet<const InternedConstraint *, 16> Seen;
+  for (const auto &C : FM->constraints()) {
+    // Top-level conjunctions are split to drop implied parts individually.
+    llvm::SmallVector<Term, 8> Operands;
+    collectJunction(*C, false, CK::CK_AND, Operands);
+
+    for (const auto &Operand : Operands) {
+      const auto *N = Normalizer.normalize(*Operand.C, Operand.Negate);
+      if (auto Value = getConstant(N); Value) {
+        if (*Value == 0) {
+          // Nothing else matters once the constraints are unsatisfiable.
+          Result.clear();
+          Result.push_back(std::make_unique<PrimaryIntegerConstraint>(0));
+          return Result;
+        }
+        continue;
+      }
+      if (!Seen.insert(N).second) {
+        continue;
+      }
+      auto Normalized = std::get<std::unique_ptr<Constraint>>(
+          Normalizer.materialize(N));
+      if (!isImpliedByFeatureTree(*Normalized)) {
+        Result.push_back(std::move(Normalized));
+      }
+    }
+  }
+  return Result;
+}
+
+} // namespace vara::feature
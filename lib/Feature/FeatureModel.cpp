@@ -1,10 +1,113 @@
 #include "vara/Feature/FeatureModel.h"
 
+#include "llvm/ADT/SmallPtrSet.h"
 #include "llvm/Support/Casting.h"
 
 #include <algorithm>
 
 namespace vara::feature {
+
+namespace {
+
+/// Collects the features of a constraint together with their polarity.
+class OccurrenceCollector : public ConstraintWalker<> {
+public:
+  using PolarityMapTy = llvm::SmallDenseMap<const Feature *, unsigned, 8>;
+
+  [[nodiscard]] const PolarityMapTy &getPolarities() const {
+    return Polarities;
+  }
+
+  /// Keep insertion order, so occurrences are reproducible between runs.
+  [[nodiscard]] llvm::ArrayRef<const Feature *> getFeatures() const {
+    return Order;
+  }
+
+protected:
+  bool preVisit(Constraint &C) override {
+    unsigned Polarity = Stack.empty() ? Positive : operandPolarity();
+    if (auto *P = llvm::dyn_cast<PrimaryFeatureConstraint>(&C); P) {
+      auto Inserted = Polarities.try_emplace(P->getFeature(), 0);
+      if (Inserted.second) {
+        Order.push_back(P->getFeature());
+      }
+      Inserted.first->second |= Polarity;
+    }
+    Stack.push_back({&C, Polarity, 0});
+    return true;
+  }
+
+  void inVisit(Constraint & /*C*/, unsigned Idx) override {
+    Stack.back().Idx = Idx;
+  }
+
+  void postVisit(Constraint & /*C*/) override { Stack.pop_back(); }
+
+private:
+  static constexpr unsigned Positive =
+      static_cast<unsigned>(OccurrencePolarity::OP_POSITIVE);
+  static constexpr unsigned Negative =
+      static_cast<unsigned>(OccurrencePolarity::OP_NEGATIVE);
+  static constexpr unsigned Both =
+      static_cast<unsigned>(OccurrencePolarity::OP_BOTH);
+
+  struct Frame {
+    Constraint *C;
+    unsigned Polarity;
+    unsigned Idx;
+  };
+
+  static unsigned flip(unsigned Polarity) {
+    return ((Polarity & Positive) ? Negative : 0) |
+           ((Polarity & Negative) ? Positive : 0);
+  }
+
+  /// Polarity of the operand of the innermost constraint walked next.
+  [[nodiscard]] unsigned operandPolarity() const {
+    const auto &Top = Stack.back();
+    switch (Top.C->getKind()) {
+    case Constraint::ConstraintKind::CK_OR:
+    case Constraint::ConstraintKind::CK_AND:
+    case Constraint::ConstraintKind::CK_NARY_OR:
+    case Constraint::ConstraintKind::CK_NARY_AND:
+      return Top.Polarity;
+    case Constraint::ConstraintKind::CK_NOT:
+    case Constraint::ConstraintKind::CK_EXCLUDES:
+      return flip(Top.Polarity);
+    case Constraint::ConstraintKind::CK_IMPLIES:
+      return Top.Idx == 0 ? flip(Top.Polarity) : Top.Polarity;
+    default:
+      return Both;
+    }
+  }
+
+  llvm::SmallVector<Frame, 32> Stack;
+  PolarityMapTy Polarities;
+  llvm::SmallVector<const Feature *, 8> Order;
+};
+
+/// Collects the feature constraints of a constraint.
+class PrimaryCollector : public ConstraintWalker<> {
+public:
+  [[nodiscard]] llvm::ArrayRef<PrimaryFeatureConstraint *>
+  getPrimaries() const {
+    return Primaries;
+  }
+
+protected:
+  bool preVisit(Constraint &C) override {
+    if (auto *P = llvm::dyn_cast<PrimaryFeatureConstraint>(&C); P) {
+      Primaries.push_back(P);
+    }
+    return true;
+  }
+
+private:
+  llvm::SmallVector<PrimaryFeatureConstraint *, 8> Primaries;
+};
+
+} // namespace
+
 void FeatureModel::dump() const {
   for (const auto &Feature : Features) {
     llvm::outs() << "{\n";
@@ -22,16 +125,243 @@ Feature *FeatureModel::addFeature(std::unique_ptr<Feature> NewFeature) {
   }
   auto *InsertedFeature = PosInsertedFeature.first->getValue().get();
   assert(InsertedFeature);
-  OrderedFeatures.insert(InsertedFeature);
+  if (OrderingDeferred) {
+    Unordered.push_back(InsertedFeature);
+  } else {
+    OrderedFeatures.insert(InsertedFeature);
+  }
   return InsertedFeature;
 }
 
-void FeatureModel::removeFeature(Feature &F) {
+std::unique_ptr<Feature> FeatureModel::removeFeature(Feature &F) {
   if (&F == Root) {
     Root = nullptr;
   }
-  OrderedFeatures.remove(&F);
-  Features.erase(F.getName());
+  if (OrderingDeferred) {
+    Unordered.push_back(&F);
+  } else {
+    OrderedFeatures.remove(&F);
+  }
+  Occurrences.erase(&F);
+  auto Search = Features.find(F.getName());
+  if (Search == Features.end()) {
+    return nullptr;
+  }
+  auto Removed = std::move(Search->getValue());
+  Features.erase(Search);
+  return Removed;
+}
+
+Constraint *
+FeatureModel::addConstraint(std::unique_ptr<Constraint> NewConstraint,
+                            std::optional<size_t> Pos) {
+  FeatureResolver R(this);
+  R.walk(*NewConstraint);
+  if (!R.succeeded()) {
+    R.unbind();
+    return nullptr;
+  }
+  return insertConstraint(std::move(NewConstraint), Pos);
+}
+
+Constraint *FeatureModel::insertConstraint(std::unique_ptr<Constraint> C,
+                                           std::optional<size_t> Pos) {
+  // Positions of removed constraints are never handed out again.
+  if (!Pos || Constraints.count(*Pos)) {
+    Pos = NextConstraintPosition++;
+  }
+  auto *InsertedConstraint = C.get();
+  Constraints.emplace(*Pos, std::move(C));
+  ConstraintPositions[InsertedConstraint] = *Pos;
+  indexConstraint(*InsertedConstraint);
+  return InsertedConstraint;
+}
+
+std::unique_ptr<Constraint> FeatureModel::removeConstraint(Constraint &C,
+                                                           size_t *Pos) {
+  auto Position = ConstraintPositions.find(&C);
+  if (Position == ConstraintPositions.end()) {
+    return nullptr;
+  }
+
+  PrimaryCollector Collector;
+  Collector.walk(C);
+  for (auto *P : Collector.getPrimaries()) {
+    auto *F = P->getFeature();
+    if (!F) {
+      continue;
+    }
+    F->removeConstraintNonPreserve(P);
+    if (auto Search = Occurrences.find(F); Search != Occurrences.end()) {
+      llvm::erase_if(Search->second, [&C](const ConstraintOccurrence &O) {
+        return O.C == &C;
+      });
+      if (Search->second.empty()) {
+        Occurrences.erase(Search);
+      }
+    }
+  }
+  if (Pos) {
+    *Pos = Position->second;
+  }
+  auto Search = Constraints.find(Position->second);
+  auto Removed = std::move(Search->second);
+  Constraints.erase(Search);
+  ConstraintPositions.erase(Position);
+  return Removed;
+}
+
+void FeatureModel::indexConstraint(Constraint &C) {
+  OccurrenceCollector Collector;
+  Collector.walk(C);
+  for (const auto *F : Collector.getFeatures()) {
+    Occurrences[F].push_back(
+        {&C, static_cast<OccurrencePolarity>(
+                 Collector.getPolarities().lookup(F))});
+  }
+}
+
+Relationship *FeatureModel::addRelationship(std::unique_ptr<Relationship> R) {
+  RelationshipPositions[R.get()] = Relationships.size();
+  Relationships.push_back(std::move(R));
+  return Relationships.back().get();
+}
+
+std::unique_ptr<Relationship>
+FeatureModel::removeRelationship(Relationship &R) {
+  auto Position = RelationshipPositions.find(&R);
+  assert(Position != RelationshipPositions.end() &&
+         "Relationship is not part of this model.");
+  size_t Index = Position->second;
+  RelationshipPositions.erase(Position);
+  // The order of relationships is irrelevant, so the last one fills the gap.
+  auto Removed = std::move(Relationships[Index]);
+  if (Index + 1 != Relationships.size()) {
+    Relationships[Index] = std::move(Relationships.back());
+    RelationshipPositions[Relationships[Index].get()] = Index;
+  }
+  Relationships.pop_back();
+  return Removed;
+}
+
+/// Collect a \a Feature and all features below it.
+static llvm::SmallVector<Feature *, 8> collectSubtree(Feature &F) {
+  llvm::SmallVector<Feature *, 8> Subtree{&F};
+  for (size_t I = 0; I < Subtree.size(); ++I) {
+    for (auto *Child : Subtree[I]->getChildren<Feature>()) {
+      Subtree.push_back(Child);
+    }
+  }
+  return Subtree;
+}
+
+void FeatureModel::reorderFeature(Feature &F) {
+  if (OrderingDeferred) {
+    Unordered.push_back(&F);
+    return;
+  }
+  // The ordering compares paths to the root, so the whole subtree moved. A
+  // subtree is contiguous in the ordering, so it is inserted as one block.
+  auto Subtree = collectSubtree(F);
+  OrderedFeatures.remove(
+      llvm::SmallPtrSet<Feature *, 8>(Subtree.begin(), Subtree.end()));
+  std::sort(Subtree.begin(), Subtree.end(),
+            [](Feature *A, Feature *B) { return *A < *B; });
+  OrderedFeatures.insertBlock(Subtree.begin(), Subtree.end());
+}
+
+void FeatureModel::unorderFeature(Feature &F) {
+  if (OrderingDeferred) {
+    Unordered.push_back(&F);
+    return;
+  }
+  auto Subtree = collectSubtree(F);
+  OrderedFeatures.remove(
+      llvm::SmallPtrSet<Feature *, 8>(Subtree.begin(), Subtree.end()));
+}
+
+void FeatureModel::restoreOrdering() {
+  OrderingDeferred = false;
+  auto Changed = std::move(Unordered);
+  Unordered.clear();
+  if (Changed.empty()) {
+    return;
+  }
+
+  // Only the subtrees of changed features moved in the ordering, while all
+  // other features kept their relative order.
+  llvm::SmallPtrSet<Feature *, 8> Moved;
+  llvm::SmallVector<Feature *, 8> Reinserted;
+  for (auto *F : Changed) {
+    if (Moved.count(F)) {
+      continue;
+    }
+    if (getFeature(F->getName()) != F) {
+      // Removed features are only taken out of the ordering.
+      Moved.insert(F);
+      continue;
+    }
+    for (auto *S : collectSubtree(*F)) {
+      if (Moved.insert(S).second) {
+        Reinserted.push_back(S);
+      }
+    }
+    if (Moved.size() > Features.size() / 8) {
+      rebuildOrdering();
+      return;
+    }
+  }
+  OrderedFeatures.remove(Moved);
+  std::sort(Reinserted.begin(), Reinserted.end(),
+            [](Feature *A, Feature *B) { return *A < *B; });
+  for (auto *F : Reinserted) {
+    OrderedFeatures.insert(F);
+  }
+}
+
+void FeatureModel::rebuildOrdering() {
+  // Siblings are ordered by their lower case names, see Feature::operator<.
+  auto SortByName = [](llvm::SmallVectorImpl<Feature *> &Siblings) {
+    std::vector<std::pair<std::string, Feature *>> Keys;
+    Keys.reserve(Siblings.size());
+    for (auto *F : Siblings) {
+      Keys.emplace_back(F->getName().lower(), F);
+    }
+    std::stable_sort(
+        Keys.begin(), Keys.end(),
+        [](const auto &A, const auto &B) { return A.first < B.first; });
+    for (size_t I = 0; I < Keys.size(); ++I) {
+      Siblings[I] = Keys[I].second;
+    }
+  };
+
+  // Emit the tree in pre-order, so parents precede their subtrees.
+  OrderedFeatures.clear();
+  llvm::SmallVector<Feature *, 8> Stack;
+  llvm::SmallVector<Feature *, 8> Children;
+  if (Root) {
+    Stack.push_back(Root);
+  }
+  while (!Stack.empty()) {
+    Feature *F = Stack.pop_back_val();
+    OrderedFeatures.push_back(F);
+    auto FS = F->getChildren<Feature>();
+    Children.assign(FS.begin(), FS.end());
+    SortByName(Children);
+    Stack.append(Children.rbegin(), Children.rend());
+  }
+
+  // Features detached from the root are not part of a consistent model, but
+  // must not get lost either.
+  if (OrderedFeatures.size() != Features.size()) {
+    llvm::SmallPtrSet<Feature *, 8> Ordered(OrderedFeatures.begin(),
+                                            OrderedFeatures.end());
+    for (const auto &KV : Features) {
+      if (!Ordered.count(KV.getValue().get())) {
+        OrderedFeatures.insert(KV.getValue().get());
+      }
+    }
+  }
 }
 
 std::unique_ptr<FeatureModel> FeatureModel::clone() {
@@ -92,7 +422,7 @@ std::unique_ptr<FeatureModel> FeatureModel::clone() {
   // builder to update pointers into the feature model correctly if invoked
   // afterwards.
   // TODO(s9latimm): Add unittests for cloned Constraints
-  for (const auto &C : this->Constraints) {
+  for (const auto &C : constraints()) {
     FMB.addConstraint(C->clone());
   }
 
@@ -172,6 +502,27 @@ void FeatureModelBuilder::detectXMLAlternatives() {
   for (const auto &FeatureName : Features.keys()) {
     std::vector<std::string> Frontier(Children[FeatureName].begin(),
                                       Children[FeatureName].end());
+    // Groups that are already known, e.g., when cloning a model, are not
+    // detected again, but their mutual exclusions are cleaned up as well.
+    if (auto Search = RelationshipEdges.find(FeatureName);
+        Search != RelationshipEdges.end()) {
+      for (const auto &[Kind, Names] : Search->second) {
+        llvm::SmallSet<Feature *, 3> Xor;
+        for (const auto &Name : Names) {
+          Frontier.erase(std::remove(Frontier.begin(), Frontier.end(), Name),
+                         Frontier.end());
+          Xor.insert(Features[Name].get());
+        }
+        if (Kind != Relationship::RelationshipKind::RK_ALTERNATIVE) {
+          continue;
+        }
+        for (auto *E : Xor) {
+          for (auto *R : cleanUpMutualExclusiveConstraints(E, Xor)) {
+            E->removeConstraintNonPreserve(R);
+          }
+        }
+      }
+    }
     while (!Frontier.empty()) {
       const std::string FName{Frontier.back()};
       Frontier.pop_back();
@@ -209,9 +560,12 @@ void FeatureModelBuilder::detectXMLAlternatives() {
 }
 
 bool FeatureModelBuilder::buildConstraints() {
-  auto B = BuilderVisitor(this);
+  FeatureResolver B(this);
   for (const auto &C : Constraints) {
-    C->accept(B);
+    B.walk(*C);
+  }
+  if (!B.succeeded()) {
+    return false;
   }
   detectXMLAlternatives();
   return true;
@@ -219,15 +573,13 @@ bool FeatureModelBuilder::buildConstraints() {
 
 bool FeatureModelBuilder::buildTree(const string &FeatureName,
                                     std::set<std::string> &Visited) {
-  if (find(Visited.begin(), Visited.end(), FeatureName) != Visited.end()) {
+  if (!Visited.insert(FeatureName).second) {
     llvm::errs() << "error: Cycle or duplicate edge in \'" << FeatureName
                  << "\'.\n";
     return false;
   }
-  Visited.insert(FeatureName);
 
-  if (find(Features.keys().begin(), Features.keys().end(), FeatureName) ==
-      Features.keys().end()) {
+  if (Features.find(FeatureName) == Features.end()) {
     llvm::errs() << "error: Missing feature \'\'" << FeatureName << "\'.\n";
     return false;
   }
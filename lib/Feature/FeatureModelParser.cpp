@@ -1,27 +1,242 @@
 #include "vara/Feature/FeatureModelParser.h"
+#include "vara/Feature/FeatureModelTransaction.h"
 
 #include "llvm/ADT/StringExtras.h"
+#include "llvm/Support/Endian.h"
+#include "llvm/Support/FileSystem.h"
 #include "llvm/Support/FormatVariadic.h"
 #include "llvm/Support/raw_ostream.h"
 
+#include "libxml/valid.h"
+#include "libxml/xmlreader.h"
+
+#include "BinaryConstants.h"
 #include "SxfmConstants.h"
 #include "XmlConstants.h"
 
+#include <algorithm>
+#include <atomic>
 #include <iostream>
-#include <regex>
+#include <limits>
+#include <thread>
 
 using std::make_unique;
 
 namespace vara::feature {
 
+namespace {
+
+/// Scan an integer, which may be surrounded by whitespace.
+///
+/// \returns whether \p Text holds an integer that fits into \p Value
+bool parseInteger(llvm::StringRef Text, int &Value) {
+  llvm::StringRef Digits = Text.trim();
+  bool Negative = Digits.consume_front("-");
+  const uint64_t Limit =
+      static_cast<uint64_t>(std::numeric_limits<int>::max()) + Negative;
+  uint64_t Result = 0;
+  bool Valid = !Digits.empty();
+  for (char C : Digits) {
+    Result = Result * 10 + (C - '0');
+    if (!llvm::isDigit(C) || Result > Limit) {
+      Valid = false;
+      break;
+    }
+  }
+  if (!Valid) {
+    llvm::errs() << "error: Invalid integer \'" << Text << "\'.\n";
+    return false;
+  }
+  Value = Negative ? static_cast<int>(-static_cast<int64_t>(Result))
+                   : static_cast<int>(Result);
+  return true;
+}
+
+/// Scan a list of integers separated by semicolons.
+bool parseValues(llvm::StringRef Text, std::vector<int> &Values) {
+  Values.clear();
+  while (!Text.trim().empty()) {
+    auto [Head, Tail] = Text.split(';');
+    int Value;
+    if (!parseInteger(Head, Value)) {
+      return false;
+    }
+    Values.push_back(Value);
+    Text = Tail;
+  }
+  return true;
+}
+
+void collectOptions(xmlNode *Node, std::vector<std::string> &Options) {
+  for (xmlNode *Child = Node->children; Child; Child = Child->next) {
+    if (Child->type == XML_ELEMENT_NODE) {
+      if (!xmlStrcmp(Child->name, XmlConstants::OPTIONS)) {
+        Options.emplace_back(reinterpret_cast<char *>(
+            FeatureModelParser::UniqueXmlChar(xmlNodeGetContent(Child),
+                                              xmlFree)
+                .get()));
+      }
+    }
+  }
+}
+
+void ignoreValidityError(void * /*Ctx*/, const char * /*Msg*/, ...) {}
+
+/// Find the next locations element in raw xml, skipping comments, CDATA
+/// sections and processing instructions.
+///
+/// \param Xml the input to search, which is advanced behind the element
+///
+/// \returns the element or an empty string if there is none
+llvm::StringRef findLocations(llvm::StringRef &Xml) {
+  static constexpr llvm::StringLiteral Tag = "<locations";
+  while (true) {
+    Xml = Xml.drop_front(std::min(Xml.find('<'), Xml.size()));
+    if (Xml.empty()) {
+      return Xml;
+    }
+
+    llvm::StringRef Terminator;
+    if (Xml.startswith("<!--")) {
+      Terminator = "-->";
+    } else if (Xml.startswith("<![CDATA[")) {
+      Terminator = "]]>";
+    } else if (Xml.startswith("<?")) {
+      Terminator = "?>";
+    } else if (Xml.startswith(Tag) && Xml.size() > Tag.size() &&
+               (Xml[Tag.size()] == '>' || Xml[Tag.size()] == '/' ||
+                llvm::isSpace(Xml[Tag.size()]))) {
+      size_t End = Xml.find('>');
+      if (End != llvm::StringRef::npos && Xml[End - 1] != '/') {
+        End = Xml.find("</locations", End);
+        End = End == llvm::StringRef::npos ? End : Xml.find('>', End);
+      }
+      if (End == llvm::StringRef::npos) {
+        Xml = "";
+        return Xml;
+      }
+      llvm::StringRef Element = Xml.take_front(End + 1);
+      Xml = Xml.drop_front(End + 1);
+      return Element;
+    }
+
+    if (Terminator.empty()) {
+      Xml = Xml.drop_front();
+    } else {
+      Xml = Xml.drop_front(
+          std::min(Xml.find(Terminator) + Terminator.size(), Xml.size()));
+    }
+  }
+}
+
+llvm::ErrorOr<std::unique_ptr<llvm::MemoryBuffer>>
+mapFile(const llvm::Twine &Path) {
+  auto FD = llvm::sys::fs::openNativeFileForRead(Path);
+  if (!FD) {
+    return llvm::errorToErrorCode(FD.takeError());
+  }
+  // Parsers get the length of the input, so files can be mapped without
+  // requiring a null terminator.
+  auto Buffer = llvm::MemoryBuffer::getOpenFile(
+      *FD, Path, /*FileSize=*/-1, /*RequiresNullTerminator=*/false);
+  llvm::sys::fs::closeFile(*FD);
+  return Buffer;
+}
+
+} // namespace
+
+//===----------------------------------------------------------------------===//
+//                          FeatureModelParser Class
+//===----------------------------------------------------------------------===//
+
+bool FeatureModelParser::updateFeatureModel(FeatureModel &FM) {
+  auto Target = buildFeatureModel();
+  if (!Target) {
+    return false;
+  }
+  if (!vara::feature::updateFeatureModel(FM, *Target)) {
+    llvm::errs() << "Root of parsed feature model does not match.\n";
+    return false;
+  }
+  return true;
+}
+
+FeatureModelParser::UniqueXmlDtd
+FeatureModelParser::parseDtd(const std::string &Raw) {
+  xmlInitParser();
+  UniqueXmlDtd Dtd(
+      xmlIOParseDTD(nullptr,
+                    xmlParserInputBufferCreateMem(Raw.c_str(), Raw.length(),
+                                                  XML_CHAR_ENCODING_UTF8),
+                    XML_CHAR_ENCODING_UTF8),
+      xmlFreeDtd);
+  assert(Dtd && "Failed to parse DTD.");
+
+  // Validation compiles content models lazily into the DTD, which would race
+  // between threads sharing it.
+  std::unique_ptr<xmlValidCtxt, void (*)(xmlValidCtxtPtr)> VCtxt(
+      xmlNewValidCtxt(), xmlFreeValidCtxt);
+  xmlHashScan(
+      static_cast<xmlElementTablePtr>(Dtd->elements),
+      [](void *Payload, void *Data, const xmlChar * /*Name*/) {
+        xmlValidBuildContentModel(static_cast<xmlValidCtxtPtr>(Data),
+                                  static_cast<xmlElementPtr>(Payload));
+      },
+      VCtxt.get());
+  return Dtd;
+}
+
+xmlParserCtxtPtr FeatureModelParser::getParserContext() {
+  static thread_local std::unique_ptr<xmlParserCtxt,
+                                      void (*)(xmlParserCtxtPtr)>
+      Ctxt(xmlNewParserCtxt(), xmlFreeParserCtxt);
+  return Ctxt.get();
+}
+
+std::shared_ptr<const llvm::MemoryBuffer> FeatureModelParser::retainInput() {
+  if (const auto *Shared =
+          std::get_if<std::shared_ptr<const llvm::MemoryBuffer>>(&Input);
+      Shared) {
+    return *Shared;
+  }
+  std::shared_ptr<const llvm::MemoryBuffer> Shared;
+  if (auto *Buffer = std::get_if<std::unique_ptr<llvm::MemoryBuffer>>(&Input);
+      Buffer) {
+    Shared = std::move(*Buffer);
+  } else {
+    Shared = llvm::MemoryBuffer::getMemBufferCopy(getInput());
+  }
+  Input = Shared;
+  return Shared;
+}
+
+std::unique_ptr<llvm::MemoryBuffer>
+FeatureModelParser::readFile(const llvm::Twine &Path) {
+  auto Buffer = mapFile(Path);
+  if (std::error_code EC = Buffer.getError()) {
+    llvm::errs() << "error: Could not read \'" << Path << "\': "
+                 << EC.message() << ".\n";
+    return nullptr;
+  }
+  return std::move(Buffer.get());
+}
+
+//===----------------------------------------------------------------------===//
+//                        FeatureModelXmlParser Class
+//===----------------------------------------------------------------------===//
+
+std::unique_ptr<FeatureModelXmlParser>
+FeatureModelXmlParser::fromFile(const llvm::Twine &Path, bool Streaming) {
+  auto Buffer = readFile(Path);
+  if (!Buffer) {
+    return nullptr;
+  }
+  return std::make_unique<FeatureModelXmlParser>(std::move(Buffer), Streaming);
+}
+
 bool FeatureModelXmlParser::parseConfigurationOption(xmlNode *Node,
                                                      bool Num = false) {
-  std::string Name{"root"};
-  bool Opt = false;
-  int MinValue = 0;
-  int MaxValue = 0;
-  std::vector<int> Values;
-  std::vector<FeatureSourceRange> SourceRanges;
+  ConfigurationOption Option;
   for (xmlNode *Head = Node->children; Head; Head = Head->next) {
     if (Head->type == XML_ELEMENT_NODE) {
       std::string Cnt{reinterpret_cast<char *>(
@@ -30,91 +245,203 @@ bool FeatureModelXmlParser::parseConfigurationOption(xmlNode *Node,
       // configurationOption. This method is never called without validating
       // the input beforehand.
       if (!xmlStrcmp(Head->name, XmlConstants::NAME)) {
-        Name = Cnt;
+        Option.Name = Cnt;
       } else if (!xmlStrcmp(Head->name, XmlConstants::OPTIONAL)) {
-        Opt = Cnt == "True";
+        Option.Opt = Cnt == "True";
       } else if (!xmlStrcmp(Head->name, XmlConstants::PARENT)) {
-        FMB.addEdge(Cnt, Name);
+        Option.Parent = Cnt;
       } else if (!xmlStrcmp(Head->name, XmlConstants::CHILDREN)) {
-        for (xmlNode *Child = Head->children; Child; Child = Child->next) {
-          if (Child->type == XML_ELEMENT_NODE) {
-            if (!xmlStrcmp(Child->name, XmlConstants::OPTIONS)) {
-              FMB.addEdge(Name, std::string(reinterpret_cast<char *>(
-                                    std::unique_ptr<xmlChar, void (*)(void *)>(
-                                        xmlNodeGetContent(Child), xmlFree)
-                                        .get())));
-            }
-          }
-        }
-      } else if (!xmlStrcmp(Head->name, XmlConstants::EXCLUDEDOPTIONS)) {
-        for (xmlNode *Child = Head->children; Child; Child = Child->next) {
-          if (Child->type == XML_ELEMENT_NODE) {
-            if (!xmlStrcmp(Child->name, XmlConstants::OPTIONS)) {
-              UniqueXmlChar CCnt(xmlNodeGetContent(Child), xmlFree);
-              FMB.addConstraint(make_unique<ExcludesConstraint>(
-                  make_unique<PrimaryFeatureConstraint>(
-                      make_unique<Feature>(Name)),
-                  make_unique<PrimaryFeatureConstraint>(make_unique<Feature>(
-                      reinterpret_cast<char *>(CCnt.get())))));
-            }
-          }
-        }
+        collectOptions(Head, Option.Children);
       } else if (!xmlStrcmp(Head->name, XmlConstants::IMPLIEDOPTIONS)) {
-        for (xmlNode *Child = Head->children; Child; Child = Child->next) {
-          if (Child->type == XML_ELEMENT_NODE) {
-            if (!xmlStrcmp(Child->name, XmlConstants::OPTIONS)) {
-              UniqueXmlChar CCnt(xmlNodeGetContent(Child), xmlFree);
-              FMB.addConstraint(make_unique<ImpliesConstraint>(
-                  make_unique<PrimaryFeatureConstraint>(
-                      make_unique<Feature>(Name)),
-                  make_unique<PrimaryFeatureConstraint>(make_unique<Feature>(
-                      reinterpret_cast<char *>(CCnt.get())))));
-            }
-          }
-        }
+        collectOptions(Head, Option.ImpliedOptions);
+      } else if (!xmlStrcmp(Head->name, XmlConstants::EXCLUDEDOPTIONS)) {
+        collectOptions(Head, Option.ExcludedOptions);
       } else if (!xmlStrcmp(Head->name, XmlConstants::LOCATIONS)) {
-        for (xmlNode *Child = Head->children; Child; Child = Child->next) {
-          if (Child->type == XML_ELEMENT_NODE) {
-            if (!xmlStrcmp(Child->name, XmlConstants::SOURCERANGE)) {
-              SourceRanges.push_back(createFeatureSourceRange(Child));
-            }
+        if (LazyLocations) {
+          if (!recordLocations(Option)) {
+            return false;
           }
+        } else if (auto Ranges = createFeatureSourceRanges(Head); Ranges) {
+          Option.SourceRanges = std::move(*Ranges);
+        } else {
+          return false;
         }
       } else if (Num) {
         if (!xmlStrcmp(Head->name, XmlConstants::MINVALUE)) {
-          MinValue = std::stoi(Cnt);
+          if (!parseInteger(Cnt, Option.MinValue)) {
+            return false;
+          }
         } else if (!xmlStrcmp(Head->name, XmlConstants::MAXVALUE)) {
-          MaxValue = std::stoi(Cnt);
+          if (!parseInteger(Cnt, Option.MaxValue)) {
+            return false;
+          }
         } else if (!xmlStrcmp(Head->name, XmlConstants::VALUES)) {
-          const std::regex Regex(R"(\d+)");
-          std::smatch Matches;
-          for (std::string Suffix = Cnt; regex_search(Suffix, Matches, Regex);
-               Suffix = Matches.suffix()) {
-            Values.emplace_back(std::stoi(Matches.str()));
+          if (!parseValues(Cnt, Option.Values)) {
+            return false;
           }
         }
       }
     }
   }
+  return addConfigurationOption(Option, Num);
+}
+
+bool FeatureModelXmlParser::addConfigurationOption(ConfigurationOption &Option,
+                                                   bool Num) {
+  const std::string &Name = Option.Name;
+  if (!Option.Parent.empty()) {
+    FMB.addEdge(Option.Parent, Name);
+  }
+  for (const auto &Child : Option.Children) {
+    FMB.addEdge(Name, Child);
+  }
+  for (const auto &Implied : Option.ImpliedOptions) {
+    FMB.addConstraint(make_unique<ImpliesConstraint>(
+        make_unique<PrimaryFeatureConstraint>(make_unique<Feature>(Name)),
+        make_unique<PrimaryFeatureConstraint>(make_unique<Feature>(Implied))));
+  }
+  for (const auto &Excluded : Option.ExcludedOptions) {
+    FMB.addConstraint(make_unique<ExcludesConstraint>(
+        make_unique<PrimaryFeatureConstraint>(make_unique<Feature>(Name)),
+        make_unique<PrimaryFeatureConstraint>(make_unique<Feature>(Excluded))));
+  }
 
   // XML has those names specified as root nodes
   if (Name == "root" || Name == "base") {
     FMB.setRootName(Name);
     return FMB.makeFeature<RootFeature>(Name);
   }
+  Feature *F;
   if (Num) {
-    if (Values.empty()) {
-      return FMB.makeFeature<NumericFeature>(Name,
-                                             std::make_pair(MinValue, MaxValue),
-                                             Opt, std::move(SourceRanges));
+    if (Option.Values.empty()) {
+      F = FMB.makeFeature<NumericFeature>(
+          Name, std::make_pair(Option.MinValue, Option.MaxValue), Option.Opt,
+          std::move(Option.SourceRanges));
+    } else {
+      F = FMB.makeFeature<NumericFeature>(Name, Option.Values, Option.Opt,
+                                          std::move(Option.SourceRanges));
+    }
+  } else {
+    F = FMB.makeFeature<BinaryFeature>(Name, Option.Opt,
+                                       std::move(Option.SourceRanges));
+  }
+  if (F && !Option.Locations.empty()) {
+    FMB.setLocationLoader(
+        Name, [Input = RetainedInput, Locations = Option.Locations]() {
+          return loadFeatureSourceRanges(Locations);
+        });
+  }
+  return F;
+}
+
+bool FeatureModelXmlParser::recordLocations(ConfigurationOption &Option) {
+  Option.Locations = findLocations(UnscannedInput);
+  if (Option.Locations.empty()) {
+    llvm::errs() << "error: Could not find locations of \'" << Option.Name
+                 << "\' in the input.\n";
+    return false;
+  }
+  return true;
+}
+
+std::optional<std::vector<FeatureSourceRange>>
+FeatureModelXmlParser::createFeatureSourceRanges(xmlNode *Node) {
+  std::vector<FeatureSourceRange> SourceRanges;
+  for (xmlNode *Child = Node->children; Child; Child = Child->next) {
+    if (Child->type == XML_ELEMENT_NODE) {
+      if (!xmlStrcmp(Child->name, XmlConstants::SOURCERANGE)) {
+        auto Range = createFeatureSourceRange(Child);
+        if (!Range) {
+          return std::nullopt;
+        }
+        SourceRanges.push_back(std::move(*Range));
+      }
+    }
+  }
+  return SourceRanges;
+}
+
+std::optional<std::vector<FeatureSourceRange>>
+FeatureModelXmlParser::loadFeatureSourceRanges(llvm::StringRef Locations) {
+  // The element was validated with the whole document, so only its content
+  // needs to be parsed.
+  UniqueXmlDoc Doc(xmlCtxtReadMemory(getParserContext(), Locations.data(),
+                                     static_cast<int>(Locations.size()),
+                                     nullptr, "UTF-8", XML_PARSE_NOBLANKS),
+                   xmlFreeDoc);
+  if (Doc) {
+    if (auto Ranges =
+            createFeatureSourceRanges(xmlDocGetRootElement(Doc.get()));
+        Ranges) {
+      return Ranges;
+    }
+  }
+  llvm::errs() << "error: Failed to load locations \'" << Locations
+               << "\'.\n";
+  return std::nullopt;
+}
+
+bool FeatureModelXmlParser::canLoadLocationsLazily() {
+  llvm::StringRef Prolog = getInput();
+  // UTF-16 and UTF-32 start with a byte order mark or a null byte.
+  if (Prolog.startswith("\xFE\xFF") || Prolog.startswith("\xFF\xFE") ||
+      Prolog.take_front(4).find('\0') != llvm::StringRef::npos) {
+    llvm::errs() << "error: Lazy locations require input in UTF-8.\n";
+    return false;
+  }
+  Prolog.consume_front("\xEF\xBB\xBF");
+
+  if (Prolog.startswith("<?xml")) {
+    llvm::StringRef Decl = Prolog.take_until([](char C) { return C == '>'; });
+    if (size_t Pos = Decl.find("encoding"); Pos != llvm::StringRef::npos) {
+      llvm::StringRef Encoding = Decl.drop_front(Pos).drop_until(
+          [](char C) { return C == '"' || C == '\''; });
+      Encoding = Encoding.drop_front().take_until(
+          [](char C) { return C == '"' || C == '\''; });
+      std::string Lower = Encoding.lower();
+      if (Lower != "utf-8" && Lower != "utf8") {
+        llvm::errs() << "error: Lazy locations require input in UTF-8, not \'"
+                     << Encoding << "\'.\n";
+        return false;
+      }
+    }
+  }
+
+  // Entities of an internal subset would be undefined in a single range.
+  for (llvm::StringRef Xml = Prolog; !Xml.empty();) {
+    Xml = Xml.drop_front(std::min(Xml.find('<'), Xml.size()));
+    if (Xml.startswith("<!--")) {
+      Xml = Xml.drop_front(std::min(Xml.find("-->"), Xml.size()));
+    } else if (Xml.startswith("<?")) {
+      Xml = Xml.drop_front(std::min(Xml.find("?>"), Xml.size()));
+    } else if (Xml.startswith("<!DOCTYPE")) {
+      // Skip quoted identifiers up to the subset or the end of the
+      // declaration.
+      char Quote = 0;
+      for (char C : Xml) {
+        if (Quote) {
+          Quote = C == Quote ? 0 : Quote;
+        } else if (C == '"' || C == '\'') {
+          Quote = C;
+        } else if (C == '[') {
+          llvm::errs()
+              << "error: Lazy locations require input without an internal "
+                 "DTD subset.\n";
+          return false;
+        } else if (C == '>') {
+          break;
+        }
+      }
+      return true;
+    } else if (!Xml.empty()) {
+      // The root element starts without a document type declaration.
+      return true;
     }
-    return FMB.makeFeature<NumericFeature>(Name, Values, Opt,
-                                           std::move(SourceRanges));
   }
-  return FMB.makeFeature<BinaryFeature>(Name, Opt, std::move(SourceRanges));
+  return true;
 }
 
-FeatureSourceRange
+std::optional<FeatureSourceRange>
 FeatureModelXmlParser::createFeatureSourceRange(xmlNode *Head) {
   fs::path Path;
   std::optional<FeatureSourceRange::FeatureSourceLocation> Start;
@@ -145,8 +472,14 @@ FeatureModelXmlParser::createFeatureSourceRange(xmlNode *Head) {
 
       } else if (!xmlStrcmp(Child->name, XmlConstants::START)) {
         Start = createFeatureSourceLocation(Child);
+        if (!Start) {
+          return std::nullopt;
+        }
       } else if (!xmlStrcmp(Child->name, XmlConstants::END)) {
         End = createFeatureSourceLocation(Child);
+        if (!End) {
+          return std::nullopt;
+        }
       }
     }
   }
@@ -215,18 +548,23 @@ bool FeatureModelXmlParser::parseVm(xmlNode *Node) {
   return true;
 }
 
-FeatureSourceRange::FeatureSourceLocation
+std::optional<FeatureSourceRange::FeatureSourceLocation>
 FeatureModelXmlParser::createFeatureSourceLocation(xmlNode *Node) {
   int Line = 0;
   int Column = 0;
   for (xmlNode *Head = Node->children; Head; Head = Head->next) {
     if (Head->type == XML_ELEMENT_NODE) {
+      int *Value = nullptr;
       if (!xmlStrcmp(Head->name, XmlConstants::LINE)) {
-        Line = atoi(reinterpret_cast<char *>(
-            UniqueXmlChar(xmlNodeGetContent(Head), xmlFree).get()));
+        Value = &Line;
       } else if (!xmlStrcmp(Head->name, XmlConstants::COLUMN)) {
-        Column = atoi(reinterpret_cast<char *>(
-            UniqueXmlChar(xmlNodeGetContent(Head), xmlFree).get()));
+        Value = &Column;
+      }
+      if (Value) {
+        UniqueXmlChar Cnt(xmlNodeGetContent(Head), xmlFree);
+        if (!parseInteger(reinterpret_cast<char *>(Cnt.get()), *Value)) {
+          return std::nullopt;
+        }
       }
     }
   }
@@ -234,6 +572,17 @@ FeatureModelXmlParser::createFeatureSourceLocation(xmlNode *Node) {
 }
 
 std::unique_ptr<FeatureModel> FeatureModelXmlParser::buildFeatureModel() {
+  if (LazyLocations) {
+    if (!canLoadLocationsLazily()) {
+      return nullptr;
+    }
+    RetainedInput = retainInput();
+    UnscannedInput = getInput();
+  }
+  if (Streaming) {
+    FMB.init();
+    return parseStream(true) ? FMB.buildFeatureModel() : nullptr;
+  }
   auto Doc = parseDoc();
   if (!Doc) {
     return nullptr;
@@ -243,29 +592,19 @@ std::unique_ptr<FeatureModel> FeatureModelXmlParser::buildFeatureModel() {
                                                   : nullptr;
 }
 
-FeatureModelParser::UniqueXmlDtd FeatureModelXmlParser::createDtd() {
-  UniqueXmlDtd Dtd(
-      xmlIOParseDTD(nullptr,
-                    xmlParserInputBufferCreateMem(XmlConstants::DtdRaw.c_str(),
-                                                  XmlConstants::DtdRaw.length(),
-                                                  XML_CHAR_ENCODING_UTF8),
-                    XML_CHAR_ENCODING_UTF8),
-      xmlFreeDtd);
-  xmlCleanupParser();
-  assert(Dtd && "Failed to parse DTD.");
-  return Dtd;
+xmlDtdPtr FeatureModelXmlParser::getDtd() {
+  static const UniqueXmlDtd Dtd = parseDtd(XmlConstants::DtdRaw);
+  return Dtd.get();
 }
 
 FeatureModelParser::UniqueXmlDoc FeatureModelXmlParser::parseDoc() {
-  std::unique_ptr<xmlParserCtxt, void (*)(xmlParserCtxtPtr)> Ctxt(
-      xmlNewParserCtxt(), xmlFreeParserCtxt);
-  UniqueXmlDoc Doc(xmlCtxtReadMemory(Ctxt.get(), Xml.c_str(), Xml.length(),
+  xmlParserCtxtPtr Ctxt = getParserContext();
+  UniqueXmlDoc Doc(xmlCtxtReadMemory(Ctxt, getInput().data(),
+                                     static_cast<int>(getInput().size()),
                                      nullptr, nullptr, XML_PARSE_NOBLANKS),
                    xmlFreeDoc);
-  xmlCleanupParser();
   if (Doc && Ctxt->valid) {
-    xmlValidateDtd(&Ctxt->vctxt, Doc.get(), createDtd().get());
-    if (Ctxt->vctxt.valid) {
+    if (Trusted || xmlValidateDtd(&Ctxt->vctxt, Doc.get(), getDtd())) {
       return Doc;
     }
     llvm::errs() << "Failed to validate DTD.\n";
@@ -276,12 +615,262 @@ FeatureModelParser::UniqueXmlDoc FeatureModelXmlParser::parseDoc() {
 }
 
 // TODO(s9latimm): replace with builder err
-bool FeatureModelXmlParser::verifyFeatureModel() { return parseDoc().get(); }
+bool FeatureModelXmlParser::verifyFeatureModel() {
+  return Streaming ? parseStream(false) : parseDoc().get() != nullptr;
+}
+
+/// \brief Parses and validates a feature model in XML in a single pass with a
+/// xmlTextReader.
+///
+/// Elements are validated against the DTD as they are opened and closed, and
+/// every configurationOption is handed to the builder as soon as it is
+/// closed. Hence, only the currently open elements and the option under
+/// construction are kept besides the model itself.
+class FeatureModelXmlParser::StreamParser {
+public:
+  StreamParser(FeatureModelXmlParser &Parser, bool Build)
+      : Parser(Parser), Build(Build), Validate(!Parser.Trusted),
+        Doc(xmlNewDoc(nullptr), xmlFreeDoc),
+        VCtxt(xmlNewValidCtxt(), xmlFreeValidCtxt) {
+    // The document only hosts the shared DTD, which is looked up by the
+    // validation.
+    Doc->extSubset = getDtd();
+  }
+  StreamParser(const StreamParser &) = delete;
+  StreamParser &operator=(const StreamParser &) = delete;
+  StreamParser(StreamParser &&) = delete;
+  StreamParser &operator=(StreamParser &&) = delete;
+  ~StreamParser() {
+    // Release the validation state of elements left open by an error.
+    VCtxt->error = ignoreValidityError;
+    while (Validate && !Open.empty()) {
+      xmlValidatePopElement(VCtxt.get(), Doc.get(), Open.back().get(),
+                            Open.back()->name);
+      Open.pop_back();
+    }
+    Doc->extSubset = nullptr;
+  }
+
+  bool parse();
+
+private:
+  using UniqueXmlNode = std::unique_ptr<xmlNode, void (*)(xmlNodePtr)>;
+
+  bool startElement(xmlTextReaderPtr Reader);
+  bool endElement();
+
+  [[nodiscard]] bool isInside(const xmlChar *Name) const {
+    return Open.size() > 1 && !xmlStrcmp(Open[Open.size() - 2]->name, Name);
+  }
+
+  FeatureModelXmlParser &Parser;
+  bool Build;
+  bool Validate;
+  UniqueXmlDoc Doc;
+  std::unique_ptr<xmlValidCtxt, void (*)(xmlValidCtxtPtr)> VCtxt;
+  std::vector<UniqueXmlNode> Open;
+  std::string Text;
+
+  bool Num{false};
+  ConfigurationOption Option;
+  fs::path Path;
+  std::optional<FeatureSourceRange::FeatureSourceLocation> Start;
+  std::optional<FeatureSourceRange::FeatureSourceLocation> End;
+  FeatureSourceRange::Category Category{
+      FeatureSourceRange::Category::necessary};
+  int Line{0};
+  int Column{0};
+  /// Whether the current locations element is recorded for lazy loading.
+  bool SkipLocations{false};
+};
+
+bool FeatureModelXmlParser::StreamParser::parse() {
+  // Readers are reused by all streaming parses on a thread.
+  static thread_local std::unique_ptr<xmlTextReader,
+                                      void (*)(xmlTextReaderPtr)>
+      Reader(nullptr, xmlFreeTextReader);
+  llvm::StringRef Xml = Parser.getInput();
+  auto Length = static_cast<int>(Xml.size());
+  if (!Reader) {
+    Reader.reset(xmlReaderForMemory(Xml.data(), Length, nullptr, nullptr,
+                                    XML_PARSE_NOBLANKS));
+  } else if (xmlReaderNewMemory(Reader.get(), Xml.data(), Length, nullptr,
+                                nullptr, XML_PARSE_NOBLANKS)) {
+    Reader.reset();
+  }
+  if (!Reader) {
+    llvm::errs() << "Failed to parse / validate XML.\n";
+    return false;
+  }
+
+  int Ret;
+  while ((Ret = xmlTextReaderRead(Reader.get())) == 1) {
+    bool Valid = true;
+    switch (xmlTextReaderNodeType(Reader.get())) {
+    case XML_READER_TYPE_ELEMENT:
+      Valid = startElement(Reader.get()) &&
+              (!xmlTextReaderIsEmptyElement(Reader.get()) || endElement());
+      break;
+    case XML_READER_TYPE_END_ELEMENT:
+      Valid = endElement();
+      break;
+    case XML_READER_TYPE_TEXT:
+    case XML_READER_TYPE_CDATA: {
+      const xmlChar *Value = xmlTextReaderConstValue(Reader.get());
+      Valid = !Validate ||
+              xmlValidatePushCData(VCtxt.get(), Value, xmlStrlen(Value));
+      Text += reinterpret_cast<const char *>(Value);
+      break;
+    }
+    default:
+      break;
+    }
+    if (!Valid) {
+      llvm::errs() << "Failed to validate DTD.\n";
+      return false;
+    }
+  }
+  if (Ret != 0) {
+    llvm::errs() << "Failed to parse / validate XML.\n";
+    return false;
+  }
+  return true;
+}
+
+bool FeatureModelXmlParser::StreamParser::startElement(
+    xmlTextReaderPtr Reader) {
+  const xmlChar *Name = xmlTextReaderConstName(Reader);
+  if (Open.empty() && xmlStrcmp(Name, XmlConstants::VM)) {
+    return false;
+  }
+  Open.emplace_back(xmlNewNode(nullptr, Name), xmlFreeNode);
+  Text.clear();
+  if (Validate && !xmlValidatePushElement(VCtxt.get(), Doc.get(),
+                                          Open.back().get(), Name)) {
+    return false;
+  }
+
+  if (!xmlStrcmp(Name, XmlConstants::VM)) {
+    UniqueXmlChar VmName(xmlTextReaderGetAttribute(Reader, XmlConstants::NAME),
+                         xmlFree);
+    if (!VmName) {
+      return false;
+    }
+    if (Build) {
+      UniqueXmlChar Root(xmlTextReaderGetAttribute(Reader, XmlConstants::ROOT),
+                         xmlFree);
+      UniqueXmlChar Commit(
+          xmlTextReaderGetAttribute(Reader, XmlConstants::COMMIT), xmlFree);
+      Parser.FMB.setVmName(reinterpret_cast<char *>(VmName.get()));
+      Parser.FMB.setPath(Root ? fs::path(reinterpret_cast<char *>(Root.get()))
+                              : fs::current_path());
+      Parser.FMB.setCommit(
+          Commit ? std::string(reinterpret_cast<char *>(Commit.get())) : "");
+    }
+  } else if (!xmlStrcmp(Name, XmlConstants::BINARYOPTIONS)) {
+    Num = false;
+  } else if (!xmlStrcmp(Name, XmlConstants::NUMERICOPTIONS)) {
+    Num = true;
+  } else if (!xmlStrcmp(Name, XmlConstants::CONFIGURATIONOPTION)) {
+    Option = ConfigurationOption();
+  } else if (!xmlStrcmp(Name, XmlConstants::LOCATIONS)) {
+    SkipLocations = Build && Parser.LazyLocations;
+    if (SkipLocations && !Parser.recordLocations(Option)) {
+      return false;
+    }
+  } else if (!xmlStrcmp(Name, XmlConstants::SOURCERANGE)) {
+    UniqueXmlChar Cnt(xmlTextReaderGetAttribute(Reader, XmlConstants::CATEGORY),
+                      xmlFree);
+    if (!Cnt || !xmlStrcmp(Cnt.get(), XmlConstants::NECESSARY)) {
+      Category = FeatureSourceRange::Category::necessary;
+    } else if (!xmlStrcmp(Cnt.get(), XmlConstants::INESSENTIAL)) {
+      Category = FeatureSourceRange::Category::inessential;
+    } else {
+      return false;
+    }
+    Path.clear();
+    Start.reset();
+    End.reset();
+  } else if (!xmlStrcmp(Name, XmlConstants::START) ||
+             !xmlStrcmp(Name, XmlConstants::END)) {
+    Line = 0;
+    Column = 0;
+  }
+  return true;
+}
+
+bool FeatureModelXmlParser::StreamParser::endElement() {
+  assert(!Open.empty() && "Closing element was never opened.");
+  const xmlChar *Name = Open.back()->name;
+  if (Validate && !xmlValidatePopElement(VCtxt.get(), Doc.get(),
+                                         Open.back().get(), Name)) {
+    return false;
+  }
+
+  bool Succeeded = true;
+  if (Build && !SkipLocations) {
+    if (!xmlStrcmp(Name, XmlConstants::NAME)) {
+      Option.Name = Text;
+    } else if (!xmlStrcmp(Name, XmlConstants::OPTIONAL)) {
+      Option.Opt = Text == "True";
+    } else if (!xmlStrcmp(Name, XmlConstants::PARENT)) {
+      Option.Parent = Text;
+    } else if (!xmlStrcmp(Name, XmlConstants::OPTIONS)) {
+      if (isInside(XmlConstants::CHILDREN)) {
+        Option.Children.push_back(Text);
+      } else if (isInside(XmlConstants::IMPLIEDOPTIONS)) {
+        Option.ImpliedOptions.push_back(Text);
+      } else if (isInside(XmlConstants::EXCLUDEDOPTIONS)) {
+        Option.ExcludedOptions.push_back(Text);
+      }
+    } else if (Num && !xmlStrcmp(Name, XmlConstants::MINVALUE)) {
+      Succeeded = parseInteger(Text, Option.MinValue);
+    } else if (Num && !xmlStrcmp(Name, XmlConstants::MAXVALUE)) {
+      Succeeded = parseInteger(Text, Option.MaxValue);
+    } else if (Num && !xmlStrcmp(Name, XmlConstants::VALUES)) {
+      Succeeded = parseValues(Text, Option.Values);
+    } else if (!xmlStrcmp(Name, XmlConstants::PATH)) {
+      Path = fs::path(Text);
+    } else if (!xmlStrcmp(Name, XmlConstants::LINE)) {
+      Succeeded = parseInteger(Text, Line);
+    } else if (!xmlStrcmp(Name, XmlConstants::COLUMN)) {
+      Succeeded = parseInteger(Text, Column);
+    } else if (!xmlStrcmp(Name, XmlConstants::START)) {
+      Start = FeatureSourceRange::FeatureSourceLocation(Line, Column);
+    } else if (!xmlStrcmp(Name, XmlConstants::END)) {
+      End = FeatureSourceRange::FeatureSourceLocation(Line, Column);
+    } else if (!xmlStrcmp(Name, XmlConstants::SOURCERANGE)) {
+      Option.SourceRanges.emplace_back(Path, Start, End, Category);
+    } else if (!xmlStrcmp(Name, XmlConstants::CONFIGURATIONOPTION)) {
+      Succeeded = Parser.addConfigurationOption(Option, Num);
+    }
+    // Constraints are skipped, just like in parseConstraints.
+  }
+  if (!xmlStrcmp(Name, XmlConstants::LOCATIONS)) {
+    SkipLocations = false;
+  }
+  Open.pop_back();
+  Text.clear();
+  return Succeeded;
+}
+
+bool FeatureModelXmlParser::parseStream(bool Build) {
+  return StreamParser(*this, Build).parse();
+}
 
 //===----------------------------------------------------------------------===//
 //                        FeatureModelSxfmParser Class
 //===----------------------------------------------------------------------===//
 
+std::unique_ptr<FeatureModelSxfmParser>
+FeatureModelSxfmParser::fromFile(const llvm::Twine &Path) {
+  auto Buffer = readFile(Path);
+  if (!Buffer) {
+    return nullptr;
+  }
+  return std::make_unique<FeatureModelSxfmParser>(std::move(Buffer));
+}
+
 std::unique_ptr<FeatureModel> FeatureModelSxfmParser::buildFeatureModel() {
   UniqueXmlDoc Doc = parseDoc();
   if (!Doc) {
@@ -289,39 +878,31 @@ std::unique_ptr<FeatureModel> FeatureModelSxfmParser::buildFeatureModel() {
   }
 
   FMB.init();
+  IdToName.clear();
   return parseVm(xmlDocGetRootElement(Doc.get())) ? FMB.buildFeatureModel()
                                                   : nullptr;
 }
 
-FeatureModelSxfmParser::UniqueXmlDtd FeatureModelSxfmParser::createDtd() {
-  UniqueXmlDtd Dtd(
-      xmlIOParseDTD(nullptr,
-                    xmlParserInputBufferCreateMem(
-                        SxfmConstants::DtdRaw.c_str(),
-                        SxfmConstants::DtdRaw.length(), XML_CHAR_ENCODING_UTF8),
-                    XML_CHAR_ENCODING_UTF8),
-      xmlFreeDtd);
-  xmlCleanupParser();
-  assert(Dtd && "Failed to parse DTD.");
-  return Dtd;
+xmlDtdPtr FeatureModelSxfmParser::getDtd() {
+  static const UniqueXmlDtd Dtd = parseDtd(SxfmConstants::DtdRaw);
+  return Dtd.get();
 }
 
 FeatureModelSxfmParser::UniqueXmlDoc FeatureModelSxfmParser::parseDoc() {
-  // Initialize the XML parser
-  std::unique_ptr<xmlParserCtxt, void (*)(xmlParserCtxtPtr)> Ctxt(
-      xmlNewParserCtxt(), xmlFreeParserCtxt);
+  // Reuse the XML parser of this thread
+  xmlParserCtxtPtr Ctxt = getParserContext();
   // Parse the given model by libxml2
-  UniqueXmlDoc Doc(xmlCtxtReadMemory(Ctxt.get(), Sxfm.c_str(), Sxfm.length(),
+  UniqueXmlDoc Doc(xmlCtxtReadMemory(Ctxt, getInput().data(),
+                                     static_cast<int>(getInput().size()),
                                      nullptr, nullptr, XML_PARSE_NOBLANKS),
                    xmlFreeDoc);
-  xmlCleanupParser();
 
   // In the following, the document is validated.
   // Therefore, (1) check whether it could be parsed
   if (Doc && Ctxt->valid) {
     // (2) validate the sxfm format by using the dtd (document type definition)
-    // file
-    if (xmlValidateDtd(&Ctxt->vctxt, Doc.get(), createDtd().get())) {
+    // file, unless the input is trusted
+    if (Trusted || xmlValidateDtd(&Ctxt->vctxt, Doc.get(), getDtd())) {
       // and (3) check the tree-like structure of the embedded feature model
       // as well as constraints
       return Doc;
@@ -372,196 +953,193 @@ bool FeatureModelSxfmParser::parseVm(xmlNode *Node) {
 }
 
 bool FeatureModelSxfmParser::parseFeatureTree(xmlNode *FeatureTree) {
-  // Split the lines of the feature tree by new lines
-  {
-    std::stringstream Ss(reinterpret_cast<const char *>(
-        UniqueXmlChar(xmlNodeGetContent(FeatureTree), xmlFree).get()));
-    std::string To;
-    std::string Name;
-    bool Opt;
-    bool IsRoot;
-    int LastIndentationLevel = -1;
-    int RootIndentation = -1;
-    int OrGroupCounter = 0;
-    std::map<int, std::string> IndentationToParentMapping;
-
-    // This map is used for the or group mapping
-    // Each entry represents an or group as a tuple where the first value is
-    // the name of the parent, the second is the relationship kind, and the
-    // third a vector consisting of the name of the children
-    std::map<int, std::tuple<std::string, Relationship::RelationshipKind,
-                             std::vector<std::string>>>
-        OrGroupMapping;
-
-    if (FeatureTree == nullptr) {
-      llvm::errs() << "Failed to read in feature tree. Is it empty?\n";
-      return false;
+  if (FeatureTree == nullptr) {
+    llvm::errs() << "Failed to read in feature tree. Is it empty?\n";
+    return false;
+  }
+  UniqueXmlChar Cnt(xmlNodeGetContent(FeatureTree), xmlFree);
+  if (!Cnt) {
+    llvm::errs() << "Failed to read in feature tree. Is it empty?\n";
+    return false;
+  }
+
+  // An or group, which is added to the feature model once all of its children
+  // are parsed.
+  struct OrGroup {
+    std::string Parent;
+    Relationship::RelationshipKind Kind;
+    std::vector<std::string> Children;
+  };
+
+  int LastIndentationLevel = -1;
+  int RootIndentation = -1;
+  int OrGroupCounter = 0;
+  // The last feature and the open or group on each indentation level, which
+  // are the parent and group of the features on the next level.
+  std::vector<std::string> Parents;
+  std::vector<std::optional<OrGroup>> OrGroups;
+
+  // Walk over the content line by line without copying it.
+  llvm::StringRef Remainder(reinterpret_cast<const char *>(Cnt.get()));
+  while (!Remainder.empty()) {
+    llvm::StringRef Line;
+    std::tie(Line, Remainder) = Remainder.split('\n');
+    if (Line.trim().empty()) {
+      continue;
     }
 
-    while (std::getline(Ss, To)) {
-      Opt = false;
-      IsRoot = false;
+    // For every line, count the indentation
+    // not more than 1 additional indentations are allowed to the original one
+    // However, we may have arbitrarily less indentations
+    auto ColonPos = Line.find(':');
+    if (ColonPos == llvm::StringRef::npos) {
+      llvm::errs() << "Colon is missing in line" << Line << "\n";
+      return false;
+    }
 
-      if (To.empty() || std::all_of(To.begin(), To.end(), isspace)) {
-        continue;
-      }
+    int CurrentIndentationLevel =
+        static_cast<int>(Line.take_front(ColonPos).count(Indentation));
+    int Diff = CurrentIndentationLevel - LastIndentationLevel;
 
-      // For every line, count the indentation
-      // not more than 1 additional indentations are allowed to the original one
-      // However, we may have arbitrarily less indentations
-      if ((To.find(':', 0)) == std::string::npos) {
-        llvm::errs() << "Colon is missing in line" << To << "\n";
-        return false;
-      }
+    // Remember the root indentation for later checks
+    if (LastIndentationLevel == -1) {
+      RootIndentation = CurrentIndentationLevel;
+    }
 
-      llvm::StringRef ToStringRef(To);
-      llvm::StringRef IndentationString =
-          ToStringRef.substr(0, ToStringRef.find(':'));
-      int CurrentIndentationLevel = IndentationString.count(Indentation);
-      int Diff = CurrentIndentationLevel - LastIndentationLevel;
+    if ((LastIndentationLevel != -1) && Diff > 1) {
+      llvm::errs() << "Indentation error in feature tree in line " << Line
+                   << "\n";
+      return false;
+    }
 
-      // Remember the root indentation for later checks
-      if (LastIndentationLevel == -1) {
-        RootIndentation = CurrentIndentationLevel;
-      }
+    // Move pointer to first character after indentation
+    // The first character has to be a colon followed by the type of
+    // the feature (m for mandatory, o for optional, a for alternative)
+    size_t Pos = CurrentIndentationLevel * Indentation.length() + 2;
+    std::optional<std::tuple<int, int>> Cardinalities;
+    bool Opt = false;
+    bool IsRoot = false;
 
-      if ((LastIndentationLevel != -1) && Diff > 1) {
-        llvm::errs() << "Indentation error in feature tree in line " << To
-                     << "\n";
+    switch (Pos <= Line.size() ? Line[Pos - 1] : '\0') {
+    case 'r':
+      IsRoot = true;
+      break;
+    case 'm':
+      break;
+    case 'o':
+      // Code for optional
+      Opt = true;
+      break;
+    case 'g':
+      // Code for an or group with different cardinalities
+      // Extract the cardinality
+      Cardinalities = extractCardinality(Line);
+      if (!Cardinalities.has_value()) {
         return false;
       }
+      break;
+    case ' ':
+      // Code for alternative child
+      Pos--;
+      break;
+    default:
+      llvm::errs()
+          << "Wrong indentation or unsupported type of configuration option:'"
+          << Line << "'\n";
+      return false;
+    }
+    // Extract the name
+    llvm::StringRef Name = Line.slice(Pos + 1, Line.find(' ', Pos + 1));
 
-      // Move pointer to first character after indentation
-      // The first character has to be a colon followed by the type of
-      // the feature (m for mandatory, o for optional, a for alternative)
-      std::string::size_type Pos =
-          CurrentIndentationLevel * Indentation.length() + 2;
-      std::optional<std::tuple<int, int>> Cardinalities;
-
-      switch (To.at(Pos - 1)) {
-      case 'r':
-        IsRoot = true;
-        break;
-      case 'm':
-        break;
-      case 'o':
-        // Code for optional
-        Opt = true;
-        break;
-      case 'g':
-        // Code for an or group with different cardinalities
-        Opt = false;
-        // Extract the cardinality
-        Cardinalities = extractCardinality(To);
-        if (!Cardinalities.has_value()) {
-          return false;
-        }
-        break;
-      case ' ':
-        // Code for alternative child
-        Pos--;
-        break;
-      default:
-        llvm::errs()
-            << "Wrong indentation or unsupported type of configuration option:'"
-            << To << "'\n";
-        return false;
-      }
-      // Extract the name
-      Name =
-          ToStringRef.substr(Pos + 1, ToStringRef.find(' ', Pos + 1) - Pos - 1)
-              .str();
-
-      // Remove the cardinality
-      if (Name.find_first_of('[') != std::string::npos) {
-        Name = ToStringRef
-                   .substr(Pos + 1, ToStringRef.find('[', Pos + 1) - Pos - 1)
-                   .str();
-
-        if (Name.empty()) {
-          // In this case, the name could also be after the cardinality.
-          // According to the examples provided by S.P.L.O.T., this is a valid
-          // format.
-          auto Remainder =
-              ToStringRef.substr(Pos + 1, ToStringRef.size() - Pos - 1);
-          auto Tokens = Remainder.split(' ');
-          if (!Tokens.second.empty()) {
-            Name = Tokens.second.str();
-          }
+    // Remove the cardinality
+    if (Name.find('[') != llvm::StringRef::npos) {
+      Name = Line.slice(Pos + 1, Line.find('[', Pos + 1));
+
+      if (Name.empty()) {
+        // In this case, the name could also be after the cardinality.
+        // According to the examples provided by S.P.L.O.T., this is a valid
+        // format.
+        auto Tokens = Line.drop_front(Pos + 1).split(' ');
+        if (!Tokens.second.empty()) {
+          Name = Tokens.second;
         }
       }
+    }
 
-      // Note that we ignore the ID and use the name of the feature
-      // as unique identifier.
-      if (Name.find_first_of('(') != std::string::npos) {
-        Name = Name.substr(0, Name.find('(', 0));
-      }
+    // Note that we ignore the ID and use the name of the feature
+    // as unique identifier.
+    Name = Name.take_until([](char C) { return C == '('; });
 
-      // If there is no name, provide an artificial one
-      if (Name.empty()) {
-        OrGroupCounter++;
-        Name = "group_" + std::to_string(OrGroupCounter);
-      }
+    // If there is no name, provide an artificial one
+    std::string FeatureName = Name.empty()
+                                  ? "group_" + std::to_string(++OrGroupCounter)
+                                  : Name.str();
 
-      // Create the feature
-      if (IsRoot) {
-        FMB.makeFeature<RootFeature>(Name);
-      } else {
-        FMB.makeFeature<BinaryFeature>(Name, Opt);
+    // Remember the ID of the feature, which is used by the constraints to
+    // reference it.
+    if (auto IdStart = Line.find('(', Pos + 1);
+        IdStart != llvm::StringRef::npos) {
+      auto IdEnd = Line.find(')', IdStart + 1);
+      llvm::StringRef Id = Line.slice(IdStart + 1, IdEnd).trim();
+      if (!Id.empty()) {
+        IdToName[Id] = FeatureName;
       }
-      IndentationToParentMapping[CurrentIndentationLevel] = Name;
+    }
 
-      // Add parent from the upper indentation level if there is one
-      if (LastIndentationLevel != -1 &&
-          CurrentIndentationLevel == RootIndentation) {
-        llvm::errs() << "Only one feature can be root and have the same "
-                        "indentation as root.\n";
-        return false;
-      }
+    // Create the feature
+    if (IsRoot) {
+      FMB.makeFeature<RootFeature>(FeatureName);
+    } else {
+      FMB.makeFeature<BinaryFeature>(FeatureName, Opt);
+    }
 
-      if (LastIndentationLevel != -1) {
-        auto Parent =
-            IndentationToParentMapping.find(CurrentIndentationLevel - 1);
-        assert(Parent != IndentationToParentMapping.end());
-        FMB.addEdge(Parent->second, Name);
-      }
+    // Add parent from the upper indentation level if there is one
+    if (LastIndentationLevel != -1 &&
+        CurrentIndentationLevel <= RootIndentation) {
+      llvm::errs() << "Only one feature can be root and have the same "
+                      "indentation as root.\n";
+      return false;
+    }
 
-      // Add the or group to the feature model if it is completely parsed
-      auto OrGroup = OrGroupMapping.find(CurrentIndentationLevel);
-      if (OrGroup != OrGroupMapping.end()) {
-        FMB.emplaceRelationship(std::get<1>(OrGroup->second),
-                                std::get<2>(OrGroup->second),
-                                std::get<0>(OrGroup->second));
-        OrGroupMapping.erase(CurrentIndentationLevel);
-      }
+    if (Parents.size() <= static_cast<size_t>(CurrentIndentationLevel)) {
+      Parents.resize(CurrentIndentationLevel + 1);
+      OrGroups.resize(CurrentIndentationLevel + 1);
+    }
+    if (LastIndentationLevel != -1) {
+      FMB.addEdge(Parents[CurrentIndentationLevel - 1], FeatureName);
+    }
 
-      // Remember the new or group parent if there is one
-      if (Cardinalities.has_value()) {
-        Relationship::RelationshipKind GroupKind =
-            Relationship::RelationshipKind::RK_ALTERNATIVE;
-        if (std::get<1>(Cardinalities.value()) == SxfmConstants::WILDCARD) {
-          GroupKind = Relationship::RelationshipKind::RK_OR;
-        }
-        OrGroupMapping[CurrentIndentationLevel] =
-            std::tuple<std::string, Relationship::RelationshipKind,
-                       std::vector<std::string>>(Name, GroupKind,
-                                                 std::vector<std::string>());
-      }
+    // Add the or group to the feature model if it is completely parsed
+    if (auto &Group = OrGroups[CurrentIndentationLevel]; Group) {
+      FMB.emplaceRelationship(Group->Kind, Group->Children, Group->Parent);
+      Group.reset();
+    }
 
-      // Add a child
-      OrGroup = OrGroupMapping.find(CurrentIndentationLevel - 1);
-      if (OrGroup != OrGroupMapping.end()) {
-        std::get<2>(OrGroup->second).push_back(Name);
+    // Remember the new or group parent if there is one
+    if (Cardinalities.has_value()) {
+      Relationship::RelationshipKind GroupKind =
+          Relationship::RelationshipKind::RK_ALTERNATIVE;
+      if (std::get<1>(Cardinalities.value()) == SxfmConstants::WILDCARD) {
+        GroupKind = Relationship::RelationshipKind::RK_OR;
       }
+      OrGroups[CurrentIndentationLevel] = OrGroup{FeatureName, GroupKind, {}};
+    }
 
-      LastIndentationLevel = CurrentIndentationLevel;
+    // Add a child
+    if (CurrentIndentationLevel > 0) {
+      if (auto &Group = OrGroups[CurrentIndentationLevel - 1]; Group) {
+        Group->Children.push_back(FeatureName);
+      }
     }
 
-    // Add the remaining or groups
-    for (auto &OrGroup : OrGroupMapping) {
-      FMB.emplaceRelationship(std::get<1>(OrGroup.second),
-                              std::get<2>(OrGroup.second),
-                              std::get<0>(OrGroup.second));
+    Parents[CurrentIndentationLevel] = std::move(FeatureName);
+    LastIndentationLevel = CurrentIndentationLevel;
+  }
+
+  // Add the remaining or groups
+  for (const auto &Group : OrGroups) {
+    if (Group) {
+      FMB.emplaceRelationship(Group->Kind, Group->Children, Group->Parent);
     }
   }
 
@@ -569,11 +1147,97 @@ bool FeatureModelSxfmParser::parseFeatureTree(xmlNode *FeatureTree) {
 }
 
 bool FeatureModelSxfmParser::parseConstraints(xmlNode *Constraints) {
-  // TODO (se-passau/VaRA#702): This has to wait until the constraint part is
-  // implemented
+  UniqueXmlChar Cnt(xmlNodeGetContent(Constraints), xmlFree);
+  if (!Cnt) {
+    return true;
+  }
+
+  // Walk over the content line by line without copying it, every non-empty
+  // line contains exactly one labeled clause.
+  llvm::StringRef Remainder(reinterpret_cast<const char *>(Cnt.get()));
+  while (!Remainder.empty()) {
+    llvm::StringRef Line;
+    std::tie(Line, Remainder) = Remainder.split('\n');
+    Line = Line.trim();
+    if (Line.empty()) {
+      continue;
+    }
+
+    auto ColonPos = Line.find(':');
+    if (ColonPos == llvm::StringRef::npos) {
+      llvm::errs() << "Colon is missing in constraint '" << Line << "'\n";
+      return false;
+    }
+
+    auto C = parseClause(Line.drop_front(ColonPos + 1));
+    if (!C) {
+      llvm::errs() << "Failed to parse constraint '" << Line << "'\n";
+      return false;
+    }
+    FMB.addConstraint(std::move(C));
+  }
+
   return true;
 }
 
+std::unique_ptr<Constraint>
+FeatureModelSxfmParser::parseClause(llvm::StringRef Clause) {
+  NaryConstraint::OperandContainerTy Literals;
+  bool ExpectLiteral = true;
+
+  while (!(Clause = Clause.ltrim()).empty()) {
+    auto TokenEnd = Clause.find_first_of(" \t");
+    llvm::StringRef Token = Clause.take_front(TokenEnd);
+    Clause = Clause.drop_front(Token.size());
+
+    if (!ExpectLiteral) {
+      if (Token != "or") {
+        llvm::errs() << "Expected 'or' but found '" << Token << "'.\n";
+        return nullptr;
+      }
+      ExpectLiteral = true;
+      continue;
+    }
+
+    bool Negated = Token.consume_front("~");
+    if (Token.empty()) {
+      llvm::errs() << "Missing feature in literal.\n";
+      return nullptr;
+    }
+
+    // Literals reference features by their ID; features without an ID can
+    // only be referenced by their name.
+    llvm::StringRef Name = Token;
+    if (auto Search = IdToName.find(Token); Search != IdToName.end()) {
+      Name = Search->getValue();
+    } else if (!FMB.getFeature(Token)) {
+      llvm::errs() << "Unknown feature '" << Token << "' in constraint.\n";
+      return nullptr;
+    }
+
+    std::unique_ptr<Constraint> Literal =
+        make_unique<PrimaryFeatureConstraint>(make_unique<Feature>(Name.str()));
+    if (Negated) {
+      Literal = make_unique<NotConstraint>(std::move(Literal));
+    }
+    Literals.push_back(std::move(Literal));
+    ExpectLiteral = false;
+  }
+
+  if (ExpectLiteral) {
+    llvm::errs() << "Clause ends without literal.\n";
+    return nullptr;
+  }
+  if (Literals.size() == 1) {
+    return std::move(Literals.front());
+  }
+  if (Literals.size() == 2) {
+    return make_unique<OrConstraint>(std::move(Literals[0]),
+                                     std::move(Literals[1]));
+  }
+  return make_unique<NaryOrConstraint>(std::move(Literals));
+}
+
 std::optional<std::tuple<int, int>> FeatureModelSxfmParser::extractCardinality(
     llvm::StringRef StringToExtractFrom) {
   std::optional<int> MinCardinality;
@@ -588,13 +1252,11 @@ std::optional<std::tuple<int, int>> FeatureModelSxfmParser::extractCardinality(
   }
   llvm::StringRef CardinalityString(StringToExtractFrom);
   size_t CommaPos = CardinalityString.find(',', Pos + 1);
-  MinCardinality = parseCardinality(
-      CardinalityString.substr(Pos + 1, CommaPos - Pos - 1).str());
+  MinCardinality =
+      parseCardinality(CardinalityString.substr(Pos + 1, CommaPos - Pos - 1));
   Pos = CommaPos;
-  MaxCardinality = parseCardinality(
-      CardinalityString
-          .substr(Pos + 1, CardinalityString.find(']', Pos + 1) - Pos - 1)
-          .str());
+  MaxCardinality = parseCardinality(CardinalityString.substr(
+      Pos + 1, CardinalityString.find(']', Pos + 1) - Pos - 1));
 
   if (!MinCardinality.has_value() || !MaxCardinality.has_value()) {
     llvm::errs() << "No parsable cardinality!\n";
@@ -634,4 +1296,413 @@ FeatureModelSxfmParser::parseCardinality(llvm::StringRef CardinalityString) {
   return Result;
 }
 
+//===----------------------------------------------------------------------===//
+//                          FeatureModelBinaryParser
+//===----------------------------------------------------------------------===//
+
+namespace {
+
+/// Reads little endian values from the input and checks all bounds.
+class BinaryReader {
+public:
+  explicit BinaryReader(llvm::StringRef Input) : Input(Input) {}
+
+  template <typename T> bool read(T &Value) {
+    if (Input.size() < sizeof(T)) {
+      return false;
+    }
+    Value = llvm::support::endian::read<T, llvm::support::little,
+                                        llvm::support::unaligned>(
+        Input.data());
+    Input = Input.drop_front(sizeof(T));
+    return true;
+  }
+
+  bool read(llvm::StringRef &Str, size_t Size) {
+    if (Input.size() < Size) {
+      return false;
+    }
+    Str = Input.take_front(Size);
+    Input = Input.drop_front(Size);
+    return true;
+  }
+
+  /// Read the number of following records, each at least one byte long.
+  bool readCount(uint32_t &Count) {
+    return read(Count) && Count <= Input.size();
+  }
+
+  [[nodiscard]] bool empty() const { return Input.empty(); }
+
+private:
+  llvm::StringRef Input;
+};
+
+/// \returns the number of operands of a constraint, or std::nullopt for n-ary
+///          constraints which store it
+std::optional<uint32_t> getNumOperands(Constraint::ConstraintKind Kind) {
+  using CK = Constraint::ConstraintKind;
+  switch (Kind) {
+  case CK::CK_NOT:
+  case CK::CK_NEG:
+    return 1;
+  case CK::CK_NARY_OR:
+  case CK::CK_NARY_AND:
+  case CK::CK_NARY_XOR:
+    return std::nullopt;
+  case CK::CK_INTEGER:
+  case CK::CK_FEATURE:
+    return 0;
+  default:
+    return 2;
+  }
+}
+
+} // namespace
+
+std::unique_ptr<FeatureModelBinaryParser>
+FeatureModelBinaryParser::fromFile(const llvm::Twine &Path) {
+  auto Buffer = readFile(Path);
+  if (!Buffer) {
+    return nullptr;
+  }
+  return std::make_unique<FeatureModelBinaryParser>(std::move(Buffer));
+}
+
+bool FeatureModelBinaryParser::isBinaryFeatureModel(llvm::StringRef Input) {
+  return Input.startswith(BinaryConstants::MAGIC);
+}
+
+std::unique_ptr<FeatureModel> FeatureModelBinaryParser::buildFeatureModel() {
+  FeatureModelBuilder FMB;
+  if (!decode(FMB)) {
+    return nullptr;
+  }
+  return FMB.buildFeatureModel();
+}
+
+bool FeatureModelBinaryParser::verifyFeatureModel() {
+  FeatureModelBuilder FMB;
+  return decode(FMB);
+}
+
+bool FeatureModelBinaryParser::decode(FeatureModelBuilder &FMB) {
+  using CK = Constraint::ConstraintKind;
+
+  llvm::StringRef Input = getInput();
+  if (!isBinaryFeatureModel(Input)) {
+    llvm::errs() << "error: Input is no binary feature model.\n";
+    return false;
+  }
+  BinaryReader R(Input.drop_front(sizeof(BinaryConstants::MAGIC) - 1));
+  auto Malformed = [](llvm::StringRef What) {
+    llvm::errs() << "error: Malformed " << What
+                 << " in binary feature model.\n";
+    return false;
+  };
+
+  uint32_t Version;
+  if (!R.read(Version) || Version != BinaryConstants::VERSION) {
+    llvm::errs() << "error: Unsupported binary feature model version.\n";
+    return false;
+  }
+
+  // Strings are referenced directly in the input until the builder copies
+  // them.
+  std::vector<llvm::StringRef> Strings;
+  uint32_t NumStrings;
+  if (!R.read(NumStrings) || NumStrings > getInput().size()) {
+    return Malformed("string table");
+  }
+  Strings.reserve(NumStrings);
+  for (uint32_t I = 0; I < NumStrings; ++I) {
+    uint32_t Size;
+    llvm::StringRef Str;
+    if (!R.read(Size) || !R.read(Str, Size)) {
+      return Malformed("string table");
+    }
+    Strings.push_back(Str);
+  }
+  auto ReadString = [&R, &Strings](std::string &Str) {
+    uint32_t Idx;
+    if (!R.read(Idx) || Idx >= Strings.size()) {
+      return false;
+    }
+    Str = Strings[Idx].str();
+    return true;
+  };
+
+  std::string Name;
+  std::string Path;
+  std::string Commit;
+  if (!ReadString(Name) || !ReadString(Path) || !ReadString(Commit)) {
+    return Malformed("header");
+  }
+  FMB.setVmName(std::move(Name));
+  FMB.setPath(Path);
+  FMB.setCommit(std::move(Commit));
+
+  uint32_t NumFeatures;
+  if (!R.readCount(NumFeatures) || NumFeatures == 0) {
+    return Malformed("feature list");
+  }
+  std::vector<std::string> FeatureNames(NumFeatures);
+  for (uint32_t I = 0; I < NumFeatures; ++I) {
+    uint8_t Tag;
+    uint8_t Opt;
+    uint32_t Parent;
+    std::string &FeatureName = FeatureNames[I];
+    // Parents are stored before their children, so the tree is acyclic.
+    if (!R.read(Tag) || !R.read(Opt) || !ReadString(FeatureName) ||
+        !R.read(Parent) || Parent > I ||
+        (I == 0) != (Parent == BinaryConstants::NO_PARENT)) {
+      return Malformed("feature");
+    }
+    auto Kind = BinaryConstants::getFeatureKind(Tag);
+    if (!Kind) {
+      return Malformed("feature");
+    }
+
+    NumericFeature::ValuesVariantType Values;
+    if (*Kind == Feature::FeatureKind::FK_NUMERIC) {
+      uint8_t ValuesKind;
+      if (!R.read(ValuesKind)) {
+        return Malformed("numeric feature");
+      }
+      if (ValuesKind == BinaryConstants::VALUES_RANGE) {
+        int32_t Min;
+        int32_t Max;
+        if (!R.read(Min) || !R.read(Max)) {
+          return Malformed("numeric feature");
+        }
+        Values = std::make_pair(Min, Max);
+      } else if (uint32_t NumValues;
+                 ValuesKind == BinaryConstants::VALUES_LIST &&
+                 R.readCount(NumValues)) {
+        std::vector<int> List(NumValues);
+        for (auto &Value : List) {
+          int32_t V;
+          if (!R.read(V)) {
+            return Malformed("numeric feature");
+          }
+          Value = V;
+        }
+        Values = std::move(List);
+      } else {
+        return Malformed("numeric feature");
+      }
+    }
+
+    uint32_t NumLocations;
+    if (!R.readCount(NumLocations)) {
+      return Malformed("feature locations");
+    }
+    std::vector<FeatureSourceRange> Locations;
+    Locations.reserve(NumLocations);
+    for (uint32_t L = 0; L < NumLocations; ++L) {
+      uint8_t Tag;
+      uint8_t Flags;
+      std::string LocationPath;
+      std::optional<FeatureSourceRange::Category> Category;
+      if (!R.read(Tag) || !R.read(Flags) || !ReadString(LocationPath) ||
+          !(Category = BinaryConstants::getCategory(Tag))) {
+        return Malformed("feature locations");
+      }
+      std::optional<FeatureSourceRange::FeatureSourceLocation> Bounds[2];
+      for (int B = 0; B < 2; ++B) {
+        int32_t Line;
+        int32_t Column;
+        if (!(Flags & (B == 0 ? BinaryConstants::LOCATION_START
+                              : BinaryConstants::LOCATION_END))) {
+          continue;
+        }
+        if (!R.read(Line) || !R.read(Column)) {
+          return Malformed("feature locations");
+        }
+        Bounds[B] = FeatureSourceRange::FeatureSourceLocation(Line, Column);
+      }
+      Locations.emplace_back(LocationPath, Bounds[0], Bounds[1], *Category);
+    }
+
+    Feature *F = nullptr;
+    switch (*Kind) {
+    case Feature::FeatureKind::FK_ROOT:
+      if (I == 0) {
+        F = FMB.makeFeature<RootFeature>(FeatureName);
+        FMB.setRootName(FeatureName);
+      }
+      break;
+    case Feature::FeatureKind::FK_BINARY:
+      F = FMB.makeFeature<BinaryFeature>(FeatureName, Opt != 0,
+                                         std::move(Locations));
+      break;
+    case Feature::FeatureKind::FK_NUMERIC:
+      F = FMB.makeFeature<NumericFeature>(FeatureName, std::move(Values),
+                                          Opt != 0, std::move(Locations));
+      break;
+    case Feature::FeatureKind::FK_UNKNOWN:
+      F = FMB.makeFeature<Feature>(FeatureName);
+      break;
+    }
+    if (!F) {
+      return Malformed("feature");
+    }
+    if (Parent != BinaryConstants::NO_PARENT) {
+      FMB.addEdge(FeatureNames[Parent - 1], FeatureName);
+    }
+  }
+
+  uint32_t NumRelationships;
+  if (!R.readCount(NumRelationships)) {
+    return Malformed("relationship list");
+  }
+  for (uint32_t I = 0; I < NumRelationships; ++I) {
+    uint8_t Tag;
+    uint32_t Parent;
+    uint32_t NumChildren;
+    std::optional<Relationship::RelationshipKind> Kind;
+    if (!R.read(Tag) || !(Kind = BinaryConstants::getRelationshipKind(Tag)) ||
+        !R.read(Parent) || Parent >= NumFeatures || !R.readCount(NumChildren)) {
+      return Malformed("relationship");
+    }
+    std::vector<std::string> Children;
+    for (uint32_t C = 0; C < NumChildren; ++C) {
+      uint32_t Child;
+      if (!R.read(Child) || Child >= NumFeatures) {
+        return Malformed("relationship");
+      }
+      Children.push_back(FeatureNames[Child]);
+    }
+    FMB.emplaceRelationship(*Kind, Children, FeatureNames[Parent]);
+  }
+
+  // Constraints are stored in pre-order, so every node is completed as soon
+  // as its last operand was read.
+  struct Frame {
+    CK Kind;
+    uint32_t NumOperands;
+    NaryConstraint::OperandContainerTy Operands;
+  };
+  uint32_t NumConstraints;
+  if (!R.readCount(NumConstraints)) {
+    return Malformed("constraint list");
+  }
+  for (uint32_t I = 0; I < NumConstraints; ++I) {
+    std::vector<Frame> Stack;
+    std::unique_ptr<Constraint> Done;
+    do {
+      uint8_t Tag;
+      if (!R.read(Tag)) {
+        return Malformed("constraint");
+      }
+      auto Decoded = BinaryConstants::getConstraintKind(Tag);
+      if (!Decoded) {
+        return Malformed("constraint");
+      }
+      CK Kind = *Decoded;
+      std::unique_ptr<Constraint> Node;
+      if (Kind == CK::CK_FEATURE) {
+        std::string FeatureName;
+        if (!ReadString(FeatureName)) {
+          return Malformed("constraint");
+        }
+        Node = std::make_unique<PrimaryFeatureConstraint>(
+            std::make_unique<Feature>(std::move(FeatureName)));
+      } else if (Kind == CK::CK_INTEGER) {
+        int32_t Value;
+        if (!R.read(Value)) {
+          return Malformed("constraint");
+        }
+        Node = std::make_unique<PrimaryIntegerConstraint>(Value);
+      } else {
+        uint32_t NumOperands;
+        if (auto Fixed = getNumOperands(Kind); Fixed) {
+          NumOperands = *Fixed;
+        } else if (!R.readCount(NumOperands) || NumOperands == 0) {
+          return Malformed("constraint");
+        }
+        Stack.push_back({Kind, NumOperands, {}});
+      }
+
+      while (Node || (!Stack.empty() && Stack.back().Operands.size() ==
+                                            Stack.back().NumOperands)) {
+        if (!Node) {
+          auto Top = std::move(Stack.back());
+          Stack.pop_back();
+          auto Fixed = getNumOperands(Top.Kind);
+          if (!Fixed) {
+            Node = NaryConstraint::create(Top.Kind, std::move(Top.Operands));
+          } else if (*Fixed == 1) {
+            Node = UnaryConstraint::create(Top.Kind,
+                                           std::move(Top.Operands[0]));
+          } else {
+            Node = BinaryConstraint::create(Top.Kind,
+                                            std::move(Top.Operands[0]),
+                                            std::move(Top.Operands[1]));
+          }
+          if (!Node) {
+            return Malformed("constraint");
+          }
+        }
+        if (Stack.empty()) {
+          Done = std::move(Node);
+          break;
+        }
+        Stack.back().Operands.push_back(std::move(Node));
+      }
+    } while (!Done);
+    FMB.addConstraint(std::move(Done));
+  }
+
+  if (!R.empty()) {
+    return Malformed("trailer");
+  }
+  return true;
+}
+
+//===----------------------------------------------------------------------===//
+//                          Batch Loading
+//===----------------------------------------------------------------------===//
+
+std::vector<LoadedFeatureModel>
+loadFeatureModels(llvm::ArrayRef<std::string> Paths, unsigned Threads) {
+  std::vector<LoadedFeatureModel> Models(Paths.size());
+
+  // Global initialization of libxml2 is not thread-safe in all versions.
+  xmlInitParser();
+
+  // Workers claim files one at a time, which balances models of different
+  // sizes, and write their results to the slot of the file.
+  std::atomic<size_t> Next{0};
+  auto Worker = [&Paths, &Models, &Next]() {
+    for (size_t I = Next++; I < Paths.size(); I = Next++) {
+      auto Buffer = mapFile(Paths[I]);
+      if (!Buffer) {
+        Models[I].Error = Buffer.getError();
+        continue;
+      }
+      Models[I].FM =
+          FeatureModelXmlParser(std::move(Buffer.get())).buildFeatureModel();
+      if (!Models[I].FM) {
+        Models[I].Error = std::make_error_code(std::errc::invalid_argument);
+      }
+    }
+  };
+
+  if (Threads == 0) {
+    Threads = std::max(std::thread::hardware_concurrency(), 1U);
+  }
+  Threads = static_cast<unsigned>(std::min<size_t>(Threads, Paths.size()));
+  std::vector<std::thread> Workers;
+  Workers.reserve(Threads);
+  for (unsigned I = 1; I < Threads; ++I) {
+    Workers.emplace_back(Worker);
+  }
+  Worker();
+  for (auto &T : Workers) {
+    T.join();
+  }
+  return Models;
+}
+
 } // namespace vara::feature
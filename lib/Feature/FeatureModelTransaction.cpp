@@ -1,6 +1,11 @@
 #include "vara/Feature/FeatureModelTransaction.h"
 
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/ADT/StringMap.h"
+
 #include <iostream>
+#include <set>
+#include <tuple>
 
 namespace vara::feature {
 
@@ -11,4 +16,240 @@ void addFeature(FeatureModel &FM, std::unique_ptr<Feature> NewFeature,
   Trans.commit();
 }
 
+namespace {
+
+/// Identifies a Relationship by its parent Feature, its kind, and the names of
+/// its child Features.
+using RelationshipKey =
+    std::tuple<std::string, Relationship::RelationshipKind,
+               std::set<std::string>>;
+
+RelationshipKey makeKey(Feature &Parent, Relationship &R) {
+  std::set<std::string> Children;
+  for (auto *Child : R.children()) {
+    if (auto *F = llvm::dyn_cast<Feature>(Child); F) {
+      Children.insert(F->getName().str());
+    }
+  }
+  return {Parent.getName().str(), R.getKind(), std::move(Children)};
+}
+
+std::vector<std::pair<RelationshipKey, Relationship *>>
+collectRelationships(FeatureModel &FM) {
+  std::vector<std::pair<RelationshipKey, Relationship *>> Relationships;
+  for (auto *F : FM.features()) {
+    // Only direct children, getChildren would also find nested groups.
+    for (auto *Child : F->children()) {
+      if (auto *R = llvm::dyn_cast<Relationship>(Child); R) {
+        Relationships.emplace_back(makeKey(*F, *R), R);
+      }
+    }
+  }
+  return Relationships;
+}
+
+/// Constraints are matched by their kind and textual representation, as
+/// excludes and implications of negations are printed alike.
+using ConstraintKey = std::pair<Constraint::ConstraintKind, std::string>;
+
+ConstraintKey makeKey(const Constraint &C) {
+  return {C.getKind(), C.toString()};
+}
+
+std::string parentName(Feature &F) {
+  auto *Parent = F.getParentFeature();
+  return Parent ? Parent->getName().str() : "";
+}
+
+std::unique_ptr<Feature> copyFeature(Feature &F) {
+  std::vector<FeatureSourceRange> Locations(F.getLocationsBegin(),
+                                            F.getLocationsEnd());
+  switch (F.getKind()) {
+  case Feature::FeatureKind::FK_BINARY:
+    return std::make_unique<BinaryFeature>(F.getName().str(), F.isOptional(),
+                                           std::move(Locations));
+  case Feature::FeatureKind::FK_NUMERIC:
+    return std::make_unique<NumericFeature>(
+        F.getName().str(), llvm::cast<NumericFeature>(F).getValues(),
+        F.isOptional(), std::move(Locations));
+  case Feature::FeatureKind::FK_ROOT:
+    return std::make_unique<RootFeature>(F.getName().str());
+  case Feature::FeatureKind::FK_UNKNOWN:
+    break;
+  }
+  return std::make_unique<Feature>(F.getName().str());
+}
+
+} // namespace
+
+bool updateFeatureModel(FeatureModel &FM, FeatureModel &Target) {
+  if (!FM.getRoot() || !Target.getRoot() ||
+      FM.getRoot()->getName() != Target.getRoot()->getName() ||
+      FM.getRoot()->getKind() != Target.getRoot()->getKind()) {
+    return false;
+  }
+
+  // Features whose kind changed cannot be updated in place and are replaced.
+  llvm::SmallPtrSet<Feature *, 8> Replaced;
+  std::vector<Feature *> Removed;
+  for (auto *F : FM.features()) {
+    auto *T = Target.getFeature(F->getName());
+    if (!T) {
+      Removed.push_back(F);
+    } else if (T->getKind() != F->getKind()) {
+      Replaced.insert(F);
+    }
+  }
+
+  auto Trans = FeatureModelModifyTransaction::openTransaction(FM);
+
+  // Keep constraints that are still part of the target, each one at most as
+  // often as it appears there.
+  llvm::SmallPtrSet<Constraint *, 8> Stale;
+  for (auto *F : Replaced) {
+    for (const auto &O : FM.getOccurrences(*F)) {
+      Stale.insert(O.C);
+    }
+  }
+  std::multiset<ConstraintKey> Missing;
+  for (const auto &C : Target.constraints()) {
+    Missing.insert(makeKey(*C));
+  }
+  for (const auto &C : FM.constraints()) {
+    auto Search = Missing.find(makeKey(*C));
+    if (!Stale.count(C.get()) && Search != Missing.end()) {
+      Missing.erase(Search);
+    } else {
+      Trans.removeConstraint(C.get());
+    }
+  }
+
+  // Dissolve groups that changed, the remaining ones move with their parent.
+  // Groups of replaced features are added again with the replacements.
+  auto Groups = collectRelationships(Target);
+  std::set<RelationshipKey> Kept;
+  auto HasReplacedChild = [&Replaced](Relationship &R) {
+    return llvm::any_of(R.children(), [&Replaced](FeatureTreeNode *Child) {
+      auto *F = llvm::dyn_cast<Feature>(Child);
+      return F && Replaced.count(F);
+    });
+  };
+  for (auto &[Key, R] : collectRelationships(FM)) {
+    auto Search = std::find_if(Groups.begin(), Groups.end(),
+                               [&Key = Key](const auto &G) {
+                                 return G.first == Key;
+                               });
+    if (Search == Groups.end() ||
+        Replaced.count(FM.getFeature(std::get<0>(Key))) ||
+        HasReplacedChild(*R)) {
+      Trans.removeRelationship(R);
+    } else {
+      Kept.insert(Key);
+      Groups.erase(Search);
+    }
+  }
+
+  for (auto *F : Replaced) {
+    for (auto *Child : FM.features()) {
+      if (Child->getParentFeature() == F) {
+        Trans.setParent(Child, FM.getRoot());
+      }
+    }
+    Trans.removeFeature(F);
+  }
+
+  // Resolve features by name to their state after the update.
+  llvm::StringMap<Feature *> Resolved;
+  for (auto *F : FM.features()) {
+    if (!Replaced.count(F)) {
+      Resolved[F->getName()] = F;
+    }
+  }
+  for (auto *T : Target.features()) {
+    if (Resolved.count(T->getName())) {
+      continue;
+    }
+    auto NewFeature = copyFeature(*T);
+    Resolved[T->getName()] = NewFeature.get();
+    Trans.addFeature(std::move(NewFeature),
+                     Resolved.lookup(parentName(*T)));
+  }
+
+  for (auto *F : FM.features()) {
+    auto *T = Target.getFeature(F->getName());
+    if (T && !Replaced.count(F) && T != Target.getRoot() &&
+        (parentName(*F) != parentName(*T) ||
+         Replaced.count(F->getParentFeature()))) {
+      Trans.setParent(F, Resolved.lookup(parentName(*T)));
+    }
+  }
+
+  // Children are removed before their parents.
+  for (auto *F : llvm::reverse(Removed)) {
+    Trans.removeFeature(F);
+  }
+
+  for (auto &[Key, R] : Groups) {
+    std::vector<Feature *> Children;
+    for (const auto &Name : std::get<2>(Key)) {
+      Children.push_back(Resolved.lookup(Name));
+    }
+    Trans.addRelationship(R->getKind(), Resolved.lookup(std::get<0>(Key)),
+                          std::move(Children));
+  }
+
+  for (auto *F : FM.features()) {
+    auto *T = Target.getFeature(F->getName());
+    if (!T || Replaced.count(F)) {
+      continue;
+    }
+    if (F->isOptional() != T->isOptional()) {
+      Trans.setOptional(F, T->isOptional());
+    }
+    if (auto *N = llvm::dyn_cast<NumericFeature>(F); N) {
+      auto Values = llvm::cast<NumericFeature>(T)->getValues();
+      if (N->getValues() != Values) {
+        Trans.setValues(N, std::move(Values));
+      }
+    }
+    if (!std::equal(F->getLocationsBegin(), F->getLocationsEnd(),
+                    T->getLocationsBegin(), T->getLocationsEnd())) {
+      Trans.setLocations(F, std::vector<FeatureSourceRange>(
+                                T->getLocationsBegin(), T->getLocationsEnd()));
+    }
+  }
+
+  for (const auto &C : Target.constraints()) {
+    if (auto Search = Missing.find(makeKey(*C)); Search != Missing.end()) {
+      Missing.erase(Search);
+      Trans.addConstraint(C->clone());
+    }
+  }
+
+  return Trans.commit();
+}
+
+bool FeatureModelHistory::undo() {
+  if (Done.empty()) {
+    return false;
+  }
+  auto Step = std::move(Done.back());
+  Done.pop_back();
+  detail::FeatureModelModification::undoAll(FM, Step);
+  Undone.push_back(std::move(Step));
+  return true;
+}
+
+bool FeatureModelHistory::redo() {
+  if (Undone.empty()) {
+    return false;
+  }
+  if (!detail::FeatureModelModification::execAll(FM, Undone.back())) {
+    return false;
+  }
+  Done.push_back(std::move(Undone.back()));
+  Undone.pop_back();
+  return true;
+}
+
 } // namespace vara::feature
@@ -1,419 +1,1125 @@
 #include "vara/Feature/FeatureModelWriter.h"
+#include "vara/Feature/ConstraintNormalizer.h"
 #include "vara/Feature/FeatureModel.h"
 
+#include <llvm/ADT/ArrayRef.h>
+#include <llvm/ADT/DenseMap.h>
+#include <llvm/ADT/STLExtras.h>
+#include <llvm/ADT/SmallString.h>
+#include <llvm/ADT/SmallVector.h>
+#include <llvm/ADT/StringMap.h>
 #include <llvm/Support/Casting.h>
+#include <llvm/Support/EndianStream.h>
+#include <llvm/Support/ErrorHandling.h>
 
+#include "BinaryConstants.h"
 #include "XmlConstants.h"
 
-#include "libxml/xmlwriter.h"
-
-#define CHECK_RC                                                               \
-  if (RC < 0) {                                                                \
-    return RC;                                                                 \
-  }
+#include <optional>
+#include <vector>
 
 namespace vara::feature {
 
-const unsigned char *charToUChar(const char *CP) {
-  return (const unsigned char *)CP;
+namespace {
+
+/// Check whether writing a model to the file stream \p OS succeeded.
+///
+/// \returns 0 on success, a negative value if writing failed
+int checkFileStream(int RC, llvm::raw_fd_ostream &OS) {
+  OS.flush();
+  return RC < 0 || OS.has_error() ? -1 : RC;
 }
 
-static constexpr xmlChar INDENTATIONSTRING[] = "  ";
-static constexpr char ENCODING[] = "UTF-8";
+} // namespace
 
-int FeatureModelXmlWriter::writeFeatureModel(std::string Path) {
-  int RC;
-  std::unique_ptr<xmlTextWriter, void (*)(xmlTextWriterPtr)> Writer(
-      xmlNewTextWriterFilename(Path.data(), 0), &xmlFreeTextWriter);
-  if (!Writer) {
-    return false;
+//===----------------------------------------------------------------------===//
+//                          FeatureModelXmlWriter
+//===----------------------------------------------------------------------===//
+
+namespace detail {
+
+/// Writes indented xml directly to an output stream. Elements without content
+/// are closed as empty elements, like libxml2 does.
+class XmlStreamWriter {
+public:
+  explicit XmlStreamWriter(llvm::raw_ostream &OS) : OS(OS) {}
+
+  void startDocument(llvm::StringRef Root, llvm::StringRef SystemId) {
+    OS << "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n";
+    OS << "<!DOCTYPE " << Root << " SYSTEM \"" << SystemId << "\">\n";
   }
 
-  RC = writeFeatureModel(Writer.get());
-  return RC;
-}
+  void startElement(const xmlChar *Name) {
+    closeStartTag();
+    indent();
+    OS << '<' << str(Name);
+    Elements.push_back(Name);
+    StartTagOpen = true;
+  }
 
-std::optional<std::string> FeatureModelXmlWriter::writeFeatureModel() {
-  int RC;
+  void writeAttribute(const xmlChar *Name, llvm::StringRef Value) {
+    assert(StartTagOpen && "Attributes must follow the start tag.");
+    OS << ' ' << str(Name) << "=\"";
+    escape(Value, true);
+    OS << '"';
+  }
 
-  std::unique_ptr<xmlDocPtr, void (*)(xmlDocPtr *)> DocPtrPtr(
-      new xmlDocPtr{nullptr}, [](xmlDocPtr *Ptr) {
-        if (*Ptr) {
-          xmlFreeDoc(*Ptr);
-        }
-        delete (Ptr);
-      });
+  void writeAttribute(const xmlChar *Name, const xmlChar *Value) {
+    writeAttribute(Name, str(Value));
+  }
 
-  std::unique_ptr<xmlTextWriter, void (*)(xmlTextWriterPtr)> Writer(
-      xmlNewTextWriterDoc(DocPtrPtr.get(), 0), &xmlFreeTextWriter);
-  if (!Writer) {
-    return std::nullopt;
+  /// Write an element with text content.
+  void writeElement(const xmlChar *Name, llvm::StringRef Text) {
+    closeStartTag();
+    indent();
+    OS << '<' << str(Name) << '>';
+    escape(Text, false);
+    OS << "</" << str(Name) << ">\n";
   }
-  RC = writeFeatureModel(Writer.get());
-  if (RC < 0) {
-    return std::nullopt;
+
+  void writeElement(const xmlChar *Name, int Value) {
+    closeStartTag();
+    indent();
+    OS << '<' << str(Name) << '>' << Value << "</" << str(Name) << ">\n";
+  }
+
+  void endElement() {
+    assert(!Elements.empty() && "No open element.");
+    const auto *Name = Elements.pop_back_val();
+    if (StartTagOpen) {
+      OS << "/>\n";
+      StartTagOpen = false;
+      return;
+    }
+    indent();
+    OS << "</" << str(Name) << ">\n";
+  }
+
+  void endDocument() {
+    while (!Elements.empty()) {
+      endElement();
+    }
+  }
+
+private:
+  static llvm::StringRef str(const xmlChar *S) {
+    return reinterpret_cast<const char *>(S);
+  }
+
+  void closeStartTag() {
+    if (StartTagOpen) {
+      OS << ">\n";
+      StartTagOpen = false;
+    }
+  }
+
+  void indent() { OS.indent(2 * Elements.size()); }
+
+  void escape(llvm::StringRef S, bool Attribute) {
+    // Write unescaped runs in one go.
+    size_t Run = 0;
+    for (size_t I = 0; I < S.size(); ++I) {
+      const char *Entity = nullptr;
+      switch (S[I]) {
+      case '&':
+        Entity = "&amp;";
+        break;
+      case '<':
+        Entity = "&lt;";
+        break;
+      case '>':
+        Entity = "&gt;";
+        break;
+      case '\r':
+        Entity = "&#13;";
+        break;
+      case '"':
+        Entity = "&quot;";
+        break;
+      case '\n':
+        Entity = Attribute ? "&#10;" : nullptr;
+        break;
+      case '\t':
+        Entity = Attribute ? "&#9;" : nullptr;
+        break;
+      default:
+        break;
+      }
+      if (Entity) {
+        OS << S.slice(Run, I) << Entity;
+        Run = I + 1;
+      }
+    }
+    OS << S.substr(Run);
   }
 
-  std::unique_ptr<xmlChar *, void (*)(xmlChar **)> XmlBuffPtr(
-      new xmlChar *{nullptr}, [](xmlChar **Ptr) {
-        if (*Ptr) {
-          xmlFree(*Ptr);
+  llvm::raw_ostream &OS;
+  llvm::SmallVector<const xmlChar *, 8> Elements;
+  bool StartTagOpen{false};
+};
+
+/// Children, implied and excluded options of all features of a model.
+///
+/// Features are identified by their position in the DFS order of the model,
+/// which is also the order in which the writer emits them. Every list is
+/// filled by a single sweep over the features in that order, so all lists
+/// come out sorted without comparing any features.
+class XmlFeatureIndex {
+public:
+  explicit XmlFeatureIndex(const FeatureModel &Fm) {
+    for (Feature *F : Fm.features()) {
+      Ids.try_emplace(F, Features.size());
+      Features.push_back(F);
+    }
+    Children.resize(Features.size());
+    Implications.resize(Features.size());
+    Excludes.resize(Features.size());
+    GroupOf.resize(Features.size(), NoGroup);
+
+    // Bucket every implication and exclusion by its target first, so that
+    // sweeping the targets in order appends them sorted to their sources.
+    std::vector<llvm::SmallVector<unsigned, 2>> ImpliedBy(Features.size());
+    std::vector<llvm::SmallVector<unsigned, 2>> ExcludedBy(Features.size());
+    llvm::DenseMap<const FeatureTreeNode *, unsigned> GroupIds;
+
+    for (unsigned Id = 0; Id < Features.size(); ++Id) {
+      Feature *F = Features[Id];
+      for (const auto *C : F->implications()) {
+        if (auto Target = getTarget(*F, *C)) {
+          ImpliedBy[*Target].push_back(Id);
+        }
+      }
+      for (const auto *C : F->excludes()) {
+        if (auto Target = getTarget(*F, *C)) {
+          ExcludedBy[*Target].push_back(Id);
         }
-        delete (Ptr);
-      });
-  int Buffersize;
-  xmlDocDumpMemoryEnc(*DocPtrPtr, XmlBuffPtr.get(), &Buffersize, ENCODING);
-  std::string Str(reinterpret_cast<char *>(*XmlBuffPtr), Buffersize);
+      }
 
-  return Str;
-}
+      if (auto Parent = getId(F->getParentFeature())) {
+        Children[*Parent].push_back(Id);
+      }
+      if (auto *R = llvm::dyn_cast_or_null<Relationship>(F->getParent())) {
+        auto [It, Inserted] = GroupIds.try_emplace(R, Groups.size());
+        if (Inserted) {
+          Groups.emplace_back();
+        }
+        Groups[It->second].push_back(Id);
+        GroupOf[Id] = It->second;
+      }
+    }
 
-int FeatureModelXmlWriter::writeFeatureModel(xmlTextWriterPtr Writer) {
-  int RC;
+    for (unsigned Id = 0; Id < Features.size(); ++Id) {
+      for (unsigned Source : ImpliedBy[Id]) {
+        Implications[Source].push_back(Id);
+      }
+      for (unsigned Source : ExcludedBy[Id]) {
+        Excludes[Source].push_back(Id);
+      }
+    }
+  }
 
-  RC = xmlTextWriterSetIndent(Writer, 1);
-  CHECK_RC
-  RC = xmlTextWriterSetIndentString(Writer, INDENTATIONSTRING);
-  CHECK_RC
+  [[nodiscard]] unsigned size() const { return Features.size(); }
 
-  RC = xmlTextWriterStartDocument(Writer, "1.0", ENCODING, nullptr);
-  CHECK_RC
-  RC = xmlTextWriterWriteDTD(Writer, charToUChar("vm"), nullptr,
-                             charToUChar("vm.dtd"), nullptr);
-  CHECK_RC
-  RC = writeVm(Writer);
+  [[nodiscard]] Feature *getFeature(unsigned Id) const { return Features[Id]; }
+
+  [[nodiscard]] llvm::ArrayRef<unsigned> getChildren(unsigned Id) const {
+    return Children[Id];
+  }
+
+  [[nodiscard]] llvm::ArrayRef<unsigned> getImplications(unsigned Id) const {
+    return Implications[Id];
+  }
 
+  /// Excluded options given by constraints, without group siblings.
+  [[nodiscard]] llvm::ArrayRef<unsigned> getExcludes(unsigned Id) const {
+    return Excludes[Id];
+  }
+
+  /// All members of the group of a feature, including the feature itself.
+  [[nodiscard]] llvm::ArrayRef<unsigned> getGroup(unsigned Id) const {
+    if (GroupOf[Id] == NoGroup) {
+      return {};
+    }
+    return Groups[GroupOf[Id]];
+  }
+
+private:
+  static constexpr unsigned NoGroup = ~0U;
+
+  [[nodiscard]] std::optional<unsigned> getId(const Feature *F) const {
+    if (auto It = Ids.find(F); It != Ids.end()) {
+      return It->second;
+    }
+    return std::nullopt;
+  }
+
+  /// Feature on the right of a binary constraint whose left operand is \p F.
+  [[nodiscard]] std::optional<unsigned>
+  getTarget(const Feature &F, const BinaryConstraint &C) const {
+    const auto *LHS =
+        llvm::dyn_cast<PrimaryFeatureConstraint>(C.getLeftOperand());
+    const auto *RHS =
+        llvm::dyn_cast<PrimaryFeatureConstraint>(C.getRightOperand());
+    if (!LHS || !RHS || !LHS->getFeature() ||
+        LHS->getFeature()->getName() != F.getName()) {
+      return std::nullopt;
+    }
+    return getId(RHS->getFeature());
+  }
+
+  std::vector<Feature *> Features;
+  llvm::DenseMap<const Feature *, unsigned> Ids;
+  std::vector<llvm::SmallVector<unsigned, 4>> Children;
+  std::vector<llvm::SmallVector<unsigned, 1>> Implications;
+  std::vector<llvm::SmallVector<unsigned, 1>> Excludes;
+  std::vector<llvm::SmallVector<unsigned, 4>> Groups;
+  std::vector<unsigned> GroupOf;
+};
+
+} // namespace detail
+
+int FeatureModelXmlWriter::writeFeatureModel(std::string Path) {
+  std::error_code EC;
+  llvm::raw_fd_ostream OS(Path, EC);
+  if (EC) {
+    return -1;
+  }
+  int RC = writeFeatureModel(OS);
+  OS.close();
+  if (OS.has_error()) {
+    OS.clear_error();
+    return -1;
+  }
   return RC;
 }
 
-int FeatureModelXmlWriter::writeVm(xmlTextWriterPtr Writer) {
-  int RC;
+std::optional<std::string> FeatureModelXmlWriter::writeFeatureModel() {
+  std::string Str;
+  llvm::raw_string_ostream OS(Str);
+  if (writeFeatureModel(OS) < 0) {
+    return std::nullopt;
+  }
+  return OS.str();
+}
+
+int FeatureModelXmlWriter::writeFeatureModel(llvm::raw_fd_ostream &OS) {
+  int RC = writeFeatureModel(static_cast<llvm::raw_ostream &>(OS));
+  return checkFileStream(RC, OS);
+}
 
-  RC = xmlTextWriterStartElement(Writer, XmlConstants::VM);
-  CHECK_RC
-  RC = xmlTextWriterWriteAttribute(Writer, XmlConstants::NAME,
-                                   charToUChar(Fm.getName().data()));
-  CHECK_RC
-  RC = xmlTextWriterWriteAttribute(Writer, XmlConstants::ROOT,
-                                   charToUChar(Fm.getPath().string().data()));
-  CHECK_RC
+int FeatureModelXmlWriter::writeFeatureModel(llvm::raw_ostream &OS) {
+  detail::XmlStreamWriter Writer(OS);
+  Writer.startDocument("vm", "vm.dtd");
+  writeVm(Writer);
+  Writer.endDocument();
 
-  RC = writeBinaryFeatures(Writer);
-  CHECK_RC
+  OS.flush();
+  return 0;
+}
 
-  RC = writeNumericFeatures(Writer);
-  CHECK_RC
+void FeatureModelXmlWriter::writeVm(detail::XmlStreamWriter &Writer) {
+  Writer.startElement(XmlConstants::VM);
+  Writer.writeAttribute(XmlConstants::NAME, Fm.getName());
+  Writer.writeAttribute(XmlConstants::ROOT, Fm.getPath().string());
 
-  RC = writeBooleanConstraints(Writer);
-  CHECK_RC
+  detail::XmlFeatureIndex Index(Fm);
+  writeBinaryFeatures(Writer, Index);
+  writeNumericFeatures(Writer, Index);
+  writeBooleanConstraints(Writer);
 
   // TODO mixed and nonNumeric constraints when supported
 
-  RC = xmlTextWriterEndDocument(Writer); // VM
-  return RC;
+  Writer.endElement(); // VM
 }
 
-int FeatureModelXmlWriter::writeBinaryFeatures(xmlTextWriterPtr Writer) {
-  int RC;
-
-  RC = xmlTextWriterStartElement(Writer, XmlConstants::BINARYOPTIONS);
-  CHECK_RC
+void FeatureModelXmlWriter::writeBinaryFeatures(
+    detail::XmlStreamWriter &Writer, const detail::XmlFeatureIndex &Index) {
+  Writer.startElement(XmlConstants::BINARYOPTIONS);
 
-  for (Feature *F : Fm.features()) {
+  for (unsigned Id = 0; Id < Index.size(); ++Id) {
+    Feature *F = Index.getFeature(Id);
     if (llvm::isa<RootFeature>(F) || llvm::isa<BinaryFeature>(F)) {
-      RC = writeFeature(Writer, *F);
-      CHECK_RC
+      writeFeature(Writer, Index, Id);
     }
   }
 
-  RC = xmlTextWriterEndElement(Writer); // BINARYOPTIONS
-  return RC;
+  Writer.endElement(); // BINARYOPTIONS
 }
 
-int FeatureModelXmlWriter::writeNumericFeatures(xmlTextWriterPtr Writer) {
-  int RC;
-
-  RC = xmlTextWriterStartElement(Writer, XmlConstants::NUMERICOPTIONS);
-  CHECK_RC
+void FeatureModelXmlWriter::writeNumericFeatures(
+    detail::XmlStreamWriter &Writer, const detail::XmlFeatureIndex &Index) {
+  Writer.startElement(XmlConstants::NUMERICOPTIONS);
 
-  for (auto *F : Fm.features()) {
-    if (llvm::isa<NumericFeature>(F)) {
-      RC = writeFeature(Writer, *F);
-      CHECK_RC
+  for (unsigned Id = 0; Id < Index.size(); ++Id) {
+    if (llvm::isa<NumericFeature>(Index.getFeature(Id))) {
+      writeFeature(Writer, Index, Id);
     }
   }
 
-  RC = xmlTextWriterEndElement(Writer); // NUMERICOPTIONS
-  return RC;
+  Writer.endElement(); // NUMERICOPTIONS
 }
 
-int FeatureModelXmlWriter::writeBooleanConstraints( // NOLINT
-    xmlTextWriterPtr Writer) {                      // NOLINT
-  int RC;
-
-  RC = xmlTextWriterStartElement(Writer, XmlConstants::BOOLEANCONSTRAINTS);
-  CHECK_RC
-
-  // collect alternative groups
-  struct FeatureCompare {
-    bool operator()(Feature *F1, Feature *F2) const { return *F1 < *F2; }
-  };
-  std::set<std::set<Feature *, FeatureCompare>> AltGroups;
-  //  for (auto *F : Fm.features()) {
-  //    // skip empty groups
-  //    if (F->alternatives().begin() == F->alternatives().end()) {
-  //      continue;
-  //    }
-  //    std::set<Feature *, FeatureCompare> AltGroup(F->alternatives_begin(),
-  //                                                 F->alternatives_end());
-  //    AltGroup.insert(F);
-  //    AltGroups.insert(std::move(AltGroup));
-  //  }
-
-  for (const auto &Group : AltGroups) {
-    RC = xmlTextWriterStartElement(Writer, XmlConstants::CONSTRAINT);
-    CHECK_RC
-
-    auto F = Group.begin();
-    RC = xmlTextWriterWriteString(Writer, charToUChar((*F)->getName().data()));
-    CHECK_RC
-    ++F;
-    for (; F != Group.end(); ++F) {
-      RC = xmlTextWriterWriteString(Writer, charToUChar(" | "));
-      CHECK_RC
-      RC =
-          xmlTextWriterWriteString(Writer, charToUChar((*F)->getName().data()));
-      CHECK_RC
-    }
-
-    RC = xmlTextWriterEndElement(Writer); // CONSTRAINT
-    CHECK_RC
-  }
+void FeatureModelXmlWriter::writeBooleanConstraints( // NOLINT
+    detail::XmlStreamWriter &Writer) {               // NOLINT
+  Writer.startElement(XmlConstants::BOOLEANCONSTRAINTS);
 
   // TODO(se-passau/VaRA#664): write other boolean constraints if they are
   //  parsed
 
-  RC = xmlTextWriterEndElement(Writer); // BOOLEANCONSTRAINT
-  return RC;
+  Writer.endElement(); // BOOLEANCONSTRAINT
 }
 
-int FeatureModelXmlWriter::writeFeature(xmlTextWriterPtr Writer,
-                                        Feature &Feature1) {
-  int RC;
+void FeatureModelXmlWriter::writeFeature(detail::XmlStreamWriter &Writer,
+                                         const detail::XmlFeatureIndex &Index,
+                                         unsigned Id) {
+  Feature &Feature1 = *Index.getFeature(Id);
+  Writer.startElement(XmlConstants::CONFIGURATIONOPTION);
 
-  RC = xmlTextWriterStartElement(Writer, XmlConstants::CONFIGURATIONOPTION);
-  CHECK_RC
-
-  RC = xmlTextWriterWriteElement(Writer, XmlConstants::NAME,
-                                 charToUChar(Feature1.getName().data()));
-  CHECK_RC
+  Writer.writeElement(XmlConstants::NAME, Feature1.getName());
 
   // parent
   if (Feature1.getParentFeature()) {
-    RC = xmlTextWriterWriteElement(
-        Writer, XmlConstants::PARENT,
-        charToUChar(Feature1.getParentFeature()->getName().data()));
-    CHECK_RC
+    Writer.writeElement(XmlConstants::PARENT,
+                        Feature1.getParentFeature()->getName());
   }
 
   // children
-  auto FS = Feature1.getChildren<Feature>();
-  auto Children = OrderedFeatureVector(FS.begin(), FS.end());
-
-  if (!Children.empty()) {
-    RC = xmlTextWriterStartElement(Writer, XmlConstants::CHILDREN);
-    CHECK_RC
-
-    for (Feature *F : Children) {
-      RC = xmlTextWriterWriteElement(Writer, XmlConstants::OPTIONS,
-                                     charToUChar(F->getName().data()));
-      CHECK_RC
+  if (!Index.getChildren(Id).empty()) {
+    Writer.startElement(XmlConstants::CHILDREN);
+    for (unsigned C : Index.getChildren(Id)) {
+      Writer.writeElement(XmlConstants::OPTIONS,
+                          Index.getFeature(C)->getName());
     }
-
-    RC = xmlTextWriterEndElement(Writer); // CHILDREN
-    CHECK_RC
+    Writer.endElement(); // CHILDREN
   }
 
   // implications
-  OrderedFeatureVector Implications;
-
-  for (const auto *C : Feature1.implications()) {
-    if (const auto *LHS =
-            llvm::dyn_cast<PrimaryFeatureConstraint>(C->getLeftOperand());
-        LHS) {
-      if (const auto *RHS =
-              llvm::dyn_cast<PrimaryFeatureConstraint>(C->getRightOperand());
-          RHS) {
-        if (LHS->getFeature() &&
-            LHS->getFeature()->getName() == Feature1.getName() &&
-            RHS->getFeature()) {
-          Implications.insert(RHS->getFeature());
+  if (!Index.getImplications(Id).empty()) {
+    Writer.startElement(XmlConstants::IMPLIEDOPTIONS);
+    for (unsigned I : Index.getImplications(Id)) {
+      Writer.writeElement(XmlConstants::OPTIONS,
+                          Index.getFeature(I)->getName());
+    }
+    Writer.endElement(); // IMPLIEDOPTIONS
+  }
+
+  // excludes, merging group siblings and excluded features, both in DFS order
+  llvm::ArrayRef<unsigned> Siblings = Index.getGroup(Id);
+  llvm::ArrayRef<unsigned> Excluded = Index.getExcludes(Id);
+  if (Siblings.size() > 1 || !Excluded.empty()) {
+    Writer.startElement(XmlConstants::EXCLUDEDOPTIONS);
+    const auto *SI = Siblings.begin();
+    const auto *EI = Excluded.begin();
+    while (SI != Siblings.end() || EI != Excluded.end()) {
+      unsigned Next;
+      if (EI == Excluded.end() || (SI != Siblings.end() && *SI <= *EI)) {
+        Next = *SI++;
+        if (Next == Id) {
+          continue;
         }
+      } else {
+        Next = *EI++;
       }
+      Writer.writeElement(XmlConstants::OPTIONS,
+                          Index.getFeature(Next)->getName());
+    }
+    Writer.endElement(); // EXCLUDEDOPTIONS
+  }
+
+  // optional
+  Writer.writeElement(XmlConstants::OPTIONAL,
+                      Feature1.isOptional() ? "True" : "False");
+
+  // numeric elements
+  if (auto *NF = llvm::dyn_cast<NumericFeature>(&Feature1)) {
+    auto ValueVariant = NF->getValues();
+    if (std::holds_alternative<std::pair<int, int>>(ValueVariant)) {
+      auto [Min, Max] = std::get<std::pair<int, int>>(ValueVariant);
+      Writer.writeElement(XmlConstants::MINVALUE, Min);
+      Writer.writeElement(XmlConstants::MAXVALUE, Max);
+    } else {
+      const auto &Values = std::get<std::vector<int>>(ValueVariant);
+      std::string Str;
+      llvm::raw_string_ostream SOS(Str);
+      for (size_t I = 0; I < Values.size(); ++I) {
+        SOS << (I ? ";" : "") << Values[I];
+      }
+      Writer.writeElement(XmlConstants::VALUES, SOS.str());
+    }
+  }
+
+  // locations?
+  if (Feature1.hasLocations()) {
+    Writer.startElement(XmlConstants::LOCATIONS);
+    for (FeatureSourceRange &Fsr : Feature1.getLocations()) {
+      writeSourceRange(Writer, Fsr);
+    }
+    Writer.endElement(); // LOCATIONS
+  }
+
+  Writer.endElement(); // CONFIGURATIONOPTION
+}
+
+void FeatureModelXmlWriter::writeSourceRange(detail::XmlStreamWriter &Writer,
+                                             FeatureSourceRange &Location) {
+  Writer.startElement(XmlConstants::SOURCERANGE);
+
+  switch (Location.getCategory()) {
+  case FeatureSourceRange::Category::necessary:
+    Writer.writeAttribute(XmlConstants::CATEGORY, XmlConstants::NECESSARY);
+    break;
+  case FeatureSourceRange::Category::inessential:
+    Writer.writeAttribute(XmlConstants::CATEGORY, XmlConstants::INESSENTIAL);
+    break;
+  }
+
+  Writer.writeElement(XmlConstants::PATH, Location.getPath().string());
+
+  Writer.startElement(XmlConstants::START);
+  auto *Start = Location.getStart();
+  Writer.writeElement(XmlConstants::LINE, Start->getLineNumber());
+  Writer.writeElement(XmlConstants::COLUMN, Start->getColumnOffset());
+  Writer.endElement(); // START
+
+  Writer.startElement(XmlConstants::END);
+  auto *End = Location.getEnd();
+  Writer.writeElement(XmlConstants::LINE, End->getLineNumber());
+  Writer.writeElement(XmlConstants::COLUMN, End->getColumnOffset());
+  Writer.endElement(); // END
+
+  Writer.endElement(); // SOURCERANGE
+}
+
+//===----------------------------------------------------------------------===//
+//                          FeatureModelDimacsWriter
+//===----------------------------------------------------------------------===//
+
+namespace {
+
+/// Encodes a feature model and its normalized constraints into CNF and passes
+/// every clause to the output stream as soon as it is complete. Without an
+/// output stream, clauses are only counted.
+class DimacsEncoder {
+public:
+  DimacsEncoder(const FeatureModel &Fm,
+                llvm::ArrayRef<ConstraintNormalizer::NormalizedTy> Constraints,
+                llvm::raw_ostream *OS)
+      : Fm(Fm), Constraints(Constraints), OS(OS) {
+    for (const auto *F : Fm.features()) {
+      Variables[F] = ++NumVariables;
     }
   }
 
-  if (!Implications.empty()) {
-    RC = xmlTextWriterStartElement(Writer, XmlConstants::IMPLIEDOPTIONS);
-    CHECK_RC
+  void writeVariables() {
+    for (const auto *F : Fm.features()) {
+      *OS << "c " << Variables[F] << ' ' << F->getName() << '\n';
+    }
+  }
 
-    for (Feature *F : Implications) {
-      RC = xmlTextWriterWriteElement(Writer, XmlConstants::OPTIONS,
-                                     charToUChar(F->getName().data()));
-      CHECK_RC
+  void encode() {
+    for (const auto *F : Fm.features()) {
+      encodeFeature(*F);
+    }
+    for (const auto &N : Constraints) {
+      encodeConstraint(N);
     }
+  }
+
+  [[nodiscard]] unsigned getNumVariables() const { return NumVariables; }
+  [[nodiscard]] unsigned getNumClauses() const { return NumClauses; }
 
-    RC = xmlTextWriterEndElement(Writer); // IMPLIEDOPTIONS
-    CHECK_RC
+private:
+  using ClauseTy = llvm::SmallVector<int, 8>;
+
+  /// Groups up to this size use pairwise at-most-one clauses, larger groups a
+  /// sequential counter with a linear number of clauses.
+  static constexpr size_t PairwiseAtMostOneLimit = 5;
+
+  int freshVariable() { return static_cast<int>(++NumVariables); }
+
+  int getVariable(const Feature *F) {
+    // Features which are not part of the model are free variables.
+    auto [It, Inserted] = Variables.try_emplace(F, 0);
+    if (Inserted) {
+      It->second = freshVariable();
+    }
+    return It->second;
   }
 
-  // excludes
-  OrderedFeatureVector Excludes;
+  void emitClause(llvm::ArrayRef<int> Clause) {
+    ++NumClauses;
+    if (!OS) {
+      return;
+    }
+    for (int Literal : Clause) {
+      *OS << Literal << ' ';
+    }
+    *OS << "0\n";
+  }
 
-  if (llvm::isa_and_nonnull<Relationship>(Feature1.getParent())) {
-    auto ES = Feature1.getParent()->getChildren<Feature>();
-    ES.erase(&Feature1);
-    Excludes.insert(ES.begin(), ES.end());
+  void encodeFeature(const Feature &F) {
+    int V = getVariable(&F);
+    if (llvm::isa<RootFeature>(F)) {
+      emitClause({V});
+    }
+    if (const auto *P = F.getParentFeature(); P) {
+      int PV = getVariable(P);
+      emitClause({-V, PV});
+      if (!F.isOptional() && llvm::isa<Feature>(F.getParent())) {
+        emitClause({-PV, V});
+      }
+    }
+    for (const auto *C : F.children()) {
+      if (const auto *R = llvm::dyn_cast<Relationship>(C); R) {
+        encodeRelationship(V, *R);
+      }
+    }
   }
-  for (const auto *C : Feature1.excludes()) {
-    if (const auto *LHS =
-            llvm::dyn_cast<PrimaryFeatureConstraint>(C->getLeftOperand());
-        LHS) {
-      if (const auto *RHS =
-              llvm::dyn_cast<PrimaryFeatureConstraint>(C->getRightOperand());
-          RHS) {
-        if (LHS->getFeature() &&
-            LHS->getFeature()->getName() == Feature1.getName() &&
-            RHS->getFeature()) {
-          Excludes.insert(RHS->getFeature());
+
+  void encodeRelationship(int Parent, const Relationship &R) {
+    ClauseTy Children;
+    for (const auto *C : R.children()) {
+      if (const auto *F = llvm::dyn_cast<Feature>(C); F) {
+        Children.push_back(getVariable(F));
+      }
+    }
+
+    ClauseTy AtLeastOne{-Parent};
+    AtLeastOne.append(Children.begin(), Children.end());
+    emitClause(AtLeastOne);
+
+    if (R.getKind() == Relationship::RelationshipKind::RK_ALTERNATIVE) {
+      encodeAtMostOne(Children);
+    }
+  }
+
+  void encodeAtMostOne(llvm::ArrayRef<int> Vars) {
+    if (Vars.size() <= PairwiseAtMostOneLimit) {
+      for (size_t I = 0; I < Vars.size(); ++I) {
+        for (size_t J = I + 1; J < Vars.size(); ++J) {
+          emitClause({-Vars[I], -Vars[J]});
         }
       }
+      return;
     }
+
+    // Sinz' sequential counter: S_i is true if one of Vars[0..i] is selected.
+    int S = freshVariable();
+    emitClause({-Vars[0], S});
+    for (size_t I = 1; I + 1 < Vars.size(); ++I) {
+      int Next = freshVariable();
+      emitClause({-Vars[I], Next});
+      emitClause({-S, Next});
+      emitClause({-Vars[I], -S});
+      S = Next;
+    }
+    emitClause({-Vars.back(), -S});
+  }
+
+  void encodeConstraint(const ConstraintNormalizer::NormalizedTy &N) {
+    if (std::holds_alternative<bool>(N)) {
+      if (!std::get<bool>(N)) {
+        emitClause({});
+      }
+      return;
+    }
+    assertFormula(*std::get<std::unique_ptr<Constraint>>(N));
   }
 
-  if (!Excludes.empty()) {
-    RC = xmlTextWriterStartElement(Writer, XmlConstants::EXCLUDEDOPTIONS);
-    CHECK_RC
+  /// A formula whose operands are encoded before the formula itself.
+  struct Frame {
+    enum class FrameKind {
+      /// Asserts the disjunction of its operands.
+      FK_ASSERT_CLAUSE,
+      /// Asserts a xor or an equivalence of its two operands.
+      FK_ASSERT_PARITY,
+      /// Defines G to be equivalent to a conjunction or disjunction.
+      FK_JUNCTION,
+      /// Defines G to imply a conjunction of clauses.
+      FK_CONJUNCTION,
+      /// Encodes a xor or an equivalence of its two operands.
+      FK_PARITY,
+      /// Encodes a xor of all of its operands.
+      FK_NARY_PARITY
+    };
+
+    FrameKind Kind;
+    const Constraint *C;
+    /// Whether the literals of the operands have to be equivalent to them.
+    bool BothPolarities;
+    /// Operands whose literals are needed, and whether an operand is the last
+    /// one of a clause of a conjunction.
+    llvm::SmallVector<std::pair<const Constraint *, bool>, 4> Operands{};
+    unsigned NextOperand{0};
+    /// Sign of the literal, which is flipped by every enclosing negation.
+    int Sign{1};
+    int G{0};
+    ClauseTy Literals{};
+  };
 
-    for (Feature *F : Excludes) {
-      RC = xmlTextWriterWriteElement(Writer, XmlConstants::OPTIONS,
-                                     charToUChar(F->getName().data()));
-      CHECK_RC
+  /// Add the clauses of a normalized formula which has to be satisfied.
+  void assertFormula(const Constraint &Root) {
+    llvm::SmallVector<const Constraint *, 8> Conjuncts;
+    flatten(Root, true, Conjuncts);
+    for (const auto *C : Conjuncts) {
+      if (ConstraintNormalizer::isImpliedByFeatureTree(*C)) {
+        continue;
+      }
+      // Parities are asserted without a Tseitin variable for the root.
+      if (const auto *B = llvm::dyn_cast<BinaryConstraint>(C);
+          B && (llvm::isa<XorConstraint>(B) ||
+                llvm::isa<EquivalenceConstraint>(B))) {
+        Frame F{Frame::FrameKind::FK_ASSERT_PARITY, C, true};
+        F.Operands.emplace_back(B->getLeftOperand(), false);
+        F.Operands.emplace_back(B->getRightOperand(), false);
+        encodeFrames(std::move(F));
+        continue;
+      }
+      Frame F{Frame::FrameKind::FK_ASSERT_CLAUSE, C, false};
+      addOperands(F, *C, false, false);
+      encodeFrames(std::move(F));
     }
+  }
 
-    RC = xmlTextWriterEndElement(Writer); // EXCLUDEDOPTIONS
-    CHECK_RC
+  /// Encode a frame and the frames of all of its operands with an explicit
+  /// stack, so deep formulas do not exhaust the call stack.
+  ///
+  /// \returns the literal of the formula of the frame
+  int encodeFrames(Frame Root) {
+    std::vector<Frame> Stack;
+    Stack.push_back(std::move(Root));
+    while (true) {
+      auto &Top = Stack.back();
+      if (Top.NextOperand < Top.Operands.size()) {
+        const auto *C = Top.Operands[Top.NextOperand++].first;
+        int Sign = 1;
+        while (const auto *N = llvm::dyn_cast<NotConstraint>(C)) {
+          C = N->getOperand();
+          Sign = -Sign;
+        }
+        // Creating a frame allocates its Tseitin variable, so operands get
+        // their variables in the same order as before.
+        if (auto F = createFrame(*C, Top.BothPolarities, Sign); F) {
+          Stack.push_back(std::move(*F));
+          continue;
+        }
+        addLiteral(Top, Sign * getAtom(*C));
+        continue;
+      }
+      int Literal = Top.Sign * finishFrame(Top);
+      Stack.pop_back();
+      if (Stack.empty()) {
+        return Literal;
+      }
+      addLiteral(Stack.back(), Literal);
+    }
   }
 
-  // optional
-  RC = xmlTextWriterWriteElement(
-      Writer, XmlConstants::OPTIONAL,
-      charToUChar((Feature1.isOptional() ? "True" : "False")));
-  CHECK_RC
+  /// \returns the frame of a formula whose literal depends on its operands,
+  ///          or nothing if \p C is an atom
+  std::optional<Frame> createFrame(const Constraint &C, bool BothPolarities,
+                                   int Sign) {
+    std::optional<Frame> F;
+    if (isConjunction(C) || isDisjunction(C)) {
+      if (!BothPolarities && isConjunction(C)) {
+        // Outside of parities, normalized formulas only contain positive
+        // conjunctions, so the implication from G to the conjunction
+        // suffices.
+        F.emplace(Frame{Frame::FrameKind::FK_CONJUNCTION, &C, false});
+        F->G = freshVariable();
+        llvm::SmallVector<const Constraint *, 8> Conjuncts;
+        flatten(C, true, Conjuncts);
+        for (const auto *Conjunct : Conjuncts) {
+          addOperands(*F, *Conjunct, false, true);
+        }
+      } else {
+        F.emplace(Frame{Frame::FrameKind::FK_JUNCTION, &C, true});
+        F->G = freshVariable();
+        addOperands(*F, C, isConjunction(C), false);
+      }
+    } else if (llvm::isa<XorConstraint>(C) ||
+               llvm::isa<EquivalenceConstraint>(C)) {
+      const auto &B = llvm::cast<BinaryConstraint>(C);
+      F.emplace(Frame{Frame::FrameKind::FK_PARITY, &C, true});
+      F->Operands.emplace_back(B.getLeftOperand(), false);
+      F->Operands.emplace_back(B.getRightOperand(), false);
+    } else if (const auto *X = llvm::dyn_cast<NaryXorConstraint>(&C); X) {
+      assert(!X->operands().empty() && "Empty parities are folded.");
+      F.emplace(Frame{Frame::FrameKind::FK_NARY_PARITY, &C, true});
+      for (const auto &Operand : X->operands()) {
+        F->Operands.emplace_back(Operand.get(), false);
+      }
+    }
+    if (F) {
+      F->Sign = Sign;
+    }
+    return F;
+  }
 
-  // numeric elements
-  if (auto *NF = llvm::dyn_cast<NumericFeature>(&Feature1)) {
-    auto ValueVariant = NF->getValues();
-    if (std::holds_alternative<std::pair<int, int>>(ValueVariant)) {
-      auto [Min, Max] = std::get<std::pair<int, int>>(ValueVariant);
-      RC = xmlTextWriterWriteElement(Writer, XmlConstants::MINVALUE,
-                                     charToUChar(std::to_string(Min).data()));
-      CHECK_RC
+  /// Add the flattened operands of a conjunction or disjunction to a frame.
+  /// If \p EndsClause is set, the last one ends a clause.
+  void addOperands(Frame &F, const Constraint &C, bool Conjunction,
+                   bool EndsClause) {
+    llvm::SmallVector<const Constraint *, 8> Operands;
+    flatten(C, Conjunction, Operands);
+    for (const auto *Operand : Operands) {
+      F.Operands.emplace_back(Operand, false);
+    }
+    F.Operands.back().second = EndsClause;
+  }
 
-      RC = xmlTextWriterWriteElement(Writer, XmlConstants::MAXVALUE,
-                                     charToUChar(std::to_string(Max).data()));
-      CHECK_RC
-    } else {
-      auto Values = std::get<std::vector<int>>(ValueVariant);
-      std::string Str;
-      std::for_each(std::begin(Values), std::end(Values) - 1, [&Str](int X) {
-        Str.append(std::to_string(X));
-        Str.push_back(';');
-      });
-      Str.append(std::to_string(Values.back()));
+  void addLiteral(Frame &F, int Literal) {
+    if (F.Kind == Frame::FrameKind::FK_NARY_PARITY && !F.Literals.empty()) {
+      F.Literals.front() = encodeXor(F.Literals.front(), Literal);
+      return;
+    }
+    F.Literals.push_back(Literal);
+    if (F.Kind == Frame::FrameKind::FK_CONJUNCTION &&
+        F.Operands[F.NextOperand - 1].second) {
+      ClauseTy Clause{-F.G};
+      Clause.append(F.Literals.begin(), F.Literals.end());
+      emitClause(Clause);
+      F.Literals.clear();
+    }
+  }
 
-      RC = xmlTextWriterWriteElement(Writer, XmlConstants::VALUES,
-                                     charToUChar(Str.data()));
-      CHECK_RC
+  /// Add the clauses of a frame whose operands are all encoded.
+  ///
+  /// \returns the literal of the formula of the frame, without its sign
+  int finishFrame(Frame &F) {
+    bool IsXor = llvm::isa<XorConstraint>(F.C);
+    switch (F.Kind) {
+    case Frame::FrameKind::FK_ASSERT_CLAUSE:
+      emitClause(F.Literals);
+      return 0;
+    case Frame::FrameKind::FK_ASSERT_PARITY: {
+      int L = F.Literals[0];
+      int R = F.Literals[1];
+      emitClause({IsXor ? L : -L, R});
+      emitClause({IsXor ? -L : L, -R});
+      return 0;
+    }
+    case Frame::FrameKind::FK_JUNCTION: {
+      // G => (l1 & ... & ln) and (l1 & ... & ln) => G, or the same for the
+      // disjunction with all literals negated.
+      int Sign = isConjunction(*F.C) ? 1 : -1;
+      ClauseTy Converse{Sign * F.G};
+      for (int Literal : F.Literals) {
+        emitClause({-Sign * F.G, Sign * Literal});
+        Converse.push_back(-Sign * Literal);
+      }
+      emitClause(Converse);
+      return F.G;
+    }
+    case Frame::FrameKind::FK_CONJUNCTION:
+      return F.G;
+    case Frame::FrameKind::FK_PARITY: {
+      int G = encodeXor(F.Literals[0], F.Literals[1]);
+      return IsXor ? G : -G;
     }
+    case Frame::FrameKind::FK_NARY_PARITY:
+      return F.Literals.front();
+    }
+    llvm_unreachable("Unknown frame kind.");
   }
 
-  // locations?
-  if (Feature1.hasLocations()) {
-    RC = xmlTextWriterStartElement(Writer, XmlConstants::LOCATIONS);
-    CHECK_RC
-    for (FeatureSourceRange &Fsr : Feature1.getLocations()) {
-      RC = writeSourceRange(Writer, Fsr);
-      CHECK_RC
+  /// \returns the literal of an atom, numeric atoms are abstracted by free
+  ///          variables
+  int getAtom(const Constraint &C) {
+    if (const auto *P = llvm::dyn_cast<PrimaryFeatureConstraint>(&C); P) {
+      return getVariable(P->getFeature());
     }
-    RC = xmlTextWriterEndElement(Writer); // LOCATIONS
-    CHECK_RC
+    auto [It, Inserted] = Atoms.try_emplace(C.toString(), 0);
+    if (Inserted) {
+      It->second = freshVariable();
+    }
+    return It->second;
+  }
+
+  /// Collect the operands of nested conjunctions, or disjunctions, from left
+  /// to right.
+  static void flatten(const Constraint &Root, bool Conjunction,
+                      llvm::SmallVectorImpl<const Constraint *> &Operands) {
+    llvm::SmallVector<const Constraint *, 16> Worklist{&Root};
+    while (!Worklist.empty()) {
+      const auto *C = Worklist.pop_back_val();
+      if (Conjunction ? !isConjunction(*C) : !isDisjunction(*C)) {
+        Operands.push_back(C);
+        continue;
+      }
+      if (const auto *B = llvm::dyn_cast<BinaryConstraint>(C); B) {
+        Worklist.push_back(B->getRightOperand());
+        Worklist.push_back(B->getLeftOperand());
+        continue;
+      }
+      for (const auto &Operand :
+           llvm::reverse(llvm::cast<NaryConstraint>(C)->operands())) {
+        Worklist.push_back(Operand.get());
+      }
+    }
+  }
+
+  /// \returns a fresh variable which is equivalent to \p L ^ \p R
+  int encodeXor(int L, int R) {
+    int G = freshVariable();
+    emitClause({-G, L, R});
+    emitClause({-G, -L, -R});
+    emitClause({G, -L, R});
+    emitClause({G, L, -R});
+    return G;
   }
 
-  RC = xmlTextWriterEndElement(Writer); // CONFIGURATIONOPTION
+  static bool isConjunction(const Constraint &C) {
+    return llvm::isa<AndConstraint>(C) || llvm::isa<NaryAndConstraint>(C);
+  }
+
+  static bool isDisjunction(const Constraint &C) {
+    return llvm::isa<OrConstraint>(C) || llvm::isa<NaryOrConstraint>(C);
+  }
+
+  const FeatureModel &Fm;
+  llvm::ArrayRef<ConstraintNormalizer::NormalizedTy> Constraints;
+  llvm::raw_ostream *OS;
+  llvm::DenseMap<const Feature *, int> Variables;
+  llvm::StringMap<int> Atoms;
+  unsigned NumVariables{0};
+  unsigned NumClauses{0};
+};
+
+} // namespace
+
+int FeatureModelDimacsWriter::writeFeatureModel(std::string Path) {
+  std::error_code EC;
+  llvm::raw_fd_ostream OS(Path, EC);
+  if (EC) {
+    return -1;
+  }
+  int RC = writeFeatureModel(OS);
+  OS.close();
+  if (OS.has_error()) {
+    OS.clear_error();
+    return -1;
+  }
   return RC;
 }
 
-int FeatureModelXmlWriter::writeSourceRange(xmlTextWriterPtr Writer,
-                                            FeatureSourceRange &Location) {
-  int RC;
+std::optional<std::string> FeatureModelDimacsWriter::writeFeatureModel() {
+  std::string Str;
+  llvm::raw_string_ostream OS(Str);
+  if (writeFeatureModel(OS) < 0) {
+    return std::nullopt;
+  }
+  return OS.str();
+}
 
-  RC = xmlTextWriterStartElement(Writer, XmlConstants::SOURCERANGE);
-  CHECK_RC
+int FeatureModelDimacsWriter::writeFeatureModel(llvm::raw_fd_ostream &OS) {
+  int RC = writeFeatureModel(static_cast<llvm::raw_ostream &>(OS));
+  return checkFileStream(RC, OS);
+}
 
-  switch (Location.getCategory()) {
-  case FeatureSourceRange::Category::necessary:
-    RC = xmlTextWriterWriteAttribute(Writer, XmlConstants::CATEGORY,
-                                     XmlConstants::NECESSARY);
-    break;
-  case FeatureSourceRange::Category::inessential:
-    RC = xmlTextWriterWriteAttribute(Writer, XmlConstants::CATEGORY,
-                                     XmlConstants::INESSENTIAL);
-    break;
+int FeatureModelDimacsWriter::writeFeatureModel(llvm::raw_ostream &OS) {
+  // Both passes share the normalized constraints.
+  ConstraintNormalizer Normalizer(&Fm);
+  std::vector<ConstraintNormalizer::NormalizedTy> Constraints;
+  for (const auto &C : Fm.constraints()) {
+    Constraints.push_back(Normalizer.normalize(*C));
   }
-  CHECK_RC
 
-  RC = xmlTextWriterWriteElement(
-      Writer, XmlConstants::PATH,
-      charToUChar(Location.getPath().string().data()));
-  CHECK_RC
+  DimacsEncoder Counter(Fm, Constraints, nullptr);
+  Counter.encode();
 
-  RC = xmlTextWriterStartElement(Writer, XmlConstants::START);
-  CHECK_RC
+  DimacsEncoder Emitter(Fm, Constraints, &OS);
+  Emitter.writeVariables();
+  OS << "p cnf " << Counter.getNumVariables() << ' '
+     << Counter.getNumClauses() << '\n';
+  Emitter.encode();
 
-  auto *Start = Location.getStart();
-  RC = xmlTextWriterWriteElement(
-      Writer, XmlConstants::LINE,
-      BAD_CAST std::to_string(Start->getLineNumber()).data());
-  CHECK_RC
+  OS.flush();
+  return 0;
+}
 
-  RC = xmlTextWriterWriteElement(
-      Writer, XmlConstants::COLUMN,
-      BAD_CAST std::to_string(Start->getColumnOffset()).data());
-  CHECK_RC
+//===----------------------------------------------------------------------===//
+//                          FeatureModelBinaryWriter
+//===----------------------------------------------------------------------===//
+
+namespace {
+
+/// Encodes the records of a binary feature model, interning all strings on
+/// the way. The string table is written before the records, so records are
+/// collected in a buffer first.
+class BinaryEncoder : public ConstraintWalker<const Constraint> {
+public:
+  BinaryEncoder()
+      : RecordStream(Records), W(RecordStream, llvm::support::little) {}
+
+  void encode(const FeatureModel &Fm) {
+    writeString(Fm.getName());
+    writeString(Fm.getPath().string());
+    writeString(Fm.getCommit());
+
+    // Features are ordered parents first, so parents are always known.
+    llvm::DenseMap<const Feature *, uint32_t> Index;
+    W.write<uint32_t>(std::distance(Fm.begin(), Fm.end()));
+    for (Feature *F : Fm.features()) {
+      encodeFeature(*F, Index);
+      Index.try_emplace(F, Index.size());
+    }
 
-  RC = xmlTextWriterEndElement(Writer); // START
-  CHECK_RC
+    llvm::SmallVector<std::pair<const Feature *, const Relationship *>, 8>
+        Relationships;
+    for (const auto *F : Fm.features()) {
+      for (const auto *Child : F->children()) {
+        if (const auto *R = llvm::dyn_cast<Relationship>(Child); R) {
+          Relationships.emplace_back(F, R);
+        }
+      }
+    }
+    W.write<uint32_t>(Relationships.size());
+    for (const auto &[Parent, R] : Relationships) {
+      W.write<uint8_t>(BinaryConstants::getTag(R->getKind()));
+      W.write<uint32_t>(Index.lookup(Parent));
+      llvm::SmallVector<uint32_t, 8> Children;
+      for (const auto *Child : R->children()) {
+        if (const auto *F = llvm::dyn_cast<Feature>(Child); F) {
+          Children.push_back(Index.lookup(F));
+        }
+      }
+      W.write<uint32_t>(Children.size());
+      for (uint32_t Child : Children) {
+        W.write<uint32_t>(Child);
+      }
+    }
 
-  RC = xmlTextWriterStartElement(Writer, XmlConstants::END);
-  CHECK_RC
+    W.write<uint32_t>(std::distance(Fm.constraints().begin(),
+                                    Fm.constraints().end()));
+    for (const auto &C : Fm.constraints()) {
+      walk(*C);
+    }
+  }
 
-  auto *End = Location.getEnd();
-  RC = xmlTextWriterWriteElement(
-      Writer, XmlConstants::LINE,
-      BAD_CAST std::to_string(End->getLineNumber()).data());
-  CHECK_RC
+  void write(llvm::raw_ostream &OS) {
+    llvm::support::endian::Writer Out(OS, llvm::support::little);
+    OS.write(BinaryConstants::MAGIC, sizeof(BinaryConstants::MAGIC) - 1);
+    Out.write<uint32_t>(BinaryConstants::VERSION);
+    Out.write<uint32_t>(Strings.size());
+    for (const auto &Str : Strings) {
+      Out.write<uint32_t>(Str.size());
+      OS << Str;
+    }
+    OS << RecordStream.str();
+  }
+
+protected:
+  bool preVisit(const Constraint &C) override {
+    W.write<uint8_t>(BinaryConstants::getTag(C.getKind()));
+    if (const auto *P = llvm::dyn_cast<PrimaryFeatureConstraint>(&C); P) {
+      writeString(P->getFeature() ? P->getFeature()->getName() : "");
+    } else if (const auto *I = llvm::dyn_cast<PrimaryIntegerConstraint>(&C);
+               I) {
+      W.write<int32_t>(I->getValue());
+    } else if (const auto *N = llvm::dyn_cast<NaryConstraint>(&C); N) {
+      W.write<uint32_t>(N->getNumOperands());
+    }
+    return true;
+  }
+
+private:
+  void writeString(llvm::StringRef Str) {
+    auto [It, Inserted] = StringIndex.try_emplace(Str, Strings.size());
+    if (Inserted) {
+      Strings.push_back(It->getKey());
+    }
+    W.write<uint32_t>(It->second);
+  }
+
+  void encodeFeature(Feature &F,
+                     const llvm::DenseMap<const Feature *, uint32_t> &Index) {
+    W.write<uint8_t>(BinaryConstants::getTag(F.getKind()));
+    W.write<uint8_t>(F.isOptional());
+    writeString(F.getName());
+    const auto *Parent = F.getParentFeature();
+    W.write<uint32_t>(Parent ? Index.lookup(Parent) + 1
+                             : BinaryConstants::NO_PARENT);
+
+    if (const auto *N = llvm::dyn_cast<NumericFeature>(&F); N) {
+      auto Values = N->getValues();
+      if (const auto *Range = std::get_if<std::pair<int, int>>(&Values);
+          Range) {
+        W.write<uint8_t>(BinaryConstants::VALUES_RANGE);
+        W.write<int32_t>(Range->first);
+        W.write<int32_t>(Range->second);
+      } else {
+        const auto &List = std::get<std::vector<int>>(Values);
+        W.write<uint8_t>(BinaryConstants::VALUES_LIST);
+        W.write<uint32_t>(List.size());
+        for (int Value : List) {
+          W.write<int32_t>(Value);
+        }
+      }
+    }
 
-  RC = xmlTextWriterWriteElement(
-      Writer, XmlConstants::COLUMN,
-      BAD_CAST std::to_string(End->getColumnOffset()).data());
-  CHECK_RC
+    W.write<uint32_t>(
+        std::distance(F.getLocationsBegin(), F.getLocationsEnd()));
+    for (auto &Location : F.getLocations()) {
+      W.write<uint8_t>(BinaryConstants::getTag(Location.getCategory()));
+      W.write<uint8_t>(
+          (Location.hasStart() ? BinaryConstants::LOCATION_START : 0) |
+          (Location.hasEnd() ? BinaryConstants::LOCATION_END : 0));
+      writeString(Location.getPath().string());
+      for (auto *L : {Location.getStart(), Location.getEnd()}) {
+        if (L) {
+          W.write<int32_t>(L->getLineNumber());
+          W.write<int32_t>(L->getColumnOffset());
+        }
+      }
+    }
+  }
 
-  RC = xmlTextWriterEndElement(Writer); // END
-  CHECK_RC
+  llvm::StringMap<uint32_t> StringIndex;
+  std::vector<llvm::StringRef> Strings;
+  llvm::SmallString<4096> Records;
+  llvm::raw_svector_ostream RecordStream;
+  llvm::support::endian::Writer W;
+};
 
-  RC = xmlTextWriterEndElement(Writer); // SOURCERANGE
+} // namespace
+
+int FeatureModelBinaryWriter::writeFeatureModel(std::string Path) {
+  std::error_code EC;
+  llvm::raw_fd_ostream OS(Path, EC);
+  if (EC) {
+    return -1;
+  }
+  int RC = writeFeatureModel(OS);
+  OS.close();
+  if (OS.has_error()) {
+    OS.clear_error();
+    return -1;
+  }
   return RC;
 }
 
+std::optional<std::string> FeatureModelBinaryWriter::writeFeatureModel() {
+  std::string Str;
+  llvm::raw_string_ostream OS(Str);
+  if (writeFeatureModel(OS) < 0) {
+    return std::nullopt;
+  }
+  return OS.str();
+}
+
+int FeatureModelBinaryWriter::writeFeatureModel(llvm::raw_fd_ostream &OS) {
+  int RC = writeFeatureModel(static_cast<llvm::raw_ostream &>(OS));
+  return checkFileStream(RC, OS);
+}
+
+int FeatureModelBinaryWriter::writeFeatureModel(llvm::raw_ostream &OS) {
+  BinaryEncoder Encoder;
+  Encoder.encode(Fm);
+  Encoder.write(OS);
+
+  OS.flush();
+  return 0;
+}
+
 } // namespace vara::feature
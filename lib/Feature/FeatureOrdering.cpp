@@ -0,0 +1,10 @@
+#include "vara/Feature/FeatureOrdering.h"
+
+namespace vara::feature {
+
+void FeatureOrdering::insert(Feature *F) {
+  remove(F);
+  Positions[F] = Features.insert(F);
+}
+
+} // namespace vara::feature
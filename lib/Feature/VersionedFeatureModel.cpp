@@ -0,0 +1,98 @@
+#include "vara/Feature/VersionedFeatureModel.h"
+
+#include <algorithm>
+#include <cassert>
+
+namespace vara::feature {
+
+//===----------------------------------------------------------------------===//
+//                          FeatureModelSnapshot Class
+//===----------------------------------------------------------------------===//
+
+void FeatureModelSnapshot::release() {
+  if (Slot) {
+    Slot->Epoch.store(detail::ReaderSlot::Idle);
+    Slot->InUse.store(false);
+    Slot = nullptr;
+  }
+}
+
+//===----------------------------------------------------------------------===//
+//                          VersionedFeatureModel Class
+//===----------------------------------------------------------------------===//
+
+VersionedFeatureModel::VersionedFeatureModel(std::unique_ptr<FeatureModel> FM)
+    : Current(new detail::FeatureModelVersion{std::move(FM), 0}) {}
+
+VersionedFeatureModel::~VersionedFeatureModel() {
+  for (auto *Slot = Slots.load(); Slot;) {
+    assert(!Slot->InUse.load() && "Snapshot outlives its model.");
+    auto *Next = Slot->Next;
+    delete Slot;
+    Slot = Next;
+  }
+  delete Current.load();
+}
+
+FeatureModelSnapshot VersionedFeatureModel::snapshot() const {
+  auto *Slot = acquireSlot();
+  // All operations are sequentially consistent: a writer that misses the
+  // announced epoch published its version before it is loaded below.
+  Slot->Epoch.store(Epoch.load());
+  return FeatureModelSnapshot(Slot, Current.load());
+}
+
+void VersionedFeatureModel::publish(std::unique_ptr<FeatureModel> FM) {
+  std::lock_guard<std::mutex> Lock(WriterMutex);
+  publishLocked(std::move(FM));
+}
+
+void VersionedFeatureModel::reclaim() {
+  std::lock_guard<std::mutex> Lock(WriterMutex);
+  reclaimLocked();
+}
+
+size_t VersionedFeatureModel::getNumRetired() const {
+  std::lock_guard<std::mutex> Lock(WriterMutex);
+  return Retired.size();
+}
+
+void VersionedFeatureModel::publishLocked(std::unique_ptr<FeatureModel> FM) {
+  auto *Previous = Current.load();
+  Current.store(
+      new detail::FeatureModelVersion{std::move(FM), Previous->Number + 1});
+  // Readers announcing a later epoch already see the new version.
+  Previous->RetiredAt = Epoch.fetch_add(1);
+  Retired.emplace_back(Previous);
+  reclaimLocked();
+}
+
+void VersionedFeatureModel::reclaimLocked() {
+  uint64_t Oldest = detail::ReaderSlot::Idle;
+  for (auto *Slot = Slots.load(); Slot; Slot = Slot->Next) {
+    Oldest = std::min(Oldest, Slot->Epoch.load());
+  }
+  Retired.erase(std::remove_if(Retired.begin(), Retired.end(),
+                               [Oldest](const auto &V) {
+                                 return V->RetiredAt < Oldest;
+                               }),
+                Retired.end());
+}
+
+detail::ReaderSlot *VersionedFeatureModel::acquireSlot() const {
+  for (auto *Slot = Slots.load(); Slot; Slot = Slot->Next) {
+    bool Free = false;
+    if (Slot->InUse.compare_exchange_strong(Free, true)) {
+      return Slot;
+    }
+  }
+  // All slots are taken, so this reader adds its own.
+  auto *Slot = new detail::ReaderSlot();
+  Slot->InUse.store(true);
+  Slot->Next = Slots.load();
+  while (!Slots.compare_exchange_weak(Slot->Next, Slot)) {
+  }
+  return Slot;
+}
+
+} // namespace vara::feature
@@ -1,7 +1,9 @@
 #include "vara/Feature/FeatureModelParser.h"
 
+#include "llvm/ADT/SmallString.h"
 #include "llvm/Support/CommandLine.h"
 #include "llvm/Support/Errc.h"
+#include "llvm/Support/FileSystem.h"
 #include "llvm/Support/InitLLVM.h"
 #include "llvm/Support/MemoryBuffer.h"
 #include "llvm/Support/Program.h"
@@ -37,6 +39,33 @@ static llvm::cl::opt<bool>
     Dump("dump", llvm::cl::desc("Dump feature model to stdout and exit."),
          llvm::cl::init(false), llvm::cl::cat(FMViewerCategory));
 
+static llvm::cl::opt<std::string>
+    Root("root", llvm::cl::desc("Only show the subtree of <feature>."),
+         llvm::cl::value_desc("feature"), llvm::cl::init(""),
+         llvm::cl::cat(FMViewerCategory));
+
+static llvm::cl::opt<int>
+    Depth("depth",
+          llvm::cl::desc("Only show features up to depth <n> below the root, "
+                         "features with hidden children are drawn dashed."),
+          llvm::cl::value_desc("n"), llvm::cl::init(-1),
+          llvm::cl::cat(FMViewerCategory));
+
+static llvm::cl::opt<bool> CollapseGroups(
+    "collapse-groups",
+    llvm::cl::desc("Show groups as single nodes listing their members."),
+    llvm::cl::init(false), llvm::cl::cat(FMViewerCategory));
+
+/// Write the DOT graph of \p FM to \p OS.
+static void writeGraph(llvm::raw_ostream &OS, vara::feature::FeatureModel *FM) {
+  vara::feature::FeatureModelGraphOptions Options;
+  Options.Root = Root;
+  Options.MaxDepth = Depth;
+  Options.CollapseGroups = CollapseGroups;
+  llvm::GraphWriter<vara::feature::FeatureModel *>(OS, FM, false, Options)
+      .writeGraph(FM->getName().str());
+}
+
 int main(int Argc, char **Argv) {
   llvm::InitLLVM X(Argc, Argv);
   llvm::cl::HideUnrelatedOptions(FMViewerCategory);
@@ -50,15 +79,12 @@ int main(int Argc, char **Argv) {
     return 1;
   }
 
-  auto FS = llvm::MemoryBuffer::getFileAsStream(FileNames[0]);
-  if (std::error_code EC = FS.getError()) {
-    llvm::errs() << EC.message() << '\n';
+  auto Parser = vara::feature::FeatureModelXmlParser::fromFile(FileNames[0]);
+  if (!Parser) {
     return 1;
   }
 
-  if (Verify &&
-      !vara::feature::FeatureModelXmlParser(std::string(FS.get()->getBuffer()))
-           .verifyFeatureModel()) {
+  if (Verify && !Parser->verifyFeatureModel()) {
     llvm::errs() << "error: Invalid feature model.\n";
     return 1;
   }
@@ -66,9 +92,7 @@ int main(int Argc, char **Argv) {
   std::unique_ptr<vara::feature::FeatureModel> FM;
 
   if (Xml) {
-    FM =
-        vara::feature::FeatureModelXmlParser(std::string(FS.get()->getBuffer()))
-            .buildFeatureModel();
+    FM = Parser->buildFeatureModel();
   } else {
     assert(FM && "No matching parser.");
   }
@@ -78,18 +102,36 @@ int main(int Argc, char **Argv) {
     return 1;
   }
 
+  if (!Root.empty() && !FM->getFeature(Root)) {
+    llvm::errs() << "error: Feature '" << Root << "' not found.\n";
+    return 1;
+  }
+
   if (Dump) {
     FM->dump();
   } else if (!Out.empty()) {
     llvm::errs() << "Writing '" << Out << "'...";
-    llvm::WriteGraph(FM.get(), llvm::Twine(FM->getName()), false, "",
-                     Out.getValue());
+    std::error_code EC;
+    llvm::raw_fd_ostream OS(Out, EC, llvm::sys::fs::OF_Text);
+    if (EC) {
+      llvm::errs() << "error: " << EC.message() << "\n";
+      return 1;
+    }
+    writeGraph(OS, FM.get());
+    llvm::errs() << " done.\n";
   } else {
-    auto Filename = llvm::WriteGraph(FM.get(), llvm::Twine(FM->getName()));
-
-    if (Filename.empty()) {
+    int FD;
+    llvm::SmallString<128> Path;
+    if (std::error_code EC = llvm::sys::fs::createTemporaryFile(
+            "feature-model", "dot", FD, Path)) {
+      llvm::errs() << "error: " << EC.message() << "\n";
       return 1;
     }
+    {
+      llvm::raw_fd_ostream OS(FD, /*shouldClose=*/true);
+      writeGraph(OS, FM.get());
+    }
+    std::string Filename = Path.str().str();
 
     if (llvm::ErrorOr<std::string> P =
             Viewer.empty() ? llvm::errc::invalid_argument
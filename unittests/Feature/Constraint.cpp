@@ -0,0 +1,178 @@
+#include "vara/Feature/Constraint.h"
+#include "vara/Feature/Feature.h"
+
+#include "UnittestHelper.h"
+
+#include "gtest/gtest.h"
+
+namespace vara::feature {
+
+static NaryConstraint::OperandContainerTy
+features(std::initializer_list<std::string> Names) {
+  NaryConstraint::OperandContainerTy Operands;
+  for (const auto &Name : Names) {
+    Operands.push_back(feature(Name));
+  }
+  return Operands;
+}
+
+TEST(NaryConstraint, toString) {
+  EXPECT_EQ(NaryOrConstraint(features({"a", "b", "c"})).toString(),
+            "(a | b | c)");
+  EXPECT_EQ(NaryAndConstraint(features({"a", "b", "c"})).toString(),
+            "(a & b & c)");
+  EXPECT_EQ(NaryAndConstraint(features({"a", "b", "c"})).toHTML(),
+            "(a &amp; b &amp; c)");
+  EXPECT_EQ(NaryXorConstraint(features({"a", "b", "c"})).toString(),
+            "(a ^ b ^ c)");
+}
+
+TEST(NaryConstraint, operands) {
+  NaryOrConstraint C(features({"a", "b", "c"}));
+
+  ASSERT_EQ(C.getNumOperands(), 3);
+  EXPECT_TRUE(llvm::isa<NaryConstraint>(&C));
+  EXPECT_FALSE(llvm::isa<BinaryConstraint>(&C));
+  for (const auto &Operand : C.operands()) {
+    EXPECT_EQ(Operand->getParent(), &C);
+  }
+  EXPECT_EQ(C.getOperand(1)->toString(), "b");
+}
+
+TEST(NaryConstraint, clone) {
+  NaryAndConstraint C(features({"a", "b"}));
+  C.getOperand(0)->setParent(nullptr);
+
+  auto Clone = C.clone();
+  ASSERT_TRUE(llvm::isa<NaryAndConstraint>(Clone.get()));
+  EXPECT_EQ(Clone->toString(), C.toString());
+  EXPECT_EQ(llvm::cast<NaryConstraint>(Clone.get())->getOperand(0)->getParent(),
+            Clone.get());
+}
+
+TEST(NaryConstraint, visitor) {
+  class CountingVisitor : public ConstraintVisitor {
+  public:
+    void visit(PrimaryFeatureConstraint * /*C*/) override { ++NumFeatures; }
+    unsigned NumFeatures{0};
+  };
+
+  NaryOrConstraint C(features({"a", "b", "c", "d"}));
+  CountingVisitor V;
+  C.accept(V);
+  EXPECT_EQ(V.NumFeatures, 4);
+}
+
+TEST(NaryConstraint, flattenDeepChain) {
+  // Binary chains of this depth exhaust the stack in recursive code.
+  constexpr unsigned Depth = 100000;
+  std::unique_ptr<Constraint> Chain = feature("a0");
+  for (unsigned I = 1; I < Depth; ++I) {
+    Chain = std::make_unique<OrConstraint>(std::move(Chain),
+                                           feature("a" + std::to_string(I)));
+  }
+
+  auto C = NaryConstraint::flatten(std::move(Chain));
+  auto *N = llvm::dyn_cast<NaryOrConstraint>(C.get());
+  ASSERT_TRUE(N);
+  ASSERT_EQ(N->getNumOperands(), Depth);
+  EXPECT_EQ(N->getOperand(0)->toString(), "a0");
+  EXPECT_EQ(N->getOperand(Depth - 1)->toString(),
+            "a" + std::to_string(Depth - 1));
+  EXPECT_EQ(N->getOperand(42)->getParent(), N);
+}
+
+TEST(NaryConstraint, flattenNested) {
+  // ((a & b) & c) | (d | !(e | f))
+  auto C = NaryConstraint::flatten(std::make_unique<OrConstraint>(
+      std::make_unique<AndConstraint>(
+          std::make_unique<AndConstraint>(feature("a"), feature("b")),
+          feature("c")),
+      std::make_unique<OrConstraint>(
+          feature("d"), std::make_unique<NotConstraint>(
+                            std::make_unique<OrConstraint>(feature("e"),
+                                                           feature("f"))))));
+
+  EXPECT_EQ(C->toString(), "((a & b & c) | d | !(e | f))");
+  EXPECT_TRUE(llvm::isa<NaryAndConstraint>(
+      llvm::cast<NaryConstraint>(C.get())->getOperand(0)));
+
+  auto X = NaryConstraint::flatten(std::make_unique<XorConstraint>(
+      std::make_unique<XorConstraint>(feature("a"), feature("b")),
+      feature("c")));
+  EXPECT_EQ(X->toString(), "(a ^ b ^ c)");
+
+  auto P = NaryConstraint::flatten(feature("a"));
+  EXPECT_EQ(P->toString(), "a");
+}
+
+TEST(ConstraintWalker, order) {
+  class RecordingWalker : public ConstraintWalker<const Constraint> {
+  public:
+    std::string Trace;
+
+  protected:
+    bool preVisit(const Constraint &C) override {
+      if (llvm::isa<PrimaryConstraint>(C)) {
+        Trace += C.toString();
+      } else {
+        Trace += "<";
+      }
+      return !llvm::isa<NotConstraint>(C);
+    }
+    void inVisit(const Constraint & /*C*/, unsigned Idx) override {
+      Trace += std::to_string(Idx);
+    }
+    void postVisit(const Constraint &C) override {
+      if (!llvm::isa<PrimaryConstraint>(C)) {
+        Trace += ">";
+      }
+    }
+  };
+
+  // (a | !b) & (c ^ d ^ e)
+  NaryConstraint::OperandContainerTy Xor = features({"c", "d", "e"});
+  AndConstraint C(
+      std::make_unique<OrConstraint>(
+          feature("a"), std::make_unique<NotConstraint>(feature("b"))),
+      std::make_unique<NaryXorConstraint>(std::move(Xor)));
+
+  RecordingWalker W;
+  W.walk(C);
+  EXPECT_EQ(W.Trace, "<<a1<>>1<c1d2e>>");
+}
+
+TEST(ConstraintWalker, printing) {
+  auto C = std::make_unique<ExcludesConstraint>(
+      std::make_unique<AndConstraint>(feature("a"), feature("b")),
+      std::make_unique<LessConstraint>(
+          std::make_unique<NegConstraint>(
+              std::make_unique<PrimaryIntegerConstraint>(1)),
+          feature("c")));
+
+  EXPECT_EQ(C->toString(), "((a & b) => !(~1 < c))");
+  EXPECT_EQ(C->toHTML(), "((a &amp; b) =&gt; !(~1 &lt; c))");
+
+  std::string Str;
+  llvm::raw_string_ostream OS(Str);
+  C->print(OS);
+  EXPECT_EQ(OS.str(), C->toString());
+}
+
+TEST(ConstraintWalker, deepConstraints) {
+  // Recursive printing, cloning or destruction of this chain exhausts the
+  // stack.
+  constexpr unsigned Depth = 200000;
+  std::unique_ptr<Constraint> Chain = feature("a");
+  for (unsigned I = 1; I < Depth; ++I) {
+    Chain = std::make_unique<NotConstraint>(std::move(Chain));
+  }
+
+  auto Clone = Chain->clone();
+  std::string Str = Clone->toString();
+  EXPECT_EQ(Str.size(), Depth);
+  EXPECT_EQ(Str, Chain->toString());
+  EXPECT_EQ(Str.back(), 'a');
+}
+
+} // namespace vara::feature
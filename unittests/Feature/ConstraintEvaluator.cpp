@@ -0,0 +1,145 @@
+#include "vara/Feature/ConstraintEvaluator.h"
+#include "vara/Feature/FeatureModel.h"
+
+#include "UnittestHelper.h"
+
+#include "gtest/gtest.h"
+
+namespace vara::feature {
+
+class ConstraintEvaluatorTest : public ::testing::Test {
+protected:
+  const Constraint *constraint(unsigned Idx) {
+    return std::next(FM->constraints().begin(), Idx)->get();
+  }
+
+  std::unique_ptr<FeatureModel> FM;
+};
+
+TEST_F(ConstraintEvaluatorTest, toggleFeatures) {
+  FeatureModelBuilder B;
+  B.makeFeature<BinaryFeature>("a", true);
+  B.makeFeature<BinaryFeature>("b", true);
+  B.makeFeature<BinaryFeature>("c", true);
+  B.addConstraint(std::make_unique<ImpliesConstraint>(feature("a"),
+                                                      feature("b")));
+  B.addConstraint(std::make_unique<ExcludesConstraint>(feature("b"),
+                                                       feature("c")));
+  FM = B.buildFeatureModel();
+  ASSERT_TRUE(FM);
+  auto *A = FM->getFeature("a");
+  auto *C = FM->getFeature("c");
+
+  ConstraintEvaluator E(*FM);
+  EXPECT_TRUE(E.isSatisfied());
+
+  auto Changes = E.select(*A);
+  ASSERT_EQ(Changes.Violated.size(), 1);
+  EXPECT_EQ(Changes.Violated[0], constraint(0));
+  EXPECT_TRUE(Changes.Satisfied.empty());
+  EXPECT_FALSE(E.isSatisfied(*constraint(0)));
+  EXPECT_EQ(E.getNumViolated(), 1);
+
+  // Selecting c does not touch the violated constraint.
+  EXPECT_TRUE(E.select(*C).Violated.empty());
+
+  Changes = E.select(*FM->getFeature("b"));
+  ASSERT_EQ(Changes.Violated.size(), 1);
+  EXPECT_EQ(Changes.Violated[0], constraint(1));
+  ASSERT_EQ(Changes.Satisfied.size(), 1);
+  EXPECT_EQ(Changes.Satisfied[0], constraint(0));
+
+  Changes = E.select(*C, false);
+  EXPECT_TRUE(Changes.Violated.empty());
+  ASSERT_EQ(Changes.Satisfied.size(), 1);
+  EXPECT_TRUE(E.isSatisfied());
+
+  // Unchanged values do not report anything.
+  Changes = E.select(*C, false);
+  EXPECT_TRUE(Changes.Violated.empty());
+  EXPECT_TRUE(Changes.Satisfied.empty());
+}
+
+TEST_F(ConstraintEvaluatorTest, repeatedOccurrences) {
+  FeatureModelBuilder B;
+  B.makeFeature<BinaryFeature>("a", true);
+  B.makeFeature<BinaryFeature>("b", true);
+  // a & (!a | b) holds only if both are selected
+  B.addConstraint(std::make_unique<AndConstraint>(
+      feature("a"), std::make_unique<OrConstraint>(neg(feature("a")),
+                                                   feature("b"))));
+  // a | !a always holds
+  B.addConstraint(
+      std::make_unique<OrConstraint>(feature("a"), neg(feature("a"))));
+  FM = B.buildFeatureModel();
+  ASSERT_TRUE(FM);
+
+  ConstraintEvaluator E(*FM);
+  EXPECT_EQ(E.getViolated(), std::vector<const Constraint *>{constraint(0)});
+
+  auto Changes = E.select(*FM->getFeature("a"));
+  EXPECT_TRUE(Changes.Violated.empty());
+  EXPECT_TRUE(Changes.Satisfied.empty());
+
+  Changes = E.select(*FM->getFeature("b"));
+  ASSERT_EQ(Changes.Satisfied.size(), 1);
+  EXPECT_EQ(Changes.Satisfied[0], constraint(0));
+  EXPECT_TRUE(E.isSatisfied());
+}
+
+TEST_F(ConstraintEvaluatorTest, numericAndNary) {
+  FeatureModelBuilder B;
+  B.makeFeature<NumericFeature>("n", std::vector<int>{0, 2, 4, 8});
+  B.makeFeature<BinaryFeature>("a", true);
+  B.makeFeature<BinaryFeature>("b", true);
+  B.makeFeature<BinaryFeature>("c", true);
+  // n * 2 > 4
+  B.addConstraint(std::make_unique<GreaterConstraint>(
+      std::make_unique<MultiplicationConstraint>(feature("n"), integer(2)),
+      integer(4)));
+  // a ^ b ^ c
+  NaryConstraint::OperandContainerTy Xor;
+  Xor.push_back(feature("a"));
+  Xor.push_back(feature("b"));
+  Xor.push_back(feature("c"));
+  B.addConstraint(std::make_unique<NaryXorConstraint>(std::move(Xor)));
+  FM = B.buildFeatureModel();
+  ASSERT_TRUE(FM);
+  auto *N = FM->getFeature("n");
+
+  ConstraintEvaluator E(*FM);
+  EXPECT_EQ(E.getNumViolated(), 2);
+
+  EXPECT_EQ(E.setValue(*N, 4).Satisfied.size(), 1);
+  EXPECT_EQ(E.getValue(*N), 4);
+  EXPECT_TRUE(E.setValue(*N, 8).Satisfied.empty());
+  EXPECT_EQ(E.setValue(*N, 2).Violated.size(), 1);
+
+  EXPECT_EQ(E.select(*FM->getFeature("a")).Satisfied.size(), 1);
+  EXPECT_EQ(E.select(*FM->getFeature("b")).Violated.size(), 1);
+  EXPECT_EQ(E.select(*FM->getFeature("c")).Satisfied.size(), 1);
+  EXPECT_FALSE(E.isSatisfied(*constraint(0)));
+  EXPECT_TRUE(E.isSatisfied(*constraint(1)));
+}
+
+TEST_F(ConstraintEvaluatorTest, manyConstraints) {
+  FeatureModelBuilder B;
+  B.makeFeature<BinaryFeature>("a", true);
+  for (int I = 0; I < 1000; ++I) {
+    auto Name = "f" + std::to_string(I);
+    B.makeFeature<BinaryFeature>(Name, true);
+    B.addConstraint(
+        std::make_unique<ImpliesConstraint>(feature(Name), feature("a")));
+  }
+  FM = B.buildFeatureModel();
+  ASSERT_TRUE(FM);
+
+  ConstraintEvaluator E(*FM);
+  EXPECT_TRUE(E.select(*FM->getFeature("a")).Satisfied.empty());
+  EXPECT_TRUE(E.select(*FM->getFeature("f42")).Violated.empty());
+  auto Changes = E.select(*FM->getFeature("a"), false);
+  ASSERT_EQ(Changes.Violated.size(), 1);
+  EXPECT_EQ(Changes.Violated[0], constraint(42));
+}
+
+} // namespace vara::feature
@@ -0,0 +1,168 @@
+#include "vara/Feature/ConstraintFactory.h"
+#include "vara/Feature/FeatureModel.h"
+
+#include "UnittestHelper.h"
+
+#include "gtest/gtest.h"
+
+namespace vara::feature {
+
+class ConstraintFactoryTest : public ::testing::Test {
+protected:
+  void SetUp() override {
+    FeatureModelBuilder B;
+    B.makeFeature<BinaryFeature>("a");
+    B.makeFeature<BinaryFeature>("b");
+    B.makeFeature<BinaryFeature>("c");
+    FM = B.buildFeatureModel();
+    assert(FM);
+  }
+
+  std::unique_ptr<FeatureModel> FM;
+};
+
+TEST_F(ConstraintFactoryTest, internPrimary) {
+  ConstraintFactory CF(*FM);
+
+  const auto *A = CF.intern(*feature("a"));
+  EXPECT_EQ(A, CF.intern(*feature("a")));
+  EXPECT_EQ(A, CF.getFeature(FM->getFeature("a")));
+  EXPECT_NE(A, CF.intern(*feature("b")));
+  EXPECT_EQ(A->getFeature(), FM->getFeature("a"));
+
+  const auto *One = CF.getInteger(1);
+  EXPECT_EQ(One, CF.intern(PrimaryIntegerConstraint(1)));
+  EXPECT_NE(One, CF.getInteger(2));
+  EXPECT_EQ(One->getValue(), 1);
+}
+
+TEST_F(ConstraintFactoryTest, shareSubexpressions) {
+  ConstraintFactory CF(*FM);
+
+  // ((a | b) & (a | b)) => !(a | b)
+  auto C = std::make_unique<ImpliesConstraint>(
+      std::make_unique<AndConstraint>(
+          std::make_unique<OrConstraint>(feature("a"), feature("b")),
+          std::make_unique<OrConstraint>(feature("a"), feature("b"))),
+      std::make_unique<NotConstraint>(
+          std::make_unique<OrConstraint>(feature("a"), feature("b"))));
+
+  const auto *N = CF.intern(*C);
+
+  // a, b, (a | b), (.. & ..), !(..), (.. => ..)
+  EXPECT_EQ(CF.size(), 6);
+  EXPECT_EQ(CF.getNumRequests(), 12);
+
+  const auto *And = N->getOperand(0);
+  EXPECT_EQ(And->getOperand(0), And->getOperand(1));
+  EXPECT_EQ(And->getOperand(0), N->getOperand(1)->getOperand(0));
+  EXPECT_EQ(N, CF.intern(*C->clone()));
+}
+
+TEST_F(ConstraintFactoryTest, kindIsPartOfIdentity) {
+  ConstraintFactory CF(*FM);
+
+  const auto *A = CF.intern(*feature("a"));
+  const auto *B = CF.intern(*feature("b"));
+
+  EXPECT_NE(CF.getBinary(Constraint::ConstraintKind::CK_OR, A, B),
+            CF.getBinary(Constraint::ConstraintKind::CK_AND, A, B));
+  EXPECT_NE(CF.getBinary(Constraint::ConstraintKind::CK_IMPLIES, A, B),
+            CF.getBinary(Constraint::ConstraintKind::CK_IMPLIES, B, A));
+  EXPECT_NE(CF.getUnary(Constraint::ConstraintKind::CK_NOT, A),
+            CF.getUnary(Constraint::ConstraintKind::CK_NEG, A));
+}
+
+TEST_F(ConstraintFactoryTest, denseIDs) {
+  ConstraintFactory CF(*FM);
+
+  auto C = std::make_unique<XorConstraint>(
+      std::make_unique<OrConstraint>(feature("a"), feature("b")),
+      std::make_unique<AndConstraint>(feature("b"), feature("c")));
+  CF.intern(*C);
+
+  std::vector<bool> Seen(CF.size(), false);
+  std::vector<const InternedConstraint *> Worklist{CF.intern(*C)};
+  while (!Worklist.empty()) {
+    const auto *N = Worklist.back();
+    Worklist.pop_back();
+    ASSERT_LT(N->getID(), CF.size());
+    Seen[N->getID()] = true;
+    Worklist.insert(Worklist.end(), N->operands().begin(),
+                    N->operands().end());
+  }
+  EXPECT_TRUE(std::all_of(Seen.begin(), Seen.end(), [](bool B) { return B; }));
+}
+
+TEST_F(ConstraintFactoryTest, materialize) {
+  ConstraintFactory CF(*FM);
+
+  auto C = std::make_unique<ImpliesConstraint>(
+      std::make_unique<OrConstraint>(feature("a"), feature("b")),
+      std::make_unique<LessConstraint>(
+          std::make_unique<NegConstraint>(
+              std::make_unique<PrimaryIntegerConstraint>(1)),
+          std::make_unique<PrimaryIntegerConstraint>(2)));
+
+  auto M = ConstraintFactory::materialize(CF.intern(*C));
+  EXPECT_EQ(M->toString(), C->toString());
+
+  auto *L = llvm::dyn_cast<OrConstraint>(
+      llvm::dyn_cast<ImpliesConstraint>(M.get())->getLeftOperand());
+  ASSERT_TRUE(L);
+  EXPECT_EQ(llvm::dyn_cast<PrimaryFeatureConstraint>(L->getLeftOperand())
+                ->getFeature(),
+            FM->getFeature("a"));
+}
+
+TEST_F(ConstraintFactoryTest, deepConstraints) {
+  ConstraintFactory CF(*FM);
+  constexpr unsigned Depth = 100000;
+
+  // (a | (b | (c | ... (a | b))))
+  const char *Names[] = {"a", "b", "c"};
+  std::unique_ptr<Constraint> C = feature("b");
+  for (unsigned I = 0; I < Depth; ++I) {
+    C = std::make_unique<OrConstraint>(feature(Names[I % 3]), std::move(C));
+  }
+  const auto *N = CF.intern(*C);
+  EXPECT_EQ(N, CF.intern(*C->clone()));
+  // One node per level and per feature.
+  EXPECT_EQ(CF.size(), Depth + 3);
+
+  auto Materialized = ConstraintFactory::materialize(N);
+  EXPECT_EQ(Materialized->toString(), C->toString());
+}
+
+TEST_F(ConstraintFactoryTest, naryConstraints) {
+  ConstraintFactory CF(*FM);
+
+  auto C = NaryConstraint::flatten(std::make_unique<OrConstraint>(
+      std::make_unique<OrConstraint>(feature("a"), feature("b")),
+      feature("c")));
+  const auto *N = CF.intern(*C);
+  EXPECT_EQ(N->operands().size(), 3);
+  EXPECT_EQ(N, CF.intern(*C->clone()));
+  EXPECT_NE(N, CF.intern(*std::make_unique<OrConstraint>(
+                   std::make_unique<OrConstraint>(feature("a"), feature("b")),
+                   feature("c"))));
+  EXPECT_EQ(ConstraintFactory::materialize(N)->toString(), "(a | b | c)");
+}
+
+TEST_F(ConstraintFactoryTest, sharingOnGeneratedModel) {
+  ConstraintFactory CF(*FM);
+
+  // Generated models frequently repeat the same implications.
+  constexpr unsigned NumConstraints = 1000;
+  for (unsigned I = 0; I < NumConstraints; ++I) {
+    auto C = std::make_unique<ImpliesConstraint>(
+        std::make_unique<AndConstraint>(feature("a"), feature("b")),
+        std::make_unique<NotConstraint>(feature("c")));
+    CF.intern(*C);
+  }
+
+  EXPECT_EQ(CF.size(), 6);
+  EXPECT_EQ(CF.getNumRequests(), 6 * NumConstraints);
+}
+
+} // namespace vara::feature
@@ -0,0 +1,296 @@
+#include "vara/Feature/ConstraintNormalizer.h"
+#include "vara/Feature/FeatureModel.h"
+
+#include "UnittestHelper.h"
+
+#include "gtest/gtest.h"
+
+namespace vara::feature {
+
+class ConstraintNormalizerTest : public ::testing::Test {
+protected:
+  static std::string toString(ConstraintNormalizer::NormalizedTy N) {
+    if (std::holds_alternative<bool>(N)) {
+      return std::get<bool>(N) ? "true" : "false";
+    }
+    return std::get<std::unique_ptr<Constraint>>(N)->toString();
+  }
+};
+
+TEST_F(ConstraintNormalizerTest, negationNormalForm) {
+  ConstraintNormalizer CN;
+
+  EXPECT_EQ(toString(CN.normalize(*neg(neg(feature("a"))))), "a");
+  EXPECT_EQ(toString(CN.normalize(*neg(std::make_unique<OrConstraint>(
+                feature("a"), feature("b"))))),
+            "(!a & !b)");
+  EXPECT_EQ(toString(CN.normalize(
+                *std::make_unique<ImpliesConstraint>(feature("a"),
+                                                     feature("b")))),
+            "(!a | b)");
+  EXPECT_EQ(toString(CN.normalize(*neg(std::make_unique<ExcludesConstraint>(
+                feature("a"), feature("b"))))),
+            "(a & b)");
+  EXPECT_EQ(toString(CN.normalize(
+                *std::make_unique<EquivalenceConstraint>(feature("a"),
+                                                         feature("b")))),
+            "(a <=> b)");
+  EXPECT_EQ(toString(CN.normalize(*neg(std::make_unique<XorConstraint>(
+                std::make_unique<OrConstraint>(feature("a"), feature("b")),
+                neg(feature("c")))))),
+            "((a | b) <=> !c)");
+  EXPECT_EQ(toString(CN.normalize(*neg(std::make_unique<LessConstraint>(
+                feature("a"), integer(3))))),
+            "(a >= 3)");
+}
+
+TEST_F(ConstraintNormalizerTest, flattenAndDeduplicate) {
+  ConstraintNormalizer CN;
+
+  // (a | (b | a)) | (!c => d)
+  auto C = std::make_unique<OrConstraint>(
+      std::make_unique<OrConstraint>(
+          feature("a"), std::make_unique<OrConstraint>(feature("b"),
+                                                       feature("a"))),
+      std::make_unique<ImpliesConstraint>(neg(feature("c")), feature("d")));
+
+  EXPECT_EQ(toString(CN.normalize(*C)), "(a | b | c | d)");
+}
+
+TEST_F(ConstraintNormalizerTest, naryConstraints) {
+  ConstraintNormalizer CN;
+
+  // a | !(b & c & a)
+  NaryConstraint::OperandContainerTy Conjunction;
+  Conjunction.push_back(feature("b"));
+  Conjunction.push_back(feature("c"));
+  Conjunction.push_back(feature("a"));
+  NaryConstraint::OperandContainerTy Disjunction;
+  Disjunction.push_back(feature("a"));
+  Disjunction.push_back(
+      neg(std::make_unique<NaryAndConstraint>(std::move(Conjunction))));
+  EXPECT_EQ(toString(CN.normalize(NaryOrConstraint(std::move(Disjunction)))),
+            "true");
+
+  // parity with a constant operand: (a ^ b ^ 1) == !(a ^ b)
+  NaryConstraint::OperandContainerTy Xor;
+  Xor.push_back(feature("a"));
+  Xor.push_back(feature("b"));
+  Xor.push_back(integer(1));
+  EXPECT_EQ(toString(CN.normalize(NaryXorConstraint(std::move(Xor)))),
+            "(a <=> b)");
+
+  // !(a ^ b ^ c) negates one operand only
+  NaryConstraint::OperandContainerTy Parity;
+  Parity.push_back(feature("a"));
+  Parity.push_back(feature("b"));
+  Parity.push_back(feature("c"));
+  EXPECT_EQ(toString(CN.normalize(
+                *neg(std::make_unique<NaryXorConstraint>(std::move(Parity))))),
+            "(!a ^ b ^ c)");
+
+  // a xor without operands is false
+  EXPECT_EQ(toString(CN.normalize(
+                NaryXorConstraint(NaryConstraint::OperandContainerTy()))),
+            "false");
+}
+
+TEST_F(ConstraintNormalizerTest, parityChainsStayLinear) {
+  ConstraintNormalizer CN;
+  constexpr int Depth = 64;
+
+  // a0 <=> (a1 <=> (... <=> a64)), negated
+  std::unique_ptr<Constraint> Equivalence =
+      feature("a" + std::to_string(Depth));
+  for (int I = Depth - 1; I >= 0; --I) {
+    Equivalence = std::make_unique<EquivalenceConstraint>(
+        feature("a" + std::to_string(I)), std::move(Equivalence));
+  }
+  auto Normalized = toString(CN.normalize(*neg(std::move(Equivalence))));
+  EXPECT_EQ(Normalized.rfind("(a0 ^ (a1 <=> ", 0), 0);
+  EXPECT_LT(Normalized.size(), 20U * Depth);
+
+  NaryConstraint::OperandContainerTy Xor;
+  for (int I = 0; I < Depth; ++I) {
+    Xor.push_back(feature("a" + std::to_string(I)));
+  }
+  EXPECT_LT(toString(CN.normalize(NaryXorConstraint(std::move(Xor)))).size(),
+            20U * Depth);
+}
+
+TEST_F(ConstraintNormalizerTest, deepConstraints) {
+  ConstraintNormalizer CN;
+  constexpr unsigned Depth = 100000;
+
+  // (a | (b | (c | ... (a | b))))
+  const char *Names[] = {"a", "b", "c"};
+  std::unique_ptr<Constraint> Disjunction = feature("b");
+  for (unsigned I = 0; I < Depth; ++I) {
+    Disjunction = std::make_unique<OrConstraint>(feature(Names[I % 3]),
+                                                 std::move(Disjunction));
+  }
+  EXPECT_EQ(toString(CN.normalize(*Disjunction)), "(a | c | b)");
+
+  // 1 ^ (b & (a | (b & ... (a | b)))), which negates every level
+  std::unique_ptr<Constraint> Alternation = feature("b");
+  for (unsigned I = 0; I < Depth; ++I) {
+    if (I % 2) {
+      Alternation = std::make_unique<AndConstraint>(feature("b"),
+                                                    std::move(Alternation));
+    } else {
+      Alternation = std::make_unique<OrConstraint>(feature("a"),
+                                                   std::move(Alternation));
+    }
+  }
+  auto Negated = toString(CN.normalize(
+      XorConstraint(integer(1), std::move(Alternation))));
+  EXPECT_EQ(Negated.rfind("(!b | (!a & (!b | (!a & ", 0), 0);
+}
+
+TEST_F(ConstraintNormalizerTest, wideParity) {
+  ConstraintNormalizer CN;
+  constexpr int Width = 30;
+
+  // !(a0 ^ ... ^ a14 ^ 1 ^ a15 ^ ... ^ a29), the constant absorbs the negation
+  NaryConstraint::OperandContainerTy Xor;
+  std::string Expected;
+  for (int I = 0; I < Width; ++I) {
+    if (I == Width / 2) {
+      Xor.push_back(integer(1));
+    }
+    Xor.push_back(feature("a" + std::to_string(I)));
+    Expected += (I ? " ^ a" : "(a") + std::to_string(I);
+  }
+  EXPECT_EQ(toString(CN.normalize(
+                *neg(std::make_unique<NaryXorConstraint>(std::move(Xor))))),
+            Expected + ")");
+
+  // Constants only
+  NaryConstraint::OperandContainerTy Ones;
+  Ones.push_back(integer(1));
+  Ones.push_back(integer(1));
+  EXPECT_EQ(toString(CN.normalize(NaryXorConstraint(std::move(Ones)))),
+            "false");
+  NaryConstraint::OperandContainerTy One;
+  One.push_back(integer(1));
+  EXPECT_EQ(toString(CN.normalize(
+                *neg(std::make_unique<NaryXorConstraint>(std::move(One))))),
+            "false");
+}
+
+TEST_F(ConstraintNormalizerTest, constants) {
+  ConstraintNormalizer CN;
+
+  EXPECT_EQ(toString(CN.normalize(*std::make_unique<OrConstraint>(
+                feature("a"), neg(feature("a"))))),
+            "true");
+  EXPECT_EQ(toString(CN.normalize(*std::make_unique<AndConstraint>(
+                feature("a"), neg(feature("a"))))),
+            "false");
+  EXPECT_EQ(toString(CN.normalize(*std::make_unique<AndConstraint>(
+                feature("a"), std::make_unique<LessConstraint>(
+                                  integer(1), integer(2))))),
+            "a");
+  EXPECT_EQ(toString(CN.normalize(
+                *std::make_unique<ImpliesConstraint>(feature("a"),
+                                                     feature("a")))),
+            "true");
+}
+
+TEST_F(ConstraintNormalizerTest, foldArithmetic) {
+  ConstraintNormalizer CN;
+
+  // a * (2 + 3) - 0 > 10 / 2
+  auto C = std::make_unique<GreaterConstraint>(
+      std::make_unique<SubtractionConstraint>(
+          std::make_unique<MultiplicationConstraint>(
+              feature("a"),
+              std::make_unique<AdditionConstraint>(integer(2), integer(3))),
+          integer(0)),
+      std::make_unique<DivisionConstraint>(integer(10), integer(2)));
+  EXPECT_EQ(toString(CN.normalize(*C)), "((a * 5) > 5)");
+
+  // Division by zero and overflows are not folded.
+  auto D = std::make_unique<EqualsConstraint>(
+      std::make_unique<DivisionConstraint>(integer(1), integer(0)),
+      std::make_unique<AdditionConstraint>(integer(INT_MAX), integer(1)));
+  EXPECT_EQ(toString(CN.normalize(*D)),
+            "((1 / 0) = (" + std::to_string(INT_MAX) + " + 1))");
+}
+
+TEST_F(ConstraintNormalizerTest, resolveFeatures) {
+  FeatureModelBuilder B;
+  B.makeFeature<BinaryFeature>("a");
+  auto FM = B.buildFeatureModel();
+  ASSERT_TRUE(FM);
+
+  ConstraintNormalizer CN(FM.get());
+  auto N = CN.normalize(*neg(neg(feature("a"))));
+  ASSERT_TRUE(std::holds_alternative<std::unique_ptr<Constraint>>(N));
+  auto *P = llvm::dyn_cast<PrimaryFeatureConstraint>(
+      std::get<std::unique_ptr<Constraint>>(N).get());
+  ASSERT_TRUE(P);
+  EXPECT_EQ(P->getFeature(), FM->getFeature("a"));
+}
+
+TEST_F(ConstraintNormalizerTest, dropTreeImpliedConstraints) {
+  FeatureModelBuilder B;
+  B.makeFeature<BinaryFeature>("a", true);
+  B.makeFeature<BinaryFeature>("aa");
+  B.makeFeature<BinaryFeature>("b", true);
+  B.makeFeature<BinaryFeature>("c", true);
+  B.makeFeature<BinaryFeature>("c1");
+  B.makeFeature<BinaryFeature>("c2");
+  B.addEdge("a", "aa");
+  B.addEdge("c", "c1");
+  B.addEdge("c", "c2");
+  B.emplaceRelationship(Relationship::RelationshipKind::RK_ALTERNATIVE,
+                        {"c1", "c2"}, "c");
+
+  // implied: child implies parent, parent implies mandatory child
+  B.addConstraint(std::make_unique<ImpliesConstraint>(feature("aa"),
+                                                      feature("a")));
+  B.addConstraint(std::make_unique<ImpliesConstraint>(feature("a"),
+                                                      feature("aa")));
+  // implied: alternatives exclude each other
+  B.addConstraint(std::make_unique<ExcludesConstraint>(feature("c1"),
+                                                       feature("c2")));
+  // implied: root is always selected, tautology
+  B.addConstraint(std::make_unique<OrConstraint>(feature("b"),
+                                                 feature("root")));
+  B.addConstraint(std::make_unique<OrConstraint>(feature("b"),
+                                                 neg(feature("b"))));
+  // kept: only the second conjunct is not implied
+  B.addConstraint(std::make_unique<AndConstraint>(
+      std::make_unique<ImpliesConstraint>(feature("c1"), feature("c")),
+      std::make_unique<ImpliesConstraint>(feature("a"), feature("b"))));
+  // kept: duplicate of the previous conjunct is dropped
+  B.addConstraint(std::make_unique<OrConstraint>(neg(feature("a")),
+                                                 feature("b")));
+  auto FM = B.buildFeatureModel();
+  ASSERT_TRUE(FM);
+
+  auto Constraints = ConstraintNormalizer(FM.get()).normalizeConstraints();
+  ASSERT_EQ(Constraints.size(), 1);
+  EXPECT_EQ(Constraints[0]->toString(), "(!a | b)");
+}
+
+TEST_F(ConstraintNormalizerTest, unsatisfiableConstraints) {
+  FeatureModelBuilder B;
+  B.makeFeature<BinaryFeature>("a");
+  B.makeFeature<BinaryFeature>("b");
+  B.addConstraint(std::make_unique<OrConstraint>(feature("a"), feature("b")));
+  B.addConstraint(std::make_unique<EquivalenceConstraint>(feature("a"),
+                                                          neg(feature("a"))));
+  B.addConstraint(std::make_unique<AndConstraint>(
+      std::make_unique<XorConstraint>(feature("b"), feature("b")),
+      feature("a")));
+  auto FM = B.buildFeatureModel();
+  ASSERT_TRUE(FM);
+
+  auto Constraints = ConstraintNormalizer(FM.get()).normalizeConstraints();
+  ASSERT_EQ(Constraints.size(), 1);
+  EXPECT_EQ(Constraints[0]->toString(), "0");
+}
+
+} // namespace vara::feature
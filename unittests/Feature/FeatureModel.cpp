@@ -85,6 +85,104 @@ TEST(FeatureModel, cloneConstraint) {
   EXPECT_TRUE((*Clone->getFeature("a")->constraints().begin())->clone());
 }
 
+TEST(FeatureModel, occurrences) {
+  auto Ref = [](const std::string &Name) {
+    return std::make_unique<PrimaryFeatureConstraint>(
+        std::make_unique<Feature>(Name));
+  };
+  FeatureModelBuilder B;
+  B.makeFeature<BinaryFeature>("a");
+  B.makeFeature<BinaryFeature>("b");
+  B.makeFeature<BinaryFeature>("c");
+  B.makeFeature<NumericFeature>("n", std::vector<int>{1, 2});
+  // a => !(b | c)
+  B.addConstraint(std::make_unique<ImpliesConstraint>(
+      Ref("a"),
+      std::make_unique<NotConstraint>(
+          std::make_unique<OrConstraint>(Ref("b"), Ref("c")))));
+  // (b & !b) | (n > 1)
+  B.addConstraint(std::make_unique<OrConstraint>(
+      std::make_unique<AndConstraint>(
+          Ref("b"), std::make_unique<NotConstraint>(Ref("b"))),
+      std::make_unique<GreaterConstraint>(
+          Ref("n"), std::make_unique<PrimaryIntegerConstraint>(1))));
+  auto FM = B.buildFeatureModel();
+  ASSERT_TRUE(FM);
+  auto *First = FM->constraints().begin()->get();
+  auto *Second = std::next(FM->constraints().begin())->get();
+
+  auto A = FM->getOccurrences(*FM->getFeature("a"));
+  ASSERT_EQ(A.size(), 1);
+  EXPECT_EQ(A[0].C, First);
+  EXPECT_EQ(A[0].Polarity, OccurrencePolarity::OP_NEGATIVE);
+
+  auto Bs = FM->getOccurrences(*FM->getFeature("b"));
+  ASSERT_EQ(Bs.size(), 2);
+  EXPECT_EQ(Bs[0].C, First);
+  EXPECT_EQ(Bs[0].Polarity, OccurrencePolarity::OP_NEGATIVE);
+  EXPECT_EQ(Bs[1].C, Second);
+  EXPECT_EQ(Bs[1].Polarity, OccurrencePolarity::OP_BOTH);
+
+  auto N = FM->getOccurrences(*FM->getFeature("n"));
+  ASSERT_EQ(N.size(), 1);
+  EXPECT_EQ(N[0].Polarity, OccurrencePolarity::OP_BOTH);
+
+  EXPECT_TRUE(FM->getOccurrences(*FM->getRoot()).empty());
+
+  auto Clone = FM->clone();
+  ASSERT_TRUE(Clone);
+  auto CA = Clone->getOccurrences(*Clone->getFeature("a"));
+  ASSERT_EQ(CA.size(), 1);
+  EXPECT_EQ(CA[0].C, Clone->constraints().begin()->get());
+}
+
+TEST(FeatureModel, graphCollapseGroups) {
+  FeatureModelBuilder B;
+  B.makeFeature<BinaryFeature>("a");
+  B.addEdge("a", "a1")->makeFeature<BinaryFeature>("a1");
+  B.addEdge("a", "a2")->makeFeature<BinaryFeature>("a2");
+  B.addEdge("a1", "a11")->makeFeature<BinaryFeature>("a11");
+  B.emplaceRelationship(Relationship::RelationshipKind::RK_ALTERNATIVE,
+                        {"a1", "a2"}, "a");
+  auto FM = B.buildFeatureModel();
+  ASSERT_TRUE(FM);
+
+  FeatureModelGraphOptions Options;
+  Options.CollapseGroups = true;
+  std::string Str;
+  llvm::raw_string_ostream OS(Str);
+  FeatureModel *G = FM.get();
+  llvm::GraphWriter<FeatureModel *>(OS, G, false, Options).writeGraph("fm");
+  llvm::StringRef Dot = OS.str();
+
+  EXPECT_NE(Dot.find("<b>ALTERNATIVE</b></td></tr><tr><td>a1</td></tr>"
+                     "<tr><td>a2</td></tr>"),
+            llvm::StringRef::npos);
+  EXPECT_EQ(Dot.find("<b>a1</b>"), llvm::StringRef::npos);
+  EXPECT_EQ(Dot.find("a11"), llvm::StringRef::npos);
+}
+
+TEST(FeatureModel, graphDeep) {
+  // Deep trees are written without recursion.
+  constexpr int NumFeatures = 1000;
+  FeatureModelBuilder B;
+  B.makeFeature<BinaryFeature>("f0");
+  for (int I = 1; I < NumFeatures; ++I) {
+    B.addEdge("f" + std::to_string(I - 1), "f" + std::to_string(I))
+        ->makeFeature<BinaryFeature>("f" + std::to_string(I));
+  }
+  auto FM = B.buildFeatureModel();
+  ASSERT_TRUE(FM);
+
+  std::string Str;
+  llvm::raw_string_ostream OS(Str);
+  FeatureModel *G = FM.get();
+  llvm::GraphWriter<FeatureModel *>(OS, G, false).writeGraph("fm");
+  llvm::StringRef Dot = OS.str();
+  EXPECT_EQ(Dot.count(" -> "), NumFeatures);
+  EXPECT_EQ(Dot.count("subgraph cluster_"), NumFeatures);
+}
+
 TEST(FeatureModel, size) {
   FeatureModelBuilder B;
 
@@ -207,6 +305,55 @@ TEST_F(FeatureModelTest, gtSimple) {
   EXPECT_GT(*FM->getFeature("b"), *FM->getFeature("a"));
 }
 
+static std::string
+writeGraph(FeatureModel &FM, FeatureModelGraphOptions Options = {}) {
+  std::string Str;
+  llvm::raw_string_ostream OS(Str);
+  FeatureModel *G = &FM;
+  llvm::GraphWriter<FeatureModel *>(OS, G, false, std::move(Options))
+      .writeGraph("fm");
+  return OS.str();
+}
+
+static bool contains(llvm::StringRef Str, llvm::StringRef Sub) {
+  return Str.find(Sub) != llvm::StringRef::npos;
+}
+
+TEST_F(FeatureModelTest, graphWhole) {
+  auto Dot = writeGraph(*FM);
+  for (const auto *Name : {"root", "a", "aa", "ab", "b", "ba", "bb", "c"}) {
+    EXPECT_TRUE(contains(Dot, (llvm::Twine("<b>") + Name + "</b>").str()));
+  }
+  EXPECT_EQ(llvm::StringRef(Dot).count(" -> "), 7);
+  EXPECT_EQ(llvm::StringRef(Dot).count('{'), llvm::StringRef(Dot).count('}'));
+  EXPECT_FALSE(contains(Dot, "style=dashed"));
+}
+
+TEST_F(FeatureModelTest, graphSubtree) {
+  FeatureModelGraphOptions Options;
+  Options.Root = "b";
+  auto Dot = writeGraph(*FM, Options);
+  EXPECT_TRUE(contains(Dot, "<b>b</b>"));
+  EXPECT_TRUE(contains(Dot, "<b>ba</b>"));
+  EXPECT_TRUE(contains(Dot, "<b>bb</b>"));
+  EXPECT_FALSE(contains(Dot, "<b>root</b>"));
+  EXPECT_FALSE(contains(Dot, "<b>a</b>"));
+  EXPECT_EQ(llvm::StringRef(Dot).count(" -> "), 2);
+}
+
+TEST_F(FeatureModelTest, graphDepth) {
+  FeatureModelGraphOptions Options;
+  Options.MaxDepth = 1;
+  auto Dot = writeGraph(*FM, Options);
+  EXPECT_TRUE(contains(Dot, "<b>a</b>"));
+  EXPECT_TRUE(contains(Dot, "<b>c</b>"));
+  EXPECT_FALSE(contains(Dot, "<b>aa</b>"));
+  EXPECT_FALSE(contains(Dot, "<b>ba</b>"));
+  // a and b have hidden children, c is a leaf.
+  EXPECT_EQ(llvm::StringRef(Dot).count("style=dashed"), 2);
+  EXPECT_EQ(llvm::StringRef(Dot).count(" -> "), 3);
+}
+
 //===----------------------------------------------------------------------===//
 //                    FeatureModelConsistencyChecker Tests
 //===----------------------------------------------------------------------===//
@@ -228,8 +375,9 @@ protected:
     assert(FM);
   }
 
-  // Dummy method to fulfill the FeatureModelModification interface
-  void exec(FeatureModel &_) override{};
+  // Dummy methods to fulfill the FeatureModelModification interface
+  bool exec(FeatureModel &_) override { return true; };
+  void undo(FeatureModel &_) override{};
 
   std::unique_ptr<FeatureModel> FM;
 };
@@ -271,6 +419,20 @@ TEST_F(FeatureModelConsistencyCheckerTest,
                CheckFeatureParentChildRelationShip>::isFeatureModelValid(*FM));
 }
 
+TEST_F(FeatureModelConsistencyCheckerTest, OnlyGivenFeaturesAreChecked) {
+  using Checker =
+      FeatureModelConsistencyChecker<EveryFeatureRequiresParent,
+                                     CheckFeatureParentChildRelationShip>;
+  FeatureModelModification::removeChild(*FM->getFeature("a"),
+                                        *FM->getFeature("aa"));
+
+  EXPECT_FALSE(Checker::isFeatureModelValid(*FM));
+  EXPECT_TRUE(Checker::areFeaturesValid(
+      *FM, std::vector<Feature *>{FM->getFeature("a"), FM->getFeature("ab")}));
+  EXPECT_FALSE(Checker::areFeaturesValid(
+      *FM, std::vector<Feature *>{FM->getFeature("ab"), FM->getFeature("aa")}));
+}
+
 TEST_F(FeatureModelConsistencyCheckerTest,
        EveryFMNeedsOneRootOnlyOneRootPresent) {
   EXPECT_TRUE(
@@ -298,6 +460,9 @@ TEST_F(FeatureModelConsistencyCheckerTest,
   EXPECT_FALSE(
       FeatureModelConsistencyChecker<ExactlyOneRootNode>::isFeatureModelValid(
           *FM));
+  EXPECT_FALSE(
+      FeatureModelConsistencyChecker<ExactlyOneRootNode>::areFeaturesValid(
+          *FM, std::vector<Feature *>{FM->getFeature("b")}));
 }
 
 } // namespace vara::feature
@@ -99,6 +99,18 @@ TEST(FeatureModelBuilder, addOrConstraint) {
       Expected);
 }
 
+TEST(FeatureModelBuilder, addConstraintUnknownFeature) {
+  FeatureModelBuilder B;
+  B.makeFeature<BinaryFeature>("a");
+  B.addConstraint(std::make_unique<OrConstraint>(
+      std::make_unique<PrimaryFeatureConstraint>(
+          std::make_unique<Feature>("a")),
+      std::make_unique<PrimaryFeatureConstraint>(
+          std::make_unique<Feature>("b"))));
+
+  EXPECT_FALSE(B.buildFeatureModel());
+}
+
 TEST(FeatureModelBuilder, addBinaryFeatureRef) {
   FeatureModelBuilder B;
 
@@ -1,10 +1,15 @@
 #include "vara/Feature/FeatureModelParser.h"
+#include "vara/Feature/FeatureModelWriter.h"
 
 #include "UnittestHelper.h"
 
 #include "llvm/Support/MemoryBuffer.h"
 #include "gtest/gtest.h"
 
+#include <limits>
+#include <map>
+#include <thread>
+
 namespace vara::feature {
 
 TEST(FeatureModelParser, onlyChildren) {
@@ -40,4 +45,367 @@ TEST(FeatureModelParser, outOfOrder) {
   EXPECT_TRUE(P.buildFeatureModel());
 }
 
+TEST(FeatureModelParser, streamingMatchesDom) {
+  for (const auto *File :
+       {"test.xml", "test_children.xml", "test_excludes.xml",
+        "test_numeric.xml", "test_only_children.xml", "test_only_parents.xml",
+        "test_out_of_order.xml"}) {
+    auto FS = llvm::MemoryBuffer::getFileAsStream(getTestResource(File));
+    assert(FS);
+
+    auto Dom = FeatureModelXmlParser(FS.get()->getBuffer().str());
+    auto Stream = FeatureModelXmlParser(FS.get()->getBuffer().str(), true);
+    EXPECT_TRUE(Stream.verifyFeatureModel()) << File;
+    auto DomFM = Dom.buildFeatureModel();
+    auto StreamFM = Stream.buildFeatureModel();
+    ASSERT_TRUE(DomFM) << File;
+    ASSERT_TRUE(StreamFM) << File;
+
+    EXPECT_EQ(FeatureModelXmlWriter(*StreamFM).writeFeatureModel(),
+              FeatureModelXmlWriter(*DomFM).writeFeatureModel())
+        << File;
+  }
+}
+
+TEST(FeatureModelParser, streamingRejectsInvalid) {
+  // name is required as first element of a configurationOption
+  auto P = FeatureModelXmlParser(
+      "<vm name=\"v\"><binaryOptions><configurationOption><optional>True"
+      "</optional></configurationOption></binaryOptions></vm>",
+      true);
+  EXPECT_FALSE(P.verifyFeatureModel());
+  EXPECT_FALSE(P.buildFeatureModel());
+
+  // missing attribute
+  EXPECT_FALSE(
+      FeatureModelXmlParser("<vm><binaryOptions/></vm>", true)
+          .verifyFeatureModel());
+  // unknown element
+  EXPECT_FALSE(FeatureModelXmlParser(
+                   "<vm name=\"v\"><binaryOptions/><foo/></vm>", true)
+                   .verifyFeatureModel());
+  // not well-formed
+  EXPECT_FALSE(
+      FeatureModelXmlParser("<vm name=\"v\"><binaryOptions></vm>", true)
+          .verifyFeatureModel());
+  EXPECT_TRUE(FeatureModelXmlParser("<vm name=\"v\"><binaryOptions/></vm>",
+                                    true)
+                  .buildFeatureModel());
+}
+
+TEST(FeatureModelParser, trustedInput) {
+  // Misplaced optional violates the DTD, but is well-formed.
+  const std::string Xml =
+      "<vm name=\"v\"><binaryOptions><configurationOption><optional>True"
+      "</optional><name>a</name></configurationOption></binaryOptions></vm>";
+
+  for (bool Streaming : {false, true}) {
+    auto P = FeatureModelXmlParser(Xml, Streaming);
+    EXPECT_FALSE(P.verifyFeatureModel());
+    P.setTrustedInput();
+    EXPECT_TRUE(P.verifyFeatureModel());
+    auto FM = P.buildFeatureModel();
+    ASSERT_TRUE(FM);
+    EXPECT_TRUE(FM->getFeature("a"));
+
+    auto Malformed = FeatureModelXmlParser("<vm name=\"v\">", Streaming);
+    Malformed.setTrustedInput();
+    EXPECT_FALSE(Malformed.verifyFeatureModel());
+  }
+}
+
+TEST(FeatureModelParser, reuseParserContexts) {
+  auto FS = llvm::MemoryBuffer::getFileAsStream(getTestResource("test.xml"));
+  assert(FS);
+  const std::string Xml = FS.get()->getBuffer().str();
+
+  auto Parse = [&Xml](bool Streaming) {
+    for (int I = 0; I < 20; ++I) {
+      // An invalid document in between must not affect later parses.
+      EXPECT_FALSE(
+          FeatureModelXmlParser("<vm/>", Streaming).verifyFeatureModel());
+      EXPECT_TRUE(FeatureModelXmlParser(Xml, Streaming).buildFeatureModel());
+    }
+  };
+
+  std::vector<std::thread> Threads;
+  for (int I = 0; I < 4; ++I) {
+    Threads.emplace_back(Parse, I % 2 == 0);
+  }
+  for (auto &T : Threads) {
+    T.join();
+  }
+}
+
+TEST(FeatureModelParser, fromFile) {
+  auto P = FeatureModelXmlParser::fromFile(getTestResource("test.xml"));
+  ASSERT_TRUE(P);
+  EXPECT_TRUE(P->verifyFeatureModel());
+  EXPECT_TRUE(P->buildFeatureModel());
+
+  auto Streaming =
+      FeatureModelXmlParser::fromFile(getTestResource("test.xml"), true);
+  ASSERT_TRUE(Streaming);
+  EXPECT_TRUE(Streaming->buildFeatureModel());
+
+  EXPECT_FALSE(FeatureModelXmlParser::fromFile(
+      getTestResource("does_not_exist.xml")));
+}
+
+TEST(FeatureModelParser, borrowedBuffer) {
+  auto FS = llvm::MemoryBuffer::getFileAsStream(getTestResource("test.xml"));
+  assert(FS);
+
+  // Both parsers read from the same buffer without copying it.
+  auto Expected =
+      FeatureModelXmlWriter(*FeatureModelXmlParser(FS.get()->getBuffer().str())
+                                 .buildFeatureModel())
+          .writeFeatureModel();
+  for (bool Streaming : {false, true}) {
+    auto FM = FeatureModelXmlParser(FS.get()->getMemBufferRef(), Streaming)
+                  .buildFeatureModel();
+    ASSERT_TRUE(FM);
+    EXPECT_EQ(FeatureModelXmlWriter(*FM).writeFeatureModel(), Expected);
+  }
+
+  // Input without a terminating null character.
+  llvm::StringRef Xml = FS.get()->getBuffer();
+  auto Copy = llvm::MemoryBuffer::getMemBufferCopy(Xml.str() + "garbage");
+  llvm::MemoryBufferRef Prefix(Copy->getBuffer().take_front(Xml.size()),
+                               "test.xml");
+  EXPECT_TRUE(FeatureModelXmlParser(Prefix).buildFeatureModel());
+}
+
+TEST(FeatureModelParser, loadFeatureModels) {
+  std::vector<std::string> Files = {"test.xml", "test_only_children.xml",
+                                    "test_only_parents.xml",
+                                    "test_out_of_order.xml"};
+  std::vector<std::string> Paths;
+  for (int I = 0; I < 25; ++I) {
+    for (const auto &File : Files) {
+      Paths.push_back(getTestResource(File));
+    }
+  }
+  std::vector<std::string> Expected;
+  for (const auto &Path : Paths) {
+    Expected.push_back(*FeatureModelXmlWriter(
+                            *FeatureModelXmlParser::fromFile(Path)
+                                 ->buildFeatureModel())
+                            .writeFeatureModel());
+  }
+  Paths.push_back(getTestResource("does_not_exist.xml"));
+  Paths.push_back(getTestResource("sxfm_example.sxfm"));
+
+  for (unsigned Threads : {1U, 4U, 0U}) {
+    auto Models = loadFeatureModels(Paths, Threads);
+    ASSERT_EQ(Models.size(), Paths.size());
+    for (size_t I = 0; I < Paths.size() - 2; ++I) {
+      ASSERT_TRUE(Models[I]);
+      EXPECT_EQ(*FeatureModelXmlWriter(*Models[I].FM).writeFeatureModel(),
+                Expected[I]);
+    }
+    EXPECT_EQ(Models[Paths.size() - 2].Error,
+              std::errc::no_such_file_or_directory);
+    EXPECT_FALSE(Models[Paths.size() - 1]);
+    EXPECT_EQ(Models[Paths.size() - 1].Error, std::errc::invalid_argument);
+  }
+
+  EXPECT_TRUE(loadFeatureModels({}).empty());
+}
+
+TEST(FeatureModelParser, numericValues) {
+  auto FS =
+      llvm::MemoryBuffer::getFileAsStream(getTestResource("test_numeric.xml"));
+  assert(FS);
+
+  for (bool Streaming : {false, true}) {
+    auto FM = FeatureModelXmlParser(FS.get()->getBuffer().str(), Streaming)
+                  .buildFeatureModel();
+    ASSERT_TRUE(FM);
+
+    auto *Values = llvm::dyn_cast<NumericFeature>(FM->getFeature("Values"));
+    ASSERT_TRUE(Values);
+    EXPECT_EQ(std::get<std::vector<int>>(Values->getValues()),
+              std::vector<int>({-5, 0, 7, std::numeric_limits<int>::max(),
+                                std::numeric_limits<int>::min()}));
+
+    auto *Range = llvm::dyn_cast<NumericFeature>(FM->getFeature("Range"));
+    ASSERT_TRUE(Range);
+    EXPECT_EQ((std::get<std::pair<int, int>>(Range->getValues())),
+              std::make_pair(-10, 10));
+    auto Location = *Range->getLocationsBegin();
+    EXPECT_EQ(Location.getStart()->getLineNumber(), 12);
+    EXPECT_EQ(Location.getEnd()->getColumnOffset(), 17);
+  }
+}
+
+TEST(FeatureModelParser, malformedNumericValues) {
+  auto FS =
+      llvm::MemoryBuffer::getFileAsStream(getTestResource("test_numeric.xml"));
+  assert(FS);
+  std::string Xml = FS.get()->getBuffer().str();
+
+  for (const auto &[From, To] :
+       std::initializer_list<std::pair<std::string, std::string>>{
+           {"-5;", "5x;"},
+           {"-5;", ";"},
+           {"-5;", "--5;"},
+           {"2147483647", "2147483648"},
+           {"-2147483648", "-2147483649"},
+           {"<minValue>-10", "<minValue>"},
+           {"<maxValue>10", "<maxValue>1 0"},
+           {"<column>3", "<column>three"}}) {
+    std::string Malformed = Xml;
+    Malformed.replace(Malformed.find(From), From.size(), To);
+    for (bool Streaming : {false, true}) {
+      EXPECT_FALSE(
+          FeatureModelXmlParser(Malformed, Streaming).buildFeatureModel())
+          << To;
+    }
+  }
+}
+
+TEST(FeatureModelParser, lazyLocations) {
+  for (const auto *File : {"test.xml", "test_numeric.xml"}) {
+    auto FS = llvm::MemoryBuffer::getFileAsStream(getTestResource(File));
+    assert(FS);
+    auto Eager =
+        FeatureModelXmlParser(FS.get()->getBuffer().str()).buildFeatureModel();
+    auto Expected = FeatureModelXmlWriter(*Eager).writeFeatureModel();
+
+    for (bool Streaming : {false, true}) {
+      // The model keeps a copy of borrowed input, which is released first.
+      auto Buffer = llvm::MemoryBuffer::getMemBufferCopy(FS.get()->getBuffer());
+      auto P = FeatureModelXmlParser(Buffer->getMemBufferRef(), Streaming);
+      P.setLazyLocations();
+      auto FM = P.buildFeatureModel();
+      Buffer.reset();
+      ASSERT_TRUE(FM) << File;
+      EXPECT_EQ(FeatureModelXmlWriter(*FM).writeFeatureModel(), Expected)
+          << File;
+    }
+  }
+}
+
+TEST(FeatureModelParser, lazyLocationsSkipComments) {
+  auto FS = llvm::MemoryBuffer::getFileAsStream(getTestResource("test.xml"));
+  assert(FS);
+  std::string Xml = FS.get()->getBuffer().str();
+  Xml.insert(Xml.find("<binaryOptions>"),
+             "<!-- <locations><sourceRange><path>comment.c</path>"
+             "</sourceRange></locations> -->");
+
+  for (bool Streaming : {false, true}) {
+    auto P = FeatureModelXmlParser(Xml, Streaming);
+    P.setLazyLocations();
+    auto FM = P.buildFeatureModel();
+    ASSERT_TRUE(FM);
+    auto *A = FM->getFeature("A");
+    ASSERT_TRUE(A->hasLocations());
+    EXPECT_EQ(A->getLocationsBegin()->getPath(), "main.c");
+    EXPECT_EQ(A->getLocationsBegin()->getStart()->getLineNumber(), 6);
+  }
+}
+
+TEST(FeatureModelParser, lazyLocationsRequireStandaloneRanges) {
+  auto FS = llvm::MemoryBuffer::getFileAsStream(getTestResource("test.xml"));
+  assert(FS);
+  const std::string Xml = FS.get()->getBuffer().str();
+  auto Replace = [&Xml](llvm::StringRef From, llvm::StringRef To) {
+    std::string Result = Xml;
+    Result.replace(Result.find(From.str()), From.size(), To.str());
+    return Result;
+  };
+
+  for (const auto &Input :
+       {Replace("encoding=\"UTF-8\"", "encoding=\"ISO-8859-1\""),
+        Replace("<!DOCTYPE vm SYSTEM \"vm.dtd\">",
+                "<!DOCTYPE vm SYSTEM \"vm.dtd\" [\n"
+                "  <!ENTITY main \"main.c\">\n"
+                "]>"),
+        "\xEF\xBB\xBF" + Replace("<!DOCTYPE vm SYSTEM \"vm.dtd\">",
+                                   "<!-- > --><!DOCTYPE vm [ ]>")}) {
+    for (bool Streaming : {false, true}) {
+      auto P = FeatureModelXmlParser(Input, Streaming);
+      P.setLazyLocations();
+      EXPECT_FALSE(P.buildFeatureModel()) << Input.substr(0, 80);
+    }
+  }
+
+  // Only the subset is rejected, quoted brackets are part of identifiers.
+  auto P = FeatureModelXmlParser(
+      Replace("SYSTEM \"vm.dtd\"", "SYSTEM \"[vm].dtd\""));
+  P.setLazyLocations();
+  EXPECT_TRUE(P.buildFeatureModel());
+}
+
+TEST(FeatureModelParser, lazyLocationsReportErrors) {
+  FeatureModelBuilder B;
+  B.makeFeature<BinaryFeature>("a");
+  B.makeFeature<BinaryFeature>("b");
+  B.setLocationLoader("a", []() { return std::nullopt; });
+  B.setLocationLoader("b", []() {
+    return std::vector<FeatureSourceRange>{FeatureSourceRange("b.c")};
+  });
+  auto FM = B.buildFeatureModel();
+  ASSERT_TRUE(FM);
+
+  EXPECT_TRUE(FM->getFeature("a")->hasLocationError());
+  EXPECT_FALSE(FM->getFeature("a")->hasLocations());
+  EXPECT_FALSE(FM->getFeature("b")->hasLocationError());
+  EXPECT_TRUE(FM->getFeature("b")->hasLocations());
+}
+
+TEST(FeatureModelParser, updateFeatureModel) {
+  // Feature lists of alternatives depend on how a model was built, so the
+  // models are compared by their structure instead of their xml.
+  auto Describe = [](FeatureModel &FM) {
+    std::vector<std::string> Description;
+    for (auto *F : FM.features()) {
+      auto *Parent = F->getParent();
+      Description.push_back(
+          F->getName().str() + (F->isOptional() ? "?" : "") + " in " +
+          (F->getParentFeature() ? F->getParentFeature()->getName().str()
+                                 : "") +
+          (llvm::isa_and_nonnull<Relationship>(Parent) ? " group" : ""));
+    }
+    std::vector<std::string> Constraints;
+    for (const auto &C : FM.constraints()) {
+      Constraints.push_back(C->toString());
+    }
+    std::sort(Constraints.begin(), Constraints.end());
+    Description.insert(Description.end(), Constraints.begin(),
+                       Constraints.end());
+    return Description;
+  };
+
+  auto FM = FeatureModelXmlParser::fromFile(getTestResource("test.xml"))
+                ->buildFeatureModel();
+  ASSERT_TRUE(FM);
+
+  for (const auto *File :
+       {"test.xml", "test_children.xml", "test_excludes.xml",
+        "test_numeric.xml", "test_only_children.xml", "test.xml"}) {
+    std::map<std::string, std::pair<Feature *, Feature::FeatureKind>> Before;
+    for (auto *F : FM->features()) {
+      Before[F->getName().str()] = {F, F->getKind()};
+    }
+
+    ASSERT_TRUE(FeatureModelXmlParser::fromFile(getTestResource(File))
+                    ->updateFeatureModel(*FM))
+        << File;
+    auto Expected = FeatureModelXmlParser::fromFile(getTestResource(File))
+                        ->buildFeatureModel();
+    EXPECT_EQ(Describe(*FM), Describe(*Expected)) << File;
+
+    for (auto *F : FM->features()) {
+      auto Search = Before.find(F->getName().str());
+      if (Search != Before.end() && Search->second.second == F->getKind()) {
+        EXPECT_EQ(Search->second.first, F)
+            << File << ": " << F->getName().str();
+      }
+    }
+  }
+}
+
 } // namespace vara::feature
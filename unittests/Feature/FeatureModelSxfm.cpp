@@ -63,6 +63,53 @@ TEST(SxfmParser, parsing) {
             Feature::FeatureKind::FK_BINARY);
 }
 
+/// Check whether the cross-tree constraints are parsed and that literals are
+/// resolved by the ids of the feature tree.
+TEST(SxfmParser, constraints) {
+  auto FS =
+      llvm::MemoryBuffer::getFileAsStream(getTestResource("sxfm_example.sxfm"));
+  EXPECT_TRUE(FS && "Input file could not be read.");
+  auto FM =
+      FeatureModelSxfmParser(FS.get()->getBuffer().str()).buildFeatureModel();
+  ASSERT_TRUE(FM);
+
+  auto *A = FM->getFeature("a");
+  ASSERT_EQ(std::distance(A->constraints().begin(), A->constraints().end()), 1);
+  EXPECT_EQ((*A->constraints().begin())->getRoot()->toString(), "(!a | opt2)");
+
+  auto *E = FM->getFeature("e");
+  ASSERT_EQ(std::distance(E->constraints().begin(), E->constraints().end()), 1);
+  EXPECT_EQ((*E->constraints().begin())->getRoot()->toString(), "(!c | !e)");
+}
+
+/// Check that clauses with more than two literals are parsed.
+TEST(SxfmParser, constraintsLongClause) {
+  auto FS = llvm::MemoryBuffer::getFileAsStream(getTestResource("test.sxfm"));
+  EXPECT_TRUE(FS && "Input file could not be read.");
+  auto FM =
+      FeatureModelSxfmParser(FS.get()->getBuffer().str()).buildFeatureModel();
+  ASSERT_TRUE(FM);
+
+  auto *F = FM->getFeature("noCompression");
+  EXPECT_EQ(std::distance(F->constraints().begin(), F->constraints().end()), 3);
+  auto *C = FM->getFeature("compressionLevel_1");
+  ASSERT_EQ(std::distance(C->constraints().begin(), C->constraints().end()), 1);
+  EXPECT_EQ(
+      (*C->constraints().begin())->getRoot()->toString(),
+      "(!noCompression | !compressionLevel_1 | !compressionLevel_5 | "
+      "!compressionLevel_9)");
+}
+
+/// Check whether constraints referencing unknown features lead to errors.
+TEST(SxfmParser, wrong_constraint) {
+  auto FS = llvm::MemoryBuffer::getFileAsStream(
+      getTestResource("test_wrong_constraint.sxfm"));
+  EXPECT_TRUE(FS && "Input file could not be read.");
+  auto FM =
+      FeatureModelSxfmParser(FS.get()->getBuffer().str()).buildFeatureModel();
+  EXPECT_FALSE(FM);
+}
+
 /// Check whether the wrong indentation leads to errors.
 TEST(SxfmParser, wrong_indentation) {
   auto FS = llvm::MemoryBuffer::getFileAsStream(
@@ -82,4 +129,67 @@ TEST(SxfmParser, wrong_xml_format) {
   EXPECT_FALSE(FM.verifyFeatureModel());
 }
 
+TEST(SxfmParser, fromFile) {
+  auto P =
+      FeatureModelSxfmParser::fromFile(getTestResource("sxfm_example.sxfm"));
+  ASSERT_TRUE(P);
+  auto FM = P->buildFeatureModel();
+  ASSERT_TRUE(FM);
+  EXPECT_EQ(FM->size(), 17);
+
+  EXPECT_FALSE(
+      FeatureModelSxfmParser::fromFile(getTestResource("does_not_exist.sxfm")));
+}
+
+/// Check a generated feature tree with many features and nested groups.
+TEST(SxfmParser, largeTree) {
+  std::string Sxfm = "<feature_model name=\"large\">\n<feature_tree>\n"
+                     ":r root(root)\n";
+  for (int I = 0; I < 1000; ++I) {
+    auto N = std::to_string(I);
+    Sxfm += "\t:o f" + N + "(id_f" + N + ")\n";
+    Sxfm += "\t\t:g [1,*] g" + N + "(id_g" + N + ")\n";
+    Sxfm += "\t\t\t: a" + N + "(id_a" + N + ")\n";
+    Sxfm += "\t\t\t\t:m m" + N + "(id_m" + N + ")\n";
+    Sxfm += "\t\t\t: b" + N + "(id_b" + N + ")\n";
+  }
+  Sxfm += "</feature_tree>\n<constraints>\n"
+          "c1: ~id_a0 or id_m999\n</constraints>\n</feature_model>\n";
+
+  auto FM = FeatureModelSxfmParser(Sxfm).buildFeatureModel();
+  ASSERT_TRUE(FM);
+  EXPECT_EQ(FM->size(), 5001);
+
+  for (const auto *N : {"0", "500", "999"}) {
+    auto *G = FM->getFeature(std::string("g") + N);
+    ASSERT_TRUE(G);
+    EXPECT_EQ(G->getParentFeature()->getName(), std::string("f") + N);
+    auto *R = llvm::dyn_cast<Relationship>(
+        FM->getFeature(std::string("a") + N)->getParent());
+    ASSERT_TRUE(R);
+    EXPECT_EQ(R->getKind(), Relationship::RelationshipKind::RK_OR);
+    EXPECT_EQ(R->getParent(), G);
+    auto *M = FM->getFeature(std::string("m") + N);
+    EXPECT_EQ(M->getParentFeature()->getName(), std::string("a") + N);
+  }
+  auto *A = FM->getFeature("a0");
+  ASSERT_EQ(std::distance(A->constraints().begin(), A->constraints().end()), 1);
+  EXPECT_EQ((*A->constraints().begin())->getRoot()->toString(), "(!a0 | m999)");
+}
+
+/// Check that features indented less than the root and truncated lines are
+/// rejected.
+TEST(SxfmParser, malformedLines) {
+  for (const auto *Tree : {"\t:r root(root)\n:o a(a)\n",
+                           ":r root(root)\n\t:\n",
+                           ":r root(root)\n\t\t\t:o a(a)\n"}) {
+    std::string Sxfm = std::string("<feature_model name=\"m\">\n"
+                                   "<feature_tree>\n") +
+                       Tree +
+                       "</feature_tree>\n<constraints>\n</constraints>\n"
+                       "</feature_model>\n";
+    EXPECT_FALSE(FeatureModelSxfmParser(Sxfm).buildFeatureModel()) << Tree;
+  }
+}
+
 } // namespace vara::feature
\ No newline at end of file
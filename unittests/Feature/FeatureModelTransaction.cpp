@@ -20,8 +20,9 @@ protected:
     FM = B.buildFeatureModel();
   }
 
-  // Dummy method to fulfill the FeatureModelModification interface
-  void exec(FeatureModel &_) override{};
+  // Dummy methods to fulfill the FeatureModelModification interface
+  bool exec(FeatureModel &_) override { return true; };
+  void undo(FeatureModel &_) override{};
 
   std::unique_ptr<FeatureModel> FM;
 };
@@ -70,6 +71,50 @@ TEST_F(FeatureModelModificationTest, addFeatureToModel_twoSuccessivley) {
   EXPECT_EQ(FM->getFeature("a"), FM->getFeature("ab")->getParentFeature());
 }
 
+TEST_F(FeatureModelModificationTest, removeFeatureFromModel_withChildren) {
+  FeatureModelModification::make_modification<AddFeatureToModel>(
+      std::make_unique<BinaryFeature>("aa"), FM->getFeature("a"))(*FM);
+
+  EXPECT_FALSE(
+      FeatureModelModification::make_modification<RemoveFeatureFromModel>(
+          FM->getFeature("a"))(*FM));
+  EXPECT_TRUE(
+      FeatureModelModification::make_modification<RemoveFeatureFromModel>(
+          FM->getFeature("aa"))(*FM));
+  EXPECT_FALSE(FM->getFeature("aa"));
+  EXPECT_TRUE(FM->getFeature("a")->getChildren<Feature>().empty());
+}
+
+TEST_F(FeatureModelModificationTest, setParentOfFeature_cycle) {
+  FeatureModelModification::make_modification<AddFeatureToModel>(
+      std::make_unique<BinaryFeature>("aa"), FM->getFeature("a"))(*FM);
+
+  EXPECT_FALSE(FeatureModelModification::make_modification<SetParentOfFeature>(
+      FM->getFeature("a"), FM->getFeature("aa"))(*FM));
+  EXPECT_EQ(FM->getFeature("a"), FM->getFeature("aa")->getParentFeature());
+}
+
+TEST_F(FeatureModelModificationTest, commitChecksTouchedFeaturesOnly) {
+  auto *A = FM->getFeature("a");
+  auto *B = FeatureModelModification::make_modification<AddFeatureToModel>(
+      std::make_unique<BinaryFeature>("b"))(*FM);
+  ASSERT_TRUE(B);
+
+  // "b" is no child of its parent anymore, which only a check of the whole
+  // model notices, unless the transaction touches "b".
+  auto Untouched = FeatureModelModifyTransaction::openTransaction(*FM);
+  Untouched.setOptional(A, true);
+  auto Touched = FeatureModelModifyTransaction::openTransaction(*FM);
+  Touched.setOptional(B, true);
+  removeChild(*FM->getRoot(), *B);
+
+  EXPECT_TRUE(Untouched.commit());
+  EXPECT_TRUE(A->isOptional());
+  EXPECT_FALSE(Touched.commit());
+  EXPECT_FALSE(B->isOptional());
+  addChild(*FM->getRoot(), *B);
+}
+
 } // namespace detail
 
 //===----------------------------------------------------------------------===//
@@ -152,6 +197,110 @@ TEST_F(FeatureModelTransactionCopyTest, addFeatureToModelThenAboard) {
   EXPECT_FALSE(FM->getFeature("ab")); // Change should not be visible
 }
 
+TEST_F(FeatureModelTransactionCopyTest, addConstraintToModel) {
+  auto FT = FeatureModelCopyTransaction::openTransaction(*FM);
+  auto *C = FT.addConstraint(std::make_unique<NotConstraint>(
+      std::make_unique<PrimaryFeatureConstraint>(
+          std::make_unique<Feature>("a"))));
+  EXPECT_TRUE(C);
+  EXPECT_FALSE(FT.addConstraint(std::make_unique<PrimaryFeatureConstraint>(
+      std::make_unique<Feature>("missing"))));
+
+  auto NewFM = FT.commit();
+
+  // Changes should not be visible on the old model
+  EXPECT_TRUE(FM->getOccurrences(*FM->getFeature("a")).empty());
+  EXPECT_EQ(FM->constraints().begin(), FM->constraints().end());
+
+  // Changes should be visible on the new model
+  auto Occurrences = NewFM->getOccurrences(*NewFM->getFeature("a"));
+  ASSERT_EQ(Occurrences.size(), 1);
+  EXPECT_EQ(Occurrences[0].C, C);
+  EXPECT_EQ(Occurrences[0].Polarity, OccurrencePolarity::OP_NEGATIVE);
+  EXPECT_EQ(std::distance(NewFM->constraints().begin(),
+                          NewFM->constraints().end()),
+            1);
+}
+
+TEST_F(FeatureModelTransactionCopyTest, removeConstraintsInSequence) {
+  FeatureModelBuilder B;
+  for (const auto *Name : {"a", "b", "c"}) {
+    B.makeFeature<BinaryFeature>(Name);
+    B.addConstraint(std::make_unique<PrimaryFeatureConstraint>(
+        std::make_unique<Feature>(Name)));
+  }
+  FM = B.buildFeatureModel();
+  ASSERT_TRUE(FM);
+  std::vector<Constraint *> Constraints;
+  for (const auto &C : FM->constraints()) {
+    Constraints.push_back(C.get());
+  }
+
+  // The first removal must not shift the constraint the second one finds.
+  auto FT = FeatureModelCopyTransaction::openTransaction(*FM);
+  EXPECT_TRUE(FT.removeConstraint(Constraints[0]));
+  EXPECT_TRUE(FT.removeConstraint(Constraints[1]));
+  EXPECT_FALSE(FT.removeConstraint(Constraints[0]));
+  auto NewFM = FT.commit();
+  ASSERT_TRUE(NewFM);
+
+  ASSERT_EQ(std::distance(NewFM->constraints().begin(),
+                          NewFM->constraints().end()),
+            1);
+  EXPECT_EQ((*NewFM->constraints().begin())->toString(), "c");
+}
+
+TEST_F(FeatureModelTransactionCopyTest, removeFeatureAndGroupChildren) {
+  auto FT = FeatureModelCopyTransaction::openTransaction(*FM);
+  auto *B = FT.addFeature(std::make_unique<BinaryFeature>("b"), nullptr);
+  auto *C = FT.addFeature(std::make_unique<BinaryFeature>("c"), nullptr);
+  EXPECT_TRUE(FT.setParent(B, FM->getFeature("a")));
+  EXPECT_TRUE(FT.setParent(C, FM->getFeature("a")));
+  auto *R = FT.addRelationship(Relationship::RelationshipKind::RK_ALTERNATIVE,
+                               FM->getFeature("a"), {B, C});
+  ASSERT_TRUE(R);
+  EXPECT_TRUE(FT.removeFeature(C));
+
+  auto NewFM = FT.commit();
+
+  ASSERT_TRUE(NewFM);
+  EXPECT_FALSE(NewFM->getFeature("c"));
+  EXPECT_EQ(NewFM->getFeature("b")->getParent(), R);
+  EXPECT_EQ(R->getParent(), NewFM->getFeature("a"));
+  // Changes should not be visible on the old model
+  EXPECT_FALSE(FM->getFeature("b"));
+}
+
+TEST_F(FeatureModelTransactionCopyTest, regroupAndRemoveSubtree) {
+  auto FT = FeatureModelCopyTransaction::openTransaction(*FM);
+  auto *A = FM->getFeature("a");
+  auto *B = FT.addFeature(std::make_unique<BinaryFeature>("b"), A);
+  auto *C = FT.addFeature(std::make_unique<BinaryFeature>("c"), A);
+  FT.addFeature(std::make_unique<BinaryFeature>("d"), B);
+  auto *Or = FT.addRelationship(Relationship::RelationshipKind::RK_OR, A,
+                                {B, C});
+  ASSERT_TRUE(Or);
+  auto *Alt = FT.setRelationshipKind(
+      Or, Relationship::RelationshipKind::RK_ALTERNATIVE);
+  ASSERT_TRUE(Alt);
+  EXPECT_EQ(Alt->getKind(), Relationship::RelationshipKind::RK_ALTERNATIVE);
+  EXPECT_EQ(C->getParent(), Alt);
+  EXPECT_TRUE(FT.removeSubtree(B));
+  EXPECT_FALSE(FT.removeSubtree(FM->getRoot()));
+
+  auto NewFM = FT.commit();
+
+  ASSERT_TRUE(NewFM);
+  EXPECT_FALSE(NewFM->getFeature("b"));
+  EXPECT_FALSE(NewFM->getFeature("d"));
+  EXPECT_EQ(NewFM->getFeature("c")->getParent(), Alt);
+  EXPECT_EQ(std::vector<Feature *>(NewFM->begin(), NewFM->end()),
+            (std::vector<Feature *>{NewFM->getRoot(), NewFM->getFeature("a"),
+                                    NewFM->getFeature("c")}));
+  // Changes should not be visible on the old model
+  EXPECT_EQ(FM->size(), 2);
+}
+
 //===----------------------------------------------------------------------===//
 //                    FeatureModelModifyTransaction Tests
 //===----------------------------------------------------------------------===//
@@ -224,4 +373,463 @@ TEST_F(FeatureModelTransactionModifyTest, addFeatureToModelThenAboard) {
   EXPECT_FALSE(FM->getFeature("ab")); // Change should not be visible
 }
 
+TEST_F(FeatureModelTransactionModifyTest, addConstraintToModel) {
+  auto FT = FeatureModelModifyTransaction::openTransaction(*FM);
+  FT.addFeature(std::make_unique<BinaryFeature>("ab"), FM->getFeature("a"));
+  FT.addConstraint(std::make_unique<ImpliesConstraint>(
+      std::make_unique<PrimaryFeatureConstraint>(
+          std::make_unique<Feature>("ab")),
+      std::make_unique<PrimaryFeatureConstraint>(
+          std::make_unique<Feature>("a"))));
+
+  EXPECT_TRUE(FM->getOccurrences(*FM->getFeature("a")).empty());
+
+  FT.commit(); // Commit changes
+
+  auto A = FM->getOccurrences(*FM->getFeature("a"));
+  auto AB = FM->getOccurrences(*FM->getFeature("ab"));
+  ASSERT_EQ(A.size(), 1);
+  ASSERT_EQ(AB.size(), 1);
+  EXPECT_EQ(A[0].C, AB[0].C);
+  EXPECT_EQ(A[0].Polarity, OccurrencePolarity::OP_POSITIVE);
+  EXPECT_EQ(AB[0].Polarity, OccurrencePolarity::OP_NEGATIVE);
+  EXPECT_EQ(std::distance(FM->getFeature("ab")->implications().begin(),
+                          FM->getFeature("ab")->implications().end()),
+            1);
+}
+
+TEST_F(FeatureModelTransactionModifyTest, setParentAndRemoveConstraint) {
+  auto FT = FeatureModelModifyTransaction::openTransaction(*FM);
+  FT.addFeature(std::make_unique<BinaryFeature>("b"), nullptr);
+  FT.addConstraint(std::make_unique<PrimaryFeatureConstraint>(
+      std::make_unique<Feature>("a")));
+  FT.commit();
+
+  auto *A = FM->getFeature("a");
+  auto *B = FM->getFeature("b");
+  FT = FeatureModelModifyTransaction::openTransaction(*FM);
+  FT.setParent(B, A);
+  FT.removeConstraint(FM->constraints().begin()->get());
+  FT.setOptional(A, false);
+  FT.commit();
+
+  EXPECT_EQ(A, FM->getFeature("a"));
+  EXPECT_EQ(B, FM->getFeature("b"));
+  EXPECT_EQ(A, B->getParentFeature());
+  EXPECT_FALSE(A->isOptional());
+  EXPECT_EQ(FM->constraints().begin(), FM->constraints().end());
+  EXPECT_TRUE(FM->getOccurrences(*A).empty());
+  // Ordering follows the new parent.
+  EXPECT_EQ(std::vector<Feature *>(FM->begin(), FM->end()),
+            (std::vector<Feature *>{FM->getRoot(), A, B}));
+}
+
+TEST_F(FeatureModelTransactionModifyTest, missingParents) {
+  auto *A = FM->getFeature("a");
+
+  auto FT = FeatureModelModifyTransaction::openTransaction(*FM);
+  FT.setParent(A, nullptr);
+  EXPECT_FALSE(FT.commit());
+  EXPECT_EQ(A->getParentFeature(), FM->getRoot());
+
+  // The parent is gone by the time the feature is added.
+  FT = FeatureModelModifyTransaction::openTransaction(*FM);
+  FT.removeFeature(A);
+  FT.addFeature(std::make_unique<BinaryFeature>("b"), A);
+  EXPECT_FALSE(FT.commit());
+  EXPECT_EQ(FM->getFeature("a"), A);
+  EXPECT_FALSE(FM->getFeature("b"));
+
+  FT = FeatureModelModifyTransaction::openTransaction(*FM);
+  FT.addFeature(std::make_unique<BinaryFeature>("b"), nullptr);
+  FT.removeFeature(A);
+  FT.setParent(FM->getFeature("b"), A);
+  EXPECT_FALSE(FT.commit());
+  EXPECT_EQ(FM->getFeature("a"), A);
+}
+
+TEST_F(FeatureModelTransactionModifyTest, bulkAddFeatures) {
+  // Features are added in an order that differs from the final ordering.
+  constexpr int NumFeatures = 2000;
+  auto FT = FeatureModelModifyTransaction::openTransaction(*FM);
+  std::vector<Feature *> Added;
+  for (int I = 0; I < NumFeatures; ++I) {
+    auto F = std::make_unique<BinaryFeature>(
+        (I % 3 ? "F" : "f") + std::to_string(NumFeatures - I));
+    auto *Parent = I < 10 ? FM->getFeature("a") : Added[I / 10];
+    Added.push_back(F.get());
+    FT.addFeature(std::move(F), Parent);
+  }
+  // Leaves can be removed in the same transaction.
+  std::string Last = Added.back()->getName().str();
+  FT.removeFeature(Added.back());
+  FT.commit();
+
+  EXPECT_EQ(FM->size(), NumFeatures + 1);
+  EXPECT_FALSE(FM->getFeature(Last));
+  std::vector<Feature *> Ordered(FM->begin(), FM->end());
+  EXPECT_EQ(Ordered.size(), FM->size());
+  EXPECT_EQ(Ordered.front(), FM->getRoot());
+  EXPECT_TRUE(std::is_sorted(Ordered.begin(), Ordered.end(),
+                             [](Feature *A, Feature *B) { return *A < *B; }));
+}
+
+TEST_F(FeatureModelTransactionModifyTest, reorderTouchedSubtrees) {
+  // Few changes in a large model only reorder the changed subtrees.
+  FeatureModelBuilder B;
+  for (int I = 0; I < 100; ++I) {
+    B.makeFeature<BinaryFeature>("a" + std::to_string(I), true);
+    B.makeFeature<BinaryFeature>("b" + std::to_string(I), true);
+    B.addEdge("a" + std::to_string(I), "b" + std::to_string(I));
+  }
+  FM = B.buildFeatureModel();
+  ASSERT_TRUE(FM);
+
+  auto FT = FeatureModelModifyTransaction::openTransaction(*FM);
+  FT.setParent(FM->getFeature("a5"), FM->getFeature("b50"));
+  FT.removeFeature(FM->getFeature("b7"));
+  FT.addFeature(std::make_unique<BinaryFeature>("A3"), FM->getFeature("a3"));
+  FT.setOptional(FM->getFeature("a9"), false);
+  ASSERT_TRUE(FT.commit());
+
+  std::vector<Feature *> Ordered(FM->begin(), FM->end());
+  EXPECT_EQ(Ordered.size(), FM->size());
+  EXPECT_EQ(Ordered.front(), FM->getRoot());
+  EXPECT_TRUE(std::is_sorted(Ordered.begin(), Ordered.end(),
+                             [](Feature *A, Feature *B) { return *A < *B; }));
+  auto Position = [&Ordered](Feature *F) {
+    return std::find(Ordered.begin(), Ordered.end(), F) - Ordered.begin();
+  };
+  EXPECT_EQ(Position(FM->getFeature("a5")),
+            Position(FM->getFeature("b50")) + 1);
+  EXPECT_EQ(Position(FM->getFeature("b5")), Position(FM->getFeature("a5")) + 1);
+  EXPECT_EQ(Position(FM->getFeature("A3")), Position(FM->getFeature("a3")) + 1);
+}
+
+class FeatureModelTransactionUndoTest : public ::testing::Test {
+protected:
+  void SetUp() override {
+    FeatureModelBuilder B;
+    B.makeFeature<BinaryFeature>("a", true);
+    B.makeFeature<BinaryFeature>("b");
+    B.makeFeature<BinaryFeature>("c");
+    B.makeFeature<NumericFeature>("n", std::pair<int, int>(0, 5));
+    B.addEdge("a", "b")->addEdge("a", "c");
+    B.emplaceRelationship(Relationship::RelationshipKind::RK_ALTERNATIVE,
+                          {"b", "c"}, "a");
+    B.addConstraint(std::make_unique<ImpliesConstraint>(
+        std::make_unique<PrimaryFeatureConstraint>(
+            std::make_unique<Feature>("n")),
+        std::make_unique<PrimaryFeatureConstraint>(
+            std::make_unique<Feature>("b"))));
+    B.addConstraint(std::make_unique<PrimaryFeatureConstraint>(
+        std::make_unique<Feature>("a")));
+    FM = B.buildFeatureModel();
+    assert(FM);
+  }
+
+  /// Pointers and properties of all features and constraints, in order.
+  [[nodiscard]] std::string describe() const {
+    std::string Str;
+    llvm::raw_string_ostream OS(Str);
+    for (auto *F : FM->features()) {
+      OS << static_cast<void *>(F) << " " << F->getName() << " "
+         << static_cast<void *>(F->getParent()) << " "
+         << F->isOptional() << " " << FM->getOccurrences(*F).size();
+      if (auto *N = llvm::dyn_cast<NumericFeature>(F); N) {
+        OS << " " << std::get<std::pair<int, int>>(N->getValues()).second;
+      }
+      OS << "\n";
+    }
+    for (const auto &C : FM->constraints()) {
+      OS << C.get() << " " << C->toString() << "\n";
+    }
+    return OS.str();
+  }
+
+  /// Change every part of the model.
+  void modify(FeatureModelModifyTransaction &FT) {
+    auto *R = llvm::cast<Relationship>(FM->getFeature("b")->getParent());
+    FT.removeConstraint(FM->constraints().begin()->get());
+    FT.removeRelationship(R);
+    FT.setParent(FM->getFeature("c"), FM->getRoot());
+    FT.removeFeature(FM->getFeature("b"));
+    FT.addFeature(std::make_unique<BinaryFeature>("d"), FM->getFeature("c"));
+    FT.addConstraint(std::make_unique<PrimaryFeatureConstraint>(
+        std::make_unique<Feature>("d")));
+    FT.setOptional(FM->getFeature("a"), false);
+    FT.setValues(llvm::cast<NumericFeature>(FM->getFeature("n")),
+                 std::pair<int, int>(0, 7));
+  }
+
+  std::unique_ptr<FeatureModel> FM;
+};
+
+TEST_F(FeatureModelTransactionUndoTest, rollbackOnFailure) {
+  auto Before = describe();
+
+  auto FT = FeatureModelModifyTransaction::openTransaction(*FM);
+  modify(FT);
+  FT.removeFeature(FM->getRoot()); // fails, reverting everything
+  EXPECT_FALSE(FT.commit());
+
+  EXPECT_EQ(Before, describe());
+  EXPECT_FALSE(FM->getFeature("d"));
+  EXPECT_TRUE(llvm::isa<Relationship>(FM->getFeature("c")->getParent()));
+}
+
+TEST_F(FeatureModelTransactionUndoTest, undoRedo) {
+  auto Before = describe();
+  FeatureModelHistory History(*FM);
+  EXPECT_FALSE(History.canUndo());
+  EXPECT_FALSE(History.undo());
+
+  auto FT = FeatureModelModifyTransaction::openTransaction(*FM);
+  modify(FT);
+  ASSERT_TRUE(FT.commit(History));
+  auto *D = FM->getFeature("d");
+  ASSERT_TRUE(D);
+  EXPECT_FALSE(FM->getFeature("b"));
+  EXPECT_FALSE(FM->getFeature("a")->isOptional());
+  auto Modified = describe();
+
+  FT = FeatureModelModifyTransaction::openTransaction(*FM);
+  FT.setParent(D, FM->getFeature("a"));
+  ASSERT_TRUE(FT.commit(History));
+  auto Moved = describe();
+
+  ASSERT_TRUE(History.undo());
+  EXPECT_EQ(Modified, describe());
+  ASSERT_TRUE(History.undo());
+  EXPECT_EQ(Before, describe());
+  EXPECT_FALSE(History.canUndo());
+  EXPECT_TRUE(History.canRedo());
+
+  // Redo restores the very same objects.
+  ASSERT_TRUE(History.redo());
+  EXPECT_EQ(Modified, describe());
+  EXPECT_EQ(D, FM->getFeature("d"));
+  ASSERT_TRUE(History.redo());
+  EXPECT_EQ(Moved, describe());
+  EXPECT_FALSE(History.redo());
+
+  // A new commit discards the undone steps.
+  ASSERT_TRUE(History.undo());
+  FT = FeatureModelModifyTransaction::openTransaction(*FM);
+  FT.setOptional(D, false);
+  ASSERT_TRUE(FT.commit(History));
+  EXPECT_FALSE(History.canRedo());
+}
+
+TEST_F(FeatureModelTransactionUndoTest, removeSubtree) {
+  auto Before = describe();
+  FeatureModelHistory History(*FM);
+
+  auto FT = FeatureModelModifyTransaction::openTransaction(*FM);
+  FT.removeSubtree(FM->getFeature("a"));
+  ASSERT_TRUE(FT.commit(History));
+
+  EXPECT_FALSE(FM->getFeature("a"));
+  EXPECT_FALSE(FM->getFeature("b"));
+  EXPECT_FALSE(FM->getFeature("c"));
+  EXPECT_EQ(FM->constraints().begin(), FM->constraints().end());
+  EXPECT_EQ(std::vector<Feature *>(FM->begin(), FM->end()),
+            (std::vector<Feature *>{FM->getRoot(), FM->getFeature("n")}));
+
+  ASSERT_TRUE(History.undo());
+  EXPECT_EQ(Before, describe());
+  ASSERT_TRUE(History.redo());
+  EXPECT_FALSE(FM->getFeature("a"));
+}
+
+TEST_F(FeatureModelTransactionUndoTest, editLocations) {
+  FeatureSourceRange First("first.c");
+  FeatureSourceRange Second("second.c");
+  FeatureSourceRange Third("third.c");
+  auto *N = FM->getFeature("n");
+  auto Locations = [N]() {
+    return std::vector<FeatureSourceRange>(N->getLocationsBegin(),
+                                           N->getLocationsEnd());
+  };
+  FeatureModelHistory History(*FM);
+
+  auto FT = FeatureModelModifyTransaction::openTransaction(*FM);
+  FT.addLocation(N, First);
+  FT.addLocation(N, Second);
+  FT.updateLocation(N, First, Third);
+  ASSERT_TRUE(FT.commit(History));
+  EXPECT_EQ(Locations(), (std::vector<FeatureSourceRange>{Third, Second}));
+
+  FT = FeatureModelModifyTransaction::openTransaction(*FM);
+  FT.removeLocation(N, Third);
+  ASSERT_TRUE(FT.commit(History));
+  EXPECT_EQ(Locations(), (std::vector<FeatureSourceRange>{Second}));
+
+  // Removing a location the feature does not have fails.
+  FT = FeatureModelModifyTransaction::openTransaction(*FM);
+  FT.removeLocation(N, First);
+  EXPECT_FALSE(FT.commit());
+
+  ASSERT_TRUE(History.undo());
+  EXPECT_EQ(Locations(), (std::vector<FeatureSourceRange>{Third, Second}));
+  ASSERT_TRUE(History.undo());
+  EXPECT_TRUE(Locations().empty());
+}
+
+//===----------------------------------------------------------------------===//
+//                        updateFeatureModel Tests
+//===----------------------------------------------------------------------===//
+
+class FeatureModelUpdateTest : public ::testing::Test {
+protected:
+  static std::unique_ptr<FeatureModel> buildModel(bool Updated) {
+    FeatureModelBuilder B;
+    B.makeFeature<BinaryFeature>("a", true);
+    B.makeFeature<BinaryFeature>("b");
+    B.makeFeature<BinaryFeature>("c");
+    B.makeFeature<BinaryFeature>(Updated ? "e" : "d");
+    if (Updated) {
+      B.makeFeature<NumericFeature>("n", std::vector<int>{1, 2});
+      B.addEdge("a", "b")->addEdge("a", "c");
+      B.emplaceRelationship(Relationship::RelationshipKind::RK_OR, {"b", "c"},
+                            "a");
+      B.addConstraint(std::make_unique<ExcludesConstraint>(
+          std::make_unique<PrimaryFeatureConstraint>(
+              std::make_unique<Feature>("b")),
+          std::make_unique<PrimaryFeatureConstraint>(
+              std::make_unique<Feature>("n"))));
+    } else {
+      B.makeFeature<BinaryFeature>("n");
+      B.addEdge("a", "b")->addEdge("b", "c");
+      B.addConstraint(std::make_unique<ImpliesConstraint>(
+          std::make_unique<PrimaryFeatureConstraint>(
+              std::make_unique<Feature>("b")),
+          std::make_unique<PrimaryFeatureConstraint>(
+              std::make_unique<Feature>("a"))));
+    }
+    B.addConstraint(std::make_unique<PrimaryFeatureConstraint>(
+        std::make_unique<Feature>("a")));
+    return B.buildFeatureModel();
+  }
+};
+
+TEST_F(FeatureModelUpdateTest, keepsUnchangedFeatures) {
+  auto FM = buildModel(false);
+  auto Target = buildModel(true);
+  ASSERT_TRUE(FM && Target);
+  auto *A = FM->getFeature("a");
+  auto *B = FM->getFeature("b");
+  auto *C = FM->getFeature("c");
+  auto *Kept = std::next(FM->constraints().begin())->get();
+
+  ASSERT_TRUE(updateFeatureModel(*FM, *Target));
+
+  EXPECT_EQ(A, FM->getFeature("a"));
+  EXPECT_EQ(B, FM->getFeature("b"));
+  EXPECT_EQ(C, FM->getFeature("c"));
+  EXPECT_FALSE(FM->getFeature("d"));
+  ASSERT_TRUE(FM->getFeature("e"));
+  EXPECT_TRUE(llvm::isa<NumericFeature>(FM->getFeature("n")));
+  EXPECT_EQ(FM->size(), Target->size());
+
+  ASSERT_TRUE(llvm::isa<Relationship>(C->getParent()));
+  EXPECT_EQ(C->getParent(), B->getParent());
+  EXPECT_EQ(A, C->getParentFeature());
+
+  std::vector<std::string> Constraints;
+  for (const auto &Constraint : FM->constraints()) {
+    Constraints.push_back(Constraint->toString());
+  }
+  EXPECT_EQ(Constraints, (std::vector<std::string>{"a", "(b => !n)"}));
+  EXPECT_EQ(Kept, FM->constraints().begin()->get());
+  EXPECT_EQ(FM->getOccurrences(*FM->getFeature("n")).size(), 1);
+
+  std::vector<std::string> Order;
+  std::vector<std::string> Expected;
+  for (auto *F : FM->features()) {
+    Order.push_back(F->getName().str());
+  }
+  for (auto *F : Target->features()) {
+    Expected.push_back(F->getName().str());
+  }
+  EXPECT_EQ(Order, Expected);
+}
+
+TEST_F(FeatureModelUpdateTest, nestedGroups) {
+  auto BuildModel = [](bool Grouped, bool NumericB = false) {
+    FeatureModelBuilder B;
+    for (const auto *Name : {"a", "x", "c", "d"}) {
+      B.makeFeature<BinaryFeature>(Name);
+    }
+    if (NumericB) {
+      B.makeFeature<NumericFeature>("b", std::pair<int, int>(0, 1));
+    } else {
+      B.makeFeature<BinaryFeature>("b");
+    }
+    B.addEdge("a", "b")->addEdge("a", "x");
+    B.addEdge("b", "c")->addEdge("b", "d");
+    if (Grouped) {
+      B.emplaceRelationship(Relationship::RelationshipKind::RK_ALTERNATIVE,
+                            {"b", "x"}, "a");
+      // Nested below its grandparent "a".
+      B.emplaceRelationship(Relationship::RelationshipKind::RK_OR,
+                            {"c", "d"}, "b");
+    }
+    return B.buildFeatureModel();
+  };
+  auto Groups = [](Feature *F) {
+    std::vector<Relationship *> Groups;
+    for (auto *Child : F->children()) {
+      if (auto *R = llvm::dyn_cast<Relationship>(Child); R) {
+        Groups.push_back(R);
+      }
+    }
+    return Groups;
+  };
+  auto FM = BuildModel(false);
+  auto Target = BuildModel(true);
+  ASSERT_TRUE(FM && Target);
+
+  ASSERT_TRUE(updateFeatureModel(*FM, *Target));
+  auto *A = FM->getFeature("a");
+  auto *B = FM->getFeature("b");
+  ASSERT_EQ(Groups(A).size(), 1);
+  ASSERT_EQ(Groups(B).size(), 1);
+  auto *Outer = Groups(A).front();
+  auto *Inner = Groups(B).front();
+  EXPECT_EQ(Outer->getKind(), Relationship::RelationshipKind::RK_ALTERNATIVE);
+  EXPECT_EQ(Inner->getKind(), Relationship::RelationshipKind::RK_OR);
+  EXPECT_EQ(FM->getFeature("c")->getParent(), Inner);
+
+  // Updating to the same model keeps all groups.
+  ASSERT_TRUE(updateFeatureModel(*FM, *Target));
+  EXPECT_EQ(Groups(A), std::vector<Relationship *>{Outer});
+  EXPECT_EQ(Groups(B), std::vector<Relationship *>{Inner});
+
+  // A replaced group member stays in its group.
+  auto Numeric = BuildModel(true, true);
+  ASSERT_TRUE(Numeric);
+  ASSERT_TRUE(updateFeatureModel(*FM, *Numeric));
+  B = FM->getFeature("b");
+  ASSERT_TRUE(llvm::isa<NumericFeature>(B));
+  ASSERT_EQ(Groups(A).size(), 1);
+  ASSERT_EQ(Groups(B).size(), 1);
+  Outer = Groups(A).front();
+  EXPECT_EQ(Outer->getKind(), Relationship::RelationshipKind::RK_ALTERNATIVE);
+  EXPECT_EQ(B->getParent(), Outer);
+  EXPECT_EQ(FM->getFeature("x")->getParent(), Outer);
+  EXPECT_EQ(FM->getFeature("c")->getParent(), Groups(B).front());
+}
+
+TEST_F(FeatureModelUpdateTest, differentRoot) {
+  auto FM = buildModel(false);
+  FeatureModelBuilder B;
+  B.setRootName("other");
+  auto Target = B.buildFeatureModel();
+  ASSERT_TRUE(FM && Target);
+
+  EXPECT_FALSE(updateFeatureModel(*FM, *Target));
+  EXPECT_TRUE(FM->getFeature("d"));
+}
+
 } // namespace vara::feature
@@ -3,6 +3,8 @@
 
 #include "UnittestHelper.h"
 
+#include "llvm/ADT/SmallString.h"
+#include "llvm/Support/FileSystem.h"
 #include "llvm/Support/MemoryBuffer.h"
 #include "gtest/gtest.h"
 
@@ -62,4 +64,504 @@ TEST(XmlWriter, test) {
   EXPECT_EQ(ExpectedOutput, ActualOutput);
 }
 
+TEST(XmlWriter, escaping) {
+  FeatureModelBuilder B;
+  B.setVmName("a \"quoted\"\tname");
+  B.setPath("dir/<root>&");
+  B.makeFeature<BinaryFeature>("a<b>&\"c", true);
+  auto FM = B.buildFeatureModel();
+  ASSERT_TRUE(FM);
+
+  auto Output = FeatureModelXmlWriter(*FM).writeFeatureModel();
+  ASSERT_TRUE(Output.has_value());
+  EXPECT_NE(Output->find("<vm name=\"a &quot;quoted&quot;&#9;name\" "
+                         "root=\"dir/&lt;root&gt;&amp;\">"),
+            std::string::npos);
+  EXPECT_NE(Output->find("<name>a&lt;b&gt;&amp;&quot;c</name>"),
+            std::string::npos);
+
+  auto Parsed = FeatureModelXmlParser(*Output).buildFeatureModel();
+  ASSERT_TRUE(Parsed);
+  EXPECT_EQ(Parsed->getName(), FM->getName());
+  EXPECT_TRUE(Parsed->getFeature("a<b>&\"c"));
+}
+
+TEST(XmlWriter, streamAndFile) {
+  auto FS = llvm::MemoryBuffer::getFileAsStream(getTestResource("test.xml"));
+  ASSERT_TRUE(FS);
+  auto FM =
+      FeatureModelXmlParser(FS.get()->getBuffer().str()).buildFeatureModel();
+  ASSERT_TRUE(FM);
+
+  std::string Str;
+  llvm::raw_string_ostream OS(Str);
+  EXPECT_EQ(FeatureModelXmlWriter(*FM).writeFeatureModel(OS), 0);
+  EXPECT_EQ(OS.str(), FS.get()->getBuffer());
+
+  llvm::SmallString<128> Path;
+  ASSERT_FALSE(llvm::sys::fs::createTemporaryFile("test", "xml", Path));
+  EXPECT_EQ(FeatureModelXmlWriter(*FM).writeFeatureModel(Path.str().str()), 0);
+  auto Written = llvm::MemoryBuffer::getFileAsStream(Path);
+  ASSERT_TRUE(Written);
+  EXPECT_EQ(Written.get()->getBuffer(), FS.get()->getBuffer());
+  llvm::sys::fs::remove(Path);
+}
+
+TEST(XmlWriter, streamErrors) {
+  auto FM = FeatureModelBuilder().buildFeatureModel();
+  ASSERT_TRUE(FM);
+
+  std::error_code EC;
+  llvm::raw_fd_ostream OS("/dev/full", EC);
+  ASSERT_FALSE(EC);
+  EXPECT_LT(FeatureModelXmlWriter(*FM).writeFeatureModel(OS), 0);
+  OS.clear_error();
+  EXPECT_LT(FeatureModelDimacsWriter(*FM).writeFeatureModel(OS), 0);
+  OS.clear_error();
+  EXPECT_LT(FeatureModelBinaryWriter(*FM).writeFeatureModel(OS), 0);
+  OS.clear_error();
+}
+
+TEST(XmlWriter, groupsAndConstraints) {
+  FeatureModelBuilder B;
+  B.makeFeature<BinaryFeature>("a", true);
+  B.makeFeature<BinaryFeature>("b", true);
+  B.makeFeature<BinaryFeature>("c");
+  B.makeFeature<BinaryFeature>("c1");
+  B.makeFeature<BinaryFeature>("c2");
+  B.makeFeature<BinaryFeature>("c3");
+  B.addEdge("c", "c1");
+  B.addEdge("c", "c2");
+  B.addEdge("c", "c3");
+  B.emplaceRelationship(Relationship::RelationshipKind::RK_ALTERNATIVE,
+                        {"c1", "c2", "c3"}, "c");
+  B.addConstraint(std::make_unique<ImpliesConstraint>(
+      std::make_unique<PrimaryFeatureConstraint>(
+          std::make_unique<Feature>("a")),
+      std::make_unique<PrimaryFeatureConstraint>(
+          std::make_unique<Feature>("c3"))));
+  B.addConstraint(std::make_unique<ImpliesConstraint>(
+      std::make_unique<PrimaryFeatureConstraint>(
+          std::make_unique<Feature>("a")),
+      std::make_unique<PrimaryFeatureConstraint>(
+          std::make_unique<Feature>("b"))));
+  B.addConstraint(std::make_unique<ExcludesConstraint>(
+      std::make_unique<PrimaryFeatureConstraint>(
+          std::make_unique<Feature>("c2")),
+      std::make_unique<PrimaryFeatureConstraint>(
+          std::make_unique<Feature>("a"))));
+  auto FM = B.buildFeatureModel();
+  ASSERT_TRUE(FM);
+
+  auto FS = llvm::MemoryBuffer::getFileAsStream(
+      getTestResource("test_groups_constraints.xml"));
+  ASSERT_TRUE(FS && "Comparisson file could not be read");
+  auto Output = FeatureModelXmlWriter(*FM).writeFeatureModel();
+  ASSERT_TRUE(Output.has_value());
+  EXPECT_EQ(FS.get()->getBuffer(), *Output);
+}
+
+TEST(XmlWriter, largeModel) {
+  // Write a wide and deep tree and check that it reads back unchanged.
+  constexpr int NumFeatures = 2000;
+  FeatureModelBuilder B;
+  for (int I = 0; I < NumFeatures; ++I) {
+    B.makeFeature<BinaryFeature>("F" + std::to_string(I), I % 2 == 0);
+    if (I > 0) {
+      B.addEdge("F" + std::to_string((I - 1) / 8), "F" + std::to_string(I));
+    }
+  }
+  B.addEdge("root", "F0");
+  auto FM = B.buildFeatureModel();
+  ASSERT_TRUE(FM);
+
+  auto Output = FeatureModelXmlWriter(*FM).writeFeatureModel();
+  ASSERT_TRUE(Output.has_value());
+  auto Parsed = FeatureModelXmlParser(*Output).buildFeatureModel();
+  ASSERT_TRUE(Parsed);
+  EXPECT_EQ(Parsed->size(), FM->size());
+  EXPECT_EQ(FeatureModelXmlWriter(*Parsed).writeFeatureModel(), Output);
+}
+
+TEST(DimacsWriter, treeAndConstraints) {
+  FeatureModelBuilder B;
+  B.makeFeature<BinaryFeature>("a", true);
+  B.makeFeature<BinaryFeature>("b");
+  B.makeFeature<BinaryFeature>("c", true);
+  B.makeFeature<BinaryFeature>("c1");
+  B.makeFeature<BinaryFeature>("c2");
+  B.addEdge("c", "c1");
+  B.addEdge("c", "c2");
+  B.emplaceRelationship(Relationship::RelationshipKind::RK_ALTERNATIVE,
+                        {"c1", "c2"}, "c");
+  // (a & c1) | !b
+  B.addConstraint(std::make_unique<OrConstraint>(
+      std::make_unique<AndConstraint>(
+          std::make_unique<PrimaryFeatureConstraint>(
+              std::make_unique<Feature>("a")),
+          std::make_unique<PrimaryFeatureConstraint>(
+              std::make_unique<Feature>("c1"))),
+      std::make_unique<NotConstraint>(
+          std::make_unique<PrimaryFeatureConstraint>(
+              std::make_unique<Feature>("b")))));
+  // implied by the alternative group
+  B.addConstraint(std::make_unique<ExcludesConstraint>(
+      std::make_unique<PrimaryFeatureConstraint>(
+          std::make_unique<Feature>("c1")),
+      std::make_unique<PrimaryFeatureConstraint>(
+          std::make_unique<Feature>("c2"))));
+  auto FM = B.buildFeatureModel();
+  ASSERT_TRUE(FM);
+
+  auto Output = FeatureModelDimacsWriter(*FM).writeFeatureModel();
+  ASSERT_TRUE(Output.has_value());
+  EXPECT_EQ(Output.value(), "c 1 root\n"
+                            "c 2 a\n"
+                            "c 3 b\n"
+                            "c 4 c\n"
+                            "c 5 c1\n"
+                            "c 6 c2\n"
+                            "p cnf 7 12\n"
+                            // tree
+                            "1 0\n"
+                            "-2 1 0\n"
+                            "-3 1 0\n"
+                            "-1 3 0\n"
+                            "-4 1 0\n"
+                            "-4 5 6 0\n"
+                            "-5 -6 0\n"
+                            "-5 4 0\n"
+                            "-6 4 0\n"
+                            // Tseitin variable 7 for (a & c1)
+                            "-7 2 0\n"
+                            "-7 5 0\n"
+                            "7 -3 0\n");
+}
+
+TEST(DimacsWriter, parities) {
+  FeatureModelBuilder B;
+  B.makeFeature<BinaryFeature>("a", true);
+  B.makeFeature<BinaryFeature>("b", true);
+  B.makeFeature<BinaryFeature>("c", true);
+  auto P = [](const char *Name) {
+    return std::make_unique<PrimaryFeatureConstraint>(
+        std::make_unique<Feature>(Name));
+  };
+  // a ^ (b <=> c)
+  B.addConstraint(std::make_unique<XorConstraint>(
+      P("a"), std::make_unique<EquivalenceConstraint>(P("b"), P("c"))));
+  auto FM = B.buildFeatureModel();
+  ASSERT_TRUE(FM);
+
+  auto Output = FeatureModelDimacsWriter(*FM).writeFeatureModel();
+  ASSERT_TRUE(Output.has_value());
+  EXPECT_EQ(Output.value(), "c 1 root\n"
+                            "c 2 a\n"
+                            "c 3 b\n"
+                            "c 4 c\n"
+                            "p cnf 5 10\n"
+                            // tree
+                            "1 0\n"
+                            "-2 1 0\n"
+                            "-3 1 0\n"
+                            "-4 1 0\n"
+                            // Tseitin variable 5 for (b ^ c)
+                            "-5 3 4 0\n"
+                            "-5 -3 -4 0\n"
+                            "5 -3 4 0\n"
+                            "5 3 -4 0\n"
+                            // a ^ !5
+                            "2 -5 0\n"
+                            "-2 5 0\n");
+}
+
+TEST(DimacsWriter, deepEquivalence) {
+  constexpr unsigned Depth = 40;
+  FeatureModelBuilder B;
+  for (unsigned I = 0; I <= Depth; ++I) {
+    B.makeFeature<BinaryFeature>("a" + std::to_string(I), true);
+  }
+  auto P = [](unsigned I) {
+    return std::make_unique<PrimaryFeatureConstraint>(
+        std::make_unique<Feature>("a" + std::to_string(I)));
+  };
+  // a0 <=> (a1 <=> (... <=> a40))
+  std::unique_ptr<Constraint> C = P(Depth);
+  for (unsigned I = Depth; I-- > 0;) {
+    C = std::make_unique<EquivalenceConstraint>(P(I), std::move(C));
+  }
+  B.addConstraint(std::move(C));
+  auto FM = B.buildFeatureModel();
+  ASSERT_TRUE(FM);
+
+  auto Output = FeatureModelDimacsWriter(*FM).writeFeatureModel();
+  ASSERT_TRUE(Output.has_value());
+  // One Tseitin variable with four clauses per nested equivalence
+  unsigned NumVariables = (Depth + 2) + (Depth - 1);
+  unsigned NumClauses = (Depth + 2) + 4 * (Depth - 1) + 2;
+  EXPECT_NE(Output->find("p cnf " + std::to_string(NumVariables) + " " +
+                         std::to_string(NumClauses) + "\n"),
+            std::string::npos);
+}
+
+TEST(DimacsWriter, deepConstraints) {
+  constexpr unsigned Depth = 100000;
+  FeatureModelBuilder B;
+  B.makeFeature<BinaryFeature>("a", true);
+  B.makeFeature<BinaryFeature>("b", true);
+  auto P = [](const std::string &Name) {
+    return std::make_unique<PrimaryFeatureConstraint>(
+        std::make_unique<Feature>(Name));
+  };
+  // b & (a | (b & (a | ... (a | b))))
+  std::unique_ptr<Constraint> C = P("b");
+  for (unsigned I = 0; I < Depth; ++I) {
+    if (I % 2) {
+      C = std::make_unique<AndConstraint>(P("b"), std::move(C));
+    } else {
+      C = std::make_unique<OrConstraint>(P("a"), std::move(C));
+    }
+  }
+  B.addConstraint(std::move(C));
+  auto FM = B.buildFeatureModel();
+  ASSERT_TRUE(FM);
+
+  auto Output = FeatureModelDimacsWriter(*FM).writeFeatureModel();
+  ASSERT_TRUE(Output.has_value());
+  // One Tseitin variable with two clauses per nested conjunction
+  unsigned NumVariables = 3 + (Depth / 2 - 1);
+  unsigned NumClauses = 3 + 2 + 2 * (Depth / 2 - 1);
+  EXPECT_NE(Output->find("p cnf " + std::to_string(NumVariables) + " " +
+                         std::to_string(NumClauses) + "\n"),
+            std::string::npos);
+}
+
+TEST(DimacsWriter, largeAlternativeGroup) {
+  constexpr unsigned NumAlternatives = 100;
+  FeatureModelBuilder B;
+  B.makeFeature<BinaryFeature>("a");
+  std::vector<std::string> Names;
+  for (unsigned I = 0; I < NumAlternatives; ++I) {
+    Names.push_back("a" + std::to_string(I));
+    B.makeFeature<BinaryFeature>(Names.back());
+    B.addEdge("a", Names.back());
+  }
+  B.emplaceRelationship(Relationship::RelationshipKind::RK_ALTERNATIVE, Names,
+                        "a");
+  auto FM = B.buildFeatureModel();
+  ASSERT_TRUE(FM);
+
+  auto Output = FeatureModelDimacsWriter(*FM).writeFeatureModel();
+  ASSERT_TRUE(Output.has_value());
+
+  // root, a => root, root => a, one clause per child, one at-least-one
+  // clause, and a sequential counter instead of quadratic pairwise clauses
+  unsigned NumVariables = NumAlternatives + 2 + (NumAlternatives - 1);
+  unsigned NumClauses = 3 + NumAlternatives + 1 + (3 * NumAlternatives - 4);
+  EXPECT_NE(Output->find("p cnf " + std::to_string(NumVariables) + " " +
+                         std::to_string(NumClauses) + "\n"),
+            std::string::npos);
+  EXPECT_NE(Output->find("c 2 a\n"), std::string::npos);
+}
+
+TEST(BinaryWriter, roundTripXml) {
+  for (const auto *File :
+       {"test.xml", "test_children.xml", "test_excludes.xml",
+        "test_numeric.xml", "test_only_children.xml", "test_only_parents.xml",
+        "test_out_of_order.xml"}) {
+    auto FM = FeatureModelXmlParser::fromFile(getTestResource(File))
+                  ->buildFeatureModel();
+    ASSERT_TRUE(FM) << File;
+
+    auto Binary = FeatureModelBinaryWriter(*FM).writeFeatureModel();
+    ASSERT_TRUE(Binary.has_value()) << File;
+    EXPECT_TRUE(FeatureModelBinaryParser::isBinaryFeatureModel(*Binary));
+    auto Loaded = FeatureModelBinaryParser(*Binary).buildFeatureModel();
+    ASSERT_TRUE(Loaded) << File;
+
+    EXPECT_EQ(FeatureModelXmlWriter(*Loaded).writeFeatureModel(),
+              FeatureModelXmlWriter(*FM).writeFeatureModel())
+        << File;
+    EXPECT_EQ(Loaded->getCommit(), FM->getCommit()) << File;
+    EXPECT_EQ(std::distance(Loaded->constraints().begin(),
+                            Loaded->constraints().end()),
+              std::distance(FM->constraints().begin(), FM->constraints().end()))
+        << File;
+    EXPECT_EQ(FeatureModelBinaryWriter(*Loaded).writeFeatureModel(), Binary)
+        << File;
+  }
+}
+
+TEST(BinaryWriter, roundTripConstraintsAndLocations) {
+  FeatureModelBuilder B;
+  B.setVmName("binary");
+  B.setCommit("abc");
+  B.makeFeature<BinaryFeature>(
+      "a", true,
+      std::vector<FeatureSourceRange>{
+          FeatureSourceRange("a.c"),
+          FeatureSourceRange(
+              "b.c", FeatureSourceRange::FeatureSourceLocation(1, 2),
+              FeatureSourceRange::FeatureSourceLocation(3, 4),
+              FeatureSourceRange::Category::inessential)});
+  B.makeFeature<BinaryFeature>("b");
+  B.makeFeature<BinaryFeature>("c");
+  B.makeFeature<NumericFeature>("n", std::vector<int>{-1, 0, 7});
+  B.makeFeature<NumericFeature>("m", std::pair<int, int>(-5, 5));
+  B.addEdge("a", "b")->addEdge("a", "c");
+  B.emplaceRelationship(Relationship::RelationshipKind::RK_OR, {"b", "c"},
+                        "a");
+  auto P = [](const char *Name) {
+    return std::make_unique<PrimaryFeatureConstraint>(
+        std::make_unique<Feature>(Name));
+  };
+  NaryConstraint::OperandContainerTy Operands;
+  Operands.push_back(P("a"));
+  Operands.push_back(std::make_unique<NotConstraint>(P("b")));
+  Operands.push_back(std::make_unique<LessConstraint>(
+      std::make_unique<AdditionConstraint>(
+          P("n"), std::make_unique<NegConstraint>(
+                      std::make_unique<PrimaryIntegerConstraint>(-3))),
+      P("m")));
+  B.addConstraint(std::make_unique<NaryOrConstraint>(std::move(Operands)));
+  B.addConstraint(std::make_unique<ExcludesConstraint>(P("b"), P("c")));
+  // Deep constraints are decoded without recursion.
+  std::unique_ptr<Constraint> Deep = P("a");
+  for (int I = 0; I < 10000; ++I) {
+    Deep = std::make_unique<NotConstraint>(std::move(Deep));
+  }
+  B.addConstraint(std::move(Deep));
+  auto FM = B.buildFeatureModel();
+  ASSERT_TRUE(FM);
+
+  llvm::SmallString<128> Path;
+  ASSERT_FALSE(llvm::sys::fs::createTemporaryFile("test", "vfmb", Path));
+  EXPECT_EQ(FeatureModelBinaryWriter(*FM).writeFeatureModel(Path.str().str()),
+            0);
+  auto Parser = FeatureModelBinaryParser::fromFile(Path);
+  ASSERT_TRUE(Parser);
+  EXPECT_TRUE(Parser->verifyFeatureModel());
+  auto Loaded = Parser->buildFeatureModel();
+  llvm::sys::fs::remove(Path);
+  ASSERT_TRUE(Loaded);
+
+  EXPECT_EQ(Loaded->getName(), "binary");
+  EXPECT_EQ(Loaded->getCommit(), "abc");
+  auto ToStrings = [](FeatureModel &Model) {
+    std::vector<std::string> Strings;
+    for (const auto &C : Model.constraints()) {
+      Strings.push_back(C->toString());
+    }
+    for (auto *F : Model.features()) {
+      Strings.push_back(F->getName().str() + (F->isOptional() ? "?" : ""));
+      for (const auto &L : F->getLocations()) {
+        Strings.push_back(
+            L.toString() +
+            (L.getCategory() == FeatureSourceRange::Category::inessential
+                 ? " inessential"
+                 : ""));
+      }
+    }
+    return Strings;
+  };
+  EXPECT_EQ(ToStrings(*Loaded), ToStrings(*FM));
+  EXPECT_EQ(llvm::cast<NumericFeature>(Loaded->getFeature("n"))->getValues(),
+            llvm::cast<NumericFeature>(FM->getFeature("n"))->getValues());
+  EXPECT_EQ(llvm::cast<NumericFeature>(Loaded->getFeature("m"))->getValues(),
+            llvm::cast<NumericFeature>(FM->getFeature("m"))->getValues());
+  ASSERT_TRUE(llvm::isa<Relationship>(Loaded->getFeature("b")->getParent()));
+  EXPECT_EQ(Loaded->getFeature("b")->getParent(),
+            Loaded->getFeature("c")->getParent());
+}
+
+TEST(BinaryWriter, stableTags) {
+  // Kinds are stored as fixed tags, independent of the in-memory enums.
+  std::string Expected("VFMB\x01\0\0\0", 8);
+  auto U32 = [&Expected](uint32_t V) {
+    for (int I = 0; I < 4; ++I) {
+      Expected.push_back(static_cast<char>((V >> (8 * I)) & 0xFF));
+    }
+  };
+  auto U8 = [&Expected](uint8_t V) {
+    Expected.push_back(static_cast<char>(V));
+  };
+  U32(5);
+  for (llvm::StringRef Str : {"vm", "/", "", "root", "a"}) {
+    U32(Str.size());
+    Expected += Str.str();
+  }
+  U32(0); // name
+  U32(1); // path
+  U32(2); // commit
+  U32(2);
+  U8(2); // root feature
+  U8(0);
+  U32(3);
+  U32(0);
+  U32(0);
+  U8(0); // binary feature
+  U8(1);
+  U32(4);
+  U32(1);
+  U32(1);
+  U8(1); // inessential location
+  U8(0);
+  U32(1);
+  U32(1);
+  U8(1); // or group
+  U32(0);
+  U32(1);
+  U32(1);
+  U32(1);
+  U8(17); // not
+  U8(25); // feature
+  U32(4);
+
+  auto FM = FeatureModelBinaryParser(Expected).buildFeatureModel();
+  ASSERT_TRUE(FM);
+  auto *A = FM->getFeature("a");
+  ASSERT_TRUE(A);
+  EXPECT_TRUE(llvm::isa<BinaryFeature>(A));
+  EXPECT_TRUE(llvm::isa<RootFeature>(FM->getRoot()));
+  ASSERT_TRUE(A->hasLocations());
+  EXPECT_EQ(A->getLocationsBegin()->getCategory(),
+            FeatureSourceRange::Category::inessential);
+  ASSERT_TRUE(llvm::isa<Relationship>(A->getParent()));
+  EXPECT_EQ(llvm::cast<Relationship>(A->getParent())->getKind(),
+            Relationship::RelationshipKind::RK_OR);
+  ASSERT_EQ(std::distance(FM->constraints().begin(), FM->constraints().end()),
+            1);
+  EXPECT_EQ((*FM->constraints().begin())->toString(), "!a");
+  EXPECT_EQ(FeatureModelBinaryWriter(*FM).writeFeatureModel(), Expected);
+
+  // Tags of abstract or unknown kinds are rejected.
+  for (uint8_t Tag : {0, 16, 19, 23, 26}) {
+    std::string Invalid = Expected;
+    Invalid[Invalid.size() - 6] = static_cast<char>(Tag);
+    EXPECT_FALSE(FeatureModelBinaryParser(Invalid).buildFeatureModel())
+        << static_cast<int>(Tag);
+  }
+}
+
+TEST(BinaryWriter, malformedInput) {
+  auto FM = FeatureModelXmlParser::fromFile(getTestResource("test.xml"))
+                ->buildFeatureModel();
+  ASSERT_TRUE(FM);
+  auto Binary = FeatureModelBinaryWriter(*FM).writeFeatureModel();
+  ASSERT_TRUE(Binary.has_value());
+
+  for (size_t Size = 0; Size < Binary->size(); Size += 7) {
+    EXPECT_FALSE(FeatureModelBinaryParser(Binary->substr(0, Size))
+                     .buildFeatureModel())
+        << Size;
+  }
+  EXPECT_FALSE(
+      FeatureModelBinaryParser(Binary->substr(0, Binary->size() - 1))
+          .buildFeatureModel());
+  EXPECT_FALSE(FeatureModelBinaryParser(*Binary + "x").verifyFeatureModel());
+  EXPECT_FALSE(FeatureModelBinaryParser("<?xml version=\"1.0\"?>")
+                   .verifyFeatureModel());
+  EXPECT_TRUE(FeatureModelBinaryParser(*Binary).verifyFeatureModel());
+}
+
 } // namespace vara::feature
@@ -0,0 +1,64 @@
+#include "vara/Feature/FeatureOrdering.h"
+#include "vara/Feature/FeatureModel.h"
+
+#include "gtest/gtest.h"
+
+namespace vara::feature {
+
+class FeatureOrderingTest : public ::testing::Test {
+protected:
+  void SetUp() override {
+    FeatureModelBuilder B;
+    B.makeFeature<BinaryFeature>("a");
+    B.addEdge("a", "aa")->makeFeature<BinaryFeature>("aa");
+    B.addEdge("a", "ab")->makeFeature<BinaryFeature>("ab");
+    B.makeFeature<BinaryFeature>("b");
+    B.addEdge("b", "ba")->makeFeature<BinaryFeature>("ba");
+    B.addEdge("b", "bb")->makeFeature<BinaryFeature>("bb");
+    FM = B.buildFeatureModel();
+    assert(FM);
+  }
+
+  static std::vector<std::string> names(const FeatureOrdering &FO) {
+    std::vector<std::string> Names;
+    for (const auto *F : FO) {
+      Names.emplace_back(F->getName());
+    }
+    return Names;
+  }
+
+  std::unique_ptr<FeatureModel> FM;
+};
+
+TEST_F(FeatureOrderingTest, insert) {
+  FeatureOrdering FO;
+  for (const auto *Name : {"bb", "a", "root", "ba", "ab", "b", "aa"}) {
+    FO.insert(FM->getFeature(Name));
+  }
+
+  EXPECT_EQ(names(FO), std::vector<std::string>(
+                           {"root", "a", "aa", "ab", "b", "ba", "bb"}));
+  // Inserting a feature again keeps it once.
+  FO.insert(FM->getFeature("ba"));
+  EXPECT_EQ(FO.size(), FM->size());
+}
+
+TEST_F(FeatureOrderingTest, removeAndInsertBlock) {
+  FeatureOrdering FO;
+  for (auto *F : FM->features()) {
+    FO.push_back(F);
+  }
+
+  FO.remove(llvm::SmallPtrSet<Feature *, 4>{
+      FM->getFeature("a"), FM->getFeature("aa"), FM->getFeature("ab")});
+  FO.remove(FM->getFeature("a"));
+  EXPECT_EQ(names(FO), std::vector<std::string>({"root", "b", "ba", "bb"}));
+
+  std::vector<Feature *> Block = {FM->getFeature("a"), FM->getFeature("aa"),
+                                  FM->getFeature("ab")};
+  FO.insertBlock(Block.begin(), Block.end());
+  EXPECT_EQ(names(FO), std::vector<std::string>(
+                           {"root", "a", "aa", "ab", "b", "ba", "bb"}));
+}
+
+} // namespace vara::feature
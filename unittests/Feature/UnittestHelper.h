@@ -1,6 +1,9 @@
 #ifndef UNITTEST_HELPER_H
 #define UNITTEST_HELPER_H
 
+#include "vara/Feature/Constraint.h"
+#include "vara/Feature/Feature.h"
+
 #include "llvm/ADT/StringRef.h"
 #include "llvm/ADT/Twine.h"
 
@@ -9,4 +12,22 @@ inline std::string getTestResource(llvm::StringRef ResourcePath = "") {
   return (llvm::Twine(BasePath) + ResourcePath).str();
 }
 
+namespace vara::feature {
+
+/// \returns a constraint for a feature, which is resolved by name
+inline std::unique_ptr<Constraint> feature(const std::string &Name) {
+  return std::make_unique<PrimaryFeatureConstraint>(
+      std::make_unique<Feature>(Name));
+}
+
+inline std::unique_ptr<Constraint> integer(int Value) {
+  return std::make_unique<PrimaryIntegerConstraint>(Value);
+}
+
+inline std::unique_ptr<Constraint> neg(std::unique_ptr<Constraint> C) {
+  return std::make_unique<NotConstraint>(std::move(C));
+}
+
+} // namespace vara::feature
+
 #endif // UNITTEST_HELPER_H
@@ -0,0 +1,85 @@
+#include "vara/Feature/VersionedFeatureModel.h"
+
+#include "gtest/gtest.h"
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+namespace vara::feature {
+
+class VersionedFeatureModelTest : public ::testing::Test {
+protected:
+  void SetUp() override {
+    FeatureModelBuilder B;
+    B.makeFeature<BinaryFeature>("a");
+    auto FM = B.buildFeatureModel();
+    assert(FM);
+    VFM = std::make_unique<VersionedFeatureModel>(std::move(FM));
+  }
+
+  /// Publish a new version with one more feature.
+  bool addFeature(const std::string &Name) {
+    return VFM->update([&Name](FeatureModelCopyTransaction &FT) {
+      FT.addFeature(std::make_unique<BinaryFeature>(Name), nullptr);
+    });
+  }
+
+  std::unique_ptr<VersionedFeatureModel> VFM;
+};
+
+TEST_F(VersionedFeatureModelTest, snapshotKeepsVersion) {
+  auto Old = VFM->snapshot();
+  ASSERT_TRUE(addFeature("b"));
+  auto New = VFM->snapshot();
+
+  EXPECT_EQ(Old.getVersion(), 0);
+  EXPECT_EQ(New.getVersion(), 1);
+  EXPECT_FALSE(Old->getFeature("b"));
+  EXPECT_TRUE(New->getFeature("b"));
+  EXPECT_TRUE(Old->getFeature("a"));
+
+  // The old version is still pinned.
+  VFM->reclaim();
+  EXPECT_EQ(VFM->getNumRetired(), 1);
+  Old = std::move(New);
+  VFM->reclaim();
+  EXPECT_EQ(VFM->getNumRetired(), 0);
+  EXPECT_TRUE(Old->getFeature("b"));
+}
+
+TEST_F(VersionedFeatureModelTest, concurrentReaders) {
+  constexpr int NumVersions = 100;
+  std::atomic<bool> Done{false};
+  std::atomic<bool> Consistent{true};
+  std::vector<std::thread> Readers;
+  for (int I = 0; I < 4; ++I) {
+    Readers.emplace_back([this, &Done, &Consistent]() {
+      uint64_t Last = 0;
+      while (!Done.load()) {
+        auto S = VFM->snapshot();
+        // Version n consists of the root, "a" and n added features.
+        if (S.getVersion() < Last || S->size() != S.getVersion() + 2 ||
+            std::distance(S->begin(), S->end()) !=
+                static_cast<long>(S.getVersion() + 2)) {
+          Consistent.store(false);
+        }
+        Last = S.getVersion();
+      }
+    });
+  }
+  for (int I = 0; I < NumVersions; ++I) {
+    EXPECT_TRUE(addFeature("f" + std::to_string(I)));
+  }
+  Done.store(true);
+  for (auto &Reader : Readers) {
+    Reader.join();
+  }
+
+  EXPECT_TRUE(Consistent.load());
+  EXPECT_EQ(VFM->snapshot().getVersion(), NumVersions);
+  VFM->reclaim();
+  EXPECT_EQ(VFM->getNumRetired(), 0);
+}
+
+} // namespace vara::feature